@@ -0,0 +1,93 @@
+// benchmark of DataIO for a struct whose members are all dumpable but has
+// padding: opt_save/opt_load pack members with one ensureWrite/ensureRead,
+// DataIO_saveObject/DataIO_loadObject serialize member by member
+#include <terark/io/DataIO.hpp>
+#include <terark/io/MemStream.hpp>
+#include <terark/util/profiling.hpp>
+#include <terark/valvec.hpp>
+
+using namespace terark;
+
+struct Record {
+	uint64_t id;
+	uint8_t  type;
+	// 3 bytes padding
+	uint32_t flags;
+	uint16_t shard;
+	// 6 bytes padding
+	double   score;
+	uint32_t a1, a2, a3, a4;
+	uint8_t  b1, b2;
+	// 6 bytes padding
+	uint64_t c1, c2, c3;
+	uint16_t d1, d2, d3;
+	// 2 bytes padding
+	float    e1, e2;
+	// 4 bytes padding
+	DATA_IO_LOAD_SAVE(Record, &id&type&flags&shard&score&a1&a2&a3&a4
+		&b1&b2&c1&c2&c3&d1&d2&d3&e1&e2)
+};
+
+int main(int argc, char* argv[]) {
+	size_t num = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000;
+	size_t rounds = argc > 2 ? strtoul(argv[2], NULL, 10) : 100;
+	valvec<Record> recs(num, valvec_reserve());
+	for (size_t i = 0; i < num; ++i) {
+		Record r;
+		memset(&r, 0, sizeof(r));
+		r.id = i; r.type = uint8_t(i); r.flags = uint32_t(i * 7);
+		r.shard = uint16_t(i); r.score = i * 0.5;
+		r.a1 = r.a2 = r.a3 = r.a4 = uint32_t(i);
+		r.b1 = r.b2 = uint8_t(i >> 8);
+		r.c1 = r.c2 = r.c3 = i * 3;
+		r.d1 = r.d2 = r.d3 = uint16_t(i >> 4);
+		r.e1 = r.e2 = float(i);
+		recs.unchecked_push_back(r);
+	}
+	profiling pf;
+	NativeDataOutput<AutoGrownMemIO> dio1, dio2;
+	valvec<Record> out1(num), out2(num);
+	NativeDataInput<MemIO> din1, din2;
+	long long save1 = 0, save2 = 0, load1 = 0, load2 = 0;
+	for (size_t r = 0; r <= rounds; ++r) { // round 0 is warm up
+		long long t0, t1, t2;
+		dio1.rewind();
+		dio2.rewind();
+		t0 = pf.now();
+		for (size_t i = 0; i < num; ++i)
+			dio1 << recs[i];
+		t1 = pf.now();
+		for (size_t i = 0; i < num; ++i)
+			DataIO_saveObject(dio2, recs[i]);
+		t2 = pf.now();
+		if (r) save1 += t1 - t0, save2 += t2 - t1;
+		din1.set(dio1.begin(), dio1.tell());
+		din2.set(dio2.begin(), dio2.tell());
+		t0 = pf.now();
+		for (size_t i = 0; i < num; ++i)
+			din1 >> out1[i];
+		t1 = pf.now();
+		for (size_t i = 0; i < num; ++i)
+			DataIO_loadObject(din2, out2[i]);
+		t2 = pf.now();
+		if (r) load1 += t1 - t0, load2 += t2 - t1;
+	}
+	if (dio1.tell() != dio2.tell() || memcmp(dio1.begin(), dio2.begin(), dio1.tell())) {
+		fprintf(stderr, "ERROR: packed output is different from member-wise\n");
+		return 1;
+	}
+	for (size_t i = 0; i < num; ++i) {
+		if (memcmp(&out1[i], &recs[i], sizeof(Record)) ||
+			memcmp(&out2[i], &recs[i], sizeof(Record))) {
+			fprintf(stderr, "ERROR: loaded record %zd is different\n", i);
+			return 1;
+		}
+	}
+	printf("records = %zd, rounds = %zd, packed size = %zd, sizeof = %zd\n",
+		num, rounds, size_t(dio1.tell() / num), sizeof(Record));
+	printf("save: packed %8.3f ns/rec, member-wise %8.3f ns/rec\n",
+		pf.nf(save1) / (num * rounds), pf.nf(save2) / (num * rounds));
+	printf("load: packed %8.3f ns/rec, member-wise %8.3f ns/rec\n",
+		pf.nf(load1) / (num * rounds), pf.nf(load2) / (num * rounds));
+	return 0;
+}
@@ -1,6 +1,7 @@
 #define _CRT_SECURE_NO_WARNINGS
 #define _SCL_SECURE_NO_WARNINGS
 #include <terark/fsa/mre_match.hpp>
+#include <terark/fsa/re2/lazy_dfa.hpp>
 #include <terark/util/linebuf.hpp>
 #include <terark/util/profiling.hpp>
 #include <getopt.h>
@@ -20,21 +21,31 @@ using namespace terark;
 int main(int argc, char* argv[]) {
 	bool verbose = false;
 	bool lower_case = false;
+	const char* lazy_regex_file = NULL;
 	MultiRegexMatchOptions mrOpt;
-	for (int opt=0; (opt = getopt(argc, argv, "D:i:lv")) != -1; ) {
+	for (int opt=0; (opt = getopt(argc, argv, "D:i:lr:v")) != -1; ) {
 		switch (opt) {
 		case '?': return 1;
 		case 'D': mrOpt.enableDynamicDFA = atoi(optarg) != 0; break;
 		case 'i': mrOpt.dfaFilePath = optarg;       break;
 		case 'l': lower_case = true; break;
+		case 'r': lazy_regex_file = optarg; break;
 		case 'v': verbose  = true;         break;
 		}
 	}
-	if (mrOpt.dfaFilePath.empty()) {
-		fprintf(stderr, "usage: -i dfa_file must be provided!\n");
+	if (lazy_regex_file) {
+		terark::profiling pf;
+		long long t0 = pf.now();
+		mrOpt.load_regex_lazy(lazy_regex_file);
+		printf("time(load_regex_lazy)=%f's\n", pf.sf(t0, pf.now()));
+	}
+	else if (mrOpt.dfaFilePath.empty()) {
+		fprintf(stderr, "usage: -i dfa_file or -r regex_file must be provided!\n");
 		return 1;
 	}
-	mrOpt.load_dfa();
+	else {
+		mrOpt.load_dfa();
+	}
 	std::unique_ptr<MultiRegexFullMatch>
 				all(MultiRegexFullMatch::create(mrOpt));
 	terark::profiling pf;
@@ -80,6 +91,8 @@ int main(int argc, char* argv[]) {
 			, pf.uf(t0,t1)/lineno
 			);
 	printf("sum hit num = %zd, %.1f Hits Per Second\n", sumhit, sumhit / pf.sf(t0,t1));
+	if (mrOpt.get_lazy_dfa())
+		mrOpt.get_lazy_dfa()->print_stats(stdout);
 	printf("time=%f's lines=%ld all(includes missed)=%ld QPS=%f Throughput=%f'MiB Latency=%f'us\n"
 			, pf.sf(t0,t1)
 			, lineno
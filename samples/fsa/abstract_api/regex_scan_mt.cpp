@@ -0,0 +1,79 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define _SCL_SECURE_NO_WARNINGS
+#include <terark/fsa/mre_match.hpp>
+#include <terark/util/mmap.hpp>
+#include <terark/util/profiling.hpp>
+#include <getopt.h>
+#include <atomic>
+
+using namespace terark;
+
+void usage(const char* prog) {
+	fprintf(stderr, R"EOS(Usage: %s Options Text-File
+Options:
+    -i DFA-File: built by regex_build, with -a for scan(search) semantic
+    -t Threads: default 8
+    -b Lookback: bytes to speculate the start state of a chunk, default 256
+    -L Line delimited mode: match each line independently
+    -v Verify the result by single thread match
+)EOS", prog);
+}
+
+int main(int argc, char* argv[]) {
+	bool lines_mode = false;
+	bool verify = false;
+	size_t threads = 8;
+	size_t lookback = 256;
+	MultiRegexMatchOptions mrOpt;
+	for (int opt=0; (opt = getopt(argc, argv, "b:i:Lt:v")) != -1; ) {
+		switch (opt) {
+		case '?': usage(argv[0]); return 1;
+		case 'b': lookback = strtoul(optarg, NULL, 10); break;
+		case 'i': mrOpt.dfaFilePath = optarg; break;
+		case 'L': lines_mode = true; break;
+		case 't': threads = std::max(1, atoi(optarg)); break;
+		case 'v': verify = true; break;
+		}
+	}
+	if (mrOpt.dfaFilePath.empty() || optind >= argc) {
+		usage(argv[0]);
+		return 1;
+	}
+	mrOpt.load_dfa();
+	std::unique_ptr<MultiRegexFullMatch> fm(MultiRegexFullMatch::create(mrOpt));
+	MmapWholeFile mmap((const char*)argv[optind]);
+	fstring text = mmap.memory();
+	profiling pf;
+	if (lines_mode) {
+		std::atomic<size_t> matched(0), hits(0);
+		long long t0 = pf.now();
+		fm->parallel_match_all_lines(text, threads,
+			[&](size_t, const MultiRegexFullMatch& m, fstring) {
+				matched++;
+				hits += m.size();
+			});
+		long long t1 = pf.now();
+		printf("lines: threads=%zd time=%f's matched=%zd hits=%zd Throughput=%f'MiB\n"
+			, threads, pf.sf(t0,t1), matched.load(), hits.load()
+			, text.size()/pf.uf(t0,t1));
+		return 0;
+	}
+	long long t0 = pf.now();
+	size_t num = fm->parallel_match_all(text, threads, lookback);
+	long long t1 = pf.now();
+	printf("whole: threads=%zd time=%f's matched regex=%zd Throughput=%f'MiB\n"
+		, threads, pf.sf(t0,t1), num, text.size()/pf.uf(t0,t1));
+	if (verify) {
+		valvec<int> par(fm->begin(), fm->size());
+		long long t2 = pf.now();
+		fm->match_all(text);
+		long long t3 = pf.now();
+		valvec<int> ser(fm->begin(), fm->size());
+		printf("single: time=%f's matched regex=%zd Throughput=%f'MiB speedup=%f %s\n"
+			, pf.sf(t2,t3), ser.size(), text.size()/pf.uf(t2,t3)
+			, pf.sf(t2,t3) / pf.sf(t0,t1), par == ser ? "same" : "DIFFERENT");
+		if (par != ser)
+			return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,235 @@
+// loopback load generator of MultiReactorServer: each client thread keeps
+// Depth requests in flight on each of its connections, reports requests/s
+// and latency percentiles. Without -C, an echo server is started in process.
+#include <terark/inet/MultiReactorServer.hpp>
+#include <terark/inet/MessageInputStream.hpp>
+#include <terark/util/profiling.hpp>
+#include <terark/valvec.hpp>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <getopt.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+using namespace terark;
+using rpc::MessageHeader;
+
+int usage(const char* prog) {
+	fprintf(stderr, R"EOS(Usage: %s Options
+Options:
+    -S Addr: run server only at Addr, until stdin is closed
+    -C Addr: run client only, connect to server at Addr
+    -r Reactors: server reactor threads, default hardware_concurrency
+    -f Fibers: fibers per reactor, 0 call handler inline, default 16
+    -t Threads: client threads, default 2
+    -c Conns: connections per client thread, default 4
+    -d Depth: requests in flight per connection, default 8
+    -s Size: request payload size, default 64
+    -T Seconds: test time, default 5
+)EOS", prog);
+	return 1;
+}
+
+static const uint32_t WHOLE = uint32_t(MSG_HEADER_WHOLE) << MSG_HEADER_SHIFT;
+
+struct ClientConn {
+	int fd;
+	valvec<byte_t> rbuf;
+	size_t rtail = 0;
+	valvec<llong> sendTime; // indexed by seqid % depth
+	uint32_t nextSeq = 0;
+};
+
+struct ClientResult {
+	size_t requests = 0;
+	valvec<llong> lat; // ns
+};
+
+static int connect_to(const char* addr) {
+	const char* colon = strrchr(addr, ':');
+	std::string ip(addr, colon);
+	struct sockaddr_in sa; memset(&sa, 0, sizeof(sa));
+	sa.sin_family = AF_INET;
+	sa.sin_port = htons(uint16_t(atoi(colon + 1)));
+	inet_pton(AF_INET, ip.c_str(), &sa.sin_addr);
+	int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (connect(fd, (struct sockaddr*)&sa, sizeof(sa)) < 0) {
+		fprintf(stderr, "ERROR: connect(%s) = %s\n", addr, strerror(errno));
+		exit(2);
+	}
+	int one = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	return fd;
+}
+
+static void send_all(int fd, const valvec<byte_t>& buf) {
+	for (size_t pos = 0; pos < buf.size(); ) {
+		ssize_t n = send(fd, buf.data() + pos, buf.size() - pos, MSG_NOSIGNAL);
+		if (n <= 0) {
+			fprintf(stderr, "ERROR: send() = %s\n", strerror(errno));
+			exit(2);
+		}
+		pos += n;
+	}
+}
+
+static void append_request(ClientConn& c, valvec<byte_t>& out,
+						   const valvec<byte_t>& payload, size_t depth, llong now) {
+	MessageHeader h;
+	h.length = uint32_t(payload.size());
+	h.seqid = c.nextSeq++;
+	h.partid = WHOLE;
+	c.sendTime[h.seqid % depth] = now;
+	h.convert();
+	out.append((const byte_t*)&h, sizeof(h));
+	out.append(payload.data(), payload.size());
+}
+
+// each connection has depth requests in flight, a reply is followed by a
+// new request, thus seqid % depth identifies the slot of the request
+static void client_thread(const char* addr, size_t conns, size_t depth,
+						  size_t size, const std::atomic<bool>* stop,
+						  ClientResult* res) {
+	profiling pf;
+	valvec<byte_t> payload(size, 'a');
+	valvec<ClientConn> cc(conns);
+	valvec<struct pollfd> pfds(conns);
+	valvec<byte_t> out;
+	for (size_t i = 0; i < conns; ++i) {
+		ClientConn& c = cc[i];
+		c.fd = connect_to(addr);
+		c.rbuf.resize_no_init(std::max<size_t>(size + sizeof(MessageHeader), 64*1024));
+		c.sendTime.resize(depth);
+		out.erase_all();
+		for (size_t j = 0; j < depth; ++j)
+			append_request(c, out, payload, depth, pf.now());
+		send_all(c.fd, out);
+		pfds[i].fd = c.fd;
+		pfds[i].events = POLLIN;
+	}
+	res->lat.reserve(1 << 20);
+	while (!stop->load(std::memory_order_relaxed)) {
+		if (poll(pfds.data(), conns, 100) <= 0)
+			continue;
+		for (size_t i = 0; i < conns; ++i) {
+			if (!(pfds[i].revents & POLLIN))
+				continue;
+			ClientConn& c = cc[i];
+			ssize_t n = recv(c.fd, c.rbuf.data() + c.rtail, c.rbuf.size() - c.rtail, 0);
+			if (n <= 0) {
+				fprintf(stderr, "ERROR: recv() = %s\n", n ? strerror(errno) : "closed");
+				exit(2);
+			}
+			c.rtail += n;
+			llong now = pf.now();
+			size_t pos = 0;
+			out.erase_all();
+			while (c.rtail - pos >= sizeof(MessageHeader)) {
+				MessageHeader h;
+				memcpy(&h, c.rbuf.data() + pos, sizeof(h));
+				h.convert();
+				if (c.rtail - pos < sizeof(h) + h.length)
+					break;
+				pos += sizeof(h) + h.length;
+				res->lat.push_back(now - c.sendTime[h.seqid % depth]);
+				res->requests++;
+				append_request(c, out, payload, depth, now);
+			}
+			memmove(c.rbuf.data(), c.rbuf.data() + pos, c.rtail - pos);
+			c.rtail -= pos;
+			send_all(c.fd, out);
+		}
+	}
+	for (auto& c : cc)
+		close(c.fd);
+}
+
+int main(int argc, char* argv[]) {
+	MultiReactorServer::Options sopt;
+	const char* serverAddr = NULL;
+	const char* clientAddr = NULL;
+	size_t threads = 2, conns = 4, depth = 8, size = 64;
+	double seconds = 5;
+	for (int c; (c = getopt(argc, argv, "c:C:d:f:r:s:S:t:T:")) != -1; ) {
+		switch (c) {
+		case '?': return usage(argv[0]);
+		case 'c': conns = std::max(1, atoi(optarg)); break;
+		case 'C': clientAddr = optarg; break;
+		case 'd': depth = std::max(1, atoi(optarg)); break;
+		case 'f': sopt.fibers = atoi(optarg); break;
+		case 'r': sopt.reactors = atoi(optarg); break;
+		case 's': size = strtoul(optarg, NULL, 10); break;
+		case 'S': serverAddr = optarg; break;
+		case 't': threads = std::max(1, atoi(optarg)); break;
+		case 'T': seconds = atof(optarg); break;
+		}
+	}
+	auto echo = [](MultiReactorServer::Request* req) {
+		req->reply(req->data()); // data points into the read buffer
+	};
+	try {
+		if (serverAddr) {
+			MultiReactorServer server(serverAddr, sopt, echo);
+			server.start();
+			printf("listening on port %d, reactors = %d\n", server.port(), server.reactors());
+			char buf[256];
+			while (read(0, buf, sizeof(buf)) > 0) {}
+			auto st = server.stats();
+			printf("accepted = %zd, requests = %zd\n", st.accepted, st.requests);
+			return 0;
+		}
+		std::unique_ptr<MultiReactorServer> server;
+		std::string addr;
+		if (clientAddr) {
+			addr = clientAddr;
+		} else {
+			server.reset(new MultiReactorServer("127.0.0.1:0", sopt, echo));
+			server->start();
+			addr = "127.0.0.1:" + std::to_string(server->port());
+		}
+		std::atomic<bool> stop(false);
+		valvec<ClientResult> res(threads);
+		valvec<std::thread> thr(threads, valvec_reserve());
+		profiling pf;
+		llong t0 = pf.now();
+		for (size_t i = 0; i < threads; ++i)
+			thr.emplace_back(&client_thread, addr.c_str(), conns, depth, size, &stop, &res[i]);
+		usleep(useconds_t(seconds * 1e6));
+		stop = true;
+		for (auto& t : thr)
+			t.join();
+		llong t1 = pf.now();
+		valvec<llong> lat;
+		size_t requests = 0;
+		for (auto& r : res) {
+			requests += r.requests;
+			lat.append(r.lat.begin(), r.lat.end());
+		}
+		std::sort(lat.begin(), lat.end());
+		auto pct = [&](double p) {
+			return lat.empty() ? 0.0 : pf.uf(lat[std::min(lat.size()-1, size_t(lat.size()*p))]);
+		};
+		printf("threads = %zd, conns = %zd, depth = %zd, size = %zd",
+			threads, threads * conns, depth, size);
+		if (server)
+			printf(", reactors = %d, fibers = %d", server->reactors(), sopt.fibers);
+		printf("\nrequests = %zd, %.1f K req/s\n", requests, requests / pf.mf(t0, t1));
+		printf("latency us: p50 = %.1f, p99 = %.1f, p999 = %.1f, max = %.1f\n",
+			pct(0.5), pct(0.99), pct(0.999), lat.empty() ? 0.0 : pf.uf(lat.back()));
+		if (server) {
+			auto st = server->stats();
+			printf("server: accepted = %zd, requests = %zd, recv = %zd, send = %zd\n",
+				st.accepted, st.requests, st.recvBytes, st.sendBytes);
+		}
+	}
+	catch (const std::exception& ex) {
+		fprintf(stderr, "ERROR: %s\n", ex.what());
+		return 3;
+	}
+	return 0;
+}
@@ -2,6 +2,7 @@
 #include <iostream>
 #include <terark/rpc/client.hpp>
 #include <terark/inet/SocketStream.hpp>
+#include <terark/util/profiling.hpp>
 
 using namespace std;
 using namespace terark;
@@ -83,6 +84,45 @@ try {
 		printVec(vec3);
 	}
 	client.wait_pending_async();
+
+	// chatty workload: many small calls, sync vs batched futures
+	const int nCalls = argc > 1 ? atoi(argv[1]) : 10000;
+	const int nBatch = 100;
+	profiling pf;
+	long long t0 = pf.now();
+	for (int i = 0; i < nCalls; ++i) {
+		if (obj1->get_val(i) != i)
+			throw std::logic_error("get_val: bad result");
+	}
+	long long t1 = pf.now();
+	std::vector<std::future<rpc_ret_t> > futures(nBatch);
+	for (int i = 0; i < nCalls; i += nBatch) {
+		int n = std::min(nBatch, nCalls - i);
+		{
+			rpc_client_base::batch_scope batch(&client);
+			for (int j = 0; j < n; ++j)
+				futures[j] = obj1->get_val.async_future(i + j);
+		}
+		client.wait_pending_async();
+		for (int j = 0; j < n; ++j) {
+			if (futures[j].get() != i + j)
+				throw std::logic_error("get_val.async_future: bad result");
+		}
+	}
+	long long t2 = pf.now();
+	printf("calls = %d, sync: %.3f us/call, batched future: %.3f us/call\n",
+		nCalls, pf.uf(t0, t1) / nCalls, pf.uf(t1, t2) / nCalls);
+
+	// server function throws on empty string, the future gets the exception
+	std::future<rpc_ret_t> ferr = obj1->get_len.async_future(std::string());
+	client.wait_pending_async();
+	try {
+		ferr.get();
+		throw std::logic_error("get_len.async_future: expect rpc_exception");
+	}
+	catch (const rpc_exception& exp) {
+		printf("get_len(\"\") failed as expected: %s\n", exp.what());
+	}
 	return 0;
 }
 catch (const std::exception& exp)
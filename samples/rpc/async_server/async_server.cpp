@@ -19,16 +19,21 @@ using namespace terark::rpc;
 
 #include "../test.h"
 
+static bool g_verbose = true;
+
 // use macro for convenient
 BEGIN_RPC_IMP_INTERFACE(SampleRPC_Imp1, AsyncInterface)
 	rpc_ret_t get_val(rpc_in<int> x)
 	{
-		std::cout << "AsyncInterface::get_val(rpc_in<int> x=" << x.r << ")\n";
+		if (g_verbose)
+			std::cout << "AsyncInterface::get_val(rpc_in<int> x=" << x.r << ")\n";
 		return x.r;
 	}
 	rpc_ret_t get_len(const std::string& x)
 	{
 		std::cout << "AsyncInterface::get_len(const std::string& x=\"" << x << "\")\n";
+		if (x.empty()) // client gets rpc_ret_exception
+			throw std::invalid_argument("get_len: empty string");
 		return x.size();
 	}
 	rpc_ret_t squareVec(vint_vec& x)
@@ -79,6 +84,13 @@ int main0(int argc, char* argv[])
 	try {
 		SocketAcceptor acceptor("0.0.0.0:8001");
 		rpc_server<PortableDataInput, PortableDataOutput> server(&acceptor);
+		// usage: async_server [-q] [WorkerThreads]
+		for (int i = 1; i < argc; ++i) {
+			if (strcmp(argv[i], "-q") == 0)
+				g_verbose = false;
+			else
+				server.set_worker_threads(atoi(argv[i]));
+		}
 
 		// register rpc implementation class...
 		RPC_SERVER_AUTO_CREATE(server, SampleRPC_Imp1);
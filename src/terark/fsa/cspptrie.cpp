@@ -20,6 +20,7 @@
 #include <terark/util/small_memcpy.hpp>
 #include <terark/util/hugepage.hpp>
 #include <terark/util/mmap.hpp>
+#include <terark/util/crc.hpp>
 #include <terark/util/profiling.hpp>
 #include <terark/num_to_str.hpp>
 #include "fast_search_byte.hpp"
@@ -403,6 +404,8 @@ void PatriciaMem<Align>::init(ConcurrentLevel conLevel) {
     m_fd = -1;
     m_appdata_offset = size_t(-1);
     m_appdata_length = 0;
+    m_vm_reserved = 0;
+    m_persist = nullptr;
     m_writing_concurrent_level = conLevel;
     m_mempool_concurrent_level = conLevel;
 }
@@ -904,6 +907,8 @@ try
     case     NoWriteReadOnly: memset(&m_mempool_lock_free, 0, sizeof(m_mempool_lock_free)); break; // do nothing
     }
     HugePageEnum use_hugepage = HugePageEnum::kNone;
+    bool vm_grow = false;
+    bool persist = false;
     if (!fpath.empty() && '?' == fpath[0]) {
         // indicate fpath is a config string
         if (const char* valstr = fpath.strstr("hugepage=")) {
@@ -915,6 +920,14 @@ try
                 WARN("ignoring bad hugepage: ?%s", valstr);
             }
         }
+        if (const char* valstr = fpath.strstr("vm_grow=")) {
+            valstr += strlen("vm_grow=");
+            vm_grow = parseBooleanRelaxed(valstr, false);
+        }
+        if (const char* valstr = fpath.strstr("persist=")) {
+            valstr += strlen("persist=");
+            persist = parseBooleanRelaxed(valstr, false);
+        }
         if (MultiWriteMultiRead == concurrentLevel) {
             if (const char* valstr = fpath.strstr("chunk_size=")) {
                 valstr += strlen("chunk_size=");
@@ -955,8 +968,15 @@ try
         }
     }
     else {
-        if (fpath.empty()) {
-            alloc_mempool_space(maxMem, use_hugepage);
+        if (persist && !fpath.empty()) {
+            if (persist_open(fpath, maxMem, use_hugepage, vm_grow))
+                return; // root is loaded
+        }
+        else if (fpath.empty()) {
+            if (vm_grow && concurrentLevel >= OneWriteMultiRead)
+                alloc_mempool_space_growable(maxMem, use_hugepage);
+            else
+                alloc_mempool_space(maxMem, use_hugepage);
         }
         else {
             // negtive maxMem indicate "virtual memory", which use mmap
@@ -1056,6 +1076,428 @@ void PatriciaMem<Align>::alloc_mempool_space(intptr_t maxMem, HugePageEnum use_h
     }
 }
 
+// reserve address space of max mempool size, and just commit abs(maxMem),
+// the mempool grows by vm_grow on demand, node ids are offsets in reserved
+// address space, so there is no copy and readers are not affected by grow.
+template<size_t Align>
+void PatriciaMem<Align>::
+alloc_mempool_space_growable(intptr_t maxMem, HugePageEnum use_hugepage) {
+    const size_t reserve = size_t(16) << 30; // max 16G, as alloc_mempool_space
+    size_t init = pow2_align_up(size_t(std::abs(maxMem)), hugepage_size);
+    init = std::min(std::max(init, hugepage_size), reserve);
+    byte_t* mem = (byte_t*)vm_reserve(reserve);
+#if !defined(_MSC_VER) && defined(MADV_HUGEPAGE)
+    // MAP_HUGETLB(kMmap) can not be committed on demand, use transparent
+    if (HugePageEnum::kNone != use_hugepage) {
+        if (madvise(mem, reserve, MADV_HUGEPAGE) != 0) {
+            WARN("madvise(MADV_HUGEPAGE, size=%zd[0x%zX]) = %s",
+                 reserve, reserve, strerror(errno));
+        }
+    }
+#else
+    TERARK_UNUSED_VAR(use_hugepage);
+#endif
+    if (!vm_commit(mem, init)) {
+        vm_release(mem, reserve);
+        THROW_STD(length_error, "vm_commit(size = %zd) failed", init);
+    }
+    m_is_virtual_alloc = true;
+    m_vm_reserved = reserve;
+    m_mempool.risk_set_data(mem);
+    m_mempool.risk_set_capacity(init);
+    if (m_mempool_concurrent_level >= MultiWriteMultiRead) {
+        m_mempool_lock_free.m_vm_reserved = reserve;
+    }
+}
+
+// for OneWriteMultiRead, MultiWriteMultiRead grows in ThreadCacheMemPool
+template<size_t Align>
+terark_no_inline
+bool PatriciaMem<Align>::vm_grow(size_t request) {
+    size_t cap = m_mempool.capacity();
+    size_t mincap = m_mempool.size() + pow2_align_up(request, AlignSize);
+    if (mincap > m_vm_reserved) {
+        return false;
+    }
+    // double the capacity, but at most 1G each time
+    size_t newcap = std::max(mincap, cap + std::min(cap, size_t(1) << 30));
+    newcap = std::min(pow2_align_up(newcap, hugepage_size), m_vm_reserved);
+    if (!vm_commit(m_mempool.data() + cap, newcap - cap)) {
+        return false;
+    }
+    m_mempool.risk_set_capacity(newcap);
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////
+// persistent mode, file layout of file_path:
+//   [0K, 4K) header slot 0, [4K, 8K) header slot 1, [8K, ...) mempool image
+// header of seq is written to slot (seq % 2), the valid header with max seq
+// is the current one, a torn header write is detected by checksum.
+// redo journal file_path.jnl: header, page ids, pages, crc of all these.
+// persist_sync: write journal -> fdatasync -> apply pages to image ->
+// fdatasync -> write header -> fdatasync, a journal is replayed on open if
+// it is complete and its seq is current seq + 1, else it is discarded.
+// pages to sync are marked dirty on alloc and on in place writes of nodes.
+struct PatriciaPersistHeader {
+    char     magic[16];
+    uint64_t seq;
+    uint64_t mem_size;
+    uint64_t valsize;
+    uint64_t align_size;
+    uint64_t n_words;
+    uint64_t n_nodes;
+    uint64_t max_word_len;
+    uint64_t adfa_total_words_len;
+    uint64_t zpath_states;
+    uint64_t total_zpath_len;
+    uint64_t appdata_offset;
+    uint64_t appdata_length;
+    uint64_t kv_delim;
+    uint64_t jnl_pages; // only for journal, num of pages follow the header
+    uint64_t checksum;  // crc32c of all above fields
+
+    static const char s_magic[16];
+    static const size_t PageSize = 4096;
+    static const size_t DataOffset = 2 * PageSize;
+    uint64_t calc_checksum() const {
+        return Crc32c_update(0, this, offsetof(PatriciaPersistHeader, checksum));
+    }
+    bool is_valid() const {
+        return memcmp(magic, s_magic, sizeof(magic)) == 0
+            && calc_checksum() == checksum;
+    }
+    // all but seq, jnl_pages and checksum
+    bool same_state(const PatriciaPersistHeader& y) const {
+        return memcmp(&mem_size, &y.mem_size,
+                      offsetof(PatriciaPersistHeader, jnl_pages) -
+                      offsetof(PatriciaPersistHeader, mem_size)) == 0;
+    }
+};
+const char PatriciaPersistHeader::s_magic[16] = "PatriciaPersist";
+
+struct PatriciaPersistFile {
+    std::string fpath;
+    intptr_t fd  = -1;
+    intptr_t jfd = -1; // journal
+    PatriciaPersistHeader head; // current committed header
+    febitvec dirty; // pages written since last persist_sync
+
+    // alloc and in place writes call this, freed memory is not persisted
+    // because free lists are not persisted
+    void mark(size_t pos, size_t len) {
+        const size_t PageSize = PatriciaPersistHeader::PageSize;
+        size_t beg = pos / PageSize;
+        size_t end = (pos + len + PageSize - 1) / PageSize;
+        if (dirty.size() < end)
+            dirty.resize(end);
+        dirty.beg_end_set1(beg, end);
+    }
+
+    ~PatriciaPersistFile() {
+  #if !defined(_MSC_VER)
+        if (fd  >= 0) ::close(int(fd));
+        if (jfd >= 0) ::close(int(jfd));
+  #endif
+    }
+};
+
+template<size_t Align>
+inline void PatriciaMem<Align>::persist_mark(size_t pos, size_t len) {
+    if (terark_unlikely(nullptr != m_persist))
+        m_persist->mark(pos, len);
+}
+
+template<size_t Align>
+void PatriciaMem<Align>::persist_mark_dirty(const void* mem, size_t len) {
+    if (nullptr == m_persist)
+        return;
+    auto pos = (const byte_t*)mem - m_mempool.data();
+    TERARK_VERIFY_LE(size_t(pos) + len, m_mempool.size());
+    m_persist->mark(pos, len);
+}
+
+#if defined(_MSC_VER)
+
+template<size_t Align>
+bool PatriciaMem<Align>::
+persist_open(fstring fpath, intptr_t, HugePageEnum, bool) {
+    THROW_STD(invalid_argument, "persist is not supported on windows: %s", fpath.c_str());
+}
+template<size_t Align>
+size_t PatriciaMem<Align>::persist_sync() {
+    THROW_STD(invalid_argument, "persist is not supported on windows");
+}
+
+#else
+
+static void persist_pwrite(intptr_t fd, const void* buf, size_t len,
+                           size_t offset, const std::string& fpath) {
+    while (len) {
+        ssize_t n = ::pwrite(int(fd), buf, len, offset);
+        if (n < 0) {
+            if (EINTR == errno)
+                continue;
+            THROW_STD(runtime_error, "pwrite(%s, len = %zd, offset = %zd) = %m",
+                      fpath.c_str(), len, offset);
+        }
+        buf = (const byte_t*)buf + n;
+        len -= n;
+        offset += n;
+    }
+}
+
+static size_t persist_pread(intptr_t fd, void* buf, size_t len,
+                            size_t offset, const std::string& fpath) {
+    size_t total = 0;
+    while (total < len) {
+        ssize_t n = ::pread(int(fd), (byte_t*)buf + total, len - total, offset + total);
+        if (n < 0) {
+            if (EINTR == errno)
+                continue;
+            THROW_STD(runtime_error, "pread(%s, len = %zd, offset = %zd) = %m",
+                      fpath.c_str(), len, offset);
+        }
+        if (0 == n)
+            break; // eof
+        total += n;
+    }
+    return total;
+}
+
+static void persist_fdatasync(intptr_t fd, const std::string& fpath) {
+  #if defined(__APPLE__)
+    int ret = ::fsync(int(fd));
+  #else
+    int ret = ::fdatasync(int(fd));
+  #endif
+    if (ret < 0) {
+        THROW_STD(runtime_error, "fdatasync(%s) = %m", fpath.c_str());
+    }
+}
+
+static void persist_truncate(intptr_t fd, const std::string& fpath) {
+    while (::ftruncate(int(fd), 0) < 0) {
+        if (EINTR != errno)
+            THROW_STD(runtime_error, "ftruncate(%s) = %m", fpath.c_str());
+    }
+}
+
+// replay a complete journal whose seq is pf->head.seq + 1, else discard it
+static void persist_recover(PatriciaPersistFile* pf) {
+    typedef PatriciaPersistHeader Header;
+    const std::string jpath = pf->fpath + ".jnl";
+    struct stat st;
+    if (::fstat(int(pf->jfd), &st) < 0) {
+        THROW_STD(runtime_error, "fstat(%s) = %m", jpath.c_str());
+    }
+    if (size_t(st.st_size) > sizeof(Header)) {
+        valvec<byte_t> jnl(st.st_size, valvec_no_init());
+        size_t n = persist_pread(pf->jfd, jnl.data(), jnl.size(), 0, jpath);
+        auto jh = (const Header*)jnl.data();
+        size_t pages = jh->jnl_pages;
+        size_t bytes = sizeof(Header) + pages * (8 + Header::PageSize) + 8;
+        if (n == jnl.size() && jh->is_valid() && bytes == n &&
+                jh->seq == pf->head.seq + 1 &&
+                unaligned_load<uint64_t>(jnl.data() + n - 8) ==
+                Crc32c_update(0, jnl.data(), n - 8)) {
+            auto ids = (const uint64_t*)(jh + 1);
+            auto data = (const byte_t*)(ids + pages);
+            for (size_t i = 0; i < pages; ++i) {
+                size_t offset = ids[i] * Header::PageSize;
+                size_t len = std::min(Header::PageSize, jh->mem_size - offset);
+                persist_pwrite(pf->fd, data + i * Header::PageSize, len,
+                               Header::DataOffset + offset, pf->fpath);
+            }
+            persist_fdatasync(pf->fd, pf->fpath);
+            Header h = *jh;
+            h.jnl_pages = 0;
+            h.checksum = h.calc_checksum();
+            persist_pwrite(pf->fd, &h, sizeof(h), (h.seq % 2) * Header::PageSize, pf->fpath);
+            persist_fdatasync(pf->fd, pf->fpath);
+            pf->head = h;
+            INFO("%s: replayed journal of seq %zd, %zd pages",
+                 pf->fpath.c_str(), size_t(h.seq), pages);
+        }
+    }
+    persist_truncate(pf->jfd, jpath);
+}
+
+/// @returns true if an existing image is loaded
+template<size_t Align>
+bool PatriciaMem<Align>::
+persist_open(fstring fpath, intptr_t maxMem, HugePageEnum use_hugepage, bool growable) {
+    typedef PatriciaPersistHeader Header;
+    auto conLevel = m_mempool_concurrent_level;
+    if (conLevel < SingleThreadStrict || conLevel > OneWriteMultiRead) {
+        THROW_STD(invalid_argument, "persist requires single writer, but ConcurrentLevel = %s",
+                  enum_cstr(conLevel));
+    }
+    std::unique_ptr<PatriciaPersistFile> pf(new PatriciaPersistFile);
+    pf->fpath = fpath.str();
+    pf->fd = ::open(fpath.c_str(), O_RDWR|O_CREAT, 0644);
+    if (pf->fd < 0) {
+        THROW_STD(invalid_argument, "open(%s) = %m", fpath.c_str());
+    }
+    std::string jpath = pf->fpath + ".jnl";
+    pf->jfd = ::open(jpath.c_str(), O_RDWR|O_CREAT, 0644);
+    if (pf->jfd < 0) {
+        THROW_STD(invalid_argument, "open(%s) = %m", jpath.c_str());
+    }
+    memset(&pf->head, 0, sizeof(Header));
+    for (size_t slot = 0; slot < 2; ++slot) {
+        Header h;
+        size_t n = persist_pread(pf->fd, &h, sizeof(h), slot * Header::PageSize, pf->fpath);
+        if (sizeof(h) == n && h.is_valid() && h.seq > pf->head.seq) {
+            pf->head = h;
+        }
+    }
+    persist_recover(pf.get());
+    const Header& h = pf->head;
+    if (h.seq) {
+        if (h.valsize != m_valsize || h.align_size != AlignSize) {
+            THROW_STD(invalid_argument, "%s: valsize = %zd, align = %zd, expect %zd, %zd",
+                      fpath.c_str(), size_t(h.valsize), size_t(h.align_size),
+                      size_t(m_valsize), AlignSize);
+        }
+        // mempool must be able to hold the image and keep growing
+        maxMem = std::max<intptr_t>(std::abs(maxMem), h.mem_size + (h.mem_size >> 1))
+               * (maxMem < 0 ? -1 : 1);
+    }
+    if (growable && conLevel >= OneWriteMultiRead)
+        alloc_mempool_space_growable(maxMem, use_hugepage);
+    else
+        alloc_mempool_space(maxMem, use_hugepage);
+    m_persist = pf.release();
+    if (0 == h.seq) {
+        return false;
+    }
+    if (h.mem_size > m_mempool.capacity()) {
+        TERARK_VERIFY_GE(conLevel, OneWriteMultiRead);
+        TERARK_VERIFY(vm_grow(h.mem_size - m_mempool.capacity()));
+    }
+    auto mem = m_mempool.data();
+    size_t n = persist_pread(m_persist->fd, mem, h.mem_size, Header::DataOffset, m_persist->fpath);
+    if (n != h.mem_size) {
+        THROW_STD(runtime_error, "%s: image is truncated: %zd, expect %zd",
+                  fpath.c_str(), n, size_t(h.mem_size));
+    }
+    if (OneWriteMultiRead == conLevel)
+        m_mempool_fixed_cap.resize_no_init(h.mem_size);
+    else
+        m_mempool_lock_none.resize_no_init(h.mem_size);
+    m_n_words = h.n_words;
+    m_n_nodes = h.n_nodes;
+    m_max_word_len = h.max_word_len;
+    m_adfa_total_words_len = h.adfa_total_words_len;
+    m_zpath_states = h.zpath_states;
+    m_total_zpath_len = h.total_zpath_len;
+    m_appdata_offset = h.appdata_offset;
+    m_appdata_length = h.appdata_length;
+    m_kv_delim = h.kv_delim;
+    return true;
+}
+
+template<size_t Align>
+void PatriciaMem<Align>::
+persist_fill_header(PatriciaPersistHeader* h, uint64_t seq) const {
+    memset(h, 0, sizeof(*h));
+    memcpy(h->magic, PatriciaPersistHeader::s_magic, sizeof(h->magic));
+    h->seq = seq;
+    h->mem_size = m_mempool.size();
+    h->valsize = m_valsize;
+    h->align_size = AlignSize;
+    h->n_words = m_n_words;
+    h->n_nodes = m_n_nodes;
+    h->max_word_len = m_max_word_len;
+    h->adfa_total_words_len = m_adfa_total_words_len;
+    h->zpath_states = m_zpath_states;
+    h->total_zpath_len = m_total_zpath_len;
+    h->appdata_offset = m_appdata_offset;
+    h->appdata_length = m_appdata_length;
+    h->kv_delim = m_kv_delim;
+}
+
+template<size_t Align>
+size_t PatriciaMem<Align>::persist_sync() {
+    typedef PatriciaPersistHeader Header;
+    const size_t PageSize = Header::PageSize;
+    auto pf = m_persist;
+    if (nullptr == pf) {
+        THROW_STD(invalid_argument, "not in persistent mode");
+    }
+    Header h;
+    persist_fill_header(&h, pf->head.seq + 1);
+    const byte_t* mem = m_mempool.data();
+    const size_t size = h.mem_size;
+    const size_t npages = ceiled_div(size, PageSize);
+    if (m_appdata_length) {
+        // appdata is written by user in place
+        pf->mark(m_appdata_offset, m_appdata_length);
+    }
+    valvec<uint64_t> ids; // of dirty pages
+    const size_t ndirty = std::min(npages, pf->dirty.size());
+    for (size_t i = 0; i < ndirty; ++i) {
+        if (pf->dirty.is1(i))
+            ids.push_back(i);
+    }
+    if (ids.empty() && h.same_state(pf->head)) {
+        return 0;
+    }
+    const std::string jpath = pf->fpath + ".jnl";
+    // journal
+    h.jnl_pages = ids.size();
+    h.checksum = h.calc_checksum();
+    uint32_t crc = Crc32c_update(0, &h, sizeof(h));
+    crc = Crc32c_update(crc, ids.data(), ids.used_mem_size());
+    persist_pwrite(pf->jfd, &h, sizeof(h), 0, jpath);
+    size_t joffset = sizeof(h);
+    persist_pwrite(pf->jfd, ids.data(), ids.used_mem_size(), joffset, jpath);
+    joffset += ids.used_mem_size();
+    byte_t tail[PageSize]; // last page may be partial, write it zero padded
+    for (size_t i = 0; i < ids.size(); ) {
+        size_t j = i + 1;
+        while (j < ids.size() && ids[j] == ids[j-1] + 1) j++;
+        size_t offset = ids[i] * PageSize;
+        size_t len = std::min((j - i) * PageSize, size - offset);
+        persist_pwrite(pf->jfd, mem + offset, len, joffset, jpath);
+        crc = Crc32c_update(crc, mem + offset, len);
+        joffset += len;
+        if (len % PageSize) {
+            size_t pad = PageSize - len % PageSize;
+            memset(tail, 0, pad);
+            persist_pwrite(pf->jfd, tail, pad, joffset, jpath);
+            crc = Crc32c_update(crc, tail, pad);
+            joffset += pad;
+        }
+        i = j;
+    }
+    uint64_t crc64 = crc;
+    persist_pwrite(pf->jfd, &crc64, 8, joffset, jpath);
+    persist_fdatasync(pf->jfd, jpath);
+    // apply to image, consecutive pages are written by one pwrite
+    for (size_t i = 0; i < ids.size(); ) {
+        size_t j = i + 1;
+        while (j < ids.size() && ids[j] == ids[j-1] + 1) j++;
+        size_t offset = ids[i] * PageSize;
+        size_t len = std::min((j - i) * PageSize, size - offset);
+        persist_pwrite(pf->fd, mem + offset, len, Header::DataOffset + offset, pf->fpath);
+        i = j;
+    }
+    persist_fdatasync(pf->fd, pf->fpath);
+    // commit
+    h.jnl_pages = 0;
+    h.checksum = h.calc_checksum();
+    persist_pwrite(pf->fd, &h, sizeof(h), (h.seq % 2) * PageSize, pf->fpath);
+    persist_fdatasync(pf->fd, pf->fpath);
+    persist_truncate(pf->jfd, jpath); // obsoleted by seq, no need to sync
+    pf->head = h;
+    pf->dirty.erase_all(); // kept on exception, thus retry writes them
+    return ids.size();
+}
+
+#endif // _MSC_VER
+
 template<size_t Align>
 size_t PatriciaMem<Align>::new_root() {
     size_t root_size = AlignSize * (2 + 256) + m_valsize;
@@ -1102,6 +1544,8 @@ void PatriciaMem<Align>::destroy() {
     if (NoWriteReadOnly != m_writing_concurrent_level) {
         set_readonly();
     }
+    delete m_persist; // changes after last persist_sync are dropped
+    m_persist = nullptr;
     if (conLevel >= MultiWriteMultiRead) {
         TERARK_VERIFY_EQ(m_writer_token_sgl.get(), nullptr);
     }
@@ -1130,7 +1574,7 @@ void PatriciaMem<Align>::destroy() {
             std::terminate();
         }
   #else
-        munmap(m_mempool.data(), m_mempool.capacity());
+        munmap(m_mempool.data(), std::max(m_vm_reserved, m_mempool.capacity()));
   #endif
         m_mempool.risk_release_ownership();
     }
@@ -1231,7 +1675,6 @@ void PatriciaMem<Align>::shrink_to_fit() {}
 size_t MainPatricia::v_num_children(size_t s) const {
     return num_children(s);
 }
-void MainPatricia::compact() {}
 
 size_t
 MainPatricia::state_move_impl(const PatriciaNode* a, size_t curr,
@@ -1327,6 +1770,143 @@ static inline size_t node_size(const PatriciaNode* p, size_t valsize) {
            + (p->meta.b_is_final ? valsize : 0);
 }
 
+void MainPatricia::compact_to(MainPatricia* dst, CompactStat* cs,
+                              const CompactValueFunc& copy_value) const {
+    TERARK_VERIFY_EQ(m_valsize, dst->m_valsize);
+    TERARK_VERIFY_EQ(1, dst->m_n_nodes); // just root
+    TERARK_VERIFY_NE(NoWriteReadOnly, dst->m_writing_concurrent_level);
+    const size_t valsize = m_valsize;
+    const size_t fast_node_size = AlignSize * (2 + 256) + valsize;
+    auto sa = reinterpret_cast<const PatriciaNode*>(m_mempool.data());
+    struct Item {
+        uint32_t src;
+        uint32_t dst_slot; // slot in dst parent to be set
+        uint32_t src_slot; // for locality stat
+        uint32_t depth;    // key len before this node's zpath
+    };
+    valvec<Item> stack(256, valvec_reserve());
+    size_t n_nodes = 0, n_words = 0, max_word_len = 0, total_words_len = 0;
+    size_t zpath_states = 0, total_zpath_len = 0;
+    double old_dist = 0, new_dist = 0;
+    size_t old_near = 0, new_near = 0;
+    stack.push_back({uint32_t(initial_state), 0, 0, 0});
+    while (!stack.empty()) {
+        Item it = stack.pop_val();
+        const PatriciaNode* sp = sa + it.src;
+        const size_t cnt_type = sp->meta.n_cnt_type;
+        const size_t zlen = sp->meta.n_zpath_len;
+        size_t nsize = 15 == cnt_type ? fast_node_size
+                     : pow2_align_up(node_size(sp, valsize), AlignSize);
+        size_t dnode = initial_state; // root was created by dst's cons
+        if (initial_state != it.src) {
+            size_t pos = dst->alloc_aux(nsize);
+            if (size_t(-1) == pos) {
+                THROW_STD(length_error, "dst is full, mem_size = %zd",
+                          dst->mem_size_inline());
+            }
+            dnode = pos / AlignSize;
+        }
+        // reload, data may be realloc'ed for SingleThread levels
+        auto da = reinterpret_cast<PatriciaNode*>(dst->m_mempool.data());
+        memcpy(da + dnode, sp, nsize);
+        da[dnode].meta.b_lazy_free = 0;
+        da[dnode].meta.b_lock = 0;
+        if (initial_state != it.src) {
+            da[it.dst_slot].child = uint32_t(dnode);
+            size_t od = AlignSize * (it.src > it.src_slot ? it.src - it.src_slot
+                                                          : it.src_slot - it.src);
+            size_t nd = AlignSize * (dnode - it.dst_slot);
+            old_dist += od; old_near += od < 4096;
+            new_dist += nd; new_near += nd < 4096;
+        }
+        n_nodes++;
+        if (zlen) {
+            zpath_states++;
+            total_zpath_len += zlen;
+        }
+        if (sp->meta.b_is_final) {
+            size_t wlen = it.depth + zlen;
+            n_words++;
+            total_words_len += wlen;
+            maximize(max_word_len, wlen);
+            if (copy_value) {
+                copy_value(dst, da->bytes + get_valpos(da, dnode),
+                                sa->bytes + get_valpos(sa, it.src));
+            }
+        }
+        const uint32_t depth = uint32_t(it.depth + zlen + 1);
+        auto push = [&](size_t slot) {
+            uint32_t child = sa[it.src + slot].child;
+            if (nil_state != child)
+                stack.push_back({child, uint32_t(dnode + slot),
+                                 uint32_t(it.src + slot), depth});
+        };
+        // push in reverse order, thus children are copied in lex order
+        switch (cnt_type) {
+        default: TERARK_DIE("bad cnt_type = %zd", cnt_type); break;
+        case 0: break;
+        case 2: push(2); no_break_fallthrough;
+        case 1: push(1); break;
+        case 3: case 4: case 5: case 6:
+            for (size_t i = cnt_type; i-- > 0; ) push(2 + i);
+            break;
+        case 7: case 8:
+            for (size_t i = sp->big.n_children; i-- > 0; )
+                push(s_skip_slots[cnt_type] + i);
+            break;
+        case 15:
+            for (size_t ch = 256; ch-- > 0; ) push(2 + ch);
+            break;
+        }
+    }
+    if (size_t(-1) != m_appdata_offset) {
+        void* appdata = dst->alloc_appdata(m_appdata_length);
+        TERARK_VERIFY_F(nullptr != appdata, "dst is full, appdata_len = %zd",
+                        m_appdata_length);
+        memcpy(appdata, appdata_ptr(), m_appdata_length);
+    }
+    dst->m_n_nodes = n_nodes;
+    dst->m_n_words = n_words;
+    dst->m_max_word_len = max_word_len;
+    dst->m_zpath_states = zpath_states;
+    dst->m_total_zpath_len = total_zpath_len;
+    dst->m_adfa_total_words_len = total_words_len;
+    dst->m_kv_delim = m_kv_delim;
+    dst->persist_mark(0, dst->mem_size_inline()); // root of dst is written in place
+    if (cs) {
+        size_t edges = std::max<size_t>(n_nodes - 1, 1);
+        cs->num_nodes = n_nodes;
+        cs->old_mem_size = mem_size_inline();
+        cs->old_frag_size = mem_frag_size();
+        cs->new_mem_size = dst->mem_size_inline();
+        cs->old_avg_dist = old_dist / edges;
+        cs->new_avg_dist = new_dist / edges;
+        cs->old_near_ratio = double(old_near) / edges;
+        cs->new_near_ratio = double(new_near) / edges;
+    }
+}
+
+void MainPatricia::compact(CompactStat* cs) {
+    TERARK_VERIFY_EQ(SingleThreadStrict, m_writing_concurrent_level);
+    TERARK_VERIFY_EQ(0, m_live_iter_num);
+    MainPatricia tmp(m_valsize, mem_size_inline(), SingleThreadStrict);
+    compact_to(&tmp, cs);
+    // node ids of tmp are valid in this, because both root are at 0
+    auto& mp = m_mempool_lock_none;
+    mp.erase_all(); // also clear freelist
+    mp.resize_no_init(tmp.mem_size_inline());
+    memcpy(mp.data(), tmp.m_mempool.data(), tmp.mem_size_inline());
+    persist_mark(0, tmp.mem_size_inline());
+    m_appdata_offset = tmp.m_appdata_offset;
+    m_appdata_length = tmp.m_appdata_length;
+    m_n_nodes = tmp.m_n_nodes;
+    m_n_words = tmp.m_n_words;
+    m_max_word_len = tmp.m_max_word_len;
+    m_zpath_states = tmp.m_zpath_states;
+    m_total_zpath_len = tmp.m_total_zpath_len;
+    m_adfa_total_words_len = tmp.m_adfa_total_words_len;
+}
+
 struct MainPatricia::NodeInfo {
     uint16_t n_skip = UINT16_MAX;
     uint16_t n_children = UINT16_MAX;
@@ -1399,10 +1979,17 @@ size_t PatriciaMem<Align>::alloc_raw(size_t nodeSize, LazyFreeListTLS* tls) {
         return m_mempool_lock_free.alloc(nodeSize, tls);
     }
     else if (ConLevel == OneWriteMultiRead) {
-        return m_mempool_fixed_cap.alloc(nodeSize);
+        size_t pos = m_mempool_fixed_cap.alloc(nodeSize);
+        if (terark_unlikely(size_t(-1) == pos) && m_vm_reserved && vm_grow(nodeSize))
+            pos = m_mempool_fixed_cap.alloc(nodeSize);
+        if (size_t(-1) != pos)
+            persist_mark(pos, nodeSize);
+        return pos;
     }
     else {
-        return m_mempool_lock_none.alloc(nodeSize);
+        size_t pos = m_mempool_lock_none.alloc(nodeSize);
+        persist_mark(pos, nodeSize);
+        return pos;
     }
 }
 
@@ -1661,6 +2248,7 @@ auto update_curr_ptr = [&](size_t newCurr, size_t nodeIncNum) {
     this->m_adfa_total_words_len += key.size();
     this->m_total_zpath_len += key.size() - pos - nodeIncNum;
     a[curr_slot].child = uint32_t(newCurr);
+    persist_mark(AlignSize * curr_slot, AlignSize);
     maximize(this->m_max_word_len, key.size());
 };
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -1880,6 +2468,8 @@ TERARK_ASSERT_LE(pos, key.size());
         m_adfa_total_words_len += key.size() - pos - 1;
         a[curr+2+ch].child = suffix_node;
         a[curr+1].big.n_children++;
+        persist_mark(AlignSize * (curr+1), AlignSize);
+        persist_mark(AlignSize * (curr+2+ch), AlignSize);
         maximize(m_max_word_len, key.size());
     }
     return true;
@@ -1952,6 +2542,8 @@ MarkFinalStateOnFastNode: {
     m_stat.n_mark_final++;
     m_adfa_total_words_len += key.size();
     a[curr].meta.b_is_final = true;
+    persist_mark(AlignSize * curr, AlignSize);
+    persist_mark(valpos, valsize);
     return true;
 }
 MarkFinalState: {
@@ -1967,6 +2559,7 @@ MarkFinalStateOmitSetNodeInfo:
         size_t oldpos = AlignSize*curr;
         size_t newpos = m_mempool_lock_none.alloc3(oldpos, oldlen, newlen);
         size_t newcur = newpos / AlignSize;
+        persist_mark(newpos, newlen);
         bool initOk = token->init_value(value, valsize);
         assert(initOk); TERARK_UNUSED_VAR(initOk);
         a = reinterpret_cast<PatriciaNode*>(m_mempool.data());
@@ -1977,10 +2570,12 @@ MarkFinalStateOmitSetNodeInfo:
         m_n_words += 1;
         m_adfa_total_words_len += key.size();
         a[curr_slot].child = uint32_t(newcur);
+        persist_mark(AlignSize * curr_slot, AlignSize);
     }
     else if (ConLevel == SingleThreadShared) {
         size_t newpos = m_mempool_lock_none.alloc(newlen);
         size_t newcur = newpos / AlignSize;
+        persist_mark(newpos, newlen);
         bool initOk = token->init_value(value, valsize);
         assert(initOk); TERARK_UNUSED_VAR(initOk);
         a = reinterpret_cast<PatriciaNode*>(m_mempool.data());
@@ -3106,6 +3701,7 @@ template<size_t Align>
 size_t PatriciaMem<Align>::mem_alloc3(size_t oldpos, size_t oldsize, size_t newsize) {
     TERARK_VERIFY(SingleThreadStrict == m_writing_concurrent_level);
     size_t pos = m_mempool_lock_none.alloc3(oldpos * AlignSize, oldsize, newsize);
+    persist_mark(pos, newsize);
     return pos / AlignSize;
 }
 
@@ -3217,7 +3813,7 @@ void* PatriciaMem<Align>::alloc_appdata(size_t len) {
     if (size_t(-1) == offset) {
         return nullptr;
     }
-    size_t len1 = offset - offset % appdata_align;
+    size_t len1 = pow2_align_up(offset, appdata_align) - offset;
     size_t len2 = extlen - len1 - len;
     TERARK_VERIFY_AL(len1, AlignSize);
     TERARK_VERIFY_AL(len2, AlignSize);
@@ -73,6 +73,9 @@ BOOST_STATIC_ASSERT(sizeof(PatriciaNode) == 4);
 
 #define PatriciaNode_IsValid(x) (x.meta.n_cnt_type <= 8 || x.meta.n_cnt_type == 15)
 
+struct PatriciaPersistFile;   // defined in cspptrie.cpp
+struct PatriciaPersistHeader; // defined in cspptrie.cpp
+
 template<size_t Align>
 class TERARK_DLL_EXPORT PatriciaMem : public Patricia {
 public:
@@ -146,6 +149,8 @@ protected:
     intptr_t  m_fd;
     size_t    m_appdata_offset;
     size_t    m_appdata_length;
+    size_t    m_vm_reserved; // > 0 if mempool is growable, see vm_grow
+    PatriciaPersistFile* m_persist; // not null in persistent mode
 
     union {
         MemPool_CompileX<AlignSize> m_mempool;
@@ -201,6 +206,11 @@ protected:
 
     enum class HugePageEnum { kNone = 0, kMmap = 1, kTransparent = 2 };
     void alloc_mempool_space(intptr_t maxMem, HugePageEnum);
+    void alloc_mempool_space_growable(intptr_t maxMem, HugePageEnum);
+    bool vm_grow(size_t request);
+    bool persist_open(fstring fpath, intptr_t maxMem, HugePageEnum, bool growable);
+    void persist_fill_header(PatriciaPersistHeader*, uint64_t seq) const;
+    void persist_mark(size_t pos, size_t len);
 
     template<ConcurrentLevel>
     size_t revoke_expired_nodes();
@@ -231,6 +241,11 @@ protected:
 public:
     PatriciaMem();
 
+    /// fpath may be a config string "?key=val&...", vm_grow=1 reserves
+    /// address space of max mempool size and commits abs(maxMem) initially,
+    /// then the mempool grows on demand instead of failing at maxMem,
+    /// vm_grow is ignored for single thread levels, they grow by realloc.
+    /// persist=1 with file_path enables persistent mode, see persist_sync
     explicit
     PatriciaMem(size_t valsize,
                 intptr_t maxMem = 512<<10,
@@ -262,6 +277,25 @@ public:
 
     void shrink_to_fit();
 
+    /// persistent mode is for single writer levels(SingleThreadStrict,
+    /// SingleThreadShared, OneWriteMultiRead), the trie is in memory and
+    /// file_path is reloaded on open. persist_sync writes pages changed
+    /// since last sync to a redo journal(file_path.jnl), then to file_path,
+    /// then commits a double buffered header with checksum, so a reopened
+    /// trie is always the state of the last completed persist_sync, changes
+    /// after it are lost as if they were never inserted.
+    /// it must be called by the writer when it is not inserting, readers
+    /// are not blocked. free lists are not persisted, reopened trie loses
+    /// fragments until compact
+    /// @returns num of pages written
+    size_t persist_sync();
+
+    /// persist_sync writes only pages marked dirty by the trie itself, a
+    /// value changed in place by user(such as through token value()) must be
+    /// marked by this function, it is a noop if not in persistent mode
+    void persist_mark_dirty(const void* mem, size_t len);
+    bool is_persistent() const { return nullptr != m_persist; }
+
     static const size_t mem_alloc_fail = size_t(-1) / AlignSize;
 
     size_t new_root();
@@ -394,7 +428,31 @@ public:
         assert(1 == a[s].meta.n_cnt_type);
         return a[s+1].child;
     }
-    void compact();
+    struct CompactStat {
+        size_t num_nodes = 0;
+        size_t old_mem_size = 0;  ///< mem_size() of src
+        size_t old_frag_size = 0; ///< mem_frag_size() of src
+        size_t new_mem_size = 0;  ///< mem_size() of dst
+        double old_avg_dist = 0;  ///< avg bytes between parent and child
+        double new_avg_dist = 0;
+        double old_near_ratio = 0; ///< ratio of children in 4K of parent
+        double new_near_ratio = 0;
+        size_t reclaimed() const { return old_mem_size - std::min(old_mem_size, new_mem_size); }
+    };
+    /// called for each value copied by compact_to, values are memcpy'ed
+    /// before calling it, it is for values which refer to mempool positions
+    typedef std::function<void(MainPatricia* dst, void* dst_val,
+                               const void* src_val)> CompactValueFunc;
+
+    /// copy all nodes into dst in DFS order, thus nodes are densely packed
+    /// and children are near to parent. dst must be an empty trie with same
+    /// valsize. writers of this trie must be stopped, readers can keep going
+    /// while compacting, then the owner swaps this trie with dst
+    void compact_to(MainPatricia* dst, CompactStat* = nullptr,
+                    const CompactValueFunc& = nullptr) const;
+
+    /// compact in place, SingleThreadStrict only
+    void compact(CompactStat* = nullptr);
 
     fstring get_zpath_data(size_t state, MatchContext* = NULL) const {
         TERARK_ASSERT_LT(state, total_states());
@@ -26,6 +26,7 @@ template<class StateID, int Sigma
 		,class StateFlags = DenseStateFlags<StateID> >
 struct DenseStateV2 : public StateFlags {
 	typedef static_bitmap<Sigma*2, bm_uint_t> MyBitMap;
+	enum { sigma = Sigma };
 	enum { PoolAlign = sizeof(StateID) };
 	enum { DenseBitIdx = 0, SparseBitIdx = 1 };
 	static const StateID nil_state = StateID(-1);
@@ -52,6 +53,14 @@ struct DenseStateV2 : public StateFlags {
 	}
 	size_t getpos() const { return m_pos * PoolAlign; }
 
+	size_t sparse_bytes(size_t n_sparse) const {
+		switch (this->sparse_width()) {
+		default: return sizeof(StateID) * n_sparse;
+		case 1:  return 2 * n_sparse;
+		case 2:  return 3 * n_sparse;
+		}
+	}
+
 	int num_children() const {
 		int n = 0;
 		for (int i = 0; i < MyBitMap::BlockN; ++i) {
@@ -179,6 +188,12 @@ public:
 	static const StateID max_state = State::max_state;
 	typedef State state_t;
 
+	/// labels of State::bits, if it is less than sigma, chars are mapped to
+	/// byte classes by the class map at the head of pool, see build_compact
+	enum { label_num = State::sigma };
+	static const bool has_byte_class = int(label_num) < int(sigma);
+	static_assert(!has_byte_class || label_num <= 256, "label_num <= 256");
+
 	bool has_freelist() const override final { return true; }
 
 	void init() {
@@ -186,6 +201,11 @@ public:
 		m_dfa_cluster_num = 0;
 		m_dyn_sigma = sigma;
         states.push_back(State()); // initial_state
+		if (has_byte_class) { // all chars are in class 0, no transitions
+			size_t pos = pool.alloc(pool.align_to(sigma));
+			TERARK_VERIFY_EQ(pos, 0);
+			memset(pool.data(), 0, sigma);
+		}
         firstFreeState = nil_state;
         numFreeStates  = 0;
         transition_num = 0;
@@ -200,6 +220,46 @@ public:
 
 	const valvec<State>& internal_get_states() const { return states; }
 	const MyMemPool    & internal_get_pool  () const { return pool  ; }
+
+	/// @returns NULL if !has_byte_class
+	const byte_t* byte_class_map() const {
+		return has_byte_class ? pool.data() : NULL;
+	}
+	size_t num_byte_class() const {
+		if (!has_byte_class)
+			return sigma;
+		return *std::max_element(pool.data(), pool.data() + sigma) + 1;
+	}
+	size_t label_of(auchar_t ch) const {
+		assert(ch < sigma);
+		return has_byte_class ? pool.data()[ch] : ch;
+	}
+	StateID sparse_target(const State& s, const byte_t* trans, size_t idx)
+	const {
+		assert(&s >= states.data() && &s < states.data() + states.size());
+		switch (s.sparse_width()) {
+		default: assert(0); no_break_fallthrough;
+		case 0:
+			return reinterpret_cast<const StateID*>(trans)[idx];
+		case 1:
+			return StateID((&s - states.data()) +
+						   reinterpret_cast<const int16_t*>(trans)[idx]);
+		case 2: {
+			const byte_t* p = trans + 3 * idx;
+			intptr_t d = p[0] | p[1] << 8 | intptr_t(int8_t(p[2])) << 16;
+			return StateID((&s - states.data()) + d);
+		  }
+		}
+	}
+	/// states built by build_compact are read only
+	void check_mutable(const State& x) const {
+		if (has_byte_class || x.sparse_width()) {
+			THROW_STD(invalid_argument,
+				"compact layout is read only, state = %zd",
+				size_t(&x - states.data()));
+		}
+	}
+
     size_t total_states() const { return states.size(); }
     size_t total_transitions() const { return transition_num; }
     size_t new_state() override final {
@@ -224,6 +284,7 @@ public:
         assert(source < states.size());
         size_t y = new_state();
         const State& s = states[source];
+		check_mutable(s);
 		states[y] = s;
 		size_t n_sparse = s.num_sparse();
 		if (n_sparse) {
@@ -256,6 +317,7 @@ public:
         assert(s < states.size());
 		State& x = states[s];
 		assert(!x.is_pzip()); // must be non-path-zipped
+		check_mutable(x);
 		if (nil_state != x.m_pos) {
 			size_t n_sparse = x.num_sparse();
 			assert(n_sparse > 0);
@@ -314,6 +376,8 @@ public:
 	}
 	bool more_than_one_child(state_id_t s) const {
         assert(s < (state_id_t)states.size());
+		if (has_byte_class)
+			return num_children(s) > 1;
 		const State& x = states[s];
 		return x.bits.popcnt() > 1;
 	}
@@ -336,7 +400,11 @@ public:
 	auchar_t get_single_child_char(state_id_t parent) const {
 		assert(0 == m_zpath_states);
         assert(parent < (state_id_t)states.size());
-	    return states[parent].get_single_child_char();
+		auchar_t lab = states[parent].get_single_child_char();
+		if (has_byte_class)
+			return auchar_t(std::find(pool.data(), pool.data() + sigma, lab)
+						  - pool.data());
+	    return lab;
 	}
 
     state_id_t state_move(state_id_t curr, auchar_t ch) const {
@@ -347,8 +415,9 @@ public:
 	}
     state_id_t state_move(const State& s, auchar_t ch) const {
 		assert(ch < sigma);
-		bm_uint_t b = s.bits.block(ch / (sizeof(bm_uint_t)*4))
-							   >> (ch % (sizeof(bm_uint_t)*4)) * 2;
+		size_t lab = label_of(ch);
+		bm_uint_t b = s.bits.block(lab / (sizeof(bm_uint_t)*4))
+							   >> (lab % (sizeof(bm_uint_t)*4)) * 2;
 		switch (b & 3) {
 		default: abort(); break; // avoid warning
 		case 0:
@@ -361,10 +430,12 @@ public:
 			return s.dense_target2;
 		case 2: // only sparse bit is set
 		  {
-			size_t idx = s.idx_sparse(ch);
-			assert(idx <= ch);
-			const StateID* trans = &pool.template at<StateID>(s.getpos());
-			return trans[idx];
+			size_t idx = s.idx_sparse(lab);
+			assert(idx <= lab);
+			const byte_t* trans = pool.data() + s.getpos();
+			if (terark_likely(0 == s.sparse_width()))
+				return reinterpret_cast<const StateID*>(trans)[idx];
+			return sparse_target(s, trans, idx);
 		  }
 		}
 		return nil_state;
@@ -375,6 +446,7 @@ public:
         assert(s < (state_id_t)states.size());
 		State& x = states[s];
 		assert(!x.is_free());
+		check_mutable(x);
 		bm_uint_t b = x.bits.block(ch / (sizeof(bm_uint_t)*4))
 							   >> (ch % (sizeof(bm_uint_t)*4)) * 2;
 		assert(b & 3);
@@ -422,6 +494,7 @@ public:
 	void add_all_move(size_t s, const CharTarget<size_t>* trans, size_t n)
 	override final {
 		State& x = states[s];
+		check_mutable(x);
 		assert(x.bits.is_all0());
 		assert(!x.is_free());
 		assert(!x.is_pzip());
@@ -436,25 +509,8 @@ public:
 			StateID children[sigma];
 			for(size_t i = 0; i < n; ++i)
 				children[i] = trans[i].target;
-			std::sort(children, children+n);
-			for(size_t i = 0; i < n; ) {
-				size_t j = i+1;
-				while (j < n && children[j] == children[i]) ++j;
-				if (max_freq1 < j - i) {
-					if (max_freq2 < max_freq1) {
-						max_freq2 = max_freq1;
-						max_dest2 = max_dest1;
-					}
-					max_freq1 = j - i;
-					max_dest1 = children[i];
-				}
-			   	else if (max_freq2 < j - i) {
-					max_freq2 = j - i;
-					max_dest2 = children[i];
-				}
-				i = j;
-			}
-			assert(max_freq1 + max_freq2 <= n);
+			pick_dense_targets(children, n, &max_dest1, &max_freq1,
+											&max_dest2, &max_freq2);
 		}
 		StateID* p_sparse = NULL;
 		size_t alsize = 0;
@@ -487,6 +543,36 @@ public:
 		assert(x.num_dense2() == (int)max_freq2);
 	}
 
+	/// 2 most frequent targets are encoded by dense bits, children is sorted
+	static void
+	pick_dense_targets(StateID* children, size_t n,
+					   StateID* dest1, size_t* freq1,
+					   StateID* dest2, size_t* freq2) {
+		size_t max_freq1 = 0; StateID max_dest1 = nil_state;
+		size_t max_freq2 = 0; StateID max_dest2 = nil_state;
+		std::sort(children, children+n);
+		for(size_t i = 0; i < n; ) {
+			size_t j = i+1;
+			while (j < n && children[j] == children[i]) ++j;
+			if (max_freq1 < j - i) {
+				if (max_freq2 < max_freq1) {
+					max_freq2 = max_freq1;
+					max_dest2 = max_dest1;
+				}
+				max_freq1 = j - i;
+				max_dest1 = children[i];
+			}
+			else if (max_freq2 < j - i) {
+				max_freq2 = j - i;
+				max_dest2 = children[i];
+			}
+			i = j;
+		}
+		assert(max_freq1 + max_freq2 <= n);
+		*dest1 = max_dest1; *freq1 = max_freq1;
+		*dest2 = max_dest2; *freq2 = max_freq2;
+	}
+
 protected:
     size_t
 	add_move_imp(size_t source, size_t target, auchar_t ch, bool OverwriteExisted)
@@ -499,6 +585,7 @@ protected:
 	//	ASSERT_isNotFree(target);
 		assert(!states[source].is_pzip());
         State& s = states[source];
+		check_mutable(s);
 		StateID old_target = nil_state;
 		size_t idx = s.idx_sparse(ch);
 		size_t n_sparse = s.num_sparse();
@@ -618,7 +705,15 @@ public:
 	size_t v_num_children(size_t s) const override { return num_children(s); }
 	size_t num_children(size_t curr) const {
 		assert(curr < states.size());
-		return states[curr].num_children();
+		const State& s = states[curr];
+		if (has_byte_class) {
+			const byte_t* cmap = pool.data();
+			size_t n = 0;
+			for (size_t ch = 0; ch < sigma; ++ch)
+				n += s.bits.is1(2*cmap[ch]) || s.bits.is1(2*cmap[ch]+1);
+			return n;
+		}
+		return s.num_children();
 	}
 
     template<class OP> // use ctz (count trailing zero)
@@ -637,11 +732,31 @@ public:
 	void for_each_dest(state_id_t curr, OP op) const {
 		for_each_move(curr, [&](StateID t, auchar_t){op(t);});
 	}
-    template<class OP> // use ctz (count trailing zero)
+    template<class OP>
 	void for_each_move(state_id_t curr, OP op) const {
+		if (has_byte_class) {
+			StateID targets[label_num];
+			std::fill_n(targets, size_t(label_num), nil_state);
+			for_each_label_move(curr,
+				[&](StateID t, auchar_t lab) { targets[lab] = t; });
+			const byte_t* cmap = pool.data();
+			for (size_t ch = 0; ch < sigma; ++ch) {
+				StateID t = targets[cmap[ch]];
+				if (nil_state != t)
+					op(t, auchar_t(ch));
+			}
+		}
+		else { // op may be noncopyable
+			for_each_label_move(curr,
+				[&](StateID t, auchar_t ch) { op(t, ch); });
+		}
+	}
+	/// same as for_each_move if !has_byte_class, else iterate byte classes
+    template<class OP> // use ctz (count trailing zero)
+	void for_each_label_move(state_id_t curr, OP op) const {
 		ASSERT_isNotFree(curr);
         const State& s = states[curr];
-		const StateID* trans = NULL;
+		const byte_t* trans = NULL;
 	#ifndef NDEBUG
 		size_t n_sparse = s.num_sparse();
 	#endif
@@ -651,7 +766,7 @@ public:
 			// use (nil_state != s.m_pos) as the condition is
 			// just for performance reason, computing n_sparse is slower
 			assert(n_sparse > 0 || s.is_pzip());
-			trans = &pool.template at<StateID>(s.getpos());
+			trans = pool.data() + s.getpos();
 		} else {
 			assert(0 == n_sparse && !s.is_pzip());
 		}
@@ -677,7 +792,7 @@ public:
 				case 2: // sparse only
 				   	assert(NULL != trans);
 					assert(pos < n_sparse);
-				   	target = trans[pos++];
+				   	target = sparse_target(s, trans, pos++);
 					assert(target < states.size());
 					break;
 				case 3: // dense & sparse
@@ -718,6 +833,8 @@ public:
 	};
 
 	void compact() {
+		for (size_t i = 0; i < states.size(); ++i)
+			check_mutable(states[i]);
 		gold_hash_map<StateID, int> freq;
 		MyMemPool tmp(sizeof(StateID) * sigma);
 #define DenseDFA_V2_compact_leftbrace { // for editor's auto brace match
@@ -867,6 +984,7 @@ public:
         assert(len <= 255);
 		State& x = states[s];
 		assert(!x.is_pzip());
+		check_mutable(x);
 		size_t newpos;
 		size_t n_sparse = x.num_sparse();
 		size_t oldlen = sizeof(StateID) * n_sparse; // unaligned
@@ -892,10 +1010,206 @@ public:
 		size_t pos = states[s].getpos();
 		size_t n_sparse = states[s].num_sparse();
 		const char*  zbeg = reinterpret_cast<const char*>(pool.data());
-		const size_t zpos = pos + sizeof(StateID) * n_sparse;
+		const size_t zpos = pos + states[s].sparse_bytes(n_sparse);
 		return fstring(zbeg + zpos+1, pool.byte_at(zpos));
 	}
 
+	/// Build a read only copy of src with a cache oriented layout:
+	///  - roots are states [0, nRoots), other states are numbered by BFS
+	///    order, if hotness is not NULL, hotter states are moved to front,
+	///    hotness[s] is the visit count of src state s
+	///  - pool data are laid out in state order
+	///  - sparse targets of a state are stored as 16 or 24 bit delta of
+	///    state id if all of them fit
+	///  - if has_byte_class, chars are mapped to byte classes
+	/// @returns false if byte classes are more than label_num
+	template<class SrcDFA>
+	bool build_compact(const valvec<size_t>& roots, const SrcDFA& src,
+					   const size_t* hotness = NULL) {
+		return build_compact(roots.data(), roots.size(), src, hotness);
+	}
+	template<class SrcDFA>
+	bool build_compact(const size_t* pRoots, size_t nRoots, const SrcDFA& src,
+					   const size_t* hotness = NULL) {
+		typedef typename SrcDFA::state_id_t src_state_id_t;
+		TERARK_VERIFY_GE(nRoots, 1);
+		const size_t nil = size_t(-1);
+		valvec<src_state_id_t> order; // new id to src id
+		valvec<size_t> s2ds(src.total_states(), nil);
+		{
+			BFS_GraphWalker<src_state_id_t> walker;
+			walker.resize(src.total_states());
+			for (size_t i = 0; i < nRoots; ++i) {
+				size_t r = pRoots[i];
+				TERARK_VERIFY_LT(r, src.total_states());
+				if (nil == s2ds[r]) {
+					s2ds[r] = i;
+					walker.putRoot(r);
+				}
+				order.push_back(r); // duplicate roots are cloned
+			}
+			while (!walker.is_finished()) {
+				src_state_id_t curr = walker.next();
+				if (nil == s2ds[curr]) {
+					s2ds[curr] = order.size();
+					order.push_back(curr);
+				}
+				walker.putChildren(&src, curr);
+			}
+		}
+		if (hotness) {
+			std::stable_sort(order.begin() + nRoots, order.end(),
+				[hotness](src_state_id_t x, src_state_id_t y) {
+					return hotness[x] > hotness[y];
+				});
+			for (size_t i = nRoots; i < order.size(); ++i)
+				s2ds[order[i]] = i;
+		}
+		uint16_t cmap[sigma]; // char to label
+		size_t nlabel = sigma;
+		for (size_t ch = 0; ch < sigma; ++ch) cmap[ch] = uint16_t(ch);
+		if (has_byte_class) {
+			// refine the partition of chars by transitions of each state
+			std::fill_n(cmap, size_t(sigma), 0);
+			valvec<size_t> csize(1, size_t(sigma));
+			valvec<CharTarget<size_t> > moves;
+			for (size_t i = 0; i < order.size(); ++i) {
+				moves.erase_all();
+				src.for_each_move(order[i], [&](src_state_id_t t, auchar_t c) {
+					assert(c < sigma);
+					moves.emplace_back(c, size_t(t));
+				});
+				std::sort(moves.begin(), moves.end(),
+					[&](const CharTarget<size_t>& x, const CharTarget<size_t>& y) {
+						if (cmap[x.ch] != cmap[y.ch])
+							return cmap[x.ch] < cmap[y.ch];
+						return x.target < y.target;
+					});
+				for (size_t j = 0; j < moves.size(); ) {
+					size_t cls = cmap[moves[j].ch], k = j;
+					while (k < moves.size() && cmap[moves[k].ch] == cls) ++k;
+					bool keep = k - j == csize[cls]; // all chars of cls
+					for (size_t l = j; l < k; ) {
+						size_t m = l + 1;
+						while (m < k && moves[m].target == moves[l].target) ++m;
+						if (keep)
+							keep = false; // first group keeps cls
+						else {
+							for (size_t u = l; u < m; ++u)
+								cmap[moves[u].ch] = uint16_t(csize.size());
+							csize.push_back(m - l);
+							csize[cls] -= m - l;
+						}
+						l = m;
+					}
+					j = k;
+				}
+				if (csize.size() > label_num)
+					return false;
+			}
+			uint16_t remap[sigma]; // number classes by their first char
+			std::fill_n(remap, size_t(sigma), uint16_t(-1));
+			nlabel = 0;
+			for (size_t ch = 0; ch < sigma; ++ch) {
+				if (uint16_t(-1) == remap[cmap[ch]])
+					remap[cmap[ch]] = uint16_t(nlabel++);
+				cmap[ch] = remap[cmap[ch]];
+			}
+			assert(csize.size() == nlabel);
+		}
+		this->erase_all();
+		this->resize_states(order.size());
+		if (has_byte_class) {
+			for (size_t ch = 0; ch < sigma; ++ch)
+				pool.data()[ch] = byte_t(cmap[ch]);
+		}
+		StateID lab_target[sigma];
+		for (size_t y = 0; y < order.size(); ++y) {
+			src_state_id_t x = order[y];
+			std::fill_n(lab_target, nlabel, nil_state);
+			src.for_each_move(x, [&](src_state_id_t t, auchar_t c) {
+				assert(nil != s2ds[t]);
+				lab_target[cmap[c]] = StateID(s2ds[t]);
+				transition_num++;
+			});
+			StateID children[sigma];
+			size_t  n = 0;
+			for (size_t lab = 0; lab < nlabel; ++lab)
+				if (nil_state != lab_target[lab])
+					children[n++] = lab_target[lab];
+			StateID d1, d2;
+			size_t  f1, f2;
+			pick_dense_targets(children, n, &d1, &f1, &d2, &f2);
+			State& ys = states[y];
+			size_t n_sparse = 0;
+			intptr_t min_delta = 0, max_delta = 0;
+			for (size_t lab = 0; lab < nlabel; ++lab) {
+				StateID t = lab_target[lab];
+				if (nil_state == t)
+					continue;
+				if (d1 == t) {
+					ys.bits.set1(2*lab);
+				} else if (d2 == t) {
+					ys.bits.set1(2*lab);
+					ys.bits.set1(2*lab+1);
+				} else {
+					ys.bits.set1(2*lab+1);
+					children[n_sparse++] = t;
+					intptr_t delta = intptr_t(t) - intptr_t(y);
+					min_delta = std::min(min_delta, delta);
+					max_delta = std::max(max_delta, delta);
+				}
+			}
+			if (n_sparse) {
+				if (min_delta >= INT16_MIN && max_delta <= INT16_MAX)
+					ys.set_sparse_width(1);
+				else if (min_delta >= -(1<<23) && max_delta < (1<<23))
+					ys.set_sparse_width(2);
+			}
+			size_t sbytes = ys.sparse_bytes(n_sparse);
+			fstring zs;
+			if (src.is_pzip(x)) {
+				zs = src.get_zpath_data(x, NULL);
+				ys.set_pzip_bit();
+				m_zpath_states++;
+				m_total_zpath_len += zs.size();
+			}
+			size_t len = sbytes + (ys.is_pzip() ? zs.size() + 1 : 0);
+			if (len) {
+				size_t pos = pool.alloc(pool.align_to(len));
+				byte_t* p = pool.data() + pos;
+				for (size_t i = 0; i < n_sparse; ++i) {
+					intptr_t delta = intptr_t(children[i]) - intptr_t(y);
+					switch (ys.sparse_width()) {
+					default: assert(0); break;
+					case 0: reinterpret_cast<StateID*>(p)[i] = children[i]; break;
+					case 1: reinterpret_cast<int16_t*>(p)[i] = int16_t(delta); break;
+					case 2:
+						p[3*i+0] = byte_t(delta);
+						p[3*i+1] = byte_t(delta >> 8);
+						p[3*i+2] = byte_t(delta >> 16);
+						break;
+					}
+				}
+				if (ys.is_pzip()) {
+					p[sbytes] = byte_t(zs.size());
+					memcpy(p + sbytes + 1, zs.data(), zs.size());
+				}
+				ys.setpos(pos);
+			}
+			ys.dense_target1 = d1;
+			ys.dense_target2 = d2;
+			if (src.is_term(x))
+				ys.set_term_bit();
+			assert(ys.num_sparse() == (int)n_sparse);
+		}
+		pool.shrink_to_fit();
+		this->set_is_dag(src.is_dag());
+		this->set_kv_delim(src.kv_delim());
+		this->set_sigma(src.get_sigma());
+		return true;
+	}
+
 private:
 	enum { SERIALIZATION_VERSION = 2 };
 
@@ -1006,6 +1320,9 @@ const StateID DenseDFA_V2<StateID, Sigma, State>::max_state;
 
 typedef DenseDFA_V2<uint32_t, 288> DenseDFA_V2_uint32_288;
 typedef DenseDFA_V2<uint64_t, 288> DenseDFA_V2_uint64_288;
+// byte class compressed, built by build_compact
+typedef DenseDFA_V2<uint32_t, 288, DenseStateV2<uint32_t, 64> >
+		DenseDFA_V2_uint32_288_bc64;
 
 template<class StateID, int Sigma, class State>
 size_t
@@ -5,12 +5,14 @@ struct DenseStateFlags {
 	StateID  m_is_pzip : 1;
 	StateID  m_is_term : 1;
 	StateID  m_is_free : 1;
-	StateID  reserved_bits : sizeof(StateID)*8 - 3;
+	StateID  m_sparse_width : 2; // 0: StateID, 1: 16 bit delta, 2: 24 bit delta
+	StateID  reserved_bits : sizeof(StateID)*8 - 5;
 
 	DenseStateFlags() {
 		m_is_pzip = 0;
 		m_is_term = 0;
 		m_is_free = 0;
+		m_sparse_width = 0;
 		reserved_bits = 0;
 		static_assert(sizeof(StateID) == sizeof(DenseStateFlags),
 			"static_assert(sizeof(StateID) == sizeof(DenseStateFlags))");
@@ -20,8 +22,10 @@ struct DenseStateFlags {
 	void set_term_bit() { m_is_term = 1; }
 	void set_free_bit() { m_is_free = 1; }
 	void clear_term_bit() { m_is_term = 0; }
+	void set_sparse_width(int w) { m_sparse_width = w; }
 
 	bool is_pzip() const { return m_is_pzip; }
 	bool is_term() const { return m_is_term; }
 	bool is_free() const { return m_is_free; }
+	int  sparse_width() const { return m_sparse_width; }
 };
@@ -522,7 +522,7 @@ dfa_read_binary_int32(const DFA& dfa, size_t state, Collector* vec) {
 	size_t oldsize = vec->size();
 	vis.start(state, 0);
 	assert(vis.nth > 0);
-	assert(vec->size() == oldsize + vis.nth);
+	assert(vec->size() <= oldsize + vis.nth); // Collector may skip dup ids
 	for (size_t i = oldsize; i < vec->size() - 1; ++i) {
 		assert((*vec)[i] != (*vec)[i+1]);
 	}
@@ -58,6 +58,8 @@
 namespace terark {
 
 bool g_enableChecksumVerify = getEnvBool("Terark_enableChecksumVerify", true);
+static thread_local bool tls_deferDataChecksum = false;
+static size_t g_mmapLoadThreads = std::max<long>(getEnvLong("Terark_mmapLoadThreads", 1), 1);
 
 TERARK_DLL_EXPORT bool isChecksumVerifyEnabled() {
     return g_enableChecksumVerify;
@@ -67,6 +69,24 @@ TERARK_DLL_EXPORT void enableChecksumVerify(bool val) {
     g_enableChecksumVerify = val;
 }
 
+TERARK_DLL_EXPORT bool isDataChecksumVerifyEnabled() {
+    return g_enableChecksumVerify && !tls_deferDataChecksum;
+}
+
+TERARK_DLL_EXPORT bool deferDataChecksumInThread(bool val) {
+    bool old = tls_deferDataChecksum;
+    tls_deferDataChecksum = val;
+    return old;
+}
+
+TERARK_DLL_EXPORT size_t getMmapLoadThreads() {
+    return g_mmapLoadThreads;
+}
+
+TERARK_DLL_EXPORT void setMmapLoadThreads(size_t val) {
+    g_mmapLoadThreads = std::max<size_t>(val, 1);
+}
+
 ByteInputRange::~ByteInputRange() {}
 
 template<class CharT>
@@ -1549,6 +1569,23 @@ BaseDFA* BaseDFA::load_mmap_user_mem(const void* baseptr, size_t length) {
 	return dfa;
 }
 
+TERARK_DLL_EXPORT void dfa_verify_file_crc32(const void* mem, size_t size) {
+	auto base = (const DFA_MmapHeader*)mem;
+	if (size < sizeof(*base) || size < base->file_size) {
+		THROW_STD(invalid_argument, "size = %zd, header.file_size = %lld",
+				  size, size < sizeof(*base) ? -1LL : (long long)base->file_size);
+	}
+	if (base->crc32cLevel >= 2) {
+		size_t  content_len = base->file_size - sizeof(*base);
+		uint32_t file_crc32 = Crc32c_update_parallel(0, base+1, content_len,
+		                                             getMmapLoadThreads());
+		if (base->file_crc32 != file_crc32) {
+			throw BadCrc32cException("BaseDFA::load_mmap_fmt(): file_crc32"
+				, base->file_crc32, file_crc32);
+		}
+	}
+}
+
 static const DFA_ClassMetaInfo* dfa_check_mmap(const DFA_MmapHeader* base) {
 	if (strcmp(base->magic, "nark-dfa-mmap") != 0) {
 		THROW_STD(invalid_argument, "file is not nark-dfa-mmap, but is: %.19s", base->magic);
@@ -1558,20 +1595,15 @@ static const DFA_ClassMetaInfo* dfa_check_mmap(const DFA_MmapHeader* base) {
 		TERARK_THROW(std::invalid_argument,
 			": unknown dfa_class: %s", base->dfa_class_name);
 	}
-	if (base->crc32cLevel >= 1 && g_enableChecksumVerify) {
+	if (base->crc32cLevel >= 1 && isChecksumVerifyEnabled()) {
 		uint32_t header_crc32 = Crc32c_update(0, base, sizeof(*base)-4);
 		if (base->header_crc32 != header_crc32) {
 			throw BadCrc32cException("BaseDFA::load_mmap_fmt(): header_crc32"
 				, base->header_crc32, header_crc32);
 		}
 	}
-	if (base->crc32cLevel >= 2 && g_enableChecksumVerify) {
-		size_t  content_len = base->file_size - sizeof(*base);
-		uint32_t file_crc32 = Crc32c_update(0, base+1, content_len);
-		if (base->file_crc32 != file_crc32) {
-			throw BadCrc32cException("BaseDFA::load_mmap_fmt(): file_crc32"
-				, base->file_crc32, file_crc32);
-		}
+	if (isDataChecksumVerifyEnabled()) {
+		dfa_verify_file_crc32(base, base->file_size);
 	}
 	return meta;
 }
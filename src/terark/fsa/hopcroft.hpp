@@ -5,7 +5,9 @@
 #include <terark/valvec.hpp>
 #include <terark/smallmap.hpp>
 #include <terark/hash_common.hpp>
+#include <terark/bitmanip.hpp>
 #include "graph_walker.hpp"
+#include <thread>
 
 namespace terark {
 
@@ -422,4 +424,227 @@ for (size_t j = 0; j < C_1.size(); ++j) {
     }
 };
 
+/// run fn(tid) for tid in [0, n_threads), tid 0 runs in the calling thread
+template<class Fn>
+void fsa_parallel_run(size_t n_threads, Fn fn) {
+	if (n_threads <= 1) {
+		fn(size_t(0));
+		return;
+	}
+	valvec<std::thread> thr(n_threads - 1, valvec_reserve());
+	for (size_t t = 1; t < n_threads; ++t)
+		thr.unchecked_emplace_back([&fn,t]() { fn(t); });
+	fn(size_t(0));
+	for (auto& t : thr)
+		t.join();
+}
+
+/// Moore style partition refinement: each round splits blocks by the
+/// signature(block, [(ch, block of target)...]) of their states, until no
+/// block is split. Only predecessors of states moved in the previous round
+/// can change signature, so a round just recomputes signatures of them:
+/// they are never equal to the signature of the other states in the same
+/// block, thus other states keep the block id and each group of equal
+/// signatures in them gets a new block id. Blocks are sharded to n_threads
+/// by block id, signatures are computed and grouped in parallel.
+///
+/// The coarsest partition is unique, thus minimized DFA is same as Hopcroft,
+/// but the block ids(state ids of the minimized DFA) are different, block ids
+/// are renumbered by the walk order from roots, initial state is in block 0.
+template<class StateID>
+struct ParallelRefine {
+	const static StateID nil = StateID(-1);
+	valvec<StateID> blid;  // parallel with dfa states, nil for unreachable
+	valvec<StateID> reach; // reachable states in walk order
+	valvec<StateID> head;  // the first state of each block in walk order
+	size_t rounds = 0;
+	size_t signatures = 0; // number of computed signatures in all rounds
+
+	size_t num_blocks() const { return head.size(); }
+
+	template<class DFA, class Uint>
+	ParallelRefine(const DFA& dfa, const Uint* roots, size_t n_roots) {
+		BOOST_STATIC_ASSERT(sizeof(StateID) >= sizeof(typename DFA::state_id_t));
+		assert(dfa.total_states() >= 1);
+		blid.resize(dfa.total_states(), nil);
+		PFS_GraphWalker<StateID> walker;
+		walker.resize(dfa.total_states());
+		for (size_t i = 0; i < n_roots; ++i) walker.putRoot(roots[i]);
+		while (!walker.is_finished()) {
+			StateID curr = walker.next();
+			reach.push_back(curr);
+			walker.putChildren(&dfa, curr);
+		}
+	}
+
+	template<class DFA>
+	void refine(const DFA& dfa, size_t n_threads) {
+		typedef typename DFA::state_id_t src_id_t;
+		const size_t n = reach.size();
+		n_threads = std::max<size_t>(1, std::min(n_threads, n / 1024 + 1));
+		valvec<size_t>  pred_idx(blid.size() + 1, 0);
+		valvec<StateID> pred;
+		for (StateID s : reach)
+			dfa.for_each_dest(s, [&](src_id_t t) { pred_idx[t+1]++; });
+		for (size_t i = 1; i < pred_idx.size(); ++i)
+			pred_idx[i] += pred_idx[i-1];
+		pred.resize_no_init(pred_idx.back());
+		{
+			valvec<size_t> ii = pred_idx;
+			for (StateID s : reach)
+				dfa.for_each_dest(s, [&](src_id_t t) { pred[ii[t]++] = s; });
+		}
+		valvec<StateID> blen; // block size
+		{ // initial partition: final and non-final
+			StateID id[2] = { nil, nil };
+			for (size_t i = 0; i < n; ++i) {
+				StateID& b = id[dfa.is_term(reach[i]) ? 1 : 0];
+				if (nil == b) {
+					b = StateID(blen.size());
+					blen.push_back(0);
+				}
+				blid[reach[i]] = b;
+				blen[b]++;
+			}
+		}
+		struct Group {
+			size_t  offset; // in Shard::sigpool
+			size_t  length;
+			size_t  hash;
+			StateID id; // local new id, nil for keeping the old block id
+		};
+		struct Shard {
+			valvec<uint32_t> touched; // index of ParallelRefine::touched
+			valvec<StateID>  sigpool;
+			valvec<Group>    groups;
+			valvec<uint32_t> bucket;
+			valvec<StateID>  moved;
+			size_t           num_new;
+		};
+		valvec<Shard>   shards(n_threads);
+		valvec<StateID> touched = reach; // all states are touched in round 1
+		valvec<StateID> tnew(n, valvec_no_init()); // new local block id
+		valvec<StateID> tcnt(blen.size(), 0); // touched states of a block
+		valvec<byte_t>  kept(blen.size(), 0); // a group keeps the block id
+		valvec<uint32_t> mark(blid.size(), 0);
+		uint32_t stamp = 0;
+		auto sig = [&](size_t s, valvec<StateID>* v) {
+			v->erase_all();
+			v->push_back(blid[s]);
+			dfa.for_each_move(src_id_t(s), [&](src_id_t t, auchar_t c) {
+				v->push_back(StateID(c));
+				v->push_back(blid[t]);
+			});
+		};
+		for (;;) {
+			rounds++;
+			signatures += touched.size();
+			for (size_t i = 0; i < touched.size(); ++i) {
+				StateID b = blid[touched[i]];
+				tcnt[b]++;
+				shards[b % n_threads].touched.push_back(uint32_t(i));
+			}
+			fsa_parallel_run(n_threads, [&](size_t tid) {
+				Shard& sh = shards[tid];
+				size_t nbkt = size_t(1) << (terark_bsr_u64(sh.touched.size() * 2 + 1) + 1);
+				sh.bucket.resize_fill(nbkt, UINT32_MAX); // index of groups
+				sh.sigpool.erase_all();
+				sh.groups.erase_all();
+				sh.num_new = 0;
+				valvec<StateID> v;
+				for (uint32_t i : sh.touched) {
+					const StateID b = blid[touched[i]];
+					sig(touched[i], &v);
+					size_t h = 0;
+					for (StateID x : v)
+						h = FaboHashCombine(h, x);
+					size_t k = h & (nbkt - 1);
+					for (; UINT32_MAX != sh.bucket[k]; k = (k + 1) & (nbkt - 1)) {
+						const Group& g = sh.groups[sh.bucket[k]];
+						if (g.hash == h && g.length == v.size() &&
+							std::equal(v.begin(), v.end(), sh.sigpool.begin() + g.offset))
+							break;
+					}
+					if (UINT32_MAX == sh.bucket[k]) {
+						Group g;
+						g.offset = sh.sigpool.size();
+						g.length = v.size();
+						g.hash = h;
+						if (tcnt[b] == blen[b] && !kept[b]) {
+							kept[b] = 1;
+							g.id = nil;
+						} else {
+							g.id = StateID(sh.num_new++);
+						}
+						sh.bucket[k] = uint32_t(sh.groups.size());
+						sh.groups.push_back(g);
+						sh.sigpool.append(v);
+					}
+					tnew[i] = sh.groups[sh.bucket[k]].id;
+				}
+			});
+			const size_t old_num = blen.size();
+			size_t new_num = old_num;
+			for (auto& sh : shards) {
+				size_t cnt = sh.num_new;
+				sh.num_new = new_num; // to offset
+				new_num += cnt;
+			}
+			blen.resize(new_num, 0);
+			tcnt.resize(new_num, 0);
+			kept.resize(new_num, 0);
+			fsa_parallel_run(n_threads, [&](size_t tid) {
+				Shard& sh = shards[tid];
+				sh.moved.erase_all();
+				for (uint32_t i : sh.touched) {
+					const StateID s = touched[i];
+					const StateID b = blid[s];
+					tcnt[b] = 0;
+					kept[b] = 0;
+					if (nil != tnew[i]) {
+						const StateID nb = StateID(sh.num_new + tnew[i]);
+						blen[b]--;
+						blen[nb]++; // new ids of this shard are not shared
+						blid[s] = nb;
+						sh.moved.push_back(s);
+					}
+				}
+				sh.touched.erase_all();
+			});
+			if (new_num == old_num)
+				break; // stable, no block is split
+			if (terark_unlikely(0 == ++stamp)) {
+				mark.fill(0);
+				stamp = 1;
+			}
+			touched.erase_all();
+			for (auto& sh : shards) {
+				for (StateID t : sh.moved) {
+					for (size_t j = pred_idx[t]; j < pred_idx[t+1]; ++j) {
+						StateID s = pred[j];
+						if (mark[s] != stamp) {
+							mark[s] = stamp;
+							touched.push_back(s);
+						}
+					}
+				}
+			}
+			if (touched.empty())
+				break;
+		}
+		// renumber by walk order
+		valvec<StateID> map(blen.size(), nil);
+		head.erase_all();
+		for (size_t i = 0; i < n; ++i) {
+			StateID& b = map[blid[reach[i]]];
+			if (nil == b) {
+				b = StateID(head.size());
+				head.push_back(reach[i]);
+			}
+		}
+		for (size_t i = 0; i < n; ++i)
+			blid[reach[i]] = map[blid[reach[i]]];
+	}
+};
+
 } // namespace terark
@@ -1,7 +1,10 @@
 #include "mre_match.hpp"
 #include "fsa.hpp"
+#include "re2/lazy_dfa.hpp"
+#include <terark/io/ZeroCopy.hpp>
 #include <terark/lcast.hpp>
 #include <terark/util/linebuf.hpp>
+#include <terark/util/mmap.hpp>
 #include <terark/util/autoclose.hpp>
 #include <terark/util/throw.hpp>
 #include <terark/util/unicode_iterator.hpp>
@@ -11,15 +14,20 @@ namespace terark {
 MultiRegexMatchOptions::~MultiRegexMatchOptions() {
 	if (m_owns_dfa)
 		delete m_dfa;
+	delete m_lazy;
 }
 
 MultiRegexMatchOptions::MultiRegexMatchOptions() {
 	maxBitmapSize = getEnvLong("MRE_MAX_BITMAP", 4*1024);
+	lazyDfaMaxMem = getEnvLong("MRE_LAZY_DFA_MAXMEM", 64L<<20);
+	lazyDfaKeepDepth = (unsigned)getEnvLong("MRE_LAZY_DFA_KEEP_DEPTH", 2);
 	enableDynamicDFA = true;
 	m_dfa = NULL;
 }
 MultiRegexMatchOptions::MultiRegexMatchOptions(fstring _dfaFilePath) {
 	maxBitmapSize = getEnvLong("MRE_MAX_BITMAP", 4*1024);
+	lazyDfaMaxMem = getEnvLong("MRE_LAZY_DFA_MAXMEM", 64L<<20);
+	lazyDfaKeepDepth = (unsigned)getEnvLong("MRE_LAZY_DFA_KEEP_DEPTH", 2);
 	enableDynamicDFA = true;
 	m_dfa = NULL;
 	load_dfa(_dfaFilePath);
@@ -48,6 +56,19 @@ void MultiRegexMatchOptions::load_dfa_user_mem(fstring user_mem) {
 	m_dfa = BaseDFA::load_mmap_user_mem(user_mem);
 }
 
+void MultiRegexMatchOptions::load_regex_lazy(fstring regexFilePath, fstring regexOption) {
+	MultiRegexLazyDFA::Options lopt;
+	lopt.maxmem = lazyDfaMaxMem;
+	lopt.keepDepth = lazyDfaKeepDepth;
+	lopt.ignoreCase = regexOption.strchr('i') != NULL;
+	lopt.addDotStar = regexOption.strchr('a') != NULL;
+	std::unique_ptr<MultiRegexLazyDFA> lazy(new MultiRegexLazyDFA(lopt));
+	lazy->load_regex_file(regexFilePath);
+	lazy->compile();
+	delete m_lazy;
+	m_lazy = lazy.release();
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
 #define IMPLEMENT_find_first(StepBytes, MatchCall) \
@@ -253,6 +274,63 @@ size_t MultiRegexFullMatch::byte_find_all_len(fstring text, const byte_t* tr) {
 }
 //@}
 
+void MultiRegexFullMatch::begin_feed(StreamMode) {
+	THROW_STD(invalid_argument, "stream match is not supported by %s", typeid(*this).name());
+}
+bool MultiRegexFullMatch::feed(fstring) {
+	THROW_STD(invalid_argument, "stream match is not supported by %s", typeid(*this).name());
+}
+bool MultiRegexFullMatch::feed(fstring, const ByteTR&) {
+	THROW_STD(invalid_argument, "stream match is not supported by %s", typeid(*this).name());
+}
+bool MultiRegexFullMatch::feed(fstring, const byte_t*) {
+	THROW_STD(invalid_argument, "stream match is not supported by %s", typeid(*this).name());
+}
+size_t MultiRegexFullMatch::finish() {
+	THROW_STD(invalid_argument, "stream match is not supported by %s", typeid(*this).name());
+}
+
+size_t MultiRegexFullMatch::match_stream(IZeroCopyInputStream* is,
+										 StreamMode mode, size_t bufsize) {
+	begin_feed(mode);
+	while (!is->eof()) {
+		size_t len = 0;
+		const void* buf = is->zcRead(bufsize, &len);
+		if (0 == len || !feed(fstring((const char*)buf, len)))
+			break;
+	}
+	return finish();
+}
+
+size_t MultiRegexFullMatch::parallel_match_all(fstring text, size_t, size_t) {
+	return match_all(text);
+}
+
+void MultiRegexFullMatch::parallel_match_all_lines(fstring text, size_t num_threads,
+	const function<void(size_t tid, const MultiRegexFullMatch&, fstring line)>& on_match)
+const {
+	num_threads = std::max<size_t>(num_threads, 1);
+	valvec<std::unique_ptr<MultiRegexFullMatch> > matchers(num_threads);
+	for (auto& m : matchers)
+		m.reset(this->clone());
+	parallel_for_lines((byte_t*)text.data(), text.size(), num_threads,
+	[&](size_t tid, byte_t* beg, byte_t* end) {
+		MultiRegexFullMatch* m = matchers[tid].get();
+		while (beg < end) {
+			byte_t* eol = (byte_t*)memchr(beg, '\n', end - beg);
+			byte_t* next = eol ? eol + 1 : end;
+			if (!eol)
+				eol = end;
+			if (eol > beg && '\r' == eol[-1])
+				--eol;
+			fstring line((const char*)beg, (const char*)eol);
+			if (m->match_all(line))
+				on_match(tid, *m, line);
+			beg = next;
+		}
+	});
+}
+
 bool MultiRegexFullMatch::has_hit(int regex_id) const {
 	size_t lo = lower_bound_a(m_regex_idvec, regex_id);
 	return lo < m_regex_idvec.size() && m_regex_idvec[lo] == regex_id;
@@ -345,6 +423,33 @@ size_t MultiRegexSubmatch::match_utf8(fstring text, const byte_t* tr) {
 	return ret;
 }
 
+void MultiRegexSubmatch::begin_feed() {
+	THROW_STD(invalid_argument, "stream match is not supported by %s", typeid(*this).name());
+}
+bool MultiRegexSubmatch::feed(fstring) {
+	THROW_STD(invalid_argument, "stream match is not supported by %s", typeid(*this).name());
+}
+bool MultiRegexSubmatch::feed(fstring, const ByteTR&) {
+	THROW_STD(invalid_argument, "stream match is not supported by %s", typeid(*this).name());
+}
+bool MultiRegexSubmatch::feed(fstring, const byte_t*) {
+	THROW_STD(invalid_argument, "stream match is not supported by %s", typeid(*this).name());
+}
+size_t MultiRegexSubmatch::finish() {
+	THROW_STD(invalid_argument, "stream match is not supported by %s", typeid(*this).name());
+}
+
+size_t MultiRegexSubmatch::match_stream(IZeroCopyInputStream* is, size_t bufsize) {
+	begin_feed();
+	while (!is->eof()) {
+		size_t len = 0;
+		const void* buf = is->zcRead(bufsize, &len);
+		if (0 == len || !feed(fstring((const char*)buf, len)))
+			break;
+	}
+	return finish();
+}
+
 void MultiRegexSubmatch::push_regex_info(int n_submatch) {
 	int* oldptr  = cap_pos_data.data();
 	int  oldsize = cap_pos_data.size();
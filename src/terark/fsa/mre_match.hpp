@@ -9,6 +9,8 @@
 namespace terark {
 
 class BaseDFA;
+class MultiRegexLazyDFA;
+class IZeroCopyInputStream;
 
 // life time should be longer than MultiRegexSubmatch/MultiRegexFullMatch
 // can be used by multiple MultiRegexSubmatch/MultiRegexFullMatch objects
@@ -16,6 +18,8 @@ struct TERARK_DLL_EXPORT MultiRegexMatchOptions {
 	std::string dfaFilePath;
 	std::string regexMetaFilePath;
 	size_t maxBitmapSize;
+	size_t lazyDfaMaxMem;
+	unsigned lazyDfaKeepDepth; // see MultiRegexLazyDFA::Options::keepDepth
 	bool enableDynamicDFA;
 
 	~MultiRegexMatchOptions();
@@ -26,9 +30,17 @@ struct TERARK_DLL_EXPORT MultiRegexMatchOptions {
 	void load_dfa(fstring dfaFilePath);
 	void load_dfa_user_mem(fstring user_mem);
 	BaseDFA* get_dfa() const { return m_dfa; }
+
+	/// load regexes(regex_build input format) into a lazy dfa instead of a
+	/// dfa file built by regex_build, dfa states are built on matching,
+	/// regexOption: 'i' for ignore case, 'a' for add dot star.
+	/// MultiRegexSubmatch is not supported in this mode
+	void load_regex_lazy(fstring regexFilePath, fstring regexOption = "");
+	MultiRegexLazyDFA* get_lazy_dfa() const { return m_lazy; }
 private:
 	bool m_owns_dfa = true;
 	BaseDFA* m_dfa;
+	MultiRegexLazyDFA* m_lazy = NULL;
 private: // disable copy
 	MultiRegexMatchOptions(const MultiRegexMatchOptions&) = delete;
 	MultiRegexMatchOptions& operator=(const MultiRegexMatchOptions&) = delete;
@@ -63,6 +75,28 @@ public:
 	size_t match_utf8(fstring text, const ByteTR& tr);
 	size_t match_utf8(fstring text, const byte_t* tr);
 
+	///@{ resumable match over a text which is split into chunks, such as the
+	///   buffers of IZeroCopyInputStream, chunks are not copied and need not
+	///   to be alive after feed returns:
+	///     begin_feed(); while (has_chunk && feed(chunk)) {} finish();
+	///   the result is same as match(whole_text). captures of all regexes are
+	///   tracked until the regex is dead, so it is slower than match() when
+	///   many regexes are alive for a long prefix
+	virtual void begin_feed();
+	/// @returns false if the result can not be changed by more text
+	virtual bool feed(fstring chunk);
+	virtual bool feed(fstring chunk, const ByteTR& tr);
+	virtual bool feed(fstring chunk, const byte_t* tr);
+	/// @returns full match len, same as match()
+	virtual size_t finish();
+	///@}
+
+	/// begin_feed, feed the buffers of zcRead(bufsize) until eof or feed
+	/// returns false, then finish. the stream is not read to eof if the
+	/// result is decided before eof
+	/// @returns same as finish()
+	size_t match_stream(IZeroCopyInputStream*, size_t bufsize = 64*1024);
+
 	///@{ only for internal use
 	void push_regex_info(int n_submatch);
 	void complete_regex_info();
@@ -243,6 +277,53 @@ public:
 	virtual size_t byte_find_all_len(fstring text, const ByteTR& tr);
 	virtual size_t byte_find_all_len(fstring text, const byte_t* tr);
 
+	enum StreamMode {
+		StreamLongest,  // as match()
+		StreamShortest, // as shortest_match()
+		StreamAll,      // as match_all()
+	};
+	///@{ resumable match over a text which is split into chunks, such as the
+	///   buffers of IZeroCopyInputStream, chunks are not copied and need not
+	///   to be alive after feed returns:
+	///     begin_feed(mode); while (has_chunk && feed(chunk)) {} finish();
+	///   the DFA states and the last match of each root are carried across
+	///   chunks, the result is same as the non-stream method of the mode on
+	///   the whole text
+	virtual void begin_feed(StreamMode = StreamLongest);
+	/// @returns false if the result can not be changed by more text
+	virtual bool feed(fstring chunk);
+	virtual bool feed(fstring chunk, const ByteTR& tr);
+	virtual bool feed(fstring chunk, const byte_t* tr);
+	/// @returns same as the non-stream method of the mode
+	virtual size_t finish();
+	///@}
+
+	/// begin_feed(mode), feed the buffers of zcRead(bufsize) until eof or
+	/// feed returns false, then finish. the stream is not read to eof if
+	/// the result is decided before eof
+	/// @returns same as finish()
+	size_t match_stream(IZeroCopyInputStream*, StreamMode = StreamLongest,
+						size_t bufsize = 64*1024);
+
+	/// match_all on a long text by threads, the text is split into chunks:
+	/// chunk 0 starts from the root, the start state of other chunks is
+	/// speculated by walking lookback bytes before the chunk from the root.
+	/// chunks are stitched by verifying the speculated states, a chunk with
+	/// a wrong speculation is walked again from the real state until it
+	/// converges with the speculated walk. for a dot star dfa(regex_build
+	/// -a), the walk converges in a few bytes, so the speedup is nearly
+	/// linear. if it is not supported by the dfa, match_all(text) is used
+	/// @returns same as match_all(text)
+	virtual size_t
+	parallel_match_all(fstring text, size_t num_threads, size_t lookback = 256);
+
+	/// line delimited fast path: lines are matched independently by
+	/// match_all of a clone of this object in each thread, on_match(tid,
+	/// matcher, line) is called for each matched line, text is split to
+	/// threads by parallel_for_lines
+	void parallel_match_all_lines(fstring text, size_t num_threads,
+		const function<void(size_t tid, const MultiRegexFullMatch&, fstring line)>& on_match) const;
+
 	virtual bool has_hit(int regex_id) const;
 
 	virtual void clear_match_result();
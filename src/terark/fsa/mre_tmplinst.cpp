@@ -171,6 +171,7 @@ public:
 #endif
 TMPL_INST_DFA_CLASS(DenseDFA_uint32_320);
 TMPL_INST_DFA_CLASS(DenseDFA_V2_uint32_288);
+TMPL_INST_DFA_CLASS(DenseDFA_V2_uint32_288_bc64);
 TMPL_INST_DFA_CLASS(VirtualMachineDFA);
 
 template<class MatchClass>
@@ -235,6 +236,7 @@ public:
 	OnDFA(MyClassName, Automata_State32_512_) \
 	OnDFA(MyClassName, DenseDFA_uint32_320) \
 	OnDFA(MyClassName, DenseDFA_V2_uint32_288) \
+	OnDFA(MyClassName, DenseDFA_V2_uint32_288_bc64) \
 	OnDFA(MyClassName, VirtualMachineDFA) \
 	else { \
 		TERARK_THROW(std::invalid_argument \
@@ -320,15 +322,80 @@ DynDFA_Context::DynDFA_Context() {
 	m_tls = &g_MatchStateThreadLocal;
 }
 
+/// a walk from a root of a maybe path zipped dfa over a chunked text
 template<class DFA>
-class MultiRegexFullMatchTmpl : public MultiRegexFullMatch {
-public:
-	febitvec m_hits;
+struct DfaChunkWalk {
+	size_t  curr;
+	size_t  zidx; // matched len of zstr
+	fstring zstr; // zpath of curr
+
+	/// @returns true if root is entered, that is its zpath is empty
+	bool start(const DFA* au, size_t root) {
+		curr = root;
+		return enter(au);
+	}
+	bool enter(const DFA* au) {
+		zidx = 0;
+		if (au->is_pzip(curr)) {
+			zstr = au->get_zpath_data(curr, NULL);
+			return zstr.empty();
+		}
+		zstr = fstring();
+		return true;
+	}
+
+	/// on_enter(state, len) is called when a state is entered, that is after
+	/// its zpath is matched, len is the consumed len of the whole text,
+	/// on_enter returns false to stop the walk
+	/// @param len consumed len of the whole text before chunk
+	/// @returns false if the walk is dead or stopped
+	template<class TR, class OnEnter>
+	bool feed(const DFA* au, fstring chunk, size_t len, TR tr, OnEnter on_enter) {
+		const byte_t* pos = chunk.udata();
+		const byte_t* end = pos + chunk.n;
+		for (; pos < end; ++pos) {
+			byte_t ch = (byte_t)tr(*pos);
+			++len;
+			if (zidx < zstr.size()) {
+				if ((byte_t)zstr[zidx] != ch)
+					return false;
+				if (++zidx < zstr.size())
+					continue;
+			}
+			else {
+				size_t next = au->state_move(curr, ch);
+				if (DFA::nil_state == next)
+					return false;
+				curr = next;
+				if (!enter(au))
+					continue;
+			}
+			if (!on_enter(curr, len))
+				return false;
+		}
+		return true;
+	}
+};
+
+/// begin_feed/feed/finish of MultiRegexFullMatch, each root is walked
+/// over each chunk, results are merged on finish as match_with_tr...
+/// parallel_match_all is also implemented here, by the same chunk walk
+template<class DFA>
+class MultiRegexFullMatchStreamTmpl : public MultiRegexFullMatch {
+protected:
 	valvec<uint32_t> m_roots;
-	valvec<int> m_idlist2;
-	MatchStateThreadLocal* m_tls = &g_MatchStateThreadLocal;
 
-	MultiRegexFullMatchTmpl(const DFA* au, bool isDyna) {
+	struct StreamRoot : DfaChunkWalk<DFA> {
+		size_t match_state; // matchid root of the last match
+		size_t match_len;   // size_t(-1) if not matched
+		bool   alive;
+	};
+	valvec<StreamRoot> m_stream;
+	size_t     m_stream_len = 0;   // fed len
+	size_t     m_stream_alive = 0; // alive roots
+	StreamMode m_stream_mode = StreamLongest;
+
+	MultiRegexFullMatchStreamTmpl(const DFA* au, bool isDyna) {
 		if (isDyna) {
 			DynamicDFA_get_roots(au, &m_roots);
 		}
@@ -338,6 +405,228 @@ public:
 		m_dfa = au;
 	}
 
+	// returns false if the root is done
+	bool stream_on_enter(StreamRoot& r, size_t state, size_t len) {
+		const DFA* au = static_cast<const DFA*>(m_dfa);
+		size_t full = dfa_matchid_root(au, state);
+		if (terark_likely(DFA::nil_state == full))
+			return true;
+		if (StreamAll == m_stream_mode) {
+			if (full != r.match_state) // dedup self loop
+				dfa_read_matchid(au, full, &m_regex_idvec);
+		}
+		r.match_state = full;
+		r.match_len = len;
+		return StreamShortest != m_stream_mode;
+	}
+
+	template<class TR>
+	bool feed_with_tr(fstring chunk, TR tr) {
+		const DFA* au = static_cast<const DFA*>(m_dfa);
+		for (StreamRoot& r : m_stream) {
+			if (!r.alive)
+				continue;
+			auto on_enter = [&](size_t state, size_t len) {
+				return this->stream_on_enter(r, state, len);
+			};
+			if (!r.feed(au, chunk, m_stream_len, tr, on_enter)) {
+				r.alive = false;
+				m_stream_alive--;
+			}
+		}
+		m_stream_len += chunk.size();
+		return m_stream_alive != 0;
+	}
+
+	typedef DfaChunkWalk<DFA> Walk;
+	// runs of consecutive match positions: (last pos, matchid root)
+	typedef valvec<std::pair<size_t, size_t> > ScanRuns;
+	struct ScanChunk {
+		size_t beg, end;
+		Walk   spec; // speculated start, curr is nil_state if dead
+		Walk   last; // end of the walk from spec
+		valvec<Walk> checkpoints; // at beg + ScanCheckpoint * (i+1)
+		ScanRuns runs;
+	};
+	static const size_t ScanCheckpoint = 4096;
+
+	// walk [pos, end), on dead, w.curr is set to nil_state
+	void scan_walk(Walk& w, fstring text, size_t pos, size_t end, ScanRuns* runs) {
+		if (DFA::nil_state == w.curr)
+			return;
+		const DFA* au = static_cast<const DFA*>(m_dfa);
+		auto on_enter = [&](size_t state, size_t len) {
+			size_t full = dfa_matchid_root(au, state);
+			if (DFA::nil_state != full && runs) {
+				if (!runs->empty() && runs->back().second == full &&
+						runs->back().first + 1 == len)
+					runs->back().first = len;
+				else
+					runs->push_back({len, full});
+			}
+			return true;
+		};
+		fstring seg(text.p + pos, end - pos);
+		if (!w.feed(au, seg, pos, IdentityTR(), on_enter))
+			w.curr = DFA::nil_state;
+	}
+	static bool same_walk(const Walk& x, const Walk& y) {
+		if (DFA::nil_state == x.curr || DFA::nil_state == y.curr)
+			return x.curr == y.curr;
+		return x.curr == y.curr && x.zidx == y.zidx;
+	}
+	void scan_start(Walk& w, size_t root, ScanRuns* runs) {
+		if (w.start(static_cast<const DFA*>(m_dfa), root) && runs) {
+			size_t full = dfa_matchid_root(static_cast<const DFA*>(m_dfa), w.curr);
+			if (DFA::nil_state != full)
+				runs->push_back({0, full});
+		}
+	}
+
+public:
+	size_t parallel_match_all(fstring text, size_t num_threads, size_t lookback) override {
+		if (num_threads <= 1 || text.size() / num_threads < 4*lookback + ScanCheckpoint)
+			return this->match_all(text);
+		this->clear_match_result();
+		const DFA* au = static_cast<const DFA*>(m_dfa);
+		const size_t nchunks = num_threads;
+		valvec<ScanChunk> chunks(nchunks);
+		valvec<size_t> fulls;
+		for (size_t root : m_roots) {
+			fsa_parallel_run(num_threads, [&](size_t tid) {
+				ScanChunk& c = chunks[tid];
+				c.beg = text.size() * tid / nchunks;
+				c.end = text.size() * (tid + 1) / nchunks;
+				c.runs.erase_all();
+				c.checkpoints.erase_all();
+				if (0 == tid) {
+					scan_start(c.spec, root, &c.runs);
+				} else {
+					size_t lb = c.beg > lookback ? c.beg - lookback : 0;
+					scan_start(c.spec, root, NULL);
+					scan_walk(c.spec, text, lb, c.beg, NULL);
+				}
+				c.last = c.spec;
+				for (size_t pos = c.beg; pos < c.end; ) {
+					size_t next = std::min(pos + ScanCheckpoint, c.end);
+					scan_walk(c.last, text, pos, next, &c.runs);
+					c.checkpoints.push_back(c.last);
+					pos = next;
+				}
+			});
+			// chunk 0 is exact, stitch others by the real end of previous
+			Walk real = chunks[0].last;
+			for (size_t i = 1; i < nchunks; ++i) {
+				ScanChunk& c = chunks[i];
+				if (!same_walk(real, c.spec)) {
+					ScanRuns runs;
+					size_t pos = c.beg, k = 0;
+					for (; k < c.checkpoints.size(); ++k) {
+						size_t next = std::min(pos + ScanCheckpoint, c.end);
+						scan_walk(real, text, pos, next, &runs);
+						pos = next;
+						if (same_walk(real, c.checkpoints[k]))
+							break;
+					}
+					if (k < c.checkpoints.size()) { // converged at pos
+						for (auto& r : c.runs)
+							if (r.first > pos) runs.push_back(r);
+					}
+					else {
+						c.last = real;
+					}
+					c.runs.swap(runs);
+				}
+				real = c.last;
+			}
+			for (auto& c : chunks)
+				for (auto& r : c.runs)
+					fulls.push_back(r.second);
+		}
+		sort_a(fulls);
+		fulls.trim(std::unique(fulls.begin(), fulls.end()));
+		for (size_t full : fulls)
+			dfa_read_matchid(au, full, &m_regex_idvec);
+		sort_a(m_regex_idvec);
+		m_regex_idvec.trim(std::unique(m_regex_idvec.begin(), m_regex_idvec.end()));
+		return m_regex_idvec.size();
+	}
+
+	void begin_feed(StreamMode mode) override {
+		this->clear_match_result();
+		m_stream_mode = mode;
+		m_stream_len = 0;
+		m_stream_alive = m_roots.size();
+		m_stream.resize_no_init(m_roots.size());
+		for (size_t i = 0; i < m_roots.size(); ++i) {
+			StreamRoot& r = m_stream[i];
+			r.match_state = DFA::nil_state;
+			r.match_len = size_t(-1);
+			r.alive = true;
+			if (r.start(static_cast<const DFA*>(m_dfa), m_roots[i])) {
+				if (!stream_on_enter(r, r.curr, 0))
+					r.alive = false, m_stream_alive--;
+			}
+		}
+	}
+	bool feed(fstring chunk) override {
+		return feed_with_tr(chunk, IdentityTR());
+	}
+	bool feed(fstring chunk, const ByteTR& tr) override {
+		return feed_with_tr<const ByteTR&>(chunk, tr);
+	}
+	bool feed(fstring chunk, const byte_t* tr) override {
+		return feed_with_tr(chunk, TableTranslator(tr));
+	}
+	size_t finish() override {
+		const DFA* au = static_cast<const DFA*>(m_dfa);
+		if (StreamAll == m_stream_mode) {
+			sort_a(m_regex_idvec);
+			m_regex_idvec.trim(std::unique(m_regex_idvec.begin(), m_regex_idvec.end()));
+			return m_regex_idvec.size();
+		}
+		size_t best = size_t(-1);
+		for (const StreamRoot& r : m_stream) {
+			if (size_t(-1) == r.match_len)
+				continue;
+			if (size_t(-1) == best ||
+				(StreamLongest == m_stream_mode ? r.match_len > best : r.match_len < best))
+				best = r.match_len;
+		}
+		m_regex_idvec.erase_all();
+		if (size_t(-1) == best)
+			return 0;
+		size_t num_match_states = 0;
+		for (const StreamRoot& r : m_stream) {
+			if (r.match_len == best) {
+				dfa_read_matchid(au, r.match_state, &m_regex_idvec);
+				num_match_states++;
+			}
+		}
+		// regex_id vec of a VirtualMachineDFA final state is already sorted
+		if (!std::is_same_v<DFA, VirtualMachineDFA> || num_match_states > 1) {
+			sort_a(m_regex_idvec);
+		}
+		return best;
+	}
+};
+
+template<class DFA>
+class MultiRegexFullMatchTmpl : public MultiRegexFullMatchStreamTmpl<DFA> {
+	typedef MultiRegexFullMatchStreamTmpl<DFA> super;
+public:
+	using super::m_roots;
+	using super::m_dfa;
+	using super::m_options;
+	using super::m_regex_idvec;
+	using super::m_all_match;
+	using super::m_cur_match;
+	febitvec m_hits;
+	valvec<int> m_idlist2;
+	MatchStateThreadLocal* m_tls = &g_MatchStateThreadLocal;
+
+	MultiRegexFullMatchTmpl(const DFA* au, bool isDyna) : super(au, isDyna) {}
+
 	template<class TR>
 	size_t match_with_tr(fstring text, TR tr) {
 		m_hits.erase_all();
@@ -614,10 +903,10 @@ public:
 			if (au->is_pzip(curr)) {
 				fstring zs = au->get_zpath_data(curr, NULL);
 				if (end - pos < zs.n)
-					return;
+					goto Done; // hits before zpath must be collected
 				for (intptr_t j = 0; j < zs.n; ++j, ++pos) {
 					if (terark_unlikely((byte_t)tr(*pos) != zs[j]))
-						return;
+						goto Done;
 				}
 				size_t full = dfa_matchid_root(au, curr);
 				if (terark_unlikely(DFA::nil_state != full)) {
@@ -645,6 +934,7 @@ public:
 				break;
 			}
 		} while (DFA::nil_state != curr);
+	Done:
 		tls.collect(au, &m_cur_match);
 	}
 	template<class TR>
@@ -1806,11 +2096,19 @@ DenseDFA_DynDFA_256::full_match_all_len_with_tr(
 	return matched->size();
 }
 
+/// stream match walks the roots of the dfa, the dynamic dfa is not used
 template<class DFA>
-class MultiRegexFullMatchDynamicDfaTmpl : public MultiRegexFullMatch {
+class MultiRegexFullMatchDynamicDfaTmpl : public MultiRegexFullMatchStreamTmpl<DFA> {
+	typedef MultiRegexFullMatchStreamTmpl<DFA> super;
 public:
-	MultiRegexFullMatchDynamicDfaTmpl(const DFA* dfa, bool /*dyna*/) {
-		m_dfa = dfa;
+	using super::m_dfa;
+	using super::m_dyn;
+	using super::m_options;
+	using super::m_regex_idvec;
+	using super::m_all_match;
+	using super::m_cur_match;
+	using super::m_max_partial_match_len;
+	MultiRegexFullMatchDynamicDfaTmpl(const DFA* dfa, bool dyna) : super(dfa, dyna) {
 		m_dyn = new DenseDFA_DynDFA_256;
 		m_dyn->dyn_init(dfa);
 	}
@@ -1943,7 +2241,13 @@ MultiRegexFullMatch* MultiRegexFullMatch_ac(const BaseDFA* dfa);
 // defined in mre_dawg.cpp:
 MultiRegexFullMatch* MultiRegexFullMatch_dawg(const BaseDFA* dfa);
 
+// defined in re2/lazy_dfa.cpp:
+MultiRegexFullMatch* MultiRegexFullMatch_lazy(const MultiRegexMatchOptions&);
+
 MultiRegexFullMatch* MultiRegexFullMatch::create(const MultiRegexMatchOptions& opt) {
+	if (opt.get_lazy_dfa()) {
+		return MultiRegexFullMatch_lazy(opt);
+	}
 	const BaseDFA* dfa = opt.get_dfa();
 	if (!dfa) {
 		THROW_STD(invalid_argument,
@@ -1991,6 +2295,8 @@ MultiRegexFullMatch::MultiRegexFullMatch(const MultiRegexFullMatch& y)
   , m_all_match(y.m_all_match)
   , m_dfa(y.m_dfa)
   , m_dyn(y.m_dyn)
+  , m_options(y.m_options)
+  , m_max_partial_match_len(y.m_max_partial_match_len)
 {
 	if (m_dyn)
 		m_dyn->refcnt++;
@@ -2024,9 +2330,153 @@ void MultiRegexFullMatch::warm_up() {
 
 /////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////
+// RootState(regex_id) = regex_id + 1
 template<class DFA>
-class MultiRegexSubmatchTwoPassTmpl : public MultiRegexSubmatch {
+static size_t submatch_root(const DFA*, size_t num_regex, int regex_id) {
+	if (1 == num_regex)
+		return initial_state; // regex[0] == regex[all]
+	else
+		return regex_id + 1;
+}
+static size_t
+submatch_root(const VirtualMachineDFA* dfa, size_t, int regex_id) {
+	if (dfa->num_roots() == 2) // only 1 regex
+		return dfa->get_root(0); // regex[0] == regex[all]
+	else
+		return dfa->get_root(regex_id + 1);
+}
+
+/// on_capture(capture_id) for each capture at state, capture_id is the
+/// index to cap_pos_ptr[regex_id]
+template<class DFA, class OnCapture>
+static void
+submatch_for_each_capture(const DFA* dfa, size_t state, OnCapture on_capture) {
+	if (DFA::nil_state == dfa->state_move(state, SUB_MATCH_DELIM))
+		return;
+	size_t zlen = dfa->is_pzip(state) ? dfa->get_zpath_data(state, NULL).size() : 0;
+	MatchContext ctx(0, state, zlen); // zpath of state has been matched
+	auto on_match = [&](size_t, size_t, fstring val) {
+		assert(val.size() == sizeof(uint32_t));
+		int32_t capture_id;
+		memcpy(&capture_id, val.data(), sizeof(capture_id));
+		on_capture(capture_id);
+	};
+	dfa->template tpl_match_key<decltype(on_match)&, IdentityTR>
+		(ctx, SUB_MATCH_DELIM, fstring(), on_match, IdentityTR());
+}
+template<class OnCapture>
+static void
+submatch_for_each_capture(const VirtualMachineDFA* dfa, size_t state, OnCapture on_capture) {
+	if (dfa->has_capture(state)) {
+		const byte_t* capt = dfa->get_capture(state);
+		const size_t cnt = capt[0] + 1;
+		for(size_t j = 0; j < cnt; ++j)
+			on_capture(capt[1+j] + 2);
+	}
+}
+
+/// begin_feed/feed/finish of MultiRegexSubmatch: the first pass is streamed
+/// by m_first_pass, the capture walk of each regex is started from pos 0 and
+/// runs until it is dead, its captures are recorded to m_stream_caps and are
+/// committed to cap_pos_data when the regex is full matched, so the last
+/// commit of a matched regex is at the longest full match len.
+template<class DFA>
+class MultiRegexSubmatchStreamTmpl : public MultiRegexSubmatch {
+protected:
+	struct CaptureWalk : DfaChunkWalk<DFA> {
+		int regex_id;
+	};
+	valvec<CaptureWalk> m_stream; // alive walks
+	valvec<int> m_stream_caps;
+	size_t m_stream_len = 0;
+
+	// returns false if the walk is done
+	bool stream_on_enter(const CaptureWalk& w, size_t state, size_t len) {
+		const DFA* au = static_cast<const DFA*>(this->dfa);
+		const int regex_id = w.regex_id;
+		const size_t offset = cap_pos_ptr[regex_id] - cap_pos_data.data();
+		const size_t ncap = cap_pos_ptr[regex_id+1] - cap_pos_ptr[regex_id];
+		int* pcap = m_stream_caps.data() + offset;
+		submatch_for_each_capture(au, state, [&](size_t capture_id) {
+			assert(capture_id < ncap);
+			pcap[capture_id] = int(len);
+		});
+		if (DFA::nil_state != dfa_matchid_root(au, state)) {
+			int* dst = cap_pos_ptr[regex_id];
+			std::copy_n(pcap, ncap, dst);
+			dst[0] = 0;
+			dst[1] = int(len);
+		}
+		return true;
+	}
+
+	template<class TR>
+	bool feed_with_tr(fstring chunk, TR tr) {
+		const DFA* au = static_cast<const DFA*>(this->dfa);
+		bool first_pass_alive = m_first_pass->feed(chunk, tr);
+		size_t j = 0;
+		for (size_t i = 0; i < m_stream.size(); ++i) {
+			CaptureWalk& w = m_stream[i];
+			auto on_enter = [&](size_t state, size_t len) {
+				return this->stream_on_enter(w, state, len);
+			};
+			if (w.feed(au, chunk, m_stream_len, tr, on_enter))
+				m_stream[j++] = w;
+		}
+		m_stream.risk_set_size(j);
+		m_stream_len += chunk.size();
+		return first_pass_alive && j != 0;
+	}
+
 public:
+	void begin_feed() override {
+		const DFA* au = static_cast<const DFA*>(this->dfa);
+		assert(NULL != this->m_first_pass);
+		const size_t num_regex = cap_pos_ptr.size() - 1;
+		m_first_pass->begin_feed(MultiRegexFullMatch::StreamLongest);
+		this->reset();
+		m_stream_caps.assign(cap_pos_data);
+		m_stream_len = 0;
+		m_stream.resize_no_init(num_regex);
+		for (size_t i = 0; i < num_regex; ++i) {
+			CaptureWalk& w = m_stream[i];
+			w.regex_id = int(i);
+			if (w.start(au, submatch_root(au, num_regex, int(i))))
+				stream_on_enter(w, w.curr, 0);
+		}
+	}
+	bool feed(fstring chunk) override {
+		return feed_with_tr(chunk, IdentityTR());
+	}
+	bool feed(fstring chunk, const ByteTR& tr) override {
+		return feed_with_tr<const ByteTR&>(chunk, tr);
+	}
+	bool feed(fstring chunk, const byte_t* tr) override {
+		return feed_with_tr(chunk, TableTranslator(tr));
+	}
+	size_t finish() override {
+		size_t match_len = m_first_pass->finish();
+		m_fullmatch_regex.swap(m_first_pass->mutable_regex_idvec());
+		assert(this->m_fullmatch_regex.size() || 0 == match_len);
+		for (int regex_id : m_fullmatch_regex) {
+			int* pcap = cap_pos_ptr[regex_id];
+			assert(pcap[1] == int(match_len));
+			pcap[0] = 0;
+			pcap[1] = int(match_len);
+		}
+		m_stream.erase_all();
+		return match_len;
+	}
+};
+
+template<class DFA>
+class MultiRegexSubmatchTwoPassTmpl : public MultiRegexSubmatchStreamTmpl<DFA> {
+	typedef MultiRegexSubmatchStreamTmpl<DFA> super;
+public:
+	using super::dfa;
+	using super::m_first_pass;
+	using super::m_fullmatch_regex;
+	using super::cap_pos_ptr;
 	// RootState(regex_id) = regex_id + 1
 	template<class TR>
 	size_t match_with_tr(fstring text, TR tr) {
@@ -2094,7 +2544,7 @@ public:
 
 template<>
 class MultiRegexSubmatchTwoPassTmpl<VirtualMachineDFA>
-	: public MultiRegexSubmatch {
+	: public MultiRegexSubmatchStreamTmpl<VirtualMachineDFA> {
 public:
 	// RootState(regex_id) = regex_id + 1
 	template<class TR>
@@ -2184,6 +2634,9 @@ public:
 
 MultiRegexSubmatch*
 MultiRegexSubmatch::create(const MultiRegexMatchOptions& opt) {
+	if (opt.get_lazy_dfa()) {
+		THROW_STD(invalid_argument, "lazy dfa does not support submatch");
+	}
 	const BaseDFA* dfa = opt.get_dfa();
 	if (!dfa) {
 		THROW_STD(invalid_argument,
@@ -1240,6 +1240,40 @@ build_patricia(QoSortedStrVec& strVec,
     build_patricia_tpl(strVec, buildTerm, conf);
 }
 
+// an unsorted input gives a broken trie silently, so the input which is not
+// sorted here is checked, it is O(n) and much cheaper than the build
+template<class StrVecType>
+static void check_sorted(const StrVecType& strVec) {
+	for (size_t i = 1, n = strVec.size(); i < n; ++i) {
+		if (terark_unlikely(strVec[i] < strVec[i-1])) {
+			THROW_STD(invalid_argument,
+				"input strVec is not sorted: strVec[%zd] < strVec[%zd], size = %zd",
+				i, i-1, n);
+		}
+	}
+}
+template<class StrVecType>
+static void ensure_sorted(StrVecType& strVec, const NestLoudsTrieConfig& conf) {
+	if (conf.isInputSorted)
+		check_sorted(strVec);
+	else
+		strVec.sort();
+}
+// SortedStrVec family can not be sorted, their sort() just throw, they are
+// sorted only if they are pushed in order, which is not checked by push_back
+static void ensure_sorted(SortedStrVec& strVec, const NestLoudsTrieConfig&) {
+	check_sorted(strVec);
+}
+static void ensure_sorted(DoSortedStrVec& strVec, const NestLoudsTrieConfig&) {
+	check_sorted(strVec);
+}
+static void ensure_sorted(QoSortedStrVec& strVec, const NestLoudsTrieConfig&) {
+	check_sorted(strVec);
+}
+static void ensure_sorted(ZoSortedStrVec& strVec, const NestLoudsTrieConfig&) {
+	check_sorted(strVec);
+}
+
 template<class RankSelect, class RankSelect2, bool FastLabel>
 template<class StrVecType>
 void
@@ -1257,9 +1291,7 @@ build_patricia_tpl(StrVecType& strVec,
 	size_t inputStrVecSize = strVec.size();
 	size_t inputStrVecBytes = strVec.str_size();
 	{
-		if (!conf.isInputSorted) {
-			strVec.sort();
-		}
+		ensure_sorted(strVec, conf);
 		valvec<size_t> linkVec;
 		build_self_trie_tpl(strVec, nestStrVec, linkVec, label, conf.nestLevel, conf);
 		if (conf.debugLevel >= 2)
@@ -1351,9 +1383,7 @@ build_strpool2(SortableStrVec& strVec, valvec<size_t>& linkVec,
 		THROW_STD(invalid_argument, "input strVec is empty");
 	}
 	valvec<byte_t> label;
-	if (!conf.isInputSorted) {
-		strVec.sort();
-	}
+	ensure_sorted(strVec, conf);
 	size_t inputStrVecBytes = strVec.str_size();
 	this->build_self_trie(strVec, linkVec, label, conf.nestLevel, conf);
 	if (strVec.size() > 0) {
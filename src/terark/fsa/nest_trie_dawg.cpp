@@ -4,6 +4,7 @@
 #include "nest_louds_trie_inline.hpp"
 #include "dfa_mmap_header.hpp"
 #include "tmplinst.hpp"
+#include "cspptrie.hpp"
 
 namespace terark {
 
@@ -801,6 +802,69 @@ build_with_id(SortableStrVec& strVec, valvec<size_t>& idvec, const NestLoudsTrie
 	}
 }
 
+template<class NestTrie, class DawgType>
+void
+NestTrieDAWG<NestTrie, DawgType>::
+build_from_patricia(const Patricia& src, valvec<size_t>* word_valpos,
+					const NestLoudsTrieConfig& conf) {
+	if (conf.nestLevel < 1) {
+		THROW_STD(invalid_argument, "conf.nestLevel=%d", conf.nestLevel);
+	}
+	if (m_trie) {
+		THROW_STD(invalid_argument, "m_trie is not NULL");
+	}
+	const size_t num = src.num_words();
+	if (0 == num) {
+		THROW_STD(invalid_argument, "Patricia is empty");
+	}
+	// keys of Patricia are unique and sorted, QoSortedStrVec is never sorted
+	// by build_patricia, and its offsets need 8 bytes per key, which is half
+	// of SortableStrVec
+	// conf.commonPrefix is cut from keys, build_patricia prepends it back
+	const fstring prefix = conf.commonPrefix;
+	QoSortedStrVec strVec;
+	const size_t total_len = src.adfa_total_words_len(); // just a hint
+	strVec.reserve(num, total_len - std::min(total_len, prefix.size() * num));
+	valvec<size_t> valpos;
+	if (word_valpos)
+		valpos.reserve(num);
+	{
+		Patricia::IteratorPtr iter(src.new_iter());
+		for (bool ok = iter->seek_begin(); ok; ok = iter->incr()) {
+			fstring word = iter->word();
+			if (!word.startsWith(prefix)) {
+				THROW_STD(invalid_argument,
+					"conf.commonPrefix is not a prefix of word: %.*s",
+					word.ilen(), word.data());
+			}
+			strVec.push_back(word.substr(prefix.size()));
+			if (word_valpos)
+				valpos.push_back(iter->get_valpos());
+		}
+	}
+	TERARK_VERIFY_EQ(strVec.size(), num);
+	this->m_adfa_total_words_len = strVec.str_size();
+	m_trie = new NestTrie();
+	auto buildTerm = [&](const valvec<size_t>& linkVec) {
+		this->build_term_bits(linkVec);
+		if (word_valpos) {
+			// linkVec[i] is the term node of i-th key in lexical order
+			auto& termFlag = this->getIsTerm();
+			word_valpos->resize_no_init(num);
+			for (size_t i = 0; i < num; ++i)
+				(*word_valpos)[termFlag.rank1(linkVec[i])] = valpos[i];
+		}
+	};
+	m_trie->build_patricia(strVec, buildTerm, conf);
+	m_trie->init_for_term(getIsTerm());
+	this->m_zpath_states = m_trie->num_zpath_states();
+	this->m_total_zpath_len = m_trie->total_zpath_len();
+	this->n_words = getIsTerm().max_rank1();
+	this->m_zpNestLevel = conf.nestLevel;
+	TERARK_VERIFY_EQ(this->n_words, num);
+	this->m_adfa_total_words_len += conf.commonPrefix.size() * this->n_words;
+}
+
 #if 1
 template<class NestTrie, class DawgType>
 ADFA_LexIterator*
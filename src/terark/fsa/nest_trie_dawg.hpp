@@ -9,6 +9,8 @@
 
 namespace terark {
 
+class Patricia;
+
 template<class NestTrie, bool IsRankSelect2>
 class TERARK_DLL_EXPORT NestTrieDAWG_IsTerm {
 protected:
@@ -174,6 +176,17 @@ public:
 
 	void build_with_id(SortableStrVec&, valvec<size_t>& idvec, const NestLoudsTrieConfig&);
 
+	/// freeze a Patricia(such as a memtable) into this trie, keys are taken
+	/// in lexical order by Patricia::Iterator, so they are never re-sorted.
+	/// if word_valpos is not null, (*word_valpos)[word_id] is the valpos of
+	/// the word in src, it is used to remap values to word ids, such as
+	/// building a BlobStore in word id order.
+	/// if conf.commonPrefix is not empty, all words of src must start with
+	/// it, else invalid_argument is thrown.
+	/// src must not be modified during building
+	void build_from_patricia(const Patricia& src, valvec<size_t>* word_valpos,
+							 const NestLoudsTrieConfig&);
+
 	template<class OP>
 	void for_each_move(size_t parent, OP op) const {
 		assert(parent < getIsTerm().size());
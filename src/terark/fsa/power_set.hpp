@@ -105,8 +105,12 @@ public:
 		return find_or_add_subset(ss.data(), ss.size());
 	}
 	size_t find_or_add_subset(const StateID* ss, size_t sn) {
+		return find_or_add_subset(ss, sn, uint_array_hash(ss, sn));
+	}
+	/// hash must be uint_array_hash(ss, sn)
+	size_t find_or_add_subset(const StateID* ss, size_t sn, size_t hash) {
 		assert(sn > 0);
-		size_t hash = uint_array_hash(ss, sn);
+		assert(uint_array_hash(ss, sn) == hash);
 		size_t hMod = hash % nBucket;
 		size_t hit = bucket[hMod];
 		while (nil_link != hit) {
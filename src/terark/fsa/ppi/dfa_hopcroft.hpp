@@ -95,6 +95,48 @@ const {
 	collapse(H, minimized);
 }
 
+/// same minimized dfa as hopcroft_multi_root_dfa, but state ids may be
+/// different, use ParallelRefine with n_threads
+template<class Au2>
+void
+par_minimize_multi_root_dfa(const valvec<size_t>& srcRoots,
+			  Au2& minimized, valvec<size_t>* dstRoots, size_t n_threads) const {
+	dstRoots->resize_no_init(srcRoots.size());
+	par_minimize_multi_root_dfa(srcRoots.data(), srcRoots.size(),
+				 minimized, dstRoots->data(), n_threads);
+}
+
+template<class Au2>
+void
+par_minimize_multi_root_dfa(const size_t* srcRoots, size_t nRoots,
+              Au2& minimized, size_t* dstRoots, size_t n_threads)
+const {
+	minimized.erase_all();
+	assert(total_states() < (size_t)nil_state);
+	ParallelRefine<state_id_t> R(*this, srcRoots, nRoots);
+	R.refine(*this, n_threads);
+	for(size_t i = 0; i < nRoots; ++i) {
+		size_t src = srcRoots[i];
+		assert(src < total_states());
+		dstRoots[i] = R.blid[src];
+	}
+	const size_t min_size = R.num_blocks();
+	minimized.resize_states(min_size);
+	valvec<CharTarget<size_t> > children;
+	children.reserve(sigma);
+	for(size_t s2 = 0; s2 < min_size; ++s2) {
+		state_id_t s1 = R.head[s2]; assert(R.blid[s1] == s2);
+		children.erase_all();
+		for_each_move(s1, [&](state_id_t t, auchar_t c) {
+			children.unchecked_push_back({c, R.blid[t]});
+			assert(R.blid[t] < min_size);
+		});
+		minimized.add_all_move(s2, children);
+		if (is_term(s1))
+			minimized.set_term_bit(s2);
+	}
+}
+
 template<class Au2>
 void graph_dfa_minimize(Au2& minimized) const {
 	minimized.erase_all();
@@ -55,6 +55,115 @@ size_t dfa_union_n(const SrcDFA& src, const SrcID* roots, size_t n_roots,
 	return pmap.data.size();
 }
 
+/// same result as dfa_union_n: states of a bfs batch are expanded by
+/// n_threads in parallel, then their subsets are added to pmap in bfs order,
+/// so the state ids are identical to dfa_union_n
+template<class SrcDFA, class SrcID>
+size_t par_dfa_union_n(const SrcDFA& src, const valvec<SrcID>& roots,
+		size_t n_threads,
+	   	size_t PowerLimit = size_t(-1), size_t timeout_us = 0) {
+	return par_dfa_union_n(src, roots.data(), roots.size(), n_threads,
+						   PowerLimit, timeout_us);
+}
+template<class SrcDFA, class SrcID>
+size_t par_dfa_union_n(const SrcDFA& src, const SrcID* roots, size_t n_roots,
+		size_t n_threads,
+		size_t PowerLimit = size_t(-1), size_t timeout_us = 0) {
+	if (n_threads <= 1)
+		return dfa_union_n(src, roots, n_roots, PowerLimit, timeout_us);
+	assert(src.get_sigma() <= this->get_sigma());
+	struct SubSet {
+		size_t ch;
+		size_t offset; // in Expanded::data
+		size_t length;
+		size_t hash;
+	};
+	struct Expanded { // expanded states of one thread
+		valvec<SrcID>  data;
+		valvec<SubSet> subsets;
+		valvec<size_t> subset_end; // per state
+		febitvec       is_final;   // per state
+	};
+	const size_t MaxBatch = 64*1024;
+	terark::profiling clock;
+	uint64_t time_start = timeout_us ? clock.now() : 0;
+	this->erase_all();
+	valvec<Expanded> expanded(n_threads);
+	valvec<CharTarget<size_t> > children(src.get_sigma(), valvec_no_init());
+	SubSetHashMap<SrcID> pmap(src.total_states());
+	pmap.find_or_add_subset(roots, n_roots);
+	for(size_t bfshead = 0; bfshead < pmap.size(); ) {
+		if (timeout_us) {
+			uint64_t time_curr = clock.now();
+			if (uint64_t(clock.us(time_start, time_curr)) > timeout_us) {
+				return 0; // Failed because timeout
+			}
+		}
+		const size_t batch = std::min(pmap.size() - bfshead, MaxBatch);
+		const size_t nthr = std::min(n_threads, (batch + 63) / 64);
+		auto chunk_beg = [&](size_t tid) { return bfshead + batch * tid / nthr; };
+		fsa_parallel_run(nthr, [&](size_t tid) {
+			Expanded& e = expanded[tid];
+			smallmap<NFA_SubSet<SrcID> > next_sets(src.get_sigma());
+			e.data.erase_all();
+			e.subsets.erase_all();
+			e.subset_end.erase_all();
+			e.is_final.erase_all();
+			for (size_t s = chunk_beg(tid); s < chunk_beg(tid+1); ++s) {
+				// pmap is not modified when expanding
+				size_t sub_beg = pmap.node[s+0].index;
+				size_t sub_end = pmap.node[s+1].index;
+				bool b_is_final = false;
+				next_sets.resize0();
+				for(size_t i = sub_beg; i < sub_end; ++i) {
+					size_t parent = pmap.data[i];
+					src.for_each_move(parent, [&](SrcID child, auchar_t ch) {
+						next_sets.bykey(ch).push_back(child);
+					});
+					b_is_final |= src.is_term(parent);
+				}
+				for(size_t i = 0; i < next_sets.size(); ++i) {
+					auto& ss = next_sets.byidx(i);
+					std::sort(ss.begin(), ss.end());
+					ss.trim(std::unique(ss.begin(), ss.end()));
+					SubSet x;
+					x.ch = ss.ch;
+					x.offset = e.data.size();
+					x.length = ss.size();
+					x.hash = uint_array_hash(ss.data(), ss.size());
+					e.data.append(ss);
+					e.subsets.push_back(x);
+				}
+				e.subset_end.push_back(e.subsets.size());
+				e.is_final.push_back(b_is_final);
+			}
+		});
+		for (size_t tid = 0; tid < nthr; ++tid) {
+			const Expanded& e = expanded[tid];
+			size_t j = 0;
+			for (size_t k = 0; k < e.subset_end.size(); ++k, ++bfshead) {
+				children.erase_all();
+				for (; j < e.subset_end[k]; ++j) {
+					const SubSet& x = e.subsets[j];
+					size_t next = pmap.find_or_add_subset(
+							e.data.data() + x.offset, x.length, x.hash);
+					children.push_back(CharTarget<size_t>(x.ch, next));
+				}
+				if (pmap.data.size() > PowerLimit) {
+					return 0;
+				}
+				if (!children.empty()) {
+					std::sort(children.begin(), children.end(), CharTarget_By_ch());
+					this->resize_states(pmap.size());
+					this->add_all_move(bfshead, children);
+				}
+				if (e.is_final[k]) this->set_term_bit(bfshead);
+			}
+		}
+	}
+	return pmap.data.size();
+}
+
 // return unioned_root_state_id
 template<class Uint>
 size_t dfa_lazy_union_n(const Uint* roots, size_t n_roots,
@@ -0,0 +1,823 @@
+#include "lazy_dfa.hpp"
+#include <terark/fsa/mre_match.hpp>
+#include <terark/fsa/x_fsa_util.hpp>
+#include <terark/bitmanip.hpp>
+#include <terark/util/autofree.hpp>
+#include <terark/util/linebuf.hpp>
+#include <terark/util/autoclose.hpp>
+#include <terark/util/profiling.hpp>
+#include <terark/util/throw.hpp>
+#include <re2/regexp.h>
+#include <re2/prog.h>
+
+namespace terark {
+
+using re2::StringPiece;
+using re2::Regexp;
+using re2::Prog;
+
+/// fixed capacity, never reallocated, so readers can walk it without lock
+/// while the writer is appending states
+class MultiRegexLazyDFA::Cache : boost::noncopyable {
+public:
+	struct StateInfo {
+		uint32_t set_beg;   // delta insts in pool[set_beg, set_beg + set_len)
+		uint32_t set_len;
+		uint32_t match_len; // followed by sorted regex_id(s)
+		uint32_t depth : 31;
+		uint32_t has_base : 1; // subset is base set + delta
+		uint32_t hash;
+		uint32_t link;
+	};
+	size_t ncls;
+	size_t cap_states;
+	size_t cap_pool;
+	size_t nbucket; // power of 2
+	size_t num_states = 0;
+	size_t pool_size = 0;
+	uint32_t start = DeadState;
+	AutoFree<std::atomic<uint32_t> > trans;
+	AutoFree<StateInfo> info;
+	AutoFree<uint32_t>  pool;
+	AutoFree<uint32_t>  bucket;
+
+	const uint32_t* set_of(size_t s) const { return pool.p + info.p[s].set_beg; }
+	const int* match_ids(size_t s) const {
+		return (const int*)(set_of(s) + info.p[s].set_len);
+	}
+	size_t match_num(size_t s) const { return info.p[s].match_len; }
+	std::atomic<uint32_t>* row(size_t s) const { return trans.p + s * ncls; }
+	size_t mem_size() const {
+		return num_states * (sizeof(uint32_t) * ncls + sizeof(StateInfo))
+			 + pool_size * sizeof(uint32_t) + nbucket * sizeof(uint32_t);
+	}
+	size_t mem_capacity() const {
+		return cap_states * (sizeof(uint32_t) * ncls + sizeof(StateInfo))
+			 + cap_pool * sizeof(uint32_t) + nbucket * sizeof(uint32_t);
+	}
+};
+
+MultiRegexLazyDFA::MultiRegexLazyDFA(const Options& opt) : m_opt(opt) {
+	m_regex_num = 0;
+	m_byte_class_num = 0;
+	memset(m_bytemap, 0, sizeof(m_bytemap));
+	memset(m_class_rep, 0, sizeof(m_class_rep));
+	memset(m_boundary, 0, sizeof(m_boundary));
+	m_cache_raw = NULL;
+	m_stamp = 0;
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+MultiRegexLazyDFA::~MultiRegexLazyDFA() {
+}
+
+int MultiRegexLazyDFA::add_regex(fstring regex, std::string* err) {
+	if (m_cache) {
+		THROW_STD(logic_error, "add_regex after compile");
+	}
+	re2::RegexpStatus status;
+	int flags = Regexp::LikePerl | Regexp::MatchNL | Regexp::NeverCapture;
+	if (m_opt.ignoreCase)
+		flags |= Regexp::FoldCase;
+	Regexp* re = Regexp::Parse(StringPiece(regex.p, regex.n),
+							   Regexp::ParseFlags(flags), &status);
+	if (NULL == re) {
+		if (err)
+			*err = status.Text();
+		return -1;
+	}
+	size_t max_mem = 128*1024*1024; // 128M, same as regex_build
+	std::unique_ptr<Prog> prog(re->CompileToProg(max_mem));
+	re->Decref();
+	if (!prog) {
+		if (err)
+			*err = "re2 CompileToProg failed";
+		return -1;
+	}
+	auto mark = [this](int c) {
+		if (c >= 0 && c <= 256)
+			m_boundary[c/64] |= uint64_t(1) << (c%64);
+	};
+	const int regex_id = int(m_regex_num);
+	const uint32_t base = uint32_t(m_inst.size());
+	m_inst.resize_no_init(base + prog->size());
+	for (int i = 0; i < prog->size(); ++i) {
+		Prog::Inst* ip = prog->inst(i);
+		Inst& x = m_inst[base + i];
+		memset(&x, 0, sizeof(x));
+		x.op = byte_t(ip->opcode());
+		switch (ip->opcode()) {
+		default:
+			assert(0);
+			break;
+		case re2::kInstFail:
+			break;
+		case re2::kInstMatch:
+			x.out = regex_id;
+			break;
+		case re2::kInstAlt:
+		case re2::kInstAltMatch:
+			x.out  = base + ip->out();
+			x.out1 = base + ip->out1();
+			break;
+		case re2::kInstByteRange:
+			x.lo   = byte_t(ip->lo());
+			x.hi   = byte_t(ip->hi());
+			x.fold = byte_t(ip->foldcase() ? 1 : 0);
+			x.out  = base + ip->out();
+			mark(x.lo);
+			mark(x.hi + 1);
+			if (x.fold) {
+				mark('A');
+				mark('Z' + 1);
+				mark(std::max<int>(x.lo, 'a') - 32);
+				mark(std::min<int>(x.hi, 'z') + 1 - 32);
+			}
+			break;
+		case re2::kInstCapture:
+		case re2::kInstNop:
+		case re2::kInstEmptyWidth:
+			x.out = base + ip->out();
+			break;
+		}
+	}
+	int start = m_opt.addDotStar ? prog->start_unanchored() : prog->start();
+	m_starts.push_back(base + start);
+	m_regex_num++;
+	return regex_id;
+}
+
+size_t MultiRegexLazyDFA::load_regex_file(fstring fpath) {
+	Auto_fclose fp(fopen(fpath.c_str(), "r"));
+	if (!fp) {
+		THROW_STD(invalid_argument, "fopen(%s, r) = %s", fpath.c_str(), strerror(errno));
+	}
+	LineBuf line;
+	std::string multiline, err;
+	valvec<fstring> F;
+	long lineno = 0, next_lineno = 1;
+	size_t nValid = 0;
+	bool is_eof = false;
+	while (!is_eof) {
+		lineno = next_lineno;
+		multiline.resize(0);
+		while (!(is_eof = line.getline(fp) < 0)) {
+			next_lineno++;
+			line.chomp();
+			if (line.empty()) break;
+			if ('\\' == line.end()[-1]) {
+				multiline.append(line.begin(), line.size()-1);
+			} else {
+				multiline.append(line.begin(), line.size());
+				break;
+			}
+		}
+		if (multiline.empty() || '#' == multiline[0]) {
+			continue;
+		}
+		fstring(multiline).split('\t', &F);
+		if (F.empty() || F[0].empty()) {
+			continue;
+		}
+		if (add_regex(F[0], &err) < 0) {
+			fprintf(stderr, "WARN: %s:%ld: skipped: %s\n",
+					fpath.c_str(), lineno, err.c_str());
+			continue;
+		}
+		nValid++;
+	}
+	return nValid;
+}
+
+static inline uint32_t next_stamp(valvec<uint32_t>& mark, uint32_t& stamp) {
+	if (terark_unlikely(0 == ++stamp)) {
+		mark.fill(0);
+		stamp = 1;
+	}
+	return stamp;
+}
+
+void MultiRegexLazyDFA::compile() {
+	if (0 == m_regex_num) {
+		THROW_STD(invalid_argument, "no any valid regex");
+	}
+	size_t cls = 0;
+	for (size_t c = 0; c < 256; ++c) {
+		if (c && (m_boundary[c/64] >> (c%64) & 1))
+			cls++;
+		if (0 == c || m_bytemap[c-1] != cls)
+			m_class_rep[cls] = byte_t(c);
+		m_bytemap[c] = byte_t(cls);
+	}
+	m_byte_class_num = cls + 1;
+	m_inst.shrink_to_fit();
+	m_mark.resize(m_inst.size(), 0);
+	m_stamp = 0;
+
+	// base set is the start subset
+	m_base.erase_all();
+	next_stamp(m_mark, m_stamp);
+	for (uint32_t root : m_starts)
+		add_closure(root, &m_base, false);
+	std::sort(m_base.begin(), m_base.end());
+	m_in_base.resize_fill(m_inst.size(), 0);
+	m_base_match.erase_all();
+	for (uint32_t i : m_base) {
+		m_in_base.set1(i);
+		if (re2::kInstMatch == m_inst[i].op)
+			m_base_match.push_back(m_inst[i].out);
+	}
+	m_base_match.trim(std::unique(m_base_match.begin(), m_base_match.end()));
+	m_base_keeps.resize_fill(m_byte_class_num, 0);
+	m_base_delta.erase_all();
+	m_base_delta_offsets.resize_no_init(m_byte_class_num + 1);
+	m_base_delta_offsets[0] = 0;
+	for (size_t c = 0; c < m_byte_class_num; ++c) {
+		m_next.erase_all();
+		next_stamp(m_mark, m_stamp);
+		move_set(m_base.data(), m_base.size(), m_class_rep[c], &m_next);
+		std::sort(m_next.begin(), m_next.end());
+		if (strip_base(&m_next)) {
+			m_base_keeps.set1(c);
+			m_base_delta.append(m_next);
+		}
+		m_base_delta_offsets[c+1] = uint32_t(m_base_delta.size());
+	}
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_stats.regexNum = m_regex_num;
+	m_stats.instNum = m_inst.size();
+	m_stats.byteClassNum = m_byte_class_num;
+	m_cache = new_cache();
+	m_cache_raw.store(m_cache.get(), std::memory_order_release);
+}
+
+// collect ByteRange and Match insts in epsilon closure of root,
+// if skip_base, insts in base set are not collected
+void MultiRegexLazyDFA::add_closure(uint32_t root, valvec<uint32_t>* set,
+									bool skip_base) const {
+	const uint32_t stamp = m_stamp;
+	uint32_t* mark = m_mark.data();
+	const Inst* inst = m_inst.data();
+	m_stack.push_back(root);
+	while (!m_stack.empty()) {
+		uint32_t i = m_stack.pop_val();
+		if (mark[i] == stamp)
+			continue;
+		mark[i] = stamp;
+		const Inst& x = inst[i];
+		switch (x.op) {
+		case re2::kInstByteRange:
+		case re2::kInstMatch:
+			if (!skip_base || m_in_base.is0(i))
+				set->push_back(i);
+			break;
+		case re2::kInstFail:
+			break;
+		case re2::kInstAlt:
+		case re2::kInstAltMatch:
+			m_stack.push_back(x.out1);
+			m_stack.push_back(x.out);
+			break;
+		default:
+			m_stack.push_back(x.out);
+			break;
+		}
+	}
+}
+
+// out = sorted move(set, ch) without base filtering
+void MultiRegexLazyDFA::move_set(const uint32_t* set, size_t len, byte_t ch,
+								 valvec<uint32_t>* out) const {
+	for (size_t j = 0; j < len; ++j) {
+		const Inst& x = m_inst[set[j]];
+		if (re2::kInstByteRange == x.op && x.matches(ch))
+			add_closure(x.out, out, false);
+	}
+}
+
+/// if set includes base set, remove base set from it and return true
+bool MultiRegexLazyDFA::strip_base(valvec<uint32_t>* set) const {
+	size_t nbase = 0;
+	for (uint32_t i : *set)
+		nbase += m_in_base.is1(i);
+	if (nbase != m_base.size())
+		return false;
+	uint32_t* p = set->data();
+	size_t n = 0;
+	for (size_t j = 0; j < set->size(); ++j)
+		if (m_in_base.is0(p[j]))
+			p[n++] = p[j];
+	set->risk_set_size(n);
+	return true;
+}
+
+/// m_next = sorted nfa subset of move(state, cls),
+/// @returns true if m_next is a delta of base set
+///
+/// With many unanchored regexes, base set(the start subset) is large and it
+/// is a subset of almost all states, thus states just save the delta and
+/// move(base, cls) is precomputed, a cache miss just costs O(delta).
+bool MultiRegexLazyDFA::next_set(const Cache* c, uint32_t s, size_t cls) const {
+	m_next.erase_all();
+	next_stamp(m_mark, m_stamp);
+	const byte_t ch = m_class_rep[cls];
+	const uint32_t* set = c->set_of(s);
+	const auto& si = c->info.p[s];
+	if (si.has_base && m_base_keeps.is1(cls)) {
+		// move(base + delta) = base + move(base)\base + move(delta)\base
+		const uint32_t* bd = m_base_delta.data() + m_base_delta_offsets[cls];
+		const size_t nbd = m_base_delta_offsets[cls+1] - m_base_delta_offsets[cls];
+		for (size_t j = 0; j < nbd; ++j)
+			m_mark[bd[j]] = m_stamp;
+		m_next.append(bd, nbd);
+		for (size_t j = 0; j < si.set_len; ++j) {
+			const Inst& x = m_inst[set[j]];
+			if (re2::kInstByteRange == x.op && x.matches(ch))
+				add_closure(x.out, &m_next, true);
+		}
+		std::sort(m_next.begin(), m_next.end());
+		return true;
+	}
+	if (si.has_base)
+		move_set(m_base.data(), m_base.size(), ch, &m_next);
+	move_set(set, si.set_len, ch, &m_next);
+	std::sort(m_next.begin(), m_next.end());
+	return strip_base(&m_next);
+}
+
+/// @returns state id with MatchFlag, UnknownState if cache is full
+uint32_t MultiRegexLazyDFA::add_state(Cache* c, const uint32_t* set, size_t len,
+									  bool has_base, uint32_t depth) const {
+	if (0 == len && !has_base)
+		return DeadState;
+	uint32_t h = has_base;
+	for (size_t i = 0; i < len; ++i) {
+		h += set[i];
+		h *= 31;
+		h += h << 3 | h >> 29;
+	}
+	const size_t ibkt = h & (c->nbucket - 1);
+	for (uint32_t s = c->bucket.p[ibkt]; UnknownState != s; s = c->info.p[s].link) {
+		auto& si = c->info.p[s];
+		if (si.hash == h && si.set_len == len && si.has_base == has_base &&
+				memcmp(c->set_of(s), set, sizeof(uint32_t) * len) == 0)
+			return s | (si.match_len ? MatchFlag : 0);
+	}
+	size_t nmatch = has_base ? m_base_match.size() : 0;
+	for (size_t i = 0; i < len; ++i)
+		nmatch += re2::kInstMatch == m_inst[set[i]].op;
+	if (c->num_states == c->cap_states || c->pool_size + len + nmatch > c->cap_pool)
+		return UnknownState;
+	const uint32_t s = uint32_t(c->num_states);
+	uint32_t* dst = c->pool.p + c->pool_size;
+	std::copy_n(set, len, dst);
+	uint32_t* ids = dst + len;
+	size_t match_len = 0;
+	if (has_base) {
+		std::copy(m_base_match.begin(), m_base_match.end(), ids);
+		match_len = m_base_match.size();
+	}
+	for (size_t i = 0; i < len; ++i) {
+		const Inst& x = m_inst[set[i]];
+		if (re2::kInstMatch == x.op)
+			ids[match_len++] = x.out;
+	}
+	if (has_base && match_len > m_base_match.size()) {
+		std::sort(ids, ids + match_len);
+	}
+	match_len = std::unique(ids, ids + match_len) - ids;
+	auto row = c->row(s);
+	for (size_t j = 0; j < c->ncls; ++j)
+		row[j].store(UnknownState, std::memory_order_relaxed);
+	auto& si = c->info.p[s];
+	si.set_beg = uint32_t(c->pool_size);
+	si.set_len = uint32_t(len);
+	si.match_len = uint32_t(match_len);
+	si.depth = depth;
+	si.has_base = has_base;
+	si.hash = h;
+	si.link = c->bucket.p[ibkt];
+	c->bucket.p[ibkt] = s;
+	c->pool_size += len + match_len;
+	c->num_states++;
+	m_stats.totalStates++;
+	return s | (match_len ? MatchFlag : 0);
+}
+
+std::shared_ptr<MultiRegexLazyDFA::Cache> MultiRegexLazyDFA::new_cache() const {
+	const size_t ncls = m_byte_class_num;
+	const size_t row = sizeof(uint32_t) * (ncls + 2) + sizeof(Cache::StateInfo);
+	// pool must hold some largest subsets, else no progress is possible
+	const size_t min_pool = 4 * (m_inst.size() + m_regex_num) + 1024;
+	size_t cap_states = std::max<size_t>(m_opt.maxmem / 2 / row, 256);
+	size_t cap_pool = std::max<size_t>(m_opt.maxmem / 2 / sizeof(uint32_t), min_pool);
+	cap_states = std::min<size_t>(cap_states, MatchFlag - 1);
+	cap_pool = std::min<size_t>(cap_pool, UnknownState);
+	std::shared_ptr<Cache> c(new Cache);
+	c->ncls = ncls;
+	c->cap_states = cap_states;
+	c->cap_pool = cap_pool;
+	c->nbucket = size_t(1) << terark_bsr_u64(cap_states * 2 - 1);
+	AutoFree<std::atomic<uint32_t> >(cap_states * ncls).swap(c->trans);
+	AutoFree<Cache::StateInfo>(cap_states).swap(c->info);
+	AutoFree<uint32_t>(cap_pool).swap(c->pool);
+	AutoFree<uint32_t>(c->nbucket, UnknownState).swap(c->bucket);
+
+	// the dead state has an empty subset and is not in hash table
+	auto& dead = c->info.p[DeadState];
+	memset(&dead, 0, sizeof(dead));
+	auto dead_row = c->row(DeadState);
+	for (size_t j = 0; j < ncls; ++j)
+		dead_row[j].store(DeadState, std::memory_order_relaxed);
+	c->num_states = 1;
+
+	// the start state is the base set with empty delta
+	c->start = add_state(c.get(), NULL, 0, true, 0);
+	TERARK_VERIFY_NE(c->start, UnknownState);
+	return c;
+}
+
+std::shared_ptr<MultiRegexLazyDFA::Cache> MultiRegexLazyDFA::get_cache() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (!m_cache) {
+		THROW_STD(logic_error, "MultiRegexLazyDFA is not compiled");
+	}
+	return m_cache;
+}
+
+// discard current cache, keep shallow states which are the hottest
+void MultiRegexLazyDFA::reset_cache() const {
+	std::shared_ptr<Cache> old = std::move(m_cache);
+	std::shared_ptr<Cache> nc = new_cache();
+	size_t kept = 0;
+	if (m_opt.keepDepth) {
+		const size_t ncls = old->ncls;
+		valvec<uint32_t> map(old->num_states, UnknownState);
+		map[DeadState] = DeadState;
+		valvec<uint32_t> keep;
+		for (size_t s = 1; s < old->num_states; ++s) {
+			auto& si = old->info.p[s];
+			if (si.depth > m_opt.keepDepth)
+				continue;
+			if (nc->num_states >= nc->cap_states / 2 ||
+				nc->pool_size + si.set_len + si.match_len >= nc->cap_pool / 2)
+				break;
+			map[s] = add_state(nc.get(), old->set_of(s), si.set_len, si.has_base, si.depth);
+			keep.push_back(uint32_t(s));
+		}
+		for (uint32_t s : keep) {
+			auto src = old->row(s);
+			auto dst = nc->row(map[s] & ~MatchFlag);
+			for (size_t j = 0; j < ncls; ++j) {
+				uint32_t t = src[j].load(std::memory_order_relaxed);
+				if (UnknownState != t && UnknownState != map[t & ~MatchFlag])
+					dst[j].store(map[t & ~MatchFlag], std::memory_order_relaxed);
+			}
+		}
+		kept = keep.size();
+	}
+	m_cache = std::move(nc);
+	m_cache_raw.store(m_cache.get(), std::memory_order_release);
+	m_stats.resets++;
+	m_stats.keptStates += kept;
+}
+
+/// compute the transition (*curr, cls), cache may be switched to the current
+/// cache, in which case *curr is translated to the state in new cache
+uint32_t MultiRegexLazyDFA::slow_move(std::shared_ptr<Cache>& cache,
+									  uint32_t* curr, size_t cls) const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	const Cache* src = cache.get(); // keeps subset of *curr alive
+	const uint32_t s = *curr & ~MatchFlag;
+	Cache* c = m_cache.get();
+	if (src == c) {
+		// may have been computed by other threads
+		uint32_t n = c->row(s)[cls].load(std::memory_order_relaxed);
+		if (UnknownState != n)
+			return n;
+	}
+	profiling pf;
+	auto t0 = pf.now();
+	const auto& si = src->info.p[s];
+	const bool next_has_base = next_set(src, s, cls);
+	uint32_t cs = *curr;
+	if (src != c)
+		cs = add_state(c, src->set_of(s), si.set_len, si.has_base, si.depth);
+	uint32_t n = UnknownState;
+	if (UnknownState != cs)
+		n = add_state(c, m_next.data(), m_next.size(), next_has_base, si.depth + 1);
+	if (UnknownState == cs || UnknownState == n) {
+		reset_cache();
+		c = m_cache.get();
+		cs = add_state(c, src->set_of(s), si.set_len, si.has_base, si.depth);
+		n = add_state(c, m_next.data(), m_next.size(), next_has_base, si.depth + 1);
+		TERARK_VERIFY_NE(cs, UnknownState);
+		TERARK_VERIFY_NE(n, UnknownState);
+	}
+	c->row(cs & ~MatchFlag)[cls].store(n, std::memory_order_release);
+	*curr = cs;
+	if (src != c)
+		cache = m_cache; // may free src, it is no longer used
+	m_stats.misses++;
+	m_stats.missNanos += pf.ns(t0, pf.now());
+	return n;
+}
+
+MultiRegexLazyDFA::Stats MultiRegexLazyDFA::get_stats() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Stats st = m_stats;
+	if (m_cache) {
+		st.states = m_cache->num_states;
+		st.memSize = m_cache->mem_size();
+	}
+	return st;
+}
+
+void MultiRegexLazyDFA::print_stats(FILE* fp) const {
+	Stats st = get_stats();
+	fprintf(fp, "MultiRegexLazyDFA: regex %zd, nfa insts %zd, byte classes %zd\n"
+		, st.regexNum, st.instNum, st.byteClassNum);
+	fprintf(fp, "  states %zd, total states %zd, mem %zd\n"
+		, st.states, st.totalStates, st.memSize);
+	fprintf(fp, "  misses %zd, miss time %.3f ms, resets %zd, kept states %zd\n"
+		, st.misses, st.missNanos / 1e6, st.resets, st.keptStates);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+class MultiRegexFullMatchLazy : public MultiRegexFullMatch {
+	typedef MultiRegexLazyDFA::Cache Cache;
+	static const uint32_t DeadState = MultiRegexLazyDFA::DeadState;
+	static const uint32_t MatchFlag = MultiRegexLazyDFA::MatchFlag;
+	static const uint32_t UnknownState = MultiRegexLazyDFA::UnknownState;
+	const MultiRegexLazyDFA* m_lazy;
+	std::shared_ptr<Cache> m_cache;
+	size_t m_epoch = 0; // inc on cache switch, (m_epoch, state) is unique
+
+	// on_match(cache, state, len) returns false to stop
+	template<class TR, class OnMatch>
+	void scan(fstring text, TR tr, OnMatch on_match) {
+		if (m_lazy->m_cache_raw.load(std::memory_order_acquire) != m_cache.get()) {
+			m_cache = m_lazy->get_cache();
+			m_epoch++;
+		}
+		const Cache* c = m_cache.get();
+		const byte_t* bytemap = m_lazy->m_bytemap;
+		const byte_t* beg = text.udata();
+		const byte_t* end = beg + text.n;
+		const byte_t* pos = beg;
+		uint32_t curr = c->start;
+		for (;;) {
+			if (terark_unlikely(curr & MatchFlag)) {
+				if (!on_match(c, curr & ~MatchFlag, size_t(pos - beg)))
+					return;
+			}
+			if (pos == end)
+				return;
+			size_t cls = bytemap[(byte_t)tr(*pos)];
+			uint32_t next = c->row(curr & ~MatchFlag)[cls].load(std::memory_order_acquire);
+			if (terark_unlikely(UnknownState == next)) {
+				next = m_lazy->slow_move(m_cache, &curr, cls);
+				if (c != m_cache.get()) {
+					c = m_cache.get();
+					m_epoch++;
+				}
+			}
+			if (DeadState == next)
+				return;
+			curr = next;
+			pos++;
+		}
+	}
+
+	template<class TR>
+	size_t match_with_tr(fstring text, TR tr) {
+		m_regex_idvec.erase_all();
+		size_t len = 0, last_epoch = 0;
+		uint32_t last_state = UnknownState;
+		scan(text, tr, [&](const Cache* c, uint32_t s, size_t l) {
+			if (s != last_state || m_epoch != last_epoch) {
+				m_regex_idvec.assign(c->match_ids(s), c->match_num(s));
+				last_state = s;
+				last_epoch = m_epoch;
+			}
+			len = l;
+			return true;
+		});
+		return len;
+	}
+
+	template<class TR>
+	size_t shortest_match_with_tr(fstring text, TR tr) {
+		m_regex_idvec.erase_all();
+		size_t len = 0;
+		scan(text, tr, [&](const Cache* c, uint32_t s, size_t l) {
+			m_regex_idvec.assign(c->match_ids(s), c->match_num(s));
+			len = l;
+			return false;
+		});
+		return len;
+	}
+
+	template<class TR>
+	size_t match_all_with_tr(fstring text, TR tr) {
+		m_regex_idvec.erase_all();
+		size_t last_epoch = 0;
+		uint32_t last_state = UnknownState;
+		scan(text, tr, [&](const Cache* c, uint32_t s, size_t) {
+			if (s != last_state || m_epoch != last_epoch) {
+				m_regex_idvec.append(c->match_ids(s), c->match_num(s));
+				last_state = s;
+				last_epoch = m_epoch;
+			}
+			return true;
+		});
+		sort_a(m_regex_idvec);
+		m_regex_idvec.trim(std::unique(m_regex_idvec.begin(), m_regex_idvec.end()));
+		return m_regex_idvec.size();
+	}
+
+	/// each regex_id is reported once with its longest match len
+	template<class TR>
+	size_t match_all_len_with_tr(fstring text, TR tr) {
+		m_cur_match.erase_all();
+		size_t last_epoch = 0, batch = 0;
+		uint32_t last_state = UnknownState;
+		scan(text, tr, [&](const Cache* c, uint32_t s, size_t l) {
+			if (s != last_state || m_epoch != last_epoch) {
+				batch = m_cur_match.size();
+				for (size_t i = 0, n = c->match_num(s); i < n; ++i)
+					m_cur_match.push_back({int(l), c->match_ids(s)[i]});
+				last_state = s;
+				last_epoch = m_epoch;
+			}
+			else {
+				for (size_t i = batch; i < m_cur_match.size(); ++i)
+					m_cur_match[i].len = int(l);
+			}
+			return true;
+		});
+		std::sort(m_cur_match.begin(), m_cur_match.end(),
+			[](const LenRegexID& x, const LenRegexID& y) {
+				return x.regex_id != y.regex_id ? x.regex_id < y.regex_id : x.len > y.len;
+			});
+		m_cur_match.trim(std::unique(m_cur_match.begin(), m_cur_match.end(),
+			[](const LenRegexID& x, const LenRegexID& y) {
+				return x.regex_id == y.regex_id;
+			}));
+		return m_cur_match.size();
+	}
+
+	// resumable match, m_cache is not switched between chunks, because
+	// m_stream_curr is a state of m_cache
+	uint32_t   m_stream_curr = DeadState;
+	uint32_t   m_stream_last = UnknownState;
+	size_t     m_stream_epoch = 0;
+	size_t     m_stream_match_len = 0;
+	size_t     m_stream_len = 0; // fed len
+	StreamMode m_stream_mode = StreamLongest;
+
+	// returns false if the result is final
+	bool stream_on_match(const Cache* c, uint32_t s, size_t l) {
+		if (StreamAll == m_stream_mode) {
+			if (s != m_stream_last || m_epoch != m_stream_epoch)
+				m_regex_idvec.append(c->match_ids(s), c->match_num(s));
+		}
+		else if (s != m_stream_last || m_epoch != m_stream_epoch) {
+			m_regex_idvec.assign(c->match_ids(s), c->match_num(s));
+		}
+		m_stream_last = s;
+		m_stream_epoch = m_epoch;
+		m_stream_match_len = l; // for StreamAll, it is not used
+		return StreamShortest != m_stream_mode;
+	}
+
+	template<class TR>
+	bool feed_with_tr(fstring chunk, TR tr) {
+		if (DeadState == m_stream_curr)
+			return false;
+		const Cache* c = m_cache.get();
+		const byte_t* bytemap = m_lazy->m_bytemap;
+		const byte_t* pos = chunk.udata();
+		const byte_t* end = pos + chunk.n;
+		uint32_t curr = m_stream_curr;
+		for (; pos < end; ++pos) {
+			size_t cls = bytemap[(byte_t)tr(*pos)];
+			uint32_t next = c->row(curr & ~MatchFlag)[cls].load(std::memory_order_acquire);
+			if (terark_unlikely(UnknownState == next)) {
+				next = m_lazy->slow_move(m_cache, &curr, cls);
+				if (c != m_cache.get()) {
+					c = m_cache.get();
+					m_epoch++;
+				}
+			}
+			if (DeadState == next)
+				break;
+			curr = next;
+			if (terark_unlikely(curr & MatchFlag)) {
+				size_t len = m_stream_len + (pos + 1 - chunk.udata());
+				if (!stream_on_match(c, curr & ~MatchFlag, len))
+					break;
+			}
+		}
+		m_stream_len += chunk.size();
+		m_stream_curr = pos == end ? curr : DeadState;
+		return DeadState != m_stream_curr;
+	}
+
+public:
+	void begin_feed(StreamMode mode) override {
+		if (m_lazy->m_cache_raw.load(std::memory_order_acquire) != m_cache.get()) {
+			m_cache = m_lazy->get_cache();
+			m_epoch++;
+		}
+		m_regex_idvec.erase_all();
+		m_stream_mode = mode;
+		m_stream_last = UnknownState;
+		m_stream_match_len = 0;
+		m_stream_len = 0;
+		m_stream_curr = m_cache->start;
+		if (m_stream_curr & MatchFlag) {
+			if (!stream_on_match(m_cache.get(), m_stream_curr & ~MatchFlag, 0))
+				m_stream_curr = DeadState;
+		}
+	}
+	bool feed(fstring chunk) override {
+		return feed_with_tr(chunk, IdentityTR());
+	}
+	bool feed(fstring chunk, const ByteTR& tr) override {
+		return feed_with_tr<const ByteTR&>(chunk, tr);
+	}
+	bool feed(fstring chunk, const byte_t* tr) override {
+		return feed_with_tr<TableTranslator>(chunk, tr);
+	}
+	size_t finish() override {
+		m_stream_curr = DeadState;
+		if (StreamAll == m_stream_mode) {
+			sort_a(m_regex_idvec);
+			m_regex_idvec.trim(std::unique(m_regex_idvec.begin(), m_regex_idvec.end()));
+			return m_regex_idvec.size();
+		}
+		return m_stream_match_len;
+	}
+
+	explicit MultiRegexFullMatchLazy(const MultiRegexMatchOptions& opt) {
+		m_lazy = opt.get_lazy_dfa();
+		m_options = &opt;
+		m_cache = m_lazy->get_cache();
+	}
+	MultiRegexFullMatchLazy(const MultiRegexFullMatchLazy& y)
+	  : MultiRegexFullMatch(y), m_lazy(y.m_lazy), m_cache(y.m_cache) {
+		m_options = y.m_options;
+	}
+	MultiRegexFullMatch* clone() const override {
+		return new MultiRegexFullMatchLazy(*this);
+	}
+
+	size_t match(fstring text) override {
+		return match_with_tr(text, IdentityTR());
+	}
+	size_t match(fstring text, const ByteTR& tr) override {
+		return match_with_tr<const ByteTR&>(text, tr);
+	}
+	size_t match(fstring text, const byte_t* tr) override {
+		return match_with_tr<TableTranslator>(text, tr);
+	}
+
+	size_t shortest_match(fstring text) override {
+		return shortest_match_with_tr(text, IdentityTR());
+	}
+	size_t shortest_match(fstring text, const ByteTR& tr) override {
+		return shortest_match_with_tr<const ByteTR&>(text, tr);
+	}
+	size_t shortest_match(fstring text, const byte_t* tr) override {
+		return shortest_match_with_tr<TableTranslator>(text, tr);
+	}
+
+	size_t match_all(fstring text) override {
+		return match_all_with_tr(text, IdentityTR());
+	}
+	size_t match_all(fstring text, const ByteTR& tr) override {
+		return match_all_with_tr<const ByteTR&>(text, tr);
+	}
+	size_t match_all(fstring text, const byte_t* tr) override {
+		return match_all_with_tr<TableTranslator>(text, tr);
+	}
+
+	size_t match_all_len(fstring text) override {
+		return match_all_len_with_tr(text, IdentityTR());
+	}
+	size_t match_all_len(fstring text, const ByteTR& tr) override {
+		return match_all_len_with_tr<const ByteTR&>(text, tr);
+	}
+	size_t match_all_len(fstring text, const byte_t* tr) override {
+		return match_all_len_with_tr<TableTranslator>(text, tr);
+	}
+};
+
+// called by MultiRegexFullMatch::create
+MultiRegexFullMatch* MultiRegexFullMatch_lazy(const MultiRegexMatchOptions& opt) {
+	return new MultiRegexFullMatchLazy(opt);
+}
+
+} // namespace terark
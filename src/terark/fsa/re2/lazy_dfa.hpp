@@ -0,0 +1,130 @@
+#pragma once
+
+#include <terark/fstring.hpp>
+#include <terark/valvec.hpp>
+#include <terark/bitmap.hpp>
+#include <boost/noncopyable.hpp>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stdio.h>
+
+namespace terark {
+
+/// DFA of a multi regex set which is determinized lazily from the re2
+/// programs of the regexes: a DFA state is created on its first visit and is
+/// cached in a memory bounded state cache, so loading does not need the power
+/// set construction and the matching only pays for visited states.
+///
+/// One object is shared by all threads, each thread uses its own matcher
+/// created by MultiRegexFullMatch::create, cache reads are lock free, cache
+/// misses are serialized by a mutex.
+///
+/// As RE2_VM_NFA, empty width assertions(^ $ \b ...) are treated as epsilon.
+class TERARK_DLL_EXPORT MultiRegexLazyDFA : boost::noncopyable {
+public:
+	struct Options {
+		size_t maxmem = size_t(64) << 20; // soft limit of the state cache
+		/// on cache reset, states whose depth(distance from the start state)
+		/// is not greater than keepDepth and the transitions between them are
+		/// kept in the new cache, 0 means discard all
+		unsigned keepDepth = 2;
+		bool ignoreCase = false;
+		bool addDotStar = false; // unanchored start, same as regex_build -a
+	};
+	struct Stats {
+		size_t regexNum;
+		size_t instNum;       // nfa states
+		size_t byteClassNum;
+		size_t states;        // states in current cache
+		size_t totalStates;   // states created since compile
+		size_t misses;        // transitions computed from nfa
+		size_t resets;        // cache resets
+		size_t keptStates;    // states kept by all cache resets
+		size_t memSize;       // memory of current cache
+		size_t missNanos;     // time spent on computing transitions
+	};
+	class Cache;
+
+	explicit MultiRegexLazyDFA(const Options&);
+	~MultiRegexLazyDFA();
+
+	/// @returns regex_id, -1 on syntax error and err is set
+	int add_regex(fstring regex, std::string* err = NULL);
+
+	/// input file format is same as regex_build: a regex per line, '\t'
+	/// separated columns are ignored, '\\' at line end continues the line,
+	/// '#' starts a comment line. regex_id is the ordinal of valid regexes,
+	/// invalid regexes are skipped with a warning, same as regex_build.
+	/// composing regex syntax of regex_build is not supported.
+	/// @returns number of valid regexes
+	size_t load_regex_file(fstring fpath);
+
+	/// must be called after all regexes are added and before matching
+	void compile();
+
+	size_t num_regex() const { return m_regex_num; }
+	const Options& options() const { return m_opt; }
+	Stats get_stats() const;
+	void print_stats(FILE*) const;
+
+	static const uint32_t DeadState = 0;
+	static const uint32_t MatchFlag = 0x80000000u;
+	static const uint32_t UnknownState = 0xFFFFFFFFu;
+
+private:
+	friend class MultiRegexFullMatchLazy;
+#pragma pack(push,1)
+	struct Inst { // flattened re2::Prog::Inst
+		byte_t   op;   // re2::InstOp
+		byte_t   lo;
+		byte_t   hi;
+		byte_t   fold;
+		uint32_t out;  // regex_id for kInstMatch
+		uint32_t out1;
+
+		bool matches(byte_t c) const {
+			if (lo <= c && c <= hi)
+				return true;
+			// same as RE2_VM_NFA::get_non_epsilon_targets
+			return fold && c >= 'A' && c <= 'Z' && lo <= c + 32 && c + 32 <= hi;
+		}
+	};
+#pragma pack(pop)
+	std::shared_ptr<Cache> get_cache() const;
+	std::shared_ptr<Cache> new_cache() const;
+	uint32_t slow_move(std::shared_ptr<Cache>&, uint32_t* curr, size_t cls) const;
+	uint32_t add_state(Cache*, const uint32_t* set, size_t len,
+					   bool has_base, uint32_t depth) const;
+	void add_closure(uint32_t inst, valvec<uint32_t>* set, bool skip_base) const;
+	void move_set(const uint32_t* set, size_t len, byte_t ch, valvec<uint32_t>*) const;
+	bool strip_base(valvec<uint32_t>* set) const;
+	bool next_set(const Cache*, uint32_t state, size_t cls) const;
+	void reset_cache() const;
+
+	Options m_opt;
+	valvec<Inst>     m_inst;
+	valvec<uint32_t> m_starts;
+	size_t   m_regex_num;
+	size_t   m_byte_class_num;
+	byte_t   m_bytemap[256];
+	byte_t   m_class_rep[256]; // a representative byte of each class
+	uint64_t m_boundary[5];    // byte class boundaries, 257 bits
+	valvec<uint32_t> m_base;   // sorted start subset
+	febitvec         m_in_base;
+	valvec<int>      m_base_match;
+	febitvec         m_base_keeps; // move(base, cls) includes base
+	valvec<uint32_t> m_base_delta; // move(base, cls) - base
+	valvec<uint32_t> m_base_delta_offsets;
+
+	mutable std::mutex m_mutex;
+	mutable std::shared_ptr<Cache> m_cache;
+	mutable std::atomic<Cache*>    m_cache_raw;
+	mutable valvec<uint32_t> m_mark; // stamps of epsilon closure
+	mutable valvec<uint32_t> m_stack;
+	mutable valvec<uint32_t> m_next;
+	mutable uint32_t m_stamp;
+	mutable Stats    m_stats;
+};
+
+} // namespace terark
@@ -1,7 +1,9 @@
 #pragma once
 
 #include "dfa_algo.hpp"
+#include "dfa_mmap_header.hpp"
 #include "mre_delim.hpp"
+#include "nfa.hpp"
 #include <terark/mempool_lock_none.hpp>
 
 namespace terark {
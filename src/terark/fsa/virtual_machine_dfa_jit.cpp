@@ -0,0 +1,385 @@
+#include "virtual_machine_dfa_jit.hpp"
+#include <terark/hash_strmap.hpp>
+#include <terark/bitmap.hpp>
+
+#if defined(__x86_64__) && !defined(_MSC_VER)
+	#define TERARK_VMDFA_JIT 1
+	#include <sys/mman.h>
+#else
+	#define TERARK_VMDFA_JIT 0
+#endif
+
+namespace terark {
+
+// JIT exits with this flag when it entered a path zip state, the driver
+// matches the zpath then reenters the state
+static const uint32_t PzipFlag = 0x80000000u;
+
+VirtualMachineDFA_JIT::VirtualMachineDFA_JIT(const VirtualMachineDFA* dfa,
+											 size_t maxCodeSize) {
+	m_dfa = dfa;
+	m_code = NULL;
+	m_mmap_size = 0;
+	m_run = NULL;
+	memset(&m_stats, 0, sizeof(m_stats));
+	compile(maxCodeSize);
+}
+
+VirtualMachineDFA_JIT::~VirtualMachineDFA_JIT() {
+#if TERARK_VMDFA_JIT
+	if (m_code)
+		munmap(m_code, m_mmap_size);
+#endif
+}
+
+size_t VirtualMachineDFA_JIT::interp_walk(const VirtualMachineDFA* dfa,
+							size_t state, fstring text, size_t* ppos) {
+	const byte_t* s = text.udata();
+	const size_t  n = text.size();
+	size_t pos = 0;
+	for (;;) {
+		if (dfa->is_pzip(state)) {
+			fstring zstr = dfa->get_zpath_data(state, NULL);
+			if (n - pos < zstr.size() || memcmp(s + pos, zstr.p, zstr.n) != 0)
+				break;
+			pos += zstr.size();
+		}
+		if (pos == n)
+			break;
+		size_t next = dfa->state_move(state, s[pos]);
+		if (VirtualMachineDFA::nil_state == next)
+			break;
+		state = next;
+		pos++;
+	}
+	*ppos = pos;
+	return state;
+}
+
+size_t VirtualMachineDFA_JIT::walk(size_t state, fstring text, size_t* ppos) const {
+	if (NULL == m_code)
+		return interp_walk(m_dfa, state, text, ppos);
+	assert(state < m_entry.size());
+	assert(UINT32_MAX != m_entry[state]);
+	const byte_t* beg = text.udata();
+	const byte_t* end = beg + text.size();
+	const byte_t* pos = beg;
+	for (;;) {
+		if (m_dfa->is_pzip(state)) {
+			fstring zstr = m_dfa->get_zpath_data(state, NULL);
+			if (size_t(end - pos) < zstr.size() || memcmp(pos, zstr.p, zstr.n) != 0)
+				break;
+			pos += zstr.size();
+		}
+		uint32_t out;
+		pos = m_run(pos, end, m_code + m_entry[state], &out);
+		state = out & ~PzipFlag;
+		if (!(out & PzipFlag))
+			break;
+	}
+	*ppos = pos - beg;
+	return state;
+}
+
+#if TERARK_VMDFA_JIT
+namespace {
+
+/// x86-64 machine code emitter, registers in generated code:
+///   rdi: current text pointer
+///   rsi: text end
+///   rcx: uint32_t* to output state
+///   eax: current byte, edx, r8, xmm0: scratch
+class Emitter {
+public:
+	valvec<byte_t> code;
+	valvec<byte_t> data;
+
+	struct StateRef { // rel32 in code, or int32 table entry in data
+		size_t   pos;
+		uint32_t target; // state id
+		bool     in_data;
+		size_t   base;   // table base in data, for in_data
+	};
+	struct DataRef { // rip relative disp32 to data
+		size_t pos;
+		size_t data_off;
+	};
+	valvec<StateRef> state_refs;
+	valvec<DataRef>  data_refs;
+	valvec<size_t>   exit_refs; // rel32 in code to exit of current state
+	valvec<size_t>   exit_entries; // table entries in data to exit
+	valvec<size_t>   exit_bases;
+
+	void b(byte_t x) { code.push_back(x); }
+	void b(std::initializer_list<byte_t> x) { code.append(x.begin(), x.size()); }
+	void u32(uint32_t x) { code.append((const byte_t*)&x, 4); }
+	void rel32_state(uint32_t target) {
+		state_refs.push_back({code.size(), target, false, 0});
+		u32(0);
+	}
+	void rel32_exit() {
+		exit_refs.push_back(code.size());
+		u32(0);
+	}
+	void rip_data(size_t data_off) {
+		data_refs.push_back({code.size(), data_off});
+		u32(0);
+	}
+	void jmp_target(uint32_t target) { // nil is exit
+		if (VirtualMachineDFA::nil_state == target)
+			b(0xE9), rel32_exit();
+		else
+			b(0xE9), rel32_state(target);
+	}
+	void jcc_target(byte_t cc, uint32_t target) {
+		b({0x0F, cc});
+		if (VirtualMachineDFA::nil_state == target)
+			rel32_exit();
+		else
+			rel32_state(target);
+	}
+	size_t data_align(size_t align) {
+		data.resize((data.size() + align - 1) & ~(align - 1), 0);
+		return data.size();
+	}
+	/// jump table of int32 relative to table base
+	size_t table(const uint32_t* targets, size_t n) {
+		size_t base = data_align(4);
+		data.resize(base + 4 * n, 0);
+		for (size_t i = 0; i < n; ++i) {
+			if (VirtualMachineDFA::nil_state == targets[i]) {
+				exit_entries.push_back(base + 4 * i);
+				exit_bases.push_back(base);
+			}
+			else
+				state_refs.push_back({base + 4 * i, targets[i], true, base});
+		}
+		return base;
+	}
+	/// jmp [table + rdx*4] relative
+	void jmp_table(size_t tab) {
+		b({0x4C, 0x8D, 0x05}), rip_data(tab); // lea r8, [rip+tab]
+		b({0x49, 0x63, 0x14, 0x90});          // movsxd rdx, [r8+rdx*4]
+		b({0x4C, 0x01, 0xC2});                // add rdx, r8
+		b({0xFF, 0xE2});                      // jmp rdx
+	}
+	/// exit of current state, patch pending references to it
+	void emit_exit(uint32_t state) {
+		const size_t exit_pos = code.size();
+		b({0xC7, 0x01}), u32(state); // mov dword [rcx], state
+		b({0x48, 0x89, 0xF8});       // mov rax, rdi
+		b(0xC3);                     // ret
+		for (size_t pos : exit_refs)
+			unaligned_save<int32_t>(code.data() + pos, int32_t(exit_pos - (pos + 4)));
+		exit_refs.erase_all();
+		// data base is unknown yet, save code offset, fix in finish()
+		for (size_t i = 0; i < exit_entries.size(); ++i)
+			exit_fix.push_back({exit_entries[i], exit_pos, exit_bases[i]});
+		exit_entries.erase_all();
+		exit_bases.erase_all();
+	}
+	struct ExitFix { size_t pos, code_pos, base; };
+	valvec<ExitFix> exit_fix;
+};
+
+} // namespace
+#endif
+
+void VirtualMachineDFA_JIT::compile(size_t maxCodeSize) {
+#if TERARK_VMDFA_JIT
+	typedef VirtualMachineDFA VM;
+	const VM* dfa = m_dfa;
+	const size_t nstates = dfa->total_states();
+	if (nstates >= PzipFlag)
+		return;
+	if (const char* env = getenv("VirtualMachineDFA_JIT")) {
+		if (0 == atoi(env))
+			return;
+	}
+	// reachable states
+	valvec<uint32_t> order;
+	{
+		febitvec color(nstates, false);
+		valvec<size_t> stack;
+		stack.push_back(initial_state);
+		color.set1(initial_state);
+		for (size_t i = 0; i < dfa->num_roots(); ++i) {
+			size_t r = dfa->get_root(i);
+			if (color.is0(r))
+				color.set1(r), stack.push_back(r);
+		}
+		while (!stack.empty()) {
+			size_t s = stack.pop_val();
+			order.push_back(uint32_t(s));
+			for (size_t ch = 0; ch < 256; ++ch) {
+				size_t t = dfa->state_move(s, auchar_t(ch));
+				if (VM::nil_state != t && color.is0(t))
+					color.set1(t), stack.push_back(t);
+			}
+		}
+		std::sort(order.begin(), order.end()); // code layout as state layout
+	}
+	Emitter e;
+	valvec<uint32_t> s_entry(nstates, UINT32_MAX); // 'inc rdi' + block
+	m_entry.resize_fill(nstates, UINT32_MAX);      // block
+	hash_strmap<size_t> idxmaps; // dedup index maps
+	e.b({0xFF, 0xE2}); // trampoline: jmp rdx
+	uint32_t trans[256];
+	uint32_t uniq[256];
+	byte_t   idx[256];
+	for (uint32_t s : order) {
+		if (e.code.size() + e.data.size() > maxCodeSize)
+			return;
+		for (size_t ch = 0; ch < 256; ++ch)
+			trans[ch] = uint32_t(dfa->state_move(s, auchar_t(ch)));
+		// S: entered by a move
+		s_entry[s] = uint32_t(e.code.size());
+		e.b({0x48, 0xFF, 0xC7}); // inc rdi
+		if (dfa->is_pzip(s)) {
+			e.emit_exit(s | PzipFlag);
+		}
+		// T: read one byte and dispatch
+		m_entry[s] = uint32_t(e.code.size());
+		e.b({0x48, 0x39, 0xF7});    // cmp rdi, rsi
+		e.b({0x0F, 0x83}), e.rel32_exit(); // jae exit
+		e.b({0x0F, 0xB6, 0x07});    // movzx eax, byte [rdi]
+		// default target is the most frequent target
+		size_t nuniq = 0;
+		uint32_t dflt = VM::nil_state;
+		{
+			uint16_t cnt[256];
+			for (size_t ch = 0; ch < 256; ++ch) {
+				size_t j = 0;
+				while (j < nuniq && uniq[j] != trans[ch]) ++j;
+				if (j == nuniq)
+					uniq[nuniq] = trans[ch], cnt[nuniq++] = 0;
+				cnt[j]++;
+				idx[ch] = byte_t(j);
+			}
+			size_t best = 0;
+			for (size_t j = 1; j < nuniq; ++j)
+				if (cnt[j] > cnt[best]) best = j;
+			dflt = uniq[best];
+		}
+		size_t nexcept = 0, nruns = 0;
+		for (size_t ch = 0; ch < 256; ++ch) {
+			if (trans[ch] != dflt) {
+				nexcept++;
+				if (0 == ch || trans[ch-1] != trans[ch])
+					nruns++;
+			}
+		}
+		if (0 == nexcept) {
+			// no dispatch
+		}
+		else if (nruns <= 4) {
+			m_stats.cmpStates++;
+			for (size_t ch = 0; ch < 256; ) {
+				if (trans[ch] == dflt) { ch++; continue; }
+				size_t lo = ch;
+				while (ch < 256 && trans[ch] == trans[lo]) ch++;
+				size_t hi = ch - 1;
+				if (lo == hi) {
+					e.b({0x3C, byte_t(lo)}); // cmp al, lo
+					e.jcc_target(0x84, trans[lo]); // je
+				} else {
+					e.b({0x8D, 0x90}), e.u32(uint32_t(-int32_t(lo))); // lea edx, [rax-lo]
+					e.b({0x81, 0xFA}), e.u32(uint32_t(hi - lo)); // cmp edx, hi-lo
+					e.jcc_target(0x86, trans[lo]); // jbe
+				}
+			}
+		}
+		else if (nexcept <= 16) {
+			m_stats.simdStates++;
+			byte_t labels[16];
+			uint32_t targets[16];
+			size_t n = 0;
+			for (size_t ch = 0; ch < 256; ++ch) {
+				if (trans[ch] != dflt) {
+					labels[n] = byte_t(ch);
+					targets[n] = trans[ch];
+					n++;
+				}
+			}
+			for (size_t j = n; j < 16; ++j)
+				labels[j] = labels[0], targets[j] = targets[0];
+			size_t vec = e.data_align(16);
+			e.data.append(labels, 16);
+			size_t tab = e.table(targets, 16);
+			e.b({0x69, 0xD0}), e.u32(0x01010101); // imul edx, eax, 0x01010101
+			e.b({0x66, 0x0F, 0x6E, 0xC2});        // movd xmm0, edx
+			e.b({0x66, 0x0F, 0x70, 0xC0, 0x00});  // pshufd xmm0, xmm0, 0
+			e.b({0x66, 0x0F, 0x74, 0x05}), e.rip_data(vec); // pcmpeqb xmm0, [vec]
+			e.b({0x66, 0x0F, 0xD7, 0xD0});        // pmovmskb edx, xmm0
+			e.b({0x85, 0xD2});                    // test edx, edx
+			e.jcc_target(0x84, dflt);             // jz default
+			e.b({0x0F, 0xBC, 0xD2});              // bsf edx, edx
+			e.jmp_table(tab);
+		}
+		else {
+			m_stats.tableStates++;
+			auto ib = idxmaps.insert_i(fstring((const char*)idx, 256), 0);
+			if (ib.second) {
+				idxmaps.val(ib.first) = e.data.size();
+				e.data.append(idx, 256);
+			}
+			size_t map = idxmaps.val(ib.first);
+			size_t tab = e.table(uniq, nuniq);
+			e.b({0x4C, 0x8D, 0x05}), e.rip_data(map); // lea r8, [rip+map]
+			e.b({0x41, 0x0F, 0xB6, 0x14, 0x00});      // movzx edx, byte [r8+rax]
+			e.jmp_table(tab);
+			dflt = VM::nil_state; // table covers all bytes
+		}
+		if (VM::nil_state != dflt)
+			e.jmp_target(dflt);
+		e.emit_exit(s);
+	}
+	m_stats.states = order.size();
+	m_stats.uniqIndexMaps = idxmaps.size();
+	const size_t data_base = (e.code.size() + 63) & ~size_t(63);
+	const size_t total = data_base + e.data.size();
+	if (total > maxCodeSize)
+		return;
+	for (const auto& r : e.state_refs) {
+		assert(UINT32_MAX != s_entry[r.target]);
+		if (r.in_data) {
+			int32_t rel = int32_t(s_entry[r.target] - (data_base + r.base));
+			unaligned_save<int32_t>(e.data.data() + r.pos, rel);
+		} else {
+			int32_t rel = int32_t(s_entry[r.target] - (r.pos + 4));
+			unaligned_save<int32_t>(e.code.data() + r.pos, rel);
+		}
+	}
+	for (const auto& r : e.exit_fix) {
+		int32_t rel = int32_t(r.code_pos - (data_base + r.base));
+		unaligned_save<int32_t>(e.data.data() + r.pos, rel);
+	}
+	for (const auto& r : e.data_refs) {
+		int32_t rel = int32_t(data_base + r.data_off - (r.pos + 4));
+		unaligned_save<int32_t>(e.code.data() + r.pos, rel);
+	}
+	const size_t page = 4096;
+	const size_t mmap_size = (total + page - 1) & ~(page - 1);
+	void* mem = mmap(NULL, mmap_size, PROT_READ|PROT_WRITE,
+					 MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+	if (MAP_FAILED == mem)
+		return;
+	byte_t* base = (byte_t*)mem;
+	memcpy(base, e.code.data(), e.code.size());
+	memset(base + e.code.size(), 0xCC, data_base - e.code.size()); // int3
+	memcpy(base + data_base, e.data.data(), e.data.size());
+	if (mprotect(mem, mmap_size, PROT_READ|PROT_EXEC) != 0) {
+		munmap(mem, mmap_size);
+		return;
+	}
+	m_code = base;
+	m_mmap_size = mmap_size;
+	m_run = (RunFunc)(void*)base;
+	m_stats.codeSize = e.code.size();
+	m_stats.dataSize = e.data.size();
+#else
+	TERARK_UNUSED_VAR(maxCodeSize);
+#endif
+}
+
+} // namespace terark
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <terark/bitmanip.hpp>
+#include "virtual_machine_dfa.hpp"
+#include <boost/noncopyable.hpp>
+
+namespace terark {
+
+/// x86-64 native code for the reachable states of a VirtualMachineDFA.
+///
+/// Each state is compiled to a code block which reads one byte and jumps
+/// to the block of the target state: sparse states use direct compare and
+/// branch, small label sets use SSE2 compare with a jump table, dense states
+/// use a byte index map with a jump table. Path zip states are handled by
+/// the driver, so the native code does not need the zpath data.
+///
+/// If the platform is not x86-64 or executable memory is not available,
+/// is_jitted() returns false and walk() falls back to the interpreter.
+class TERARK_DLL_EXPORT VirtualMachineDFA_JIT : boost::noncopyable {
+public:
+	struct Stats {
+		size_t states;      // compiled states
+		size_t codeSize;    // bytes of native code
+		size_t dataSize;    // bytes of jump tables and label vectors
+		size_t cmpStates;   // states dispatched by compare and branch
+		size_t simdStates;  // states dispatched by SSE2 compare
+		size_t tableStates; // states dispatched by index map
+		size_t uniqIndexMaps;
+	};
+
+	/// dfa must outlive this object, maxCodeSize limits the executable
+	/// memory, if it is exceeded, the interpreter is used
+	explicit VirtualMachineDFA_JIT(const VirtualMachineDFA* dfa,
+								   size_t maxCodeSize = size_t(1) << 30);
+	~VirtualMachineDFA_JIT();
+
+	bool is_jitted() const { return NULL != m_code; }
+	const Stats& stats() const { return m_stats; }
+	const VirtualMachineDFA* dfa() const { return m_dfa; }
+
+	/// walk from state by text, stop at end of text or on a dead move
+	/// @returns the last state, *pos is the number of consumed bytes,
+	///          if zpath of the last state is not matched, it is not consumed
+	size_t walk(size_t state, fstring text, size_t* pos) const;
+
+	/// same as walk, always use the interpreter
+	static size_t
+	interp_walk(const VirtualMachineDFA*, size_t state, fstring text, size_t* pos);
+
+private:
+	typedef const byte_t* (*RunFunc)(const byte_t* beg, const byte_t* end,
+									 const byte_t* entry, uint32_t* state);
+	void compile(size_t maxCodeSize);
+
+	const VirtualMachineDFA* m_dfa;
+	byte_t*  m_code;     // mmap'ed executable code and data
+	size_t   m_mmap_size;
+	RunFunc  m_run;
+	valvec<uint32_t> m_entry; // code offset of each state
+	Stats    m_stats;
+};
+
+} // namespace terark
@@ -0,0 +1,545 @@
+/* vim: set tabstop=4 : */
+#include "MultiReactorServer.hpp"
+#include "MessageInputStream.hpp"
+#include "SocketStream.hpp"
+#include <terark/valvec.hpp>
+#include <terark/util/throw.hpp>
+#include <atomic>
+#include <thread>
+
+#if defined(_MSC_VER) || defined(__ANDROID__)
+	#define TERARK_REACTOR_WITH_FIBER 0
+#elif !defined(TERARK_REACTOR_WITH_FIBER)
+	#define TERARK_REACTOR_WITH_FIBER 1
+#endif
+
+#if TERARK_REACTOR_WITH_FIBER
+	#include <terark/thread/fiber_pool.hpp>
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+
+namespace terark {
+
+using rpc::MessageHeader;
+
+static const uint32_t WHOLE_PARTID = uint32_t(MSG_HEADER_WHOLE) << MSG_HEADER_SHIFT;
+static const int MaxSpinRounds = 64; // epoll polls without progress
+
+/// read buffer, shared by a connection and its requests in flight
+struct ReadBlock {
+	int    refcnt;
+	size_t cap;
+	size_t tail; // end of received data
+	byte_t data[1];
+	static ReadBlock* create(size_t cap) {
+		auto b = (ReadBlock*)malloc(offsetof(ReadBlock, data) + cap);
+		TERARK_VERIFY(NULL != b);
+		b->refcnt = 1;
+		b->cap = cap;
+		b->tail = 0;
+		return b;
+	}
+	void unref() { if (0 == --refcnt) free(this); }
+};
+
+struct Connection {
+	int fd;
+	int refcnt = 1;     // the reactor + requests in flight
+	bool closed = false;
+	bool dirty = false; // in Reactor::m_dirty
+	bool pollout = false;
+	size_t idx;         // in Reactor::m_conns
+	ReadBlock* rblk;
+	size_t rhead = 0;   // parse pos in rblk
+	valvec<byte_t> wbuf;
+	size_t wpos = 0;
+	Connection(int fd1, size_t bufsize) : fd(fd1) {
+		rblk = ReadBlock::create(bufsize);
+	}
+	~Connection() { rblk->unref(); }
+	void unref() { if (0 == --refcnt) delete this; }
+};
+
+class MultiReactorServer::Reactor {
+public:
+	struct InRequest : Request {
+		Reactor*    reactor;
+		Connection* conn;
+		ReadBlock*  blk;
+	};
+	MultiReactorServer* m_owner;
+	int m_epfd = -1;
+	int m_listenfd = -1;
+	int m_stopfd = -1;
+	valvec<Connection*> m_conns;
+	valvec<Connection*> m_dirty;
+	valvec<Connection*> m_closing; // refs of reactor, released after flush
+	valvec<InRequest*> m_free_req;
+	std::thread m_thread;
+	std::atomic<size_t> m_accepted{0}, m_closed{0}, m_requests{0};
+	std::atomic<size_t> m_recv_bytes{0}, m_send_bytes{0};
+#if TERARK_REACTOR_WITH_FIBER
+	FiberPool* m_pool = NULL;
+#endif
+
+	explicit Reactor(MultiReactorServer* owner) : m_owner(owner) {}
+	~Reactor() {
+		if (m_listenfd >= 0) ::close(m_listenfd);
+		if (m_stopfd >= 0) ::close(m_stopfd);
+		if (m_epfd >= 0) ::close(m_epfd);
+		for (auto r : m_free_req) delete r;
+	}
+
+	/// returns bound port
+	int listen(const std::string& addr, int port) {
+		size_t colon = addr.rfind(':');
+		if (std::string::npos == colon) {
+			THROW_STD(invalid_argument, "bad addr: %s", addr.c_str());
+		}
+		std::string ip = addr.substr(0, colon);
+		m_listenfd = ::socket(AF_INET, SOCK_STREAM|SOCK_NONBLOCK|SOCK_CLOEXEC, IPPROTO_TCP);
+		if (m_listenfd < 0) {
+			throw SocketException("MultiReactorServer: socket()");
+		}
+		int one = 1;
+		::setsockopt(m_listenfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+		if (::setsockopt(m_listenfd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0) {
+			throw SocketException("MultiReactorServer: setsockopt(SO_REUSEPORT)");
+		}
+		struct sockaddr_in sa; memset(&sa, 0, sizeof(sa));
+		sa.sin_family = AF_INET;
+		sa.sin_port = htons(uint16_t(port));
+		if (ip.empty() || "0.0.0.0" == ip)
+			sa.sin_addr.s_addr = htonl(INADDR_ANY);
+		else if (::inet_pton(AF_INET, ip.c_str(), &sa.sin_addr) != 1) {
+			THROW_STD(invalid_argument, "bad ip: %s", addr.c_str());
+		}
+		if (::bind(m_listenfd, (struct sockaddr*)&sa, sizeof(sa)) < 0) {
+			std::string msg = "MultiReactorServer: bind(" + addr + ")";
+			throw SocketException(msg.c_str());
+		}
+		if (::listen(m_listenfd, m_owner->m_opt.backlog) < 0) {
+			throw SocketException("MultiReactorServer: listen()");
+		}
+		socklen_t len = sizeof(sa);
+		::getsockname(m_listenfd, (struct sockaddr*)&sa, &len);
+		m_epfd = ::epoll_create1(EPOLL_CLOEXEC);
+		m_stopfd = ::eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC);
+		if (m_epfd < 0 || m_stopfd < 0) {
+			throw SocketException("MultiReactorServer: epoll_create1/eventfd");
+		}
+		struct epoll_event ev;
+		ev.events = EPOLLIN;
+		ev.data.ptr = NULL; // listen socket
+		::epoll_ctl(m_epfd, EPOLL_CTL_ADD, m_listenfd, &ev);
+		ev.data.ptr = this; // stop event
+		::epoll_ctl(m_epfd, EPOLL_CTL_ADD, m_stopfd, &ev);
+		return ntohs(sa.sin_port);
+	}
+
+	void stop() {
+		uint64_t one = 1;
+		ssize_t n = ::write(m_stopfd, &one, sizeof(one));
+		TERARK_UNUSED_VAR(n);
+	}
+
+	void on_accept() {
+		for (;;) {
+			int fd = ::accept4(m_listenfd, NULL, NULL, SOCK_NONBLOCK|SOCK_CLOEXEC);
+			if (fd < 0) {
+				if (EINTR == errno) continue;
+				if (EAGAIN != errno && EWOULDBLOCK != errno)
+					fprintf(stderr, "WARN: MultiReactorServer: accept4() = %s\n", strerror(errno));
+				return;
+			}
+			int one = 1;
+			::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+			auto conn = new Connection(fd, m_owner->m_opt.readBufSize);
+			struct epoll_event ev;
+			ev.events = EPOLLIN | EPOLLRDHUP;
+			ev.data.ptr = conn;
+			if (::epoll_ctl(m_epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+				::close(fd);
+				delete conn;
+				continue;
+			}
+			conn->idx = m_conns.size();
+			m_conns.push_back(conn);
+			m_accepted.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	void close_conn(Connection* conn) {
+		if (conn->closed)
+			return;
+		::epoll_ctl(m_epfd, EPOLL_CTL_DEL, conn->fd, NULL);
+		::close(conn->fd);
+		conn->closed = true;
+		conn->wbuf.clear();
+		m_closed.fetch_add(1, std::memory_order_relaxed);
+		Connection* last = m_conns.back();
+		last->idx = conn->idx;
+		m_conns[conn->idx] = last;
+		m_conns.pop_back();
+		m_closing.push_back(conn); // conn may still be used by the caller
+	}
+
+	void release_closing() {
+		for (Connection* conn : m_closing)
+			conn->unref();
+		m_closing.risk_set_size(0);
+	}
+
+	/// make room for at least `need` bytes from rhead, move the unparsed data
+	/// to a new block if current block is referenced by requests in flight
+	void ensure_room(Connection* conn, size_t need) {
+		ReadBlock* b = conn->rblk;
+		size_t rest = b->tail - conn->rhead;
+		if (1 == b->refcnt && need <= b->cap) {
+			memmove(b->data, b->data + conn->rhead, rest);
+		} else {
+			size_t cap = std::max(need, m_owner->m_opt.readBufSize);
+			ReadBlock* nb = ReadBlock::create(cap);
+			memcpy(nb->data, b->data + conn->rhead, rest);
+			b->unref();
+			conn->rblk = b = nb;
+		}
+		b->tail = rest;
+		conn->rhead = 0;
+	}
+
+	void on_readable(Connection* conn) {
+		const size_t maxMsgLen = m_owner->m_opt.maxMsgLen;
+		for (;;) {
+			ReadBlock* b = conn->rblk;
+			if (conn->rhead == b->tail && 1 == b->refcnt) {
+				b->tail = conn->rhead = 0; // cheap reset
+			}
+			size_t need = sizeof(MessageHeader);
+			if (b->tail - conn->rhead >= sizeof(MessageHeader)) {
+				MessageHeader h;
+				memcpy(&h, b->data + conn->rhead, sizeof(h));
+				h.convert();
+				need += h.length;
+			}
+			if (b->cap - conn->rhead < need || b->tail == b->cap) {
+				ensure_room(conn, need);
+				b = conn->rblk;
+			}
+			size_t room = b->cap - b->tail;
+			ssize_t n = ::recv(conn->fd, b->data + b->tail, room, 0);
+			if (n <= 0) {
+				if (n < 0 && EINTR == errno) continue;
+				if (n < 0 && (EAGAIN == errno || EWOULDBLOCK == errno)) return;
+				close_conn(conn); // peer closed or error
+				return;
+			}
+			m_recv_bytes.fetch_add(n, std::memory_order_relaxed);
+			b->tail += n;
+			if (!parse_requests(conn, maxMsgLen)) {
+				close_conn(conn);
+				return;
+			}
+			if (size_t(n) < room)
+				return; // socket buffer is drained
+		}
+	}
+
+	bool parse_requests(Connection* conn, size_t maxMsgLen) {
+		ReadBlock* b = conn->rblk;
+		while (b->tail - conn->rhead >= sizeof(MessageHeader)) {
+			MessageHeader h;
+			memcpy(&h, b->data + conn->rhead, sizeof(h));
+			h.convert();
+			if (WHOLE_PARTID != (h.partid & MSG_HEADER_MASK)) {
+				fprintf(stderr, "ERROR: MultiReactorServer: multi part message is not supported\n");
+				return false;
+			}
+			if (h.length > maxMsgLen) {
+				fprintf(stderr, "ERROR: MultiReactorServer: msg len = %u > maxMsgLen = %zd\n",
+						h.length, maxMsgLen);
+				return false;
+			}
+			size_t msgEnd = conn->rhead + sizeof(h) + h.length;
+			if (msgEnd > b->tail)
+				break;
+			InRequest* r = alloc_req();
+			r->m_data = fstring(b->data + conn->rhead + sizeof(h), h.length);
+			r->m_seqid = h.seqid;
+			r->m_replied = false;
+			r->reactor = this;
+			r->conn = conn;
+			r->blk = b;
+			conn->refcnt++;
+			b->refcnt++;
+			conn->rhead = msgEnd;
+			m_requests.fetch_add(1, std::memory_order_relaxed);
+			dispatch(r);
+			if (conn->closed)
+				return true; // handler must not close, be defensive
+		}
+		return true;
+	}
+
+	InRequest* alloc_req() {
+		if (m_free_req.empty())
+			return new InRequest;
+		return m_free_req.pop_val();
+	}
+
+	static void run_request(void* arg1, size_t, size_t) {
+		auto r = (InRequest*)arg1;
+		Reactor* self = r->reactor;
+		try {
+			self->m_owner->m_handler(r);
+		}
+		catch (const std::exception& ex) {
+			fprintf(stderr, "ERROR: MultiReactorServer: handler: %s\n", ex.what());
+		}
+		if (!r->m_replied)
+			r->reply(fstring());
+		r->blk->unref();
+		r->conn->unref();
+		self->m_free_req.push_back(r);
+	}
+
+	void dispatch(InRequest* r) {
+#if TERARK_REACTOR_WITH_FIBER
+		if (m_pool) {
+			// if the channel is full, push suspends the reactor fiber and
+			// fibers run pending requests
+			m_pool->push({&run_request, r, 0, 0});
+			return;
+		}
+#endif
+		run_request(r, 0, 0);
+	}
+
+	void reply(InRequest* r, fstring data) {
+		TERARK_VERIFY(!r->m_replied);
+		r->m_replied = true;
+		Connection* conn = r->conn;
+		if (conn->closed)
+			return;
+		MessageHeader h;
+		h.length = uint32_t(data.size());
+		h.seqid = r->m_seqid;
+		h.partid = WHOLE_PARTID;
+		h.convert();
+		conn->wbuf.append((const byte_t*)&h, sizeof(h));
+		conn->wbuf.append(data.udata(), data.size());
+		if (!conn->dirty) {
+			conn->dirty = true;
+			conn->refcnt++;
+			m_dirty.push_back(conn);
+		}
+	}
+
+	/// @returns false on error
+	bool send_buffered(Connection* conn) {
+		while (conn->wpos < conn->wbuf.size()) {
+			size_t len = conn->wbuf.size() - conn->wpos;
+			ssize_t n = ::send(conn->fd, conn->wbuf.data() + conn->wpos, len, MSG_NOSIGNAL);
+			if (n < 0) {
+				if (EINTR == errno) continue;
+				if (EAGAIN == errno || EWOULDBLOCK == errno) break;
+				return false;
+			}
+			m_send_bytes.fetch_add(n, std::memory_order_relaxed);
+			conn->wpos += n;
+		}
+		bool pending = conn->wpos < conn->wbuf.size();
+		if (!pending) {
+			conn->wbuf.risk_set_size(0);
+			conn->wpos = 0;
+		}
+		if (pending != conn->pollout) {
+			struct epoll_event ev;
+			ev.events = EPOLLIN | EPOLLRDHUP | (pending ? uint32_t(EPOLLOUT) : 0u);
+			ev.data.ptr = conn;
+			::epoll_ctl(m_epfd, EPOLL_CTL_MOD, conn->fd, &ev);
+			conn->pollout = pending;
+		}
+		return true;
+	}
+
+	void flush_dirty() {
+		for (size_t i = 0; i < m_dirty.size(); ++i) {
+			Connection* conn = m_dirty[i];
+			conn->dirty = false;
+			if (!conn->closed && !conn->pollout && !send_buffered(conn))
+				close_conn(conn);
+			conn->unref();
+		}
+		m_dirty.risk_set_size(0);
+	}
+
+	void run() {
+#if TERARK_REACTOR_WITH_FIBER
+		std::unique_ptr<FiberPool> pool;
+		if (m_owner->m_opt.fibers > 0) {
+			pool.reset(new FiberPool(boost::fibers::context::active_pp()));
+			pool->update_fiber_count(m_owner->m_opt.fibers);
+			m_pool = pool.get();
+		}
+#endif
+		const int maxEvents = 256;
+		struct epoll_event events[maxEvents];
+		bool running = true;
+		int idleRounds = 0;
+		while (running) {
+			int timeout = -1;
+#if TERARK_REACTOR_WITH_FIBER
+			if (m_pool && m_pool->pending_cnt() > 0) {
+				// handlers are waiting on fiber aio, which is reaped when
+				// fibers are yielded to: poll epoll for a few idle rounds,
+				// then sleep in epoll_wait shortly instead of busy spinning
+				int pending = m_pool->pending_cnt();
+				m_pool->unchecked_yield();
+				flush_dirty();
+				if (m_pool->pending_cnt() < pending)
+					idleRounds = 0;
+				else if (idleRounds < MaxSpinRounds)
+					idleRounds++;
+				if (m_pool->pending_cnt() > 0)
+					timeout = idleRounds < MaxSpinRounds ? 0 : 1;
+			}
+#endif
+			int n = ::epoll_wait(m_epfd, events, maxEvents, timeout);
+			if (n < 0) {
+				if (EINTR == errno) continue;
+				fprintf(stderr, "ERROR: MultiReactorServer: epoll_wait() = %s\n", strerror(errno));
+				break;
+			}
+			if (n > 0)
+				idleRounds = 0;
+			for (int i = 0; i < n; ++i) {
+				void* ptr = events[i].data.ptr;
+				uint32_t evts = events[i].events;
+				if (NULL == ptr) {
+					on_accept();
+				}
+				else if (this == ptr) {
+					running = false;
+				}
+				else {
+					auto conn = (Connection*)ptr;
+					if (evts & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+						on_readable(conn);
+					if (!conn->closed && (evts & EPOLLOUT) && !send_buffered(conn))
+						close_conn(conn);
+				}
+			}
+#if TERARK_REACTOR_WITH_FIBER
+			if (m_pool && m_pool->pending_cnt() > 0)
+				m_pool->unchecked_yield(); // run requests
+#endif
+			flush_dirty();
+			release_closing();
+		}
+#if TERARK_REACTOR_WITH_FIBER
+		if (m_pool) {
+			m_pool->wait();
+			flush_dirty();
+			m_pool->close();
+			m_pool = NULL;
+		}
+#endif
+		close_all();
+	}
+
+	void close_all() {
+		while (!m_conns.empty())
+			close_conn(m_conns.back());
+		release_closing();
+	}
+};
+
+void MultiReactorServer::Request::reply(fstring data) {
+	auto r = static_cast<Reactor::InRequest*>(this);
+	r->reactor->reply(r, data);
+}
+
+MultiReactorServer::MultiReactorServer(fstring bindAddr, const Options& opt, Handler h)
+	: m_addr(bindAddr.str()), m_opt(opt), m_handler(std::move(h)), m_port(0) {
+	if (m_opt.reactors <= 0)
+		m_opt.reactors = std::max(1, int(std::thread::hardware_concurrency()));
+	m_opt.readBufSize = std::max<size_t>(m_opt.readBufSize, 4096);
+}
+
+MultiReactorServer::~MultiReactorServer() {
+	if (m_reactors) {
+		stop();
+		join();
+	}
+}
+
+void MultiReactorServer::start() {
+	TERARK_VERIFY(!m_reactors);
+	const int num = m_opt.reactors;
+	std::unique_ptr<Reactor*[]> reactors(new Reactor*[num]());
+	try {
+		int port = atoi(m_addr.c_str() + m_addr.rfind(':') + 1);
+		for (int i = 0; i < num; ++i) {
+			reactors[i] = new Reactor(this);
+			port = reactors[i]->listen(m_addr, port); // port 0: all use 1st
+		}
+		m_port = port;
+	}
+	catch (...) {
+		for (int i = 0; i < num; ++i) delete reactors[i];
+		throw;
+	}
+	for (int i = 0; i < num; ++i) {
+		Reactor* r = reactors[i];
+		r->m_thread = std::thread(&Reactor::run, r);
+	}
+	m_reactors = std::move(reactors);
+}
+
+void MultiReactorServer::stop() {
+	if (m_reactors) {
+		for (int i = 0; i < m_opt.reactors; ++i)
+			m_reactors[i]->stop();
+	}
+}
+
+void MultiReactorServer::join() {
+	if (m_reactors) {
+		for (int i = 0; i < m_opt.reactors; ++i) {
+			m_reactors[i]->m_thread.join();
+			delete m_reactors[i];
+		}
+		m_reactors.reset();
+	}
+}
+
+int MultiReactorServer::reactors() const {
+	return m_opt.reactors;
+}
+
+MultiReactorServer::Stats MultiReactorServer::stats() const {
+	Stats st = {0, 0, 0, 0, 0};
+	if (m_reactors) {
+		for (int i = 0; i < m_opt.reactors; ++i) {
+			const Reactor* r = m_reactors[i];
+			st.accepted  += r->m_accepted.load(std::memory_order_relaxed);
+			st.closed    += r->m_closed.load(std::memory_order_relaxed);
+			st.requests  += r->m_requests.load(std::memory_order_relaxed);
+			st.recvBytes += r->m_recv_bytes.load(std::memory_order_relaxed);
+			st.sendBytes += r->m_send_bytes.load(std::memory_order_relaxed);
+		}
+	}
+	return st;
+}
+
+} // namespace terark
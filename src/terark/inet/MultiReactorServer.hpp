@@ -0,0 +1,86 @@
+/* vim: set tabstop=4 : */
+#pragma once
+
+#include <terark/fstring.hpp>
+#include <boost/noncopyable.hpp>
+#include <functional>
+#include <memory>
+
+namespace terark {
+
+/// Multi reactor TCP server, each of Options::reactors threads has its own
+/// epoll and its own SO_REUSEPORT listen socket bound on the same address,
+/// thus the kernel shards incoming connections to reactors, a connection is
+/// served by one reactor for its whole life and no locks are needed.
+///
+/// Messages are framed by rpc::MessageHeader(MessageInputStream.hpp), only
+/// MSG_HEADER_WHOLE is supported. A request is handed to the handler as a
+/// pointer into the read buffer of the connection(zero copy), the buffer is
+/// kept alive until the handler returns, more data of the connection is read
+/// into a new buffer if the old one is still in use.
+///
+/// With Options::fibers > 0, each request is run by a fiber of the reactor's
+/// FiberPool, thus a handler can wait on fiber aio without blocking other
+/// requests, else the handler is called inline in the reactor loop.
+/// Replies are appended to the connection's write buffer and are sent once
+/// after each round of epoll events, pipelined requests are replied by one
+/// send.
+///
+/// It is Linux only(epoll, eventfd), it is not built on other systems.
+class TERARK_DLL_EXPORT MultiReactorServer : boost::noncopyable {
+public:
+	struct Options {
+		int    reactors = 0;   // 0: std::thread::hardware_concurrency()
+		int    fibers = 16;    // fibers per reactor, 0: call handler inline
+		int    backlog = 1024;
+		size_t readBufSize = size_t(64) << 10; // initial read buffer size
+		size_t maxMsgLen = size_t(64) << 20;   // close connection on larger
+	};
+	class Request {
+	public:
+		fstring  data() const { return m_data; }
+		uint32_t seqid() const { return m_seqid; }
+		/// must be called in the handler, at most once, if the handler
+		/// returns without reply, an empty reply is sent
+		void reply(fstring data);
+		void reply(const void* data, size_t len) { reply(fstring((const char*)data, len)); }
+		bool replied() const { return m_replied; }
+	protected:
+		friend class MultiReactorServer;
+		fstring  m_data;
+		uint32_t m_seqid;
+		bool     m_replied;
+	};
+	typedef std::function<void(Request*)> Handler;
+	struct Stats {
+		size_t accepted;
+		size_t closed;
+		size_t requests;
+		size_t recvBytes;
+		size_t sendBytes;
+	};
+
+	/// bindAddr is "ip:port", port 0 selects a free port, see port()
+	MultiReactorServer(fstring bindAddr, const Options&, Handler);
+	~MultiReactorServer(); // stop() and join()
+
+	/// start reactor threads, throw SocketException if bind/listen fails
+	void start();
+	/// notify all reactors to exit, does not wait
+	void stop();
+	void join();
+
+	int port() const { return m_port; }
+	int reactors() const;
+	Stats stats() const; // sum of all reactors
+
+	class Reactor;
+private:
+	std::string  m_addr;
+	Options      m_opt;
+	Handler      m_handler;
+	int          m_port;
+	std::unique_ptr<Reactor*[]> m_reactors;
+};
+
+} // namespace terark
@@ -10,7 +10,7 @@ namespace terark {
 
 class ReactAcceptor : public IAcceptor
 {
-	std::auto_ptr<class ReactAcceptor_imp> m_impl;
+	std::unique_ptr<class ReactAcceptor_imp> m_impl;
 public:
 	ReactAcceptor(int port);
 	IDuplexStream* accept(); ///< override
@@ -13,6 +13,7 @@ typedef int socklen_t;
 #	include <sys/types.h>
 #	include <sys/socket.h>
 #	include <netinet/in.h>
+#	include <netinet/tcp.h>
 #	include <arpa/inet.h>
 #	include <unistd.h>
 #	define closesocket close
@@ -152,6 +153,12 @@ SocketAcceptor::SocketAcceptor(const char* szBindAddr)
 	}
 }
 
+bool SocketStream::set_nodelay(bool nodelay)
+{
+	int val = nodelay ? 1 : 0;
+	return ::setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, (const char*)&val, sizeof(val)) == 0;
+}
+
 SocketStream* SocketAcceptor::accept()
 {
 	struct sockaddr_in from;
@@ -164,6 +171,7 @@ SocketStream* SocketAcceptor::accept()
 		return 0;
 	}
 	SocketStream* stream = new SocketStream(client);
+	stream->set_nodelay(true);
 	return stream;
 }
 
@@ -191,6 +199,7 @@ SocketStream* ConnectSocket(const char* szServerAddr)
 		throw SocketException(errText.c_str());
 	}
 	SocketStream* stream = new SocketStream(hSocket);
+	stream->set_nodelay(true);
 	return stream;
 }
 
@@ -42,6 +42,10 @@ public:
 	size_t tellp() { return posp; }
 	size_t tellg() { return posg; }
 
+	//! TCP_NODELAY, set by SocketAcceptor::accept and ConnectSocket:
+	//! writes are buffered and flushed by message, Nagle only adds delay
+	bool set_nodelay(bool nodelay);
+
 protected:
 	virtual bool waitfor_again();
 
@@ -0,0 +1,506 @@
+/* vim: set tabstop=4 : */
+#include "AsyncFileStream.hpp"
+#include "IOException.hpp"
+#include <terark/num_to_str.hpp>
+#include <terark/util/throw.hpp>
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32) || defined(WIN32) || defined(_WIN64) || defined(WIN64)
+	#include <io.h>
+#else
+	#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+  #include <linux/version.h>
+  #if defined(TOPLING_IO_WITH_URING)
+    #if TOPLING_IO_WITH_URING // mandatory io uring
+      #include <liburing.h>
+      #define TOPLING_IO_HAS_URING
+    #endif
+  #elif LINUX_VERSION_CODE >= KERNEL_VERSION(5,1,0)
+    #include <liburing.h>
+    #define TOPLING_IO_HAS_URING
+  #endif
+#endif
+
+namespace terark {
+
+#if defined(_WIN32) || defined(WIN32) || defined(_WIN64) || defined(WIN64)
+// buffers are written sequentially by one thread, seek + write is ok
+static intptr_t pwrite(int fd, const void* buf, size_t len, uint64_t offset) {
+	if (_lseeki64(fd, offset, SEEK_SET) < 0)
+		return -1;
+	return _write(fd, buf, (unsigned)std::min<size_t>(len, INT_MAX));
+}
+#endif
+
+static int sync_data(int fd) {
+#if defined(_WIN32) || defined(WIN32) || defined(_WIN64) || defined(WIN64)
+	return _commit(fd);
+#elif defined(__linux__)
+	return ::fdatasync(fd);
+#else
+	return ::fsync(fd);
+#endif
+}
+
+class AsyncFileOutputStream::Impl {
+public:
+	struct Buf {
+		byte_t*  data;
+		size_t   len;    // bytes to write
+		size_t   done;   // bytes written
+		uint64_t offset; // file offset of data
+		bool     busy;   // submitted and not finished
+	};
+	Options  m_opt;
+	int      m_fd = -1;
+	int      m_err = 0;    // first error of background writes
+	byte_t*  m_mem = NULL;
+	Buf*     m_bufs = NULL;
+	size_t   m_cur = 0;    // the buffer being filled
+	uint64_t m_offset = 0; // file offset of m_bufs[m_cur]
+	uint64_t m_synced = 0; // sync_file_range was issued up to m_synced
+
+	// writer thread, buffers are written in the order of submission
+	std::thread m_thr;
+	std::mutex  m_mtx;
+	std::condition_variable m_cond;
+	size_t m_submitted = 0;
+	size_t m_finished = 0;
+	bool   m_stop = false;
+
+#if defined(TOPLING_IO_HAS_URING)
+	bool     m_uring = false;
+	size_t   m_inflight = 0; // submitted sqe which are not reaped
+	io_uring m_ring;
+#endif
+
+	Impl(int fd, const Options& opt) : m_opt(opt) {
+		maximize(m_opt.bufNum, size_t(2));
+		maximize(m_opt.bufSize, size_t(4096));
+		m_fd = fd;
+	#if defined(_WIN32) || defined(WIN32) || defined(_WIN64) || defined(WIN64)
+		int64_t pos = _lseeki64(fd, 0, SEEK_CUR);
+	#else
+		off_t pos = ::lseek(fd, 0, SEEK_CUR);
+	#endif
+		m_offset = m_synced = pos > 0 ? pos : 0;
+		m_mem = (byte_t*)malloc(m_opt.bufSize * m_opt.bufNum);
+		m_bufs = (Buf*)calloc(m_opt.bufNum, sizeof(Buf));
+		if (NULL == m_mem || NULL == m_bufs) {
+			free(m_mem);
+			free(m_bufs);
+			throw std::bad_alloc();
+		}
+		for (size_t i = 0; i < m_opt.bufNum; i++)
+			m_bufs[i].data = m_mem + m_opt.bufSize * i;
+	#if defined(TOPLING_IO_HAS_URING)
+		if (m_opt.useUring) {
+			unsigned depth = unsigned(2 * m_opt.bufNum + 2);
+			m_uring = io_uring_queue_init(depth, &m_ring, 0) == 0;
+		}
+		if (m_uring)
+			return;
+	#endif
+		m_thr = std::thread(&Impl::writer_loop, this);
+	}
+
+	~Impl() {
+	#if defined(TOPLING_IO_HAS_URING)
+		if (m_uring) {
+			try {
+				while (m_inflight)
+					uring_reap(true);
+			}
+			catch (const std::exception&) {
+				// buffers must not be freed while they are being written
+				while (m_inflight) {
+					io_uring_cqe* cqe = nullptr;
+					if (io_uring_wait_cqe(&m_ring, &cqe) == 0)
+						io_uring_cqe_seen(&m_ring, cqe), m_inflight--;
+				}
+			}
+			io_uring_queue_exit(&m_ring);
+		}
+	#endif
+		if (m_thr.joinable()) {
+			{
+				std::lock_guard<std::mutex> lock(m_mtx);
+				m_stop = true;
+			}
+			m_cond.notify_all();
+			m_thr.join();
+		}
+		free(m_mem);
+		free(m_bufs);
+	}
+
+	bool is_uring() const {
+	#if defined(TOPLING_IO_HAS_URING)
+		return m_uring;
+	#else
+		return false;
+	#endif
+	}
+
+	/// write b->data[b->done, b->len) synchronously
+	int write_buf(Buf* b) {
+		while (b->done < b->len) {
+			intptr_t n = pwrite(m_fd, b->data + b->done, b->len - b->done,
+								b->offset + b->done);
+			if (n > 0)
+				b->done += n;
+			else if (n < 0 && EINTR == errno)
+				continue;
+			else
+				return n < 0 ? errno : EIO;
+		}
+		return 0;
+	}
+
+	int sync_range(uint64_t upto) {
+		int err = 0;
+	#if defined(__linux__)
+		int ret = sync_file_range(m_fd, m_synced, upto - m_synced,
+								  SYNC_FILE_RANGE_WRITE);
+		if (ret < 0)
+			err = errno;
+	#endif
+		m_synced = upto;
+		return err;
+	}
+
+	void writer_loop() {
+		std::unique_lock<std::mutex> lock(m_mtx);
+		for (;;) {
+			m_cond.wait(lock, [&]{ return m_finished < m_submitted || m_stop; });
+			if (m_finished == m_submitted)
+				break; // m_stop
+			Buf* b = &m_bufs[m_finished % m_opt.bufNum];
+			int err = m_err;
+			lock.unlock();
+			if (0 == err) { // skip writes after an error
+				err = write_buf(b);
+				uint64_t upto = b->offset + b->done;
+				if (0 == err && m_opt.syncBytes && upto - m_synced >= m_opt.syncBytes)
+					err = sync_range(upto);
+			}
+			lock.lock();
+			if (err && 0 == m_err)
+				m_err = err;
+			b->busy = false;
+			m_finished++;
+			m_cond.notify_all();
+		}
+	}
+
+#if defined(TOPLING_IO_HAS_URING)
+	io_uring_sqe* uring_get_sqe() {
+		io_uring_sqe* sqe;
+		while ((sqe = io_uring_get_sqe(&m_ring)) == nullptr)
+			uring_reap(true);
+		return sqe;
+	}
+	void uring_submit(Buf* b) {
+		int ret = io_uring_submit(&m_ring);
+		if (ret < 0) {
+			if (b)
+				b->busy = false;
+			throw IOException(-ret, "AsyncFileOutputStream: io_uring_submit");
+		}
+		m_inflight += ret;
+	}
+	void uring_write(Buf* b) {
+		io_uring_sqe* sqe = uring_get_sqe();
+		size_t len = std::min<size_t>(b->len - b->done, INT_MAX);
+		io_uring_prep_write(sqe, m_fd, b->data + b->done, unsigned(len),
+							b->offset + b->done);
+		io_uring_sqe_set_data(sqe, b);
+		uring_submit(b);
+	}
+	/// issue sync_file_range for data which is fully written
+	void uring_sync() {
+		uint64_t upto = m_offset;
+		for (size_t i = 0; i < m_opt.bufNum; i++) {
+			if (m_bufs[i].busy)
+				minimize(upto, m_bufs[i].offset + m_bufs[i].done);
+		}
+		if (upto - m_synced < m_opt.syncBytes)
+			return;
+		uint64_t len = upto - m_synced;
+		io_uring_sqe* sqe = uring_get_sqe();
+		io_uring_prep_sync_file_range(sqe, m_fd, unsigned(len > UINT_MAX ? 0 : len),
+									  m_synced, SYNC_FILE_RANGE_WRITE);
+		io_uring_sqe_set_data(sqe, nullptr);
+		uring_submit(nullptr);
+		m_synced = upto;
+	}
+	void uring_reap(bool block) {
+		bool sync = false;
+		while (m_inflight) {
+			io_uring_cqe* cqe = nullptr;
+			int ret = block ? io_uring_wait_cqe(&m_ring, &cqe)
+							: io_uring_peek_cqe(&m_ring, &cqe);
+			if (-EAGAIN == ret && !block)
+				break;
+			if (-EINTR == ret)
+				continue;
+			if (ret < 0)
+				throw IOException(-ret, "AsyncFileOutputStream: io_uring_wait_cqe");
+			Buf* b = (Buf*)io_uring_cqe_get_data(cqe);
+			int res = cqe->res;
+			io_uring_cqe_seen(&m_ring, cqe);
+			m_inflight--;
+			block = false; // got one, reap others without blocking
+			if (NULL == b) { // sync_file_range
+				if (res < 0 && 0 == m_err)
+					m_err = -res;
+				continue;
+			}
+			if (res > 0)
+				b->done += res;
+			else if (res < 0 && -EINTR != res && -EAGAIN != res)
+				m_err = m_err ? m_err : -res;
+			else if (0 == res)
+				m_err = m_err ? m_err : EIO;
+			if (b->done < b->len && 0 == m_err)
+				uring_write(b); // short write, write the remain
+			else
+				b->busy = false, sync = true;
+		}
+		if (sync && m_opt.syncBytes && 0 == m_err)
+			uring_sync();
+	}
+#endif
+
+	void check_err() {
+		int err;
+		if (m_thr.joinable()) {
+			std::lock_guard<std::mutex> lock(m_mtx);
+			err = m_err;
+		} else {
+			err = m_err;
+		}
+		if (terark_unlikely(err)) {
+			throw IOException(err, "AsyncFileOutputStream: background write");
+		}
+	}
+
+	/// submit m_bufs[m_cur] with len bytes and switch to next buffer
+	void submit(size_t len) {
+		Buf* b = &m_bufs[m_cur];
+		b->len = len;
+		b->done = 0;
+		b->offset = m_offset;
+		b->busy = true;
+		m_offset += len;
+		m_cur = (m_cur + 1) % m_opt.bufNum;
+	#if defined(TOPLING_IO_HAS_URING)
+		if (m_uring) {
+			uring_write(b);
+			uring_reap(false);
+			return;
+		}
+	#endif
+		{
+			std::lock_guard<std::mutex> lock(m_mtx);
+			m_submitted++;
+		}
+		m_cond.notify_all();
+	}
+
+	void wait_buf(Buf* b) {
+	#if defined(TOPLING_IO_HAS_URING)
+		if (m_uring) {
+			while (b->busy)
+				uring_reap(true);
+			return;
+		}
+	#endif
+		std::unique_lock<std::mutex> lock(m_mtx);
+		m_cond.wait(lock, [b]{ return !b->busy; });
+	}
+
+	void wait_all() {
+	#if defined(TOPLING_IO_HAS_URING)
+		if (m_uring) {
+			while (m_inflight)
+				uring_reap(true);
+			return;
+		}
+	#endif
+		std::unique_lock<std::mutex> lock(m_mtx);
+		m_cond.wait(lock, [this]{ return m_finished == m_submitted; });
+	}
+};
+
+AsyncFileOutputStream::AsyncFileOutputStream() noexcept {
+	m_pos = m_end = NULL;
+	m_impl = NULL;
+}
+
+AsyncFileOutputStream::AsyncFileOutputStream(fstring fpath) {
+	m_pos = m_end = NULL;
+	m_impl = NULL;
+	open(fpath, Options());
+}
+
+AsyncFileOutputStream::AsyncFileOutputStream(fstring fpath, const Options& opt) {
+	m_pos = m_end = NULL;
+	m_impl = NULL;
+	open(fpath, opt);
+}
+
+AsyncFileOutputStream::~AsyncFileOutputStream() {
+	try {
+		close();
+	}
+	catch (const std::exception& ex) {
+		fprintf(stderr, "ERROR: AsyncFileOutputStream::close() = %s\n", ex.what());
+	}
+}
+
+void AsyncFileOutputStream::open(fstring fpath) {
+	open(fpath, Options());
+}
+
+void AsyncFileOutputStream::open(fstring fpath, const Options& opt) {
+#if defined(_WIN32) || defined(WIN32) || defined(_WIN64) || defined(WIN64)
+	int fd = ::_open(fpath.c_str(), _O_WRONLY|_O_CREAT|_O_TRUNC|_O_BINARY, 0644);
+#else
+	int fd = ::open(fpath.c_str(), O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC, 0644);
+#endif
+	if (fd < 0) {
+		throw OpenFileException(fpath, "AsyncFileOutputStream::open");
+	}
+	dopen(fd, opt);
+}
+
+void AsyncFileOutputStream::dopen(int fd) {
+	dopen(fd, Options());
+}
+
+void AsyncFileOutputStream::dopen(int fd, const Options& opt) {
+	TERARK_VERIFY(NULL == m_impl);
+	TERARK_VERIFY_GE(fd, 0);
+	m_impl = new Impl(fd, opt);
+	m_pos = m_impl->m_bufs[0].data;
+	m_end = m_pos + m_impl->m_opt.bufSize;
+}
+
+void AsyncFileOutputStream::close() {
+	if (NULL == m_impl)
+		return;
+	std::unique_ptr<Impl> impl(m_impl);
+	int fd = impl->m_fd;
+	bool syncOnClose = impl->m_opt.syncOnClose;
+	try {
+		flush();
+		if (syncOnClose && sync_data(fd) < 0) {
+			int err = errno;
+			throw IOException(err, "AsyncFileOutputStream::close: fdatasync");
+		}
+	}
+	catch (...) {
+		m_impl = NULL;
+		m_pos = m_end = NULL;
+		impl.reset();
+		::close(fd);
+		throw;
+	}
+	m_impl = NULL;
+	m_pos = m_end = NULL;
+	impl.reset();
+	if (::close(fd) < 0) {
+		int err = errno;
+		throw IOException(err, "AsyncFileOutputStream::close");
+	}
+}
+
+void AsyncFileOutputStream::next_buf() {
+	if (NULL == m_impl) {
+		THROW_STD(invalid_argument, "stream is not opened");
+	}
+	Impl* impl = m_impl;
+	impl->check_err();
+	byte_t* beg = impl->m_bufs[impl->m_cur].data;
+	if (m_pos != beg)
+		impl->submit(m_pos - beg);
+	Impl::Buf* b = &impl->m_bufs[impl->m_cur];
+	impl->wait_buf(b);
+	m_pos = b->data;
+	m_end = b->data + impl->m_opt.bufSize;
+}
+
+size_t AsyncFileOutputStream::write(const void* vbuf, size_t length) {
+	auto src = (const byte_t*)vbuf;
+	size_t n = length;
+	while (n) {
+		if (terark_unlikely(m_pos == m_end))
+			next_buf();
+		size_t k = std::min(n, size_t(m_end - m_pos));
+		memcpy(m_pos, src, k);
+		m_pos += k;
+		src += k;
+		n -= k;
+	}
+	return length;
+}
+
+void AsyncFileOutputStream::flush_async() {
+	if (NULL == m_impl)
+		return;
+	Impl* impl = m_impl;
+	if (m_pos != impl->m_bufs[impl->m_cur].data)
+		next_buf();
+	else
+		impl->check_err();
+}
+
+void AsyncFileOutputStream::wait() {
+	if (NULL == m_impl)
+		return;
+	m_impl->wait_all();
+	m_impl->check_err();
+}
+
+void AsyncFileOutputStream::flush() {
+	flush_async();
+	wait();
+}
+
+void AsyncFileOutputStream::fdatasync() {
+	flush();
+	if (m_impl && sync_data(m_impl->m_fd) < 0) {
+		int err = errno;
+		throw IOException(err, "AsyncFileOutputStream::fdatasync");
+	}
+}
+
+uint64_t AsyncFileOutputStream::tell() const noexcept {
+	if (NULL == m_impl)
+		return 0;
+	return m_impl->m_offset + (m_pos - m_impl->m_bufs[m_impl->m_cur].data);
+}
+
+bool AsyncFileOutputStream::is_uring() const noexcept {
+	return m_impl && m_impl->is_uring();
+}
+
+int AsyncFileOutputStream::fd() const noexcept {
+	return m_impl ? m_impl->m_fd : -1;
+}
+
+} // namespace terark
@@ -0,0 +1,75 @@
+/* vim: set tabstop=4 : */
+#pragma once
+
+#include <terark/fstring.hpp>
+#include <boost/noncopyable.hpp>
+#include "IStream.hpp"
+
+namespace terark {
+
+/// Sequential file writer: data is copied into one of Options::bufNum buffers,
+/// a full buffer is written in background while the next one is being filled,
+/// so the caller is not blocked by write syscalls.
+///
+/// Buffers are written by io_uring if it is compiled in(liburing is detected
+/// by Makefile) and io_uring_queue_init succeeds, else by a writer thread.
+/// With Options::syncBytes, sync_file_range(WRITE) is issued for every
+/// syncBytes of written data, thus dirty pages do not pile up to a long stall
+/// at the final fdatasync.
+///
+/// Errors of background writes are thrown as IOException by the next call of
+/// write/flush_async/wait/flush/close.
+class TERARK_DLL_EXPORT AsyncFileOutputStream
+	: public IOutputStream, boost::noncopyable {
+public:
+	struct Options {
+		size_t bufSize = size_t(1) << 20; // size of each buffer
+		size_t bufNum = 3;         // 2 is double buffering, 3 is triple
+		size_t syncBytes = 0;      // > 0: sync_file_range every syncBytes
+		bool   syncOnClose = false; // fdatasync in close
+		bool   useUring = true;    // false: always use writer thread
+	};
+	AsyncFileOutputStream() noexcept;
+	explicit AsyncFileOutputStream(fstring fpath);
+	AsyncFileOutputStream(fstring fpath, const Options&);
+	~AsyncFileOutputStream() override;
+
+	/// create or truncate fpath
+	void open(fstring fpath);
+	void open(fstring fpath, const Options&);
+	/// write from current file position of fd, fd is closed by close()
+	void dopen(int fd);
+	void dopen(int fd, const Options&);
+	bool isOpen() const noexcept { return NULL != m_impl; }
+	void close();
+
+	size_t write(const void* vbuf, size_t length) override;
+	void ensureWrite(const void* vbuf, size_t length) { write(vbuf, length); }
+	void writeByte(byte_t b) {
+		if (terark_unlikely(m_pos == m_end))
+			next_buf();
+		*m_pos++ = b;
+	}
+
+	/// flush_async() + wait()
+	void flush() override;
+	/// submit the current buffer even if it is not full, does not wait
+	void flush_async();
+	/// wait for all submitted buffers to be written
+	void wait();
+	/// flush() + fdatasync
+	void fdatasync();
+
+	uint64_t tell() const noexcept; // file offset of next byte, includes buffered
+	bool is_uring() const noexcept;
+	int  fd() const noexcept;
+
+	class Impl;
+private:
+	void next_buf();
+	byte_t* m_pos;
+	byte_t* m_end;
+	Impl*   m_impl;
+};
+
+} // namespace terark
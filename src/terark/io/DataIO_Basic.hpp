@@ -2,6 +2,7 @@
 #pragma once
 
 #include <utility>
+#include <string.h>
 
 #ifndef BOOST_INTRUSIVE_PTR_HPP_INCLUDED
 #  include <boost/intrusive_ptr.hpp>
@@ -173,7 +174,12 @@ struct DataIO_is_realdump
 	BOOST_STATIC_CONSTANT(int, size = Size);
 	typedef boost::mpl::bool_<MembersDumpable && sizeof(Outer)==Size> is_dump_t;
 
+	// all members are dumpable but Outer has padding, the members can be
+	// packed into Size bytes by DataIO_pack_saver and DataIO_pack_loader
+	typedef boost::mpl::bool_<MembersDumpable && sizeof(Outer)!=Size> is_pack_t;
+
 	is_dump_t is_dumpable() const { return is_dump_t(); }
+	is_pack_t is_packable() const { return is_pack_t(); }
 
 #if (defined(_DEBUG) || !defined(NDEBUG)) && !defined(DATA_IO_DONT_CHECK_REAL_DUMP)
 	const Outer* address;
@@ -220,6 +226,34 @@ struct DataIO_is_realdump
 	}
 };
 
+/// copy members to a packed buffer, each member is a fixed-size memcpy which
+/// is compiled to a plain load/store, there is no bounds check and no branch,
+/// usage: DataIO_pack_saver(buf) & a & b & c
+class DataIO_pack_saver {
+	byte_t* m_dst;
+public:
+	explicit DataIO_pack_saver(byte_t* dst) : m_dst(dst) {}
+	template<class T>
+	DataIO_pack_saver& operator&(const T& x) {
+		memcpy(m_dst, &x, sizeof(T));
+		m_dst += sizeof(T);
+		return *this;
+	}
+};
+
+/// reverse of DataIO_pack_saver
+class DataIO_pack_loader {
+	const byte_t* m_src;
+public:
+	explicit DataIO_pack_loader(const byte_t* src) : m_src(src) {}
+	template<class T>
+	DataIO_pack_loader& operator&(T& x) {
+		memcpy((void*)&x, m_src, sizeof(T));
+		m_src += sizeof(T);
+		return *this;
+	}
+};
+
 template<class T>
 struct ObjectDefaultCons {
 	T t;
@@ -441,6 +441,8 @@ unsigned int DataIO_load_check_version(Input& in, unsigned int curr_version, con
 	}
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
+//! reverse of DATA_IO_OPTIMIZE_ELEMEN_SAVE: a padded class of dumpable
+//! members is read by one ensureRead to a stack buffer, then unpacked
 #define DATA_IO_OPTIMIZE_ELEMEN_LOAD(Class, Members)\
 	template<class Bswap>							\
 	void _M_byte_swap_in(Bswap)						\
@@ -451,10 +453,30 @@ unsigned int DataIO_load_check_version(Input& in, unsigned int curr_version, con
 	void opt_load(DataIO& aDataIO, Bswap)			\
 	{												\
 		using namespace terark;						\
-	  DataIO_load_elem_aux(aDataIO,					\
-		static_cast<Class&>(*this), Bswap(),		\
-		(DataIO_is_realdump<DataIO,Class,0,true>	\
-		  (this) Members).is_dumpable() );			\
+		auto _M_realdump =							\
+			DataIO_is_realdump<DataIO,Class,0,true>	\
+			  (this) Members;						\
+		typedef decltype(_M_realdump) _M_realdump_t;\
+		TERARK_UNUSED_VAR(_M_realdump);				\
+		opt_load_pack<_M_realdump_t::size>(aDataIO,	\
+		  Bswap(), typename _M_realdump_t::is_dump_t(),\
+		  boost::mpl::bool_<_M_realdump_t::is_pack_t::value \
+		                    && !Bswap::value>());	\
+	}												\
+	template<int _N_PackSize, class DataIO, class Bswap, class IsDump>\
+	void opt_load_pack(DataIO& aDataIO, Bswap, IsDump,	\
+					   terark::IsDump_false)		\
+	{												\
+		terark::DataIO_load_elem_aux(aDataIO,		\
+		  static_cast<Class&>(*this), Bswap(), IsDump());\
+	}												\
+	template<int _N_PackSize, class DataIO, class Bswap>\
+	void opt_load_pack(DataIO& aDataIO, Bswap, terark::IsDump_false,\
+					   terark::IsDump_true)			\
+	{												\
+		terark::byte_t _M_pack_buf[_N_PackSize];	\
+		aDataIO.ensureRead(_M_pack_buf, _N_PackSize);\
+		terark::DataIO_pack_loader(_M_pack_buf) Members;\
 	}
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 #define DATA_IO_OPTIMIZE_ELEMEN_LOAD_REG(Friend, Self, Class)\
@@ -76,6 +76,28 @@ public:
 	   	x.t = this->getStream()->read_var_uint32();
 	   	return *this;
    	}
+
+	// bulk decode, same format as loading elements one by one
+	MyType& operator>>(valvec<var_uint32_t>& x)
+	{
+		BOOST_STATIC_ASSERT(sizeof(var_uint32_t) == sizeof(uint32_t));
+		var_size_t n;
+		*this >> n;
+		x.resize_no_init(n.t);
+		this->getStream()->read_var_uint32_array((uint32_t*)x.data(), n.t);
+		return *this;
+	}
+#if !defined(BOOST_NO_INT64_T)
+	MyType& operator>>(valvec<var_uint64_t>& x)
+	{
+		BOOST_STATIC_ASSERT(sizeof(var_uint64_t) == sizeof(uint64_t));
+		var_size_t n;
+		*this >> n;
+		x.resize_no_init(n.t);
+		this->getStream()->read_var_uint64_array((uint64_t*)x.data(), n.t);
+		return *this;
+	}
+#endif
 #endif // TERARK_DATA_IO_SLOW_VAR_INT
 
 //-------------------------------------------------------------
@@ -415,7 +415,7 @@ void DataIO_saveObject(Output& output, const std::pair<FirstT, SecondT>& x)
 	template<class DataIO, class Bswap>				\
 	void save_array(DataIO& aDataIO					\
 		, const Class* _vector_, size_t _N_count	\
-		, Bswap)									\
+		, Bswap) const								\
 	{												\
 		using namespace terark;						\
 		DataIO_save_array_aux(						\
@@ -433,15 +433,39 @@ void DataIO_saveObject(Output& output, const std::pair<FirstT, SecondT>& x)
 	}
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
+//! if all members are dumpable but Class has padding, members are copied to
+//! a packed stack buffer which is written by one ensureWrite, the bytes are
+//! same as saving member by member. a class with non-dumpable members is
+//! saved member by member, runs of dumpable members in it are not packed
 #define DATA_IO_OPTIMIZE_ELEMEN_SAVE(Class, Members)\
 	template<class DataIO, class Bswap>				\
 	void opt_save(DataIO& aDataIO, Bswap) const		\
 	{												\
 		using namespace terark;						\
-		DataIO_save_elem_aux(aDataIO,				\
-		  static_cast<const Class&>(*this), Bswap(),\
-			(DataIO_is_realdump<DataIO,Class,0,true>\
-			  (this) Members).is_dumpable());		\
+		auto _M_realdump =							\
+			DataIO_is_realdump<DataIO,Class,0,true>	\
+			  (this) Members;						\
+		typedef decltype(_M_realdump) _M_realdump_t;\
+		TERARK_UNUSED_VAR(_M_realdump);				\
+		opt_save_pack<_M_realdump_t::size>(aDataIO,	\
+		  Bswap(), typename _M_realdump_t::is_dump_t(),\
+		  boost::mpl::bool_<_M_realdump_t::is_pack_t::value \
+		                    && !Bswap::value>());	\
+	}												\
+	template<int _N_PackSize, class DataIO, class Bswap, class IsDump>\
+	void opt_save_pack(DataIO& aDataIO, Bswap, IsDump,	\
+					   terark::IsDump_false) const	\
+	{												\
+		terark::DataIO_save_elem_aux(aDataIO,		\
+		  static_cast<const Class&>(*this), Bswap(), IsDump());\
+	}												\
+	template<int _N_PackSize, class DataIO, class Bswap>\
+	void opt_save_pack(DataIO& aDataIO, Bswap, terark::IsDump_false,\
+					   terark::IsDump_true) const	\
+	{												\
+		terark::byte_t _M_pack_buf[_N_PackSize];	\
+		terark::DataIO_pack_saver(_M_pack_buf) Members;\
+		aDataIO.ensureWrite(_M_pack_buf, _N_PackSize);\
 	}
 #define DATA_IO_OPTIMIZE_ELEMEN_SAVE_REG(Friend, Self, Class)\
 	template<class DataIO, class Bswap>	 \
@@ -66,6 +66,24 @@ public:
 		this->getStream()->write_var_uint32(x.t);
 		return *this;
 	}
+
+	// bulk encode, same format as saving elements one by one
+	MyType& operator<<(const valvec<var_uint32_t>& x)
+	{
+		BOOST_STATIC_ASSERT(sizeof(var_uint32_t) == sizeof(uint32_t));
+		*this << var_size_t(x.size());
+		this->getStream()->write_var_uint32_array((const uint32_t*)x.data(), x.size());
+		return *this;
+	}
+#if !defined(BOOST_NO_INT64_T)
+	MyType& operator<<(const valvec<var_uint64_t>& x)
+	{
+		BOOST_STATIC_ASSERT(sizeof(var_uint64_t) == sizeof(uint64_t));
+		*this << var_size_t(x.size());
+		this->getStream()->write_var_uint64_array((const uint64_t*)x.data(), x.size());
+		return *this;
+	}
+#endif
 #endif // TERARK_DATA_IO_SLOW_VAR_INT
 
 //--------------------------------------------------------
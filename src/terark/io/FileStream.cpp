@@ -512,6 +512,23 @@ void FileStream::write_string(const std::string& str)
 	ensureWrite(str.data(), str.size());
 }
 
+void FileStream::read_var_uint32_array(uint32_t* a, size_t n)
+{
+	for (size_t i = 0; i < n; ++i) a[i] = read_var_uint32();
+}
+void FileStream::read_var_uint64_array(uint64_t* a, size_t n)
+{
+	for (size_t i = 0; i < n; ++i) a[i] = read_var_uint64();
+}
+void FileStream::write_var_uint32_array(const uint32_t* a, size_t n)
+{
+	for (size_t i = 0; i < n; ++i) write_var_uint32(a[i]);
+}
+void FileStream::write_var_uint64_array(const uint64_t* a, size_t n)
+{
+	for (size_t i = 0; i < n; ++i) write_var_uint64(a[i]);
+}
+
 #if 0
 /**
  * manually write a string
@@ -121,6 +121,7 @@ void MemMapStream::init()
     m_file_size = 0;
     m_beg = m_pos = m_end = 0;
     m_is_owner = true;
+    m_seq_window = 0;
     assert(m_best_block_size % m_AllocationGranularity == 0);
 }
 
@@ -151,6 +152,7 @@ void MemMapStream::clone(const MemMapStream& source)
     m_file_pos = 0;
     m_beg = m_pos = m_end = nullptr;
     m_best_block_size = source.m_best_block_size;
+    m_seq_window = source.m_seq_window;
     m_fpath = source.m_fpath;
 }
 
@@ -290,6 +292,15 @@ void MemMapStream::set_fsize(stream_position_t fsize)
     m_file_size = fsize;
 }
 
+void MemMapStream::set_seq_hint(size_t window)
+{
+    m_seq_window = window; // not supported on windows, ignored
+}
+
+void MemMapStream::seq_advise(stream_position_t, size_t)
+{
+}
+
 bool MemMapStream::remap_impl(stream_position_t fpos, size_t map_size)
 {
     bool readonly = !(m_mode & (O_RDWR|O_WRONLY));
@@ -417,6 +428,33 @@ void MemMapStream::set_fsize(stream_position_t fsize)
     m_file_size = fsize;
 }
 
+void MemMapStream::set_seq_hint(size_t window)
+{
+    m_seq_window = window;
+  #if defined(POSIX_FADV_SEQUENTIAL)
+    if (window && -1 != m_hFile)
+        posix_fadvise(m_hFile, 0, 0, POSIX_FADV_SEQUENTIAL);
+  #endif
+}
+
+void MemMapStream::seq_advise(stream_position_t fpos, size_t map_size)
+{
+  #if defined(POSIX_FADV_WILLNEED)
+    using namespace std; // for min
+    if (m_beg && m_file_pos < fpos) {
+        // fpos may be in the old region when a read crosses its end
+        stream_position_t old_end = m_file_pos + (m_end - m_beg);
+        posix_fadvise(m_hFile, m_file_pos, min(old_end, fpos) - m_file_pos,
+                      POSIX_FADV_DONTNEED);
+    }
+    stream_position_t ahead = fpos + map_size;
+    if (ahead < m_file_size) {
+        posix_fadvise(m_hFile, ahead, min<stream_position_t>(m_seq_window, m_file_size - ahead),
+                      POSIX_FADV_WILLNEED);
+    }
+  #endif
+}
+
 bool MemMapStream::remap_impl(stream_position_t fpos, size_t map_size)
 {
     if (m_beg)
@@ -424,6 +462,10 @@ bool MemMapStream::remap_impl(stream_position_t fpos, size_t map_size)
         if (0 != munmap(m_beg, align_up(m_end-m_beg, m_page_size)))
             cleanup_and_throw("failed unmapping in MemMapStream::remap_impl");
     }
+    // after munmap, POSIX_FADV_DONTNEED does not drop mapped pages,
+    // m_beg and m_end are still the old region for seq_advise
+    if (m_seq_window && !(m_mode & (O_RDWR|O_WRONLY)))
+        seq_advise(fpos, map_size);
 
     if (m_mode & O_RDWR && m_file_size < fpos + map_size)
     {
@@ -504,8 +546,9 @@ void MemMapStream::unaligned_remap(stream_position_t fpos, size_t size)
     size_t page_offset = size_t(fpos - aligned_fpos);
     size_t map_size = max(size_t(m_best_block_size), page_offset + size);
     if (!(m_mode & O_RDWR))
-    { // mapped area can not beyond file size
-        stream_position_t remain = m_file_size - this->tell();
+    { // mapped area can not beyond file size, tell() is stale when
+      // called by remap_and_read, which has moved m_file_pos forward
+        stream_position_t remain = m_file_size - aligned_fpos;
         if (map_size > remain)
             map_size = size_t(remain);
     }
@@ -607,13 +650,14 @@ size_t MemMapStream::remap_and_read(void* vbuf, size_t size)
     size_t curr = m_end-m_pos;
     memcpy(bbuf, m_pos, curr);
     m_pos += curr; // == m_end
-    m_file_pos += m_end - m_beg;
+    // m_file_pos is the old region until remap, seq_advise needs it
+    stream_position_t fpos = m_file_pos + (m_end - m_beg);
 
     size_t remain = size - curr;
-    size_t file_remain = size_t(m_file_size - m_file_pos); // NOLINT
+    size_t file_remain = size_t(m_file_size - fpos); // NOLINT
     size_t mapsize = min(file_remain, max(size_t(m_best_block_size), remain));
 
-    unaligned_remap(m_file_pos, mapsize);
+    unaligned_remap(fpos, mapsize);
 
     remain = min(remain, file_remain);
     memcpy(bbuf+curr, m_pos, remain);
@@ -101,6 +101,12 @@ public:
 	void* map(stream_position_t fpos, size_t size, int mode);
 	void  unmap(void* base, size_t size);
 
+	/// sequential read hint for readonly stream: when the mapped region
+	/// moves forward, posix_fadvise WILLNEED on window bytes ahead of it and
+	/// DONTNEED on the unmapped region behind it, window = 0 disables
+	void set_seq_hint(size_t window);
+	size_t seq_hint() const { return m_seq_window; }
+
 	size_t page_size() const { return m_page_size; }
 	size_t best_block_size() const { return m_best_block_size; }
 	void set_best_block_size(size_t n) { m_best_block_size = uint32_t(n); }
@@ -146,6 +152,7 @@ protected:
 	uint32_t m_best_block_size;
 	uint32_t m_page_size;
 	uint32_t m_AllocationGranularity;
+	size_t   m_seq_window;
 	std::string m_fpath;
 
 	void init();
@@ -156,6 +163,7 @@ protected:
 	stream_position_t get_fsize();
 
 	bool remap_impl(stream_position_t fpos, size_t size);
+	void seq_advise(stream_position_t fpos, size_t size);
 
 	void remap_and_skip(size_t size);
 	void remap_and_probe(size_t size);
@@ -234,8 +234,8 @@ public:
 	#include "var_int_declare_write.hpp"
 
 protected:
-	void throw_EndOfFile(const char* func, size_t want);
-	void throw_OutOfSpace(const char* func, size_t want);
+	terark_no_return void throw_EndOfFile(const char* func, size_t want);
+	terark_no_return void throw_OutOfSpace(const char* func, size_t want);
 
 protected:
 	byte* m_end; // only used by set/eof
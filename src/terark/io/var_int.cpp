@@ -22,6 +22,13 @@
 #pragma optimize("t", on)
 #endif
 
+#if defined(__SSSE3__)
+# include <tmmintrin.h>
+#elif defined(__SSE2__)
+# include <emmintrin.h>
+#endif
+#include <string.h>
+
 namespace terark {
 
 #include "var_int_inline.hpp"
@@ -179,5 +186,242 @@ int64_t reverse_get_var_int64(const unsigned char* buf, unsigned char const ** c
 
 #endif //BOOST_NO_INT64_T
 
-} // namespace terark
+//////////////////////////////////////////////////////////////////////////
+// bulk decode/encode
+//
+// Decoding is Masked-VByte style: the continuation bits of 16 input bytes
+// are extracted by one movemask, the low 12 bits select a precomputed
+// shuffle which gathers up to 8 ints of 1~2 bytes into 16 bit lanes, or up
+// to 4 ints of 1~3 bytes into 32 bit lanes, then the 7 bit groups of all
+// lanes are combined by a few shifts. Longer ints are decoded by scalar code.
+
+namespace {
+
+// decode one int which is known to be complete in [p, end)
+template<class UInt>
+inline bool var_uint_complete(const unsigned char* p, const unsigned char* end) {
+	const size_t maxlen = sizeof(UInt) == 4 ? 5 : 10;
+	for (size_t i = 0; p + i < end && i < maxlen; ++i) {
+		if (!(p[i] & 0x80))
+			return true;
+	}
+	return size_t(end - p) >= maxlen; // let gg_load_var_uint throw on bad data
+}
+
+#if defined(__SSSE3__)
+
+struct VarUintShuffle {
+	unsigned char consumed; // 0 means the first int is decoded by scalar
+	unsigned char num;      // number of decoded ints
+	unsigned char wide;     // 0: 16 bit lanes, 1: 32 bit lanes
+	unsigned char pad;
+	unsigned char shuf[16];
+};
+
+class VarUintShuffleTable {
+public:
+	VarUintShuffle tab[4096];
+	VarUintShuffleTable() {
+		for (unsigned mask = 0; mask < 4096; ++mask)
+			gen(mask, &tab[mask]);
+	}
+	static void gen(unsigned mask, VarUintShuffle* e) {
+		unsigned beg[12], len[12], n = 0;
+		for (unsigned pos = 0; pos < 12; ) {
+			unsigned l = 1;
+			while (pos + l - 1 < 12 && (mask >> (pos + l - 1) & 1))
+				l++;
+			if (pos + l - 1 >= 12)
+				break; // last int is not complete in 12 bytes
+			beg[n] = pos; len[n] = l; n++;
+			pos += l;
+		}
+		unsigned c2 = 0, c3 = 0;
+		while (c2 < n && c2 < 8 && len[c2] <= 2) c2++;
+		while (c3 < n && c3 < 4 && len[c3] <= 3) c3++;
+		memset(e->shuf, 0x80, 16);
+		e->pad = 0;
+		if (c2 >= c3 && c2) {
+			e->wide = 0;
+			e->num = c2;
+			e->consumed = beg[c2-1] + len[c2-1];
+			for (unsigned j = 0; j < c2; ++j) {
+				e->shuf[2*j] = beg[j];
+				if (len[j] == 2) e->shuf[2*j+1] = beg[j] + 1;
+			}
+		}
+		else if (c3) {
+			e->wide = 1;
+			e->num = c3;
+			e->consumed = beg[c3-1] + len[c3-1];
+			for (unsigned j = 0; j < c3; ++j) {
+				for (unsigned k = 0; k < len[j]; ++k)
+					e->shuf[4*j+k] = beg[j] + k;
+			}
+		}
+		else {
+			e->wide = 0;
+			e->num = 0;
+			e->consumed = 0;
+		}
+	}
+};
+
+inline void store_u32x4(uint32_t* a, __m128i v) {
+	_mm_storeu_si128((__m128i*)a, v);
+}
+inline void store_u32x4(uint64_t* a, __m128i v) {
+	const __m128i zero = _mm_setzero_si128();
+	_mm_storeu_si128((__m128i*)(a + 0), _mm_unpacklo_epi32(v, zero));
+	_mm_storeu_si128((__m128i*)(a + 2), _mm_unpackhi_epi32(v, zero));
+}
+
+#endif // __SSSE3__
+
+template<class UInt>
+const unsigned char*
+load_var_uint_array(const unsigned char* p, const unsigned char* end,
+					UInt* a, size_t* pn, const char* func) {
+	const size_t maxlen = sizeof(UInt) == 4 ? 5 : 10;
+	const size_t n = *pn;
+	size_t i = 0;
+#if defined(__SSSE3__)
+	static const VarUintShuffleTable table;
+	const __m128i zero = _mm_setzero_si128();
+	while (end - p >= 16 && n - i >= 16) {
+		__m128i in = _mm_loadu_si128((const __m128i*)p);
+		unsigned mask = _mm_movemask_epi8(in);
+		if (0 == mask) { // 16 ints of 1 byte
+			__m128i lo = _mm_unpacklo_epi8(in, zero);
+			__m128i hi = _mm_unpackhi_epi8(in, zero);
+			store_u32x4(a + i +  0, _mm_unpacklo_epi16(lo, zero));
+			store_u32x4(a + i +  4, _mm_unpackhi_epi16(lo, zero));
+			store_u32x4(a + i +  8, _mm_unpacklo_epi16(hi, zero));
+			store_u32x4(a + i + 12, _mm_unpackhi_epi16(hi, zero));
+			p += 16;
+			i += 16;
+			continue;
+		}
+		const VarUintShuffle& e = table.tab[mask & 0xFFF];
+		if (e.consumed) {
+			__m128i x = _mm_shuffle_epi8(in, _mm_loadu_si128((const __m128i*)e.shuf));
+			if (0 == e.wide) {
+				__m128i v = _mm_or_si128(
+					_mm_and_si128(x, _mm_set1_epi16(0x007F)),
+					_mm_srli_epi16(_mm_and_si128(x, _mm_set1_epi16(0x7F00)), 1));
+				store_u32x4(a + i + 0, _mm_unpacklo_epi16(v, zero));
+				store_u32x4(a + i + 4, _mm_unpackhi_epi16(v, zero));
+			}
+			else {
+				__m128i v = _mm_or_si128(_mm_or_si128(
+					_mm_and_si128(x, _mm_set1_epi32(0x00007F)),
+					_mm_srli_epi32(_mm_and_si128(x, _mm_set1_epi32(0x007F00)), 1)),
+					_mm_srli_epi32(_mm_and_si128(x, _mm_set1_epi32(0x7F0000)), 2));
+				store_u32x4(a + i, v);
+			}
+			p += e.consumed;
+			i += e.num;
+		}
+		else {
+			a[i++] = gg_load_var_uint<UInt>(p, &p, func);
+		}
+	}
+#else
+	while (end - p >= 8 && n - i >= 8) {
+		uint64_t w;
+		memcpy(&w, p, 8);
+		if (0 == (w & 0x8080808080808080ULL)) { // 8 ints of 1 byte
+			for (size_t k = 0; k < 8; ++k)
+				a[i + k] = p[k];
+			p += 8;
+			i += 8;
+		}
+		else if (size_t(end - p) >= maxlen) {
+			a[i++] = gg_load_var_uint<UInt>(p, &p, func);
+		}
+		else {
+			break; // int may be cut at end, checked by the tail loop
+		}
+	}
+#endif
+	for (; i < n; ++i) {
+		if (size_t(end - p) < maxlen && !var_uint_complete<UInt>(p, end))
+			break;
+		a[i] = gg_load_var_uint<UInt>(p, &p, func);
+	}
+	*pn = i;
+	return p;
+}
 
+template<class UInt>
+unsigned char* save_var_uint_array(unsigned char* p, const UInt* a, size_t n) {
+	size_t i = 0;
+#if defined(__SSE2__)
+	if (sizeof(UInt) == 4) {
+		const __m128i high = _mm_set1_epi32(~0x7F);
+		const __m128i zero = _mm_setzero_si128();
+		for (; i + 16 <= n; i += 16) {
+			__m128i x0 = _mm_loadu_si128((const __m128i*)(a + i +  0));
+			__m128i x1 = _mm_loadu_si128((const __m128i*)(a + i +  4));
+			__m128i x2 = _mm_loadu_si128((const __m128i*)(a + i +  8));
+			__m128i x3 = _mm_loadu_si128((const __m128i*)(a + i + 12));
+			__m128i all = _mm_or_si128(_mm_or_si128(x0, x1), _mm_or_si128(x2, x3));
+			__m128i big = _mm_cmpeq_epi8(_mm_and_si128(all, high), zero);
+			if (0xFFFF == _mm_movemask_epi8(big)) { // 16 ints of 1 byte
+				__m128i w0 = _mm_packs_epi32(x0, x1);
+				__m128i w1 = _mm_packs_epi32(x2, x3);
+				_mm_storeu_si128((__m128i*)p, _mm_packus_epi16(w0, w1));
+				p += 16;
+			}
+			else {
+				for (size_t k = 0; k < 16; ++k)
+					p = gg_save_var_uint<UInt>(p, a[i + k]);
+			}
+		}
+	}
+#endif
+	for (; i + 8 <= n; i += 8) {
+		UInt all = a[i+0] | a[i+1] | a[i+2] | a[i+3]
+				 | a[i+4] | a[i+5] | a[i+6] | a[i+7];
+		if (all < 128) { // 8 ints of 1 byte
+			for (size_t k = 0; k < 8; ++k)
+				p[k] = (unsigned char)(a[i + k]);
+			p += 8;
+		}
+		else {
+			for (size_t k = 0; k < 8; ++k)
+				p = gg_save_var_uint<UInt>(p, a[i + k]);
+		}
+	}
+	for (; i < n; ++i)
+		p = gg_save_var_uint<UInt>(p, a[i]);
+	return p;
+}
+
+} // namespace
+
+const unsigned char*
+load_var_uint32_array(const unsigned char* buf, const unsigned char* end,
+					  uint32_t* a, size_t* n)
+{
+	return load_var_uint_array<uint32_t>(buf, end, a, n, BOOST_CURRENT_FUNCTION);
+}
+
+unsigned char* save_var_uint32_array(unsigned char* buf, const uint32_t* a, size_t n)
+{
+	return save_var_uint_array<uint32_t>(buf, a, n);
+}
+
+const unsigned char*
+load_var_uint64_array(const unsigned char* buf, const unsigned char* end,
+					  uint64_t* a, size_t* n)
+{
+	return load_var_uint_array<uint64_t>(buf, end, a, n, BOOST_CURRENT_FUNCTION);
+}
+
+unsigned char* save_var_uint64_array(unsigned char* buf, const uint64_t* a, size_t n)
+{
+	return save_var_uint_array<uint64_t>(buf, a, n);
+}
+
+} // namespace terark
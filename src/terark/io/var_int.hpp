@@ -212,6 +212,20 @@ TERARK_DLL_EXPORT unsigned char* save_var_int30(unsigned char* buf, int32_t x);
 TERARK_DLL_EXPORT unsigned char* save_var_int64(unsigned char* buf, int64_t x);
 TERARK_DLL_EXPORT unsigned char* save_var_int61(unsigned char* buf, int64_t x);
 
+//--------------------------------------------------------------------------------------
+/// decode at most *n ints from [buf, end) to a, an int which is not complete
+/// in [buf, end) is not decoded, *n is set to the number of decoded ints
+/// @returns end of the decoded data
+TERARK_DLL_EXPORT const unsigned char*
+load_var_uint32_array(const unsigned char* buf, const unsigned char* end, uint32_t* a, size_t* n);
+TERARK_DLL_EXPORT const unsigned char*
+load_var_uint64_array(const unsigned char* buf, const unsigned char* end, uint64_t* a, size_t* n);
+
+/// buf must have space of 5*n or 10*n bytes
+/// @returns end of the encoded data
+TERARK_DLL_EXPORT unsigned char* save_var_uint32_array(unsigned char* buf, const uint32_t* a, size_t n);
+TERARK_DLL_EXPORT unsigned char* save_var_uint64_array(unsigned char* buf, const uint64_t* a, size_t n);
+
 ////////////////////////////////////////////////////////////////////////////////////////
 TERARK_DLL_EXPORT uint32_t reverse_get_var_uint32(const unsigned char* buf, unsigned char const ** cur);
 TERARK_DLL_EXPORT int32_t reverse_get_var_int32(const unsigned char* buf, unsigned char const ** cur);
@@ -6,5 +6,7 @@
 	int32_t read_var_int30();
 	int64_t read_var_int64();
 	int64_t read_var_int61();
+	void read_var_uint32_array(uint32_t* a, size_t n);
+	void read_var_uint64_array(uint64_t* a, size_t n);
 	void read_string(std::string& str);
 
@@ -6,6 +6,8 @@
 	void write_var_int30(int32_t x);
 	void write_var_int64(int64_t x);
 	void write_var_int61(int64_t x);
+	void write_var_uint32_array(const uint32_t* a, size_t n);
+	void write_var_uint64_array(const uint64_t* a, size_t n);
 	void write_string(const std::string& str);
 //	void write_string(const char* str, size_t len);
 
@@ -89,6 +89,44 @@ int64_t STREAM_READER::read_var_int61()
 	return var_int61_u2s(read_var_uint61());
 }
 
+// ints which are complete in the buffer are decoded in bulk, an int across
+// the buffer end is read by read_var_uint*, which refills the buffer
+void STREAM_READER::read_var_uint32_array(uint32_t* a, size_t n)
+{
+	while (n) {
+		size_t k = n;
+		if (this->buf_remain_bytes() > 0) {
+			const unsigned char* end = m_pos + this->buf_remain_bytes();
+			m_pos = (unsigned char*)load_var_uint32_array(m_pos, end, a, &k);
+		} else {
+			k = 0;
+		}
+		a += k, n -= k;
+		if (n) {
+			*a++ = read_var_uint32();
+			n--;
+		}
+	}
+}
+
+void STREAM_READER::read_var_uint64_array(uint64_t* a, size_t n)
+{
+	while (n) {
+		size_t k = n;
+		if (this->buf_remain_bytes() > 0) {
+			const unsigned char* end = m_pos + this->buf_remain_bytes();
+			m_pos = (unsigned char*)load_var_uint64_array(m_pos, end, a, &k);
+		} else {
+			k = 0;
+		}
+		a += k, n -= k;
+		if (n) {
+			*a++ = read_var_uint64();
+			n--;
+		}
+	}
+}
+
 void STREAM_READER::read_string(std::string& str)
 {
 	size_t len = read_var_uint32();
@@ -190,6 +228,34 @@ void STREAM_WRITER::write_var_int61(int64_t x)
 }
 
 
+void STREAM_WRITER::write_var_uint32_array(const uint32_t* a, size_t n)
+{
+	while (n) {
+		size_t k = std::min(n, size_t(this->buf_remain_bytes()) / 5);
+		if (k) {
+			m_pos = save_var_uint32_array(m_pos, a, k);
+		} else {
+			write_var_uint32(*a);
+			k = 1;
+		}
+		a += k, n -= k;
+	}
+}
+
+void STREAM_WRITER::write_var_uint64_array(const uint64_t* a, size_t n)
+{
+	while (n) {
+		size_t k = std::min(n, size_t(this->buf_remain_bytes()) / 10);
+		if (k) {
+			m_pos = save_var_uint64_array(m_pos, a, k);
+		} else {
+			write_var_uint64(*a);
+			k = 1;
+		}
+		a += k, n -= k;
+	}
+}
+
 void STREAM_WRITER::write_string(const std::string& str)
 {
 	write_var_uint32(str.size());
@@ -580,6 +580,27 @@ ThreadCacheMemPoolMF(terark_no_inline void)reserve(size_t cap) {
 ThreadCacheMemPoolMF(void)shrink_to_fit() {}
 
 
+ThreadCacheMemPoolMF(terark_no_inline bool)vm_grow(size_t mincap) {
+    size_t cap = as_atomic(mem::c).load(std::memory_order_acquire);
+    if (mincap <= cap) {
+        return true; // grown by other threads
+    }
+    if (mincap > m_vm_reserved) {
+        return false;
+    }
+    // double the capacity, but at most 1G each time
+    size_t newcap = std::max(mincap, cap + std::min(cap, size_t(1) << 30));
+    newcap = std::min(pow2_align_up(newcap, ArenaSize), m_vm_reserved);
+    // concurrent growers may commit overlapped ranges, it is idempotent
+    if (!vm_commit(mem::p + cap, newcap - cap)) {
+        return false;
+    }
+    while (cap < newcap && !cas_weak(mem::c, cap, newcap)) {
+        cap = as_atomic(mem::c).load(std::memory_order_acquire);
+    }
+    return true;
+}
+
     // should not throw
 ThreadCacheMemPoolMF(terark_no_inline bool)
 chunk_alloc(TCMemPoolOneThread<AlignSize>* tc, size_t request) {
@@ -594,9 +615,13 @@ chunk_alloc(TCMemPoolOneThread<AlignSize>* tc, size_t request) {
         if (terark_unlikely((endpos & (m_chunk_size-1)) != 0)) {
             chunk_len += m_chunk_size - (endpos & (m_chunk_size-1));
         }
+        if (terark_unlikely(oldn + chunk_len > cap) && m_vm_reserved > cap) {
+            if (vm_grow(oldn + chunk_len))
+                cap = as_atomic(mem::c).load(std::memory_order_acquire);
+        }
         if (terark_unlikely(oldn + chunk_len > cap)) {
             if (oldn + request > cap) {
-                // cap is fixed, so fail
+                // cap can not grow, so fail
                 return false;
             }
             chunk_len = cap - oldn;
@@ -131,6 +131,12 @@ public:
     size_t m_vm_commit_fail_cnt = 0;
     size_t m_vm_commit_fail_len = 0;
 
+    /// if m_vm_reserved > capacity(), address space [data(), data() +
+    /// m_vm_reserved) is reserved by vm_reserve, and it is committed on
+    /// demand by vm_grow, thus capacity grows without moving data
+    size_t m_vm_reserved = 0;
+    bool vm_grow(size_t mincap);
+
     void set_chunk_size(size_t sz) {
         TERARK_VERIFY_F((sz & (sz-1)) == 0, "%zd(%#zX)", sz, sz);
         m_chunk_size = sz;
@@ -23,6 +23,7 @@ client_stub_i::~client_stub_i()
 rpc_client_base::rpc_client_base(IDuplexStream* duplex)
 	: m_minseqid(0)
 	, m_sequence_id(0)
+	, m_batch(0)
 	, m_duplex(duplex)
 {
 	intrusive_ptr_add_ref(this);
@@ -54,9 +55,32 @@ void rpc_client_base::async_packet(client_packet_base* p)
 	m_pendings.insert(std::make_pair(p->seqid, p));
 }
 
+void rpc_client_base::begin_batch()
+{
+	boost::mutex::scoped_lock lock(m_mutex_write);
+	m_batch++;
+}
+
+/**
+ @brief 批量发送 begin_batch 之后的异步调用
+
+ 最外层的 end_batch 才 flush，多个小的调用合并为一次 write
+ */
+void rpc_client_base::end_batch()
+{
+	boost::mutex::scoped_lock lock(m_mutex_write);
+	assert(m_batch > 0);
+	if (0 == --m_batch)
+		flush_output();
+}
+
 void rpc_client_base::wait_pending_async()
 {
-	boost::intrusive_ptr<client_packet_base> packet;
+	{
+		// calls in an unfinished batch would never be replied
+		boost::mutex::scoped_lock lock(m_mutex_write);
+		flush_output();
+	}
 	bool isEmpty;
 	{
 		boost::mutex::scoped_lock lockP(m_mutex_pendings);
@@ -64,6 +88,7 @@ void rpc_client_base::wait_pending_async()
 	}
 	while (!isEmpty)
 	{
+		boost::intrusive_ptr<client_packet_base> packet;
 		{
 			boost::mutex::scoped_lock lock(m_mutex_read);
 			unsigned seqid = read_seqid();
@@ -77,8 +102,9 @@ void rpc_client_base::wait_pending_async()
 					isEmpty = m_pendings.empty();
 				}
 			}
+			assert(packet);
+			packet->read_args(this);
 		}
-		assert(packet);
 		packet->on_return();
 	}
 }
@@ -99,9 +125,9 @@ void rpc_client_base::wait_async_return_once()
 			}
 		//	m_cond_pendings.notify_all();
 		}
-	//	packet->read_args(this);
+		assert(packet);
+		packet->read_args(this);
 	}
-	assert(packet);
 	packet->on_return();
 }
 
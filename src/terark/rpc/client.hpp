@@ -13,6 +13,8 @@
 #include <boost/preprocessor/repetition.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread.hpp>
+#include <future>
+#include <memory>
 
 #define IF_RPC_SERVER(Server, Client) Client
 
@@ -133,14 +135,25 @@ public:
 	short		 how_call;
 	bool		 isbyid;
 	rpc_ret_t    retv;
+	std::unique_ptr<std::promise<rpc_ret_t> > promise; //!< set by async_future
 
 	virtual void send_id_args(rpc_client_basebase* client) = 0;
 	virtual void send_nm_args(rpc_client_basebase* client) = 0;
 	virtual void read_args(rpc_client_basebase* client) = 0;
 
+	//! called after read_args, invoke the callback and fulfill the promise
 	virtual void on_return() = 0;
 
 	void async_packet(rpc_client_basebase* client);
+	void set_future_value() {
+		if (promise) {
+			if (rpc_ret_exception == retv)
+				promise->set_exception(std::make_exception_ptr(
+					rpc_exception("exception in server function " + stub->m_name)));
+			else
+				promise->set_value(retv);
+		}
+	}
 };
 
 //! @brief 定义 client_packet 的回调函数
@@ -151,6 +164,7 @@ class client_packet_fun : public client_packet_base
 {
 public:
 	CallBackFunction on_ret;
+	client_packet_fun() : on_ret(NULL) {}
 };
 
 //! 实现 client_packet io
@@ -200,19 +214,24 @@ public:
 		Client* client = (Client*)(vpclient);
 		boost::mutex::scoped_lock lock(client->m_mutex_write);
 		this->seqid = client->next_sequence_id();
+		if (rpc_call_synch != this->how_call)
+			client->async_packet(this); // before the reply can be read
 		client->m_co_output.get()
 			<< var_size_t(this->seqid)
 			<< var_size_t(this->stub->m_callid)
 			<< var_size_t(this->how_call)
 			;
 		refs.dio_save(client->m_co_output);
-		client->m_co_output.flush();
+		if (rpc_call_synch == this->how_call || !client->in_batch())
+			client->m_co_output.flush();
 	}
 	void t_send_nm_args(rpc_client_basebase* vpclient, arglist_ref_t& refs) {
 		this->isbyid = false;
 		Client* client = (Client*)(vpclient);
 		boost::mutex::scoped_lock lock(client->m_mutex_write);
 		this->seqid = client->next_sequence_id();
+		if (rpc_call_synch != this->how_call)
+			client->async_packet(this); // before the reply can be read
 		client->m_co_output.get()
 			<< var_size_t(this->seqid)
 			<< (byte)(0)
@@ -220,7 +239,8 @@ public:
 			<< var_size_t(this->how_call)
 			;
 		refs.dio_save(client->m_co_output);
-		client->m_co_output.flush();
+		if (rpc_call_synch == this->how_call || !client->in_batch())
+			client->m_co_output.flush();
 	}
 };
 
@@ -247,6 +267,7 @@ protected:
 	boost::mutex     m_mutex_pendings;
 	unsigned	 m_minseqid;
 	unsigned	 m_sequence_id;
+	int          m_batch; // nest level of begin_batch, guarded by m_mutex_write
 	volatile int m_run;
 	std::vector<boost::thread*> m_threads;
 	IDuplexStream* m_duplex;
@@ -273,6 +294,26 @@ public:
 
 	virtual unsigned read_seqid() = 0;
 
+	//! flush the output stream, called with m_mutex_write locked
+	virtual void flush_output() = 0;
+
+	//! @brief async calls between begin_batch and the outermost end_batch are
+	//! not flushed one by one, they are sent together by end_batch(or when
+	//! the output buffer is full), sync calls always flush
+	void begin_batch();
+	void end_batch();
+	bool in_batch() const { return 0 != m_batch; }
+
+	class batch_scope {
+		DECLARE_NONE_COPYABLE_CLASS(batch_scope)
+		rpc_client_base* m_client;
+	public:
+		explicit batch_scope(rpc_client_base* client) : m_client(client) {
+			client->begin_batch();
+		}
+		~batch_scope() { m_client->end_batch(); }
+	};
+
 	void wait_pending_async();
 	void wait_async_return_once();
 	void wait_async_return();
@@ -365,6 +406,8 @@ public:
 		m_input >> seqid;
 		return seqid.t;
 	}
+	// @Override
+	void flush_output() { m_output.flush(); }
 
 	//! @brief 查询远程对象
 	//! 根据 Class 是 GlobaleScope, 还是 SessionScope, 自动决定如何查询
@@ -38,10 +38,9 @@ public:
 	void read_args(rpc_client_basebase* client) { return this->t_read_args(client, refs); }
 
 	virtual void on_return() {
-		assert(NULL != this->on_ret); // on_ret is a function pointer
-		rpc_client_basebase* client = refs.self->get_ext_ptr();
-		this->t_read_args(client, refs);
-		(refs.self.get()->*this->on_ret)(*this BOOST_PP_ENUM_TRAILING(ArgCount, PP_ArgListDeRef, refs.a));
+		if (this->on_ret) // on_ret is a function pointer
+			(refs.self.get()->*this->on_ret)(*this BOOST_PP_ENUM_TRAILING(ArgCount, PP_ArgListDeRef, refs.a));
+		this->set_future_value();
 	}
 };
 
@@ -69,10 +68,9 @@ public:
 	void send_nm_args(rpc_client_basebase* client) { return this->t_send_nm_args(client, *refs); }
 	void read_args(rpc_client_basebase* client) { return this->t_read_args(client, *refs); }
 	virtual void on_return() {
-		assert(NULL != this->on_ret); // on_ret is a function pointer
-		rpc_client_basebase* client = refs->self->get_ext_ptr();
-		this->t_read_args(client, *refs);
-		(refs->self.get()->*this->on_ret)(*this BOOST_PP_ENUM_TRAILING(ArgCount, PP_ArgListDeRef, refs->a));
+		if (this->on_ret) // on_ret is a function pointer
+			(refs->self.get()->*this->on_ret)(*this BOOST_PP_ENUM_TRAILING(ArgCount, PP_ArgListDeRef, refs->a));
+		this->set_future_value();
 	}
 };
 
@@ -122,11 +120,11 @@ public:
 		return this->t_read_args(client, refs);
 	}
 	virtual void on_return() {
-		assert(NULL != this->on_ret); // on_ret is a function pointer
-		arglist_ref_t refs(boost::mpl::true_(), vals);
-		rpc_client_basebase* client = vals.self->get_ext_ptr();
-		this->t_read_args(client, refs);
-		(refs.self.get()->*this->on_ret)(*this BOOST_PP_ENUM_TRAILING(ArgCount, PP_ArgListDeRef, refs.a));
+		if (this->on_ret) { // on_ret is a function pointer
+			arglist_ref_t refs(boost::mpl::true_(), vals);
+			(refs.self.get()->*this->on_ret)(*this BOOST_PP_ENUM_TRAILING(ArgCount, PP_ArgListDeRef, refs.a));
+		}
+		this->set_future_value();
 	}
 };
 
@@ -187,11 +185,10 @@ public:
 		p->on_ret = on_return;
 		packet->stub = this->m_meta;
 		packet->how_call = rpc_call_asynch_ordered;
-		if (m_self->stub->callid) // prefer by id
+		if (m_meta->m_callid) // prefer by id
 			m_meta->send_id_args(client, packet.get());
 		else // fall back to by name
 			m_meta->send_nm_args(client, packet.get());
-		packet->async_packet(client);
 	}
 	void async_byname(BOOST_PP_ENUM(ArgCount, ArgDeclare, BOOST_PP_EMPTY())) {
 		arglist_ref_t args(m_self BOOST_PP_ENUM_TRAILING_PARAMS(ArgCount, a));
@@ -203,7 +200,26 @@ public:
 		packet->stub = this->m_meta;
 		packet->how_call = rpc_call_asynch_ordered;
 		m_meta->send_nm_args(client, packet.get());
-		packet->async_packet(client);
+	}
+
+	//! @brief args are referenced, not copied
+	//! in args are sent before return, out and inout args are written when
+	//! the reply is read by start_async threads or wait_pending_async, they
+	//! must be alive until the future is ready. The call is sent as
+	//! rpc_call_asynch_noorder, server may run it on its worker pool
+	std::future<rpc_ret_t> async_future(BOOST_PP_ENUM(ArgCount, ArgDeclare, BOOST_PP_EMPTY())) {
+		arglist_ref_t args(m_self BOOST_PP_ENUM_TRAILING_PARAMS(ArgCount, a));
+		rpc_client_basebase* client = m_self->get_ext_ptr();
+		boost::intrusive_ptr<client_packet_base> packet = m_meta->refpacket_create(&args);
+		packet->promise.reset(new std::promise<rpc_ret_t>());
+		std::future<rpc_ret_t> future = packet->promise->get_future();
+		packet->stub = this->m_meta;
+		packet->how_call = rpc_call_asynch_noorder;
+		if (m_meta->m_callid) // prefer by id
+			m_meta->send_id_args(client, packet.get());
+		else // fall back to by name
+			m_meta->send_nm_args(client, packet.get());
+		return future;
 	}
 
 	rpc_ret_t reap(BOOST_PP_ENUM(ArgCount, ArgDeclare, BOOST_PP_EMPTY())) {
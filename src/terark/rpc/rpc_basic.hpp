@@ -44,6 +44,10 @@ enum {
 
 typedef int32_t rpc_ret_t;
 
+//! retv of the reply when the server function threw an exception,
+//! out args of the reply are not meaningful, async_future throws rpc_exception
+const rpc_ret_t rpc_ret_exception = INT32_MIN;
+
 /**
  @brief 输入参数
  在 client 仅发送，不接收 @see client_io.hpp
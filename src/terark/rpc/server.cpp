@@ -2,6 +2,8 @@
 #include "server.hpp"
 #include <boost/bind.hpp>
 #include <boost/thread.hpp>
+#include <boost/function.hpp>
+#include <deque>
 #include <terark/io/IOException.hpp>
 #include <terark/inet/SocketStream.hpp>
 
@@ -22,6 +24,51 @@ public:
 	boost::mutex sessionScopeFactory;
 };
 
+//! shared by all sessions, runs rpc_call_asynch_noorder calls
+class rpc_server_base::WorkerPool {
+	boost::mutex     m_mutex;
+	boost::condition_variable m_cond;
+	std::deque<boost::function<void()> > m_queue;
+	boost::thread_group m_threads;
+	bool m_stop;
+
+	void run() {
+		for (;;) {
+			boost::function<void()> task;
+			{
+				boost::mutex::scoped_lock lock(m_mutex);
+				while (m_queue.empty() && !m_stop)
+					m_cond.wait(lock);
+				if (m_queue.empty())
+					return; // m_stop
+				task.swap(m_queue.front());
+				m_queue.pop_front();
+			}
+			task();
+		}
+	}
+public:
+	explicit WorkerPool(int nThreads) : m_stop(false) {
+		for (int i = 0; i < nThreads; ++i)
+			m_threads.create_thread(boost::bind(&WorkerPool::run, this));
+	}
+	~WorkerPool() {
+		{
+			boost::mutex::scoped_lock lock(m_mutex);
+			m_stop = true;
+		}
+		m_cond.notify_all();
+		m_threads.join_all();
+	}
+	void post(const boost::function<void()>& task) {
+		{
+			boost::mutex::scoped_lock lock(m_mutex);
+			m_queue.push_back(task);
+		}
+		m_cond.notify_one();
+	}
+};
+
 server_stub_i::~server_stub_i()
 {
 }
@@ -40,6 +87,8 @@ session_base::session_base(class rpc_server_base* owner)
 {
 //	m_sessionScopeObjects.add_ptr(this);
 	m_thread = NULL;
+	m_queued = 0;
+	m_batching = false;
 }
 
 session_base::~session_base()
@@ -54,22 +103,66 @@ void session_base::call(server_packet_base& header)
 	default:
 		assert(0);
 		break;
-	case rpc_call_asynch_ordered:
-	//	break;
-	case rpc_call_asynch_noorder: {
-		//	assert(!"implemented now");
-			header.stub->sync_call(this, &header);
-// 			QueueItem t;
-// 			t.args = stub->read_args(m_so_input);
-// 			t.stub = stub;
+	case rpc_call_asynch_noorder:
+		if (m_owner->m_pool) {
+			boost::intrusive_ptr<server_packet_base>
+				packet(header.stub->read_args(this, &header));
+			if (!packet)
+				throw rpc_exception("read args of async call failed");
+			{
+				boost::mutex::scoped_lock lock(m_mutex_write);
+				m_queued++;
+			}
+			m_owner->m_pool->post(boost::bind(&session_base::async_call,
+				boost::intrusive_ptr<session_base>(this), packet));
 		}
+		else
+			header.stub->sync_call(this, &header);
 		break;
+	case rpc_call_asynch_ordered: // run in session thread to keep the order
 	case rpc_call_synch:
 		header.stub->sync_call(this, &header);
 		break;
 	}
 }
 
+void session_base::async_call(boost::intrusive_ptr<server_packet_base> packet)
+{
+	{
+		boost::mutex::scoped_lock lock(m_mutex_write);
+		m_queued--;
+	}
+	try {
+		packet->invoke();
+	}
+	catch (const std::exception& exp) {
+		fprintf(stderr, "catch: %s, in async call %s\n", exp.what(), packet->stub->m_name.c_str());
+		packet->retv = rpc_ret_exception; // client must get a reply
+	}
+	try {
+		send_reply(packet.get());
+	}
+	catch (const std::exception& exp) {
+		// connection is broken, the session thread will close the session
+		fprintf(stderr, "catch: %s, reply of async call %s\n", exp.what(), packet->stub->m_name.c_str());
+	}
+}
+
+/**
+ @brief 写入调用结果
+
+ 一批请求(输入缓冲中已读入的请求)的结果在批次结束时一起 flush,
+ worker 线程完成的调用, 在该 session 没有排队中的调用时 flush,
+ 正在执行的慢调用不会推迟其它调用结果的 flush
+ */
+void session_base::send_reply(server_packet_base* packet)
+{
+	boost::mutex::scoped_lock lock(m_mutex_write);
+	packet->stub->send_args(this, packet);
+	if (!m_batching && 0 == m_queued)
+		flush_output();
+}
+
 void session_base::start()
 {
 	m_thread = new boost::thread(boost::bind(&session_base::run, this));
@@ -87,7 +180,16 @@ void session_base::run()
 		while (m_bRun) {
 			server_packet_base header;
 			this->read_header(header);
+			if (!m_batching) {
+				boost::mutex::scoped_lock lock(m_mutex_write);
+				m_batching = true;
+			}
 			call(header);
+			if (!input_buffered()) { // batch end, next read may block
+				boost::mutex::scoped_lock lock(m_mutex_write);
+				m_batching = false;
+				flush_output();
+			}
 		}
 	}
 	catch (const SocketException& exp) {
@@ -109,6 +211,7 @@ rpc_server_base::rpc_server_base(IAcceptor* acceptor)
 : m_acceptor(acceptor)
 {
 	m_mutex = new MyMutex;
+	m_pool = NULL;
 }
 rpc_server_base::~rpc_server_base()
 {
@@ -123,6 +226,7 @@ rpc_server_base::~rpc_server_base()
 		DEBUG_printf("%ld sessions is not still active\n", remainSessions);
 	//	thread::Thread::sleep(100);
 	}
+	delete m_pool;
 	m_globaleScopeObjects.destroy();
 	m_globaleScopeFactory.destroy();
 	m_sessionScopeFactory.destroy();
@@ -154,6 +258,13 @@ void rpc_server_base::removeSession(boost::intrusive_ptr<session_base> session)
 	m_sessionList.erase(session);
 }
 
+void rpc_server_base::set_worker_threads(int nThreads)
+{
+	assert(nThreads >= 0);
+	delete m_pool;
+	m_pool = nThreads > 0 ? new WorkerPool(nThreads) : NULL;
+}
+
 void rpc_server_base::start()
 {
 //	m_pipeline.setQueueSize(50);
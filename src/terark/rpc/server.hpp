@@ -10,6 +10,7 @@
 
 #include <boost/preprocessor/punctuation.hpp>
 #include <boost/preprocessor/repetition.hpp>
+#include <boost/thread/mutex.hpp>
 #include <stdio.h>
 
 #include <terark/num_to_str.hpp>
@@ -238,9 +239,13 @@ protected:
 	AccessByNameID<SessionScopePtr>  m_sessionScopeObjects;
 	ObjectFactory<SessionScope>*     m_sessionScopeFactory;
 	boost::thread*   m_thread;
+	boost::mutex     m_mutex_write;
+	size_t m_queued; // calls posted to worker pool but not started
+	bool m_batching; // replies are flushed at the end of a batch
 	volatile bool m_bRun;
 
 	void call(server_packet_base& header);
+	void async_call(boost::intrusive_ptr<server_packet_base> packet);
 
 	typedef session_base my_self_t;
 
@@ -249,6 +254,10 @@ protected:
 #include "rpc_interface.hpp"
 
 	virtual void read_header(server_packet_base& header) = 0;
+	//! has more received bytes in input buffer
+	virtual bool input_buffered() const = 0;
+	//! called with m_mutex_write locked
+	virtual void flush_output() = 0;
 	void run();
 
 public:
@@ -256,6 +265,9 @@ public:
 	virtual ~session_base();
 
 	void start();
+
+	//! write reply of packet, may be called by worker threads
+	void send_reply(server_packet_base* packet);
 };
 
 class TERARK_DLL_EXPORT rpc_server_base
@@ -270,6 +282,8 @@ protected:
 	ObjectFactory<SessionScope> m_sessionScopeFactory;
 	class MyMutex;
 	MyMutex* m_mutex;
+	class WorkerPool;
+	WorkerPool* m_pool;
 
 	IAcceptor*   m_acceptor;
 
@@ -292,6 +306,11 @@ public:
 	rpc_server_base(IAcceptor* acceptor = 0);
 	virtual ~rpc_server_base();
 
+	//! @brief rpc_call_asynch_noorder calls are run by a shared pool of
+	//! nThreads workers, so they may run concurrently, even in one session.
+	//! 0 (default) runs all calls in the session thread. Call before start()
+	void set_worker_threads(int nThreads);
+
 	void start();
 };
 
@@ -346,6 +365,11 @@ class rpc_server : public rpc_server_base
 		void read_header(server_packet_base& header) {
 			header.read_header(input, *m_stubTable);
 		}
+		bool input_buffered() const { return input.buf_remain_bytes() > 0; }
+		void flush_output() {
+			if (output.bufpos())
+				output.flush();
+		}
 	public:
 		so_input_t  m_so_input;
 		so_output_t m_so_output;
@@ -436,8 +460,14 @@ server_stub<Session, Function>::sync_call(session_base* vpsession, const server_
 	refs.dio_load(session->m_so_input);
 	packet.argvals.sync(refs);
 
-	packet.invoke_f(m_pfun);
-	do_send_args(session, &packet);
+	try {
+		packet.invoke_f(m_pfun);
+	}
+	catch (const std::exception& exp) {
+		fprintf(stderr, "catch: %s, in call %s\n", exp.what(), this->m_name.c_str());
+		packet.retv = rpc_ret_exception; // client must get a reply
+	}
+	session->send_reply(&packet);
 }
 
 template<class Session, class Function>
@@ -491,7 +521,7 @@ server_stub<Session, Function>::do_send_args(Session* session, packet_t* p) cons
 
 	if (!p->isbyid) // called by name, tell client the callid
 		session->m_so_output.get() << var_size_t(this->m_id);
-	session->m_so_output.flush();
+	// flush is done by session_base::send_reply
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////
@@ -32,6 +32,7 @@ void FiberPool::fiber_proc(int fiber_idx) {
     task.func(task.arg1, task.arg2, task.arg3);
     m_pending_cnt--;
   }
+  m_alive_cnt--;
 }
 
 void FiberPool::update_fiber_count(int count) {
@@ -45,6 +46,7 @@ void FiberPool::update_fiber_count(int count) {
   //using stack_t = default_stack;
     using stack_t = protected_fixedsize_stack;
     fiber(std::allocator_arg, stack_t(stack_size), &FiberPool::fiber_proc, this, i).detach();
+    m_alive_cnt++;
   }
   m_fiber_cnt = count;
 }
@@ -101,4 +103,11 @@ int FiberPool::wait() {
   return int(cnt);
 }
 
+void FiberPool::close() {
+  m_channel.close();
+  while (m_alive_cnt > 0) {
+    this->unchecked_yield();
+  }
+}
+
 } // namespace terark
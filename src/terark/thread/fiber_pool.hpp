@@ -27,12 +27,16 @@ public:
   bool try_push(const task_t& task);
   int wait(int timeout_us);
   int wait();
+  /// close the task channel and wait for all fibers to exit, fibers
+  /// blocked on an empty channel would block thread exit forever
+  void close();
   int fiber_cnt() const { return m_fiber_cnt; }
   int pending_cnt() const { return m_pending_cnt; }
 protected:
   void fiber_proc(int fiber_idx);
   int m_fiber_cnt = 0;
   int m_pending_cnt = 0;
+  int m_alive_cnt = 0;
   boost::fibers::buffered_channel<task_t> m_channel;
 };
 
@@ -1,4 +1,6 @@
 #include "crc.hpp"
+#include <terark/valvec.hpp>
+#include <thread>
 
 #if defined(__GNUC__) && __GNUC__ * 1000 + __GNUC_MINOR__ >= 4005 || defined(__clang__)
   #if defined(__amd64__) || defined(__amd64) || \
@@ -31,6 +33,46 @@ BadCrc32cException::~BadCrc32cException() {}
 
 BadCrc16cException::~BadCrc16cException() {}
 
+// CRC32C has no pre/post inversion here, it is linear on the register:
+//   crc(c, A+B) = crc(c, A) * x^(8*|B|) mod P  xor  crc(0, B)
+// polynomials are bit reflected, bit 31 is x^0
+static const uint32_t CRC32C_POLY_REFLECTED = 0x82F63B78;
+
+static constexpr uint32_t crc32c_multmodp(uint32_t a, uint32_t b) {
+    uint32_t m = uint32_t(1) << 31, p = 0;
+    for (;;) {
+        if (a & m) {
+            p ^= b;
+            if ((a & (m - 1)) == 0)
+                break;
+        }
+        m >>= 1;
+        b = b & 1 ? (b >> 1) ^ CRC32C_POLY_REFLECTED : b >> 1;
+    }
+    return p;
+}
+
+struct Crc32cX2nTable {
+    uint32_t x2n[32]; // x2n[k] = x^(2^k) mod P
+    constexpr Crc32cX2nTable() : x2n{} {
+        uint32_t p = uint32_t(1) << 30; // x^1
+        x2n[0] = p;
+        for (int k = 1; k < 32; k++)
+            x2n[k] = p = crc32c_multmodp(p, p);
+    }
+};
+static constexpr Crc32cX2nTable g_crc32c_x2n;
+
+// x^(8*len) mod P
+static constexpr uint32_t crc32c_x8nmodp(size_t len) {
+    uint32_t p = uint32_t(1) << 31; // x^0
+    for (unsigned k = 3; len; len >>= 1, k++) {
+        if (len & 1)
+            p = crc32c_multmodp(g_crc32c_x2n.x2n[k & 31], p);
+    }
+    return p;
+}
+
 /*
  * Copyright (c) 2015, Intel Corporation
  *
@@ -624,6 +666,50 @@ uint32_t crc32c_sb8_64_bit(uint32_t running_crc, const unsigned char* p_buf,
 #define CRC_FUNC _mm_crc32_u32
 #endif
 
+// crc32 instruction has 3 cycles latency and 1 cycle throughput, long
+// buffers are computed as 3 interleaved streams of Block bytes, the stream
+// crcs are merged by shifting over Block zero bytes via tables
+static const size_t CRC32C_LONG  = 8192;
+static const size_t CRC32C_SHORT = 256;
+
+struct Crc32cShiftTable {
+    uint32_t tab[4][256]; // tab[k][n] = (n << 8k) * x^(8*len) mod P
+    constexpr explicit Crc32cShiftTable(size_t len) : tab{} {
+        const uint32_t xp = crc32c_x8nmodp(len);
+        for (int k = 0; k < 4; k++)
+            for (uint32_t n = 0; n < 256; n++)
+                tab[k][n] = crc32c_multmodp(xp, n << (8 * k));
+    }
+};
+static constexpr Crc32cShiftTable g_crc32c_shift_long(CRC32C_LONG);
+static constexpr Crc32cShiftTable g_crc32c_shift_short(CRC32C_SHORT);
+
+static really_inline
+uint32_t crc32c_shift(const Crc32cShiftTable& t, uint32_t crc) {
+    return t.tab[0][crc & 0xFF] ^ t.tab[1][(crc >> 8) & 0xFF] ^
+           t.tab[2][(crc >> 16) & 0xFF] ^ t.tab[3][crc >> 24];
+}
+
+template<size_t Block>
+static really_inline
+uint32_t crc32c_sse42_3way(uint32_t crc0, const CRC_TYPE*& wp, size_t& words,
+                           const Crc32cShiftTable& shift) {
+    const size_t n = Block / CRC_WORD;
+    while (words >= 3 * n) {
+        uint32_t crc1 = 0, crc2 = 0;
+        for (size_t i = 0; i < n; i++) {
+            crc0 = (uint32_t)CRC_FUNC(crc0, wp[i]);
+            crc1 = (uint32_t)CRC_FUNC(crc1, wp[i + n]);
+            crc2 = (uint32_t)CRC_FUNC(crc2, wp[i + 2 * n]);
+        }
+        crc0 = crc32c_shift(shift, crc0) ^ crc1;
+        crc0 = crc32c_shift(shift, crc0) ^ crc2;
+        wp += 3 * n;
+        words -= 3 * n;
+    }
+    return crc0;
+}
+
 /*
  * Use the crc32 instruction from SSE4.2 to compute our checksum - same
  * polynomial as the above function.
@@ -651,13 +737,16 @@ uint32_t crc32c_sse42(uint32_t running_crc, const unsigned char* p_buf,
         crc = _mm_crc32_u8(crc, *p_buf++);
     }
 
-    // Main aligned loop, processes a word at a time.
+    // Main aligned loop, 3 streams for long input, then a word at a time.
 
-    for (size_t li = 0; li < running_length/CRC_WORD; li++) {
-        CRC_TYPE block = *(const CRC_TYPE *)p_buf;
-        crc = CRC_FUNC(crc, block);
-        p_buf += CRC_WORD;
+    const CRC_TYPE* wp = (const CRC_TYPE*)p_buf;
+    size_t words = running_length/CRC_WORD;
+    crc = crc32c_sse42_3way<CRC32C_LONG >(crc, wp, words, g_crc32c_shift_long);
+    crc = crc32c_sse42_3way<CRC32C_SHORT>(crc, wp, words, g_crc32c_shift_short);
+    for (size_t li = 0; li < words; li++) {
+        crc = (uint32_t)CRC_FUNC(crc, wp[li]);
     }
+    p_buf = (const unsigned char*)(wp + words);
 
     // Remaining bytes
 
@@ -692,6 +781,73 @@ uint32_t Crc32c_update(uint32_t inCrc32, const void *buf, size_t bufLen) {
     return crc;
 }
 
+void Crc32c_update_batch(size_t num, const void* const* bufs,
+                         const size_t* lens, uint32_t* crcs) {
+    size_t i = 0;
+#ifdef __SSE4_2__
+    // 3 records are interleaved on their common length to hide the latency
+    // of crc32 instruction, the rest of each record is a single stream
+    for (; i + 3 <= num; i += 3) {
+        auto p0 = (const unsigned char*)bufs[i+0];
+        auto p1 = (const unsigned char*)bufs[i+1];
+        auto p2 = (const unsigned char*)bufs[i+2];
+        size_t common = std::min(std::min(lens[i+0], lens[i+1]), lens[i+2]);
+        size_t words = common / CRC_WORD;
+        uint32_t c0 = 0, c1 = 0, c2 = 0;
+        for (size_t j = 0; j < words; j++) {
+            c0 = (uint32_t)CRC_FUNC(c0, unaligned_load<CRC_TYPE>(p0, j));
+            c1 = (uint32_t)CRC_FUNC(c1, unaligned_load<CRC_TYPE>(p1, j));
+            c2 = (uint32_t)CRC_FUNC(c2, unaligned_load<CRC_TYPE>(p2, j));
+        }
+        size_t done = words * CRC_WORD;
+        crcs[i+0] = crc32c_sse42(c0, p0 + done, lens[i+0] - done);
+        crcs[i+1] = crc32c_sse42(c1, p1 + done, lens[i+1] - done);
+        crcs[i+2] = crc32c_sse42(c2, p2 + done, lens[i+2] - done);
+    }
+#endif
+    for (; i < num; i++) {
+        crcs[i] = Crc32c_update(0, bufs[i], lens[i]);
+    }
+#ifdef VERIFY_ASSERTION
+    for (i = 0; i < num; i++)
+        assert(crcs[i] == crc32c(0, (const unsigned char*)bufs[i], lens[i]));
+#endif
+}
+
+uint32_t Crc32c_combine(uint32_t crc1, uint32_t crc2, size_t len2) {
+    return crc32c_multmodp(crc32c_x8nmodp(len2), crc1) ^ crc2;
+}
+
+uint32_t Crc32c_update_parallel(uint32_t inCrc32, const void* buf, size_t bufLen,
+                                size_t threads, size_t minChunk) {
+    minChunk = std::max<size_t>(minChunk, 64 * 1024);
+    threads = std::min(threads, bufLen / minChunk);
+    if (threads <= 1) {
+        return Crc32c_update(inCrc32, buf, bufLen);
+    }
+    const size_t chunk = (bufLen + threads - 1) / threads;
+    valvec<uint32_t> crcs(threads);
+    valvec<std::thread> thr(threads - 1, valvec_reserve());
+    auto calc = [&](size_t i) {
+        size_t pos = chunk * i;
+        size_t len = std::min(chunk, bufLen - pos);
+        crcs[i] = Crc32c_update(0, (const byte_t*)buf + pos, len);
+    };
+    for (size_t i = 1; i < threads; i++) {
+        thr.unchecked_emplace_back(calc, i);
+    }
+    calc(0);
+    for (auto& t : thr) {
+        t.join();
+    }
+    uint32_t crc = Crc32c_combine(inCrc32, crcs[0], chunk);
+    for (size_t i = 1; i < threads; i++) {
+        size_t len = std::min(chunk, bufLen - chunk * i);
+        crc = Crc32c_combine(crc, crcs[i], len);
+    }
+    return crc;
+}
+
 /* CRC16 implementation according to CCITT standards.
  *
  * Note by @antirez: this is actually the XMODEM CRC 16 algorithm, using the
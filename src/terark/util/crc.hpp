@@ -7,6 +7,23 @@ namespace terark {
 TERARK_DLL_EXPORT
 uint32_t Crc32c_update(uint32_t inCrc32, const void *buf, size_t bufLen);
 
+/// crcs[i] = Crc32c_update(0, bufs[i], lens[i]), for many small records,
+/// such as per record checksums, 3 records are computed interleaved
+TERARK_DLL_EXPORT
+void Crc32c_update_batch(size_t num, const void* const* bufs,
+                         const size_t* lens, uint32_t* crcs);
+
+/// crc of A+B from crc1 = crc of A and crc2 = Crc32c_update(0, B, len2)
+TERARK_DLL_EXPORT
+uint32_t Crc32c_combine(uint32_t crc1, uint32_t crc2, size_t len2);
+
+/// same as Crc32c_update, buf is split into up to `threads` chunks of at
+/// least minChunk bytes, chunks are computed by threads and are combined,
+/// page faults of cold mmap memory are also parallelized
+TERARK_DLL_EXPORT
+uint32_t Crc32c_update_parallel(uint32_t inCrc32, const void *buf, size_t bufLen,
+                                size_t threads, size_t minChunk = 4 << 20);
+
 TERARK_DLL_EXPORT
 uint16_t Crc16c_update(uint16_t inCrc16, const void *buf, size_t bufLen);
 
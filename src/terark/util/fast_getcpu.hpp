@@ -1,3 +1,4 @@
+#pragma once
 #include <terark/config.hpp>
 
 #if defined(__linux__) && (defined(__amd64__) || defined(__amd64) || \
@@ -24,15 +25,34 @@ terark_forceinline unsigned int fast_getcpu(void) {
     // unsigned node = p >> 12;
     return p & VGETCPU_CPU_MASK;
 }
+/// numa node of current cpu, same trick as fast_getcpu
+terark_forceinline unsigned int fast_getnode(void) {
+    const unsigned GDT_ENTRY_PER_CPU = 15;
+    const unsigned __PER_CPU_SEG = (GDT_ENTRY_PER_CPU * 8 + 3);
+    unsigned int p;
+    asm volatile ("lsl %1,%0" : "=r" (p) : "r" (__PER_CPU_SEG));
+    return p >> 12;
+}
 } // namespace terark
 
 #elif !defined(_MSC_VER)
 
 #include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
 namespace terark {
 terark_forceinline unsigned int fast_getcpu(void) {
     return sched_getcpu();
 }
+terark_forceinline unsigned int fast_getnode(void) {
+  #if defined(SYS_getcpu)
+    unsigned int cpu = 0, node = 0;
+    syscall(SYS_getcpu, &cpu, &node, NULL);
+    return node;
+  #else
+    return 0;
+  #endif
+}
 } // namespace terark
 
 #endif
@@ -1,5 +1,161 @@
 #include "hugepage.hpp"
+#include <terark/util/throw.hpp>
+#if defined(_MSC_VER)
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <Windows.h>
+#else
+	#include <dirent.h>
+	#include <unistd.h>
+	#include <sys/syscall.h>
+#endif
 
 namespace terark {
 
+#if defined(_MSC_VER)
+
+TERARK_DLL_EXPORT size_t numa_node_num() {
+	ULONG highest = 0;
+	if (GetNumaHighestNodeNumber(&highest))
+		return highest + 1;
+	return 1;
+}
+
+TERARK_DLL_EXPORT void* hugepage_alloc(size_t bytes, int numa_node, bool) {
+	void* mem;
+	if (numa_node >= 0)
+		mem = VirtualAllocExNuma(GetCurrentProcess(), NULL, bytes,
+				MEM_RESERVE|MEM_COMMIT, PAGE_READWRITE, DWORD(numa_node));
+	else
+		mem = VirtualAlloc(NULL, bytes, MEM_RESERVE|MEM_COMMIT, PAGE_READWRITE);
+	TERARK_VERIFY_F(NULL != mem, "VirtualAlloc(%zd, node = %d) : ErrCode = %zd\n",
+		bytes, numa_node, (size_t)GetLastError());
+	return mem;
+}
+
+TERARK_DLL_EXPORT void hugepage_free(void* mem, size_t) {
+	VirtualFree(mem, 0, MEM_RELEASE);
+}
+
+TERARK_DLL_EXPORT void* vm_reserve(size_t bytes) {
+	void* mem = VirtualAlloc(NULL, bytes, MEM_RESERVE, PAGE_NOACCESS);
+	TERARK_VERIFY_F(NULL != mem, "VirtualAlloc(%zd, MEM_RESERVE) : ErrCode = %zd\n",
+		bytes, (size_t)GetLastError());
+	return mem;
+}
+
+TERARK_DLL_EXPORT bool vm_commit(void* mem, size_t bytes) {
+	return NULL != VirtualAlloc(mem, bytes, MEM_COMMIT, PAGE_READWRITE);
+}
+
+TERARK_DLL_EXPORT void vm_release(void* mem, size_t) {
+	VirtualFree(mem, 0, MEM_RELEASE);
+}
+
+#else
+
+static size_t detect_numa_node_num() {
+	DIR* dir = opendir("/sys/devices/system/node");
+	if (NULL == dir) {
+		return 1;
+	}
+	size_t num = 0;
+	while (struct dirent* ent = readdir(dir)) {
+		if (strncmp(ent->d_name, "node", 4) == 0 && isdigit(ent->d_name[4]))
+			num++;
+	}
+	closedir(dir);
+	return std::max<size_t>(num, 1);
+}
+
+TERARK_DLL_EXPORT size_t numa_node_num() {
+	static const size_t num = detect_numa_node_num();
+	return num;
+}
+
+// avoid dependency on libnuma, values are same as <numaif.h>
+static const int TERARK_MPOL_PREFERRED = 1;
+
+TERARK_DLL_EXPORT void* hugepage_alloc(size_t bytes, int numa_node, bool hugetlb) {
+	TERARK_VERIFY_F(bytes % hugepage_size == 0, "bytes = %zd", bytes);
+	byte_t* mem = (byte_t*)MAP_FAILED;
+  #if defined(MAP_HUGETLB)
+	if (hugetlb) {
+		mem = (byte_t*)mmap(NULL, bytes, PROT_READ|PROT_WRITE,
+				MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+		if (MAP_FAILED == mem) {
+			fprintf(stderr, "WARN: %s: mmap(MAP_HUGETLB, size=%zd) = %s, fallback\n",
+				BOOST_CURRENT_FUNCTION, bytes, strerror(errno));
+		}
+	}
+  #else
+	TERARK_UNUSED_VAR(hugetlb);
+  #endif
+	if (MAP_FAILED == mem) {
+		// over alloc hugepage_size for alignment, then trim head and tail
+		size_t maplen = bytes + hugepage_size;
+		byte_t* base = (byte_t*)mmap(NULL, maplen, PROT_READ|PROT_WRITE,
+				MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+		TERARK_VERIFY_F(MAP_FAILED != base,
+			"mmap(size = %zd) = %s\n", maplen, strerror(errno));
+		mem = (byte_t*)align_up(size_t(base), hugepage_size);
+		if (mem != base)
+			munmap(base, mem - base);
+		if (base + maplen != mem + bytes)
+			munmap(mem + bytes, base + maplen - (mem + bytes));
+	  #if defined(MADV_HUGEPAGE)
+		if (madvise(mem, bytes, MADV_HUGEPAGE) < 0) {
+			fprintf(stderr, "WARN: %s: madvise(MADV_HUGEPAGE, size=%zd) = %s\n",
+				BOOST_CURRENT_FUNCTION, bytes, strerror(errno));
+		}
+	  #endif
+	}
+  #if defined(SYS_mbind)
+	if (numa_node >= 0 && numa_node_num() > 1) {
+		unsigned long nodemask[4] = {0};
+		const size_t maxnode = sizeof(nodemask) * 8;
+		if (size_t(numa_node) < maxnode) {
+			nodemask[numa_node / 64] = 1UL << (numa_node % 64);
+			// must be called before any page is touched
+			if (syscall(SYS_mbind, mem, bytes, TERARK_MPOL_PREFERRED,
+						nodemask, maxnode, 0) < 0) {
+				fprintf(stderr, "WARN: %s: mbind(node=%d, size=%zd) = %s\n",
+					BOOST_CURRENT_FUNCTION, numa_node, bytes, strerror(errno));
+			}
+		}
+	}
+  #else
+	TERARK_UNUSED_VAR(numa_node);
+  #endif
+	return mem;
+}
+
+TERARK_DLL_EXPORT void hugepage_free(void* mem, size_t bytes) {
+	munmap(mem, bytes);
+}
+
+TERARK_DLL_EXPORT void* vm_reserve(size_t bytes) {
+	// PROT_NONE + MAP_NORESERVE is not accounted for overcommit
+	void* mem = mmap(NULL, bytes, PROT_NONE,
+			MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+	TERARK_VERIFY_F(MAP_FAILED != mem,
+		"mmap(PROT_NONE, size = %zd) = %s\n", bytes, strerror(errno));
+	return mem;
+}
+
+TERARK_DLL_EXPORT bool vm_commit(void* mem, size_t bytes) {
+	if (mprotect(mem, bytes, PROT_READ|PROT_WRITE) != 0) {
+		fprintf(stderr, "WARN: %s: mprotect(%p, %zd, RW) = %s\n",
+			BOOST_CURRENT_FUNCTION, mem, bytes, strerror(errno));
+		return false;
+	}
+	return true;
+}
+
+TERARK_DLL_EXPORT void vm_release(void* mem, size_t bytes) {
+	munmap(mem, bytes);
+}
+
+#endif
+
 } // namespace terark
@@ -12,6 +12,24 @@ namespace terark {
 
 static const size_t hugepage_size = size_t(2) << 20;
 
+/// number of numa nodes, 1 if the system is not numa or can not be detected
+TERARK_DLL_EXPORT size_t numa_node_num();
+
+/// anonymous memory, aligned to hugepage_size, pages are preferred to be
+/// allocated on numa_node(no binding if numa_node < 0), use MAP_HUGETLB if
+/// hugetlb is true and hugetlbfs pages are available, else MADV_HUGEPAGE.
+/// the memory must be freed by hugepage_free(mem, bytes)
+TERARK_DLL_EXPORT void* hugepage_alloc(size_t bytes, int numa_node, bool hugetlb);
+TERARK_DLL_EXPORT void  hugepage_free(void* mem, size_t bytes);
+
+/// reserve address space only, no memory is committed, mem is inaccessible
+/// until it is committed by vm_commit, freed by vm_release(mem, bytes)
+TERARK_DLL_EXPORT void* vm_reserve(size_t bytes);
+/// commit a sub range of vm_reserve'd space, it is idempotent
+/// @returns false on fail, such as out of memory
+TERARK_DLL_EXPORT bool  vm_commit(void* mem, size_t bytes);
+TERARK_DLL_EXPORT void  vm_release(void* mem, size_t bytes);
+
 template<class T>
 void use_hugepage_advise(valvec<T>* vec) {
 #if defined(_MSC_VER) || !defined(MADV_HUGEPAGE)
@@ -6,6 +6,8 @@
 #include <string.h>
 #include <stdexcept>
 #include <thread>
+#include <atomic>
+#include <errno.h>
 
 #ifdef _MSC_VER
 	#define NOMINMAX
@@ -275,6 +277,105 @@ void  mmap_close(void* base, size_t size, intptr_t fd) {
 #endif
 }
 
+#if !defined(_MSC_VER)
+static size_t g_page_size = (size_t)sysconf(_SC_PAGESIZE);
+
+// MADV_COLD is since linux 5.4, it is probed once on an anonymous page
+static int probe_drop_advice() {
+#if defined(MADV_COLD)
+	void* p = ::mmap(NULL, g_page_size, PROT_READ|PROT_WRITE,
+					 MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+	if (MAP_FAILED != p) {
+		int ret = ::madvise(p, g_page_size, MADV_COLD);
+		::munmap(p, g_page_size);
+		if (0 == ret)
+			return MADV_COLD;
+	}
+#endif
+	return MADV_DONTNEED;
+}
+static const int g_drop_advice = probe_drop_advice();
+
+// [beg, end) is shrinked to page boundary
+static void madvise_range(const byte_t* beg, const byte_t* end, int advice) {
+	byte_t* lo = (byte_t*)align_up(size_t(beg), g_page_size);
+	byte_t* hi = (byte_t*)align_down(size_t(end), g_page_size);
+	if (lo < hi && ::madvise(lo, hi - lo, advice) < 0) {
+		// EINVAL of MADV_COLD is also for locked pages in the range, so
+		// DONTNEED is only for this call, it fails on locked pages too
+		if (EINVAL == errno && MADV_DONTNEED != advice)
+			::madvise(lo, hi - lo, MADV_DONTNEED);
+	}
+}
+#endif
+
+int MmapSeqAdvise::drop_advice() {
+#if defined(_MSC_VER)
+	return 0;
+#else
+	return g_drop_advice;
+#endif
+}
+
+MmapSeqAdvise::MmapSeqAdvise(const void* beg, const void* end,
+							 size_t window, bool drop_behind) {
+	TERARK_VERIFY_LE(size_t(beg), size_t(end));
+	m_beg = m_ahead = m_behind = m_next = m_cursor = (const byte_t*)beg;
+	m_end = (const byte_t*)end;
+	m_window = std::max(window, size_t(1) << 20);
+	m_drop_behind = drop_behind;
+#if !defined(_MSC_VER)
+	byte_t* lo = (byte_t*)align_down(size_t(beg), g_page_size);
+	if (lo < m_end)
+		::madvise(lo, m_end - lo, MADV_SEQUENTIAL);
+#endif
+	advance_slow(m_beg);
+}
+
+MmapSeqAdvise::~MmapSeqAdvise() {
+	finish();
+}
+
+void MmapSeqAdvise::advance_slow(const byte_t* cursor) {
+	cursor = std::min(cursor, m_end);
+	m_cursor = cursor;
+	m_next = std::min(cursor + m_window / 4, m_end);
+#if !defined(_MSC_VER)
+	const byte_t* ahead = size_t(m_end - cursor) > m_window ? cursor + m_window : m_end;
+	if (ahead > m_ahead) {
+		byte_t* lo = (byte_t*)align_down(size_t(std::max(m_ahead, cursor)), g_page_size);
+		::madvise(lo, ahead - lo, MADV_WILLNEED);
+		m_ahead = ahead;
+	}
+	if (m_drop_behind && cursor > m_behind) {
+		madvise_range(m_behind, cursor, g_drop_advice);
+		m_behind = std::max(m_behind, (const byte_t*)align_down(size_t(cursor), g_page_size));
+	}
+#endif
+}
+
+void MmapSeqAdvise::finish() {
+	if (NULL == m_beg)
+		return;
+#if !defined(_MSC_VER)
+	if (m_drop_behind && m_cursor > m_behind)
+		madvise_range(m_behind, m_cursor, g_drop_advice);
+	byte_t* lo = (byte_t*)align_down(size_t(m_beg), g_page_size);
+	if (lo < m_end)
+		::madvise(lo, m_end - lo, MADV_NORMAL);
+#endif
+	m_beg = NULL;
+	m_next = (const byte_t*)(-1); // advance() will be a no-op
+}
+
+void MmapWholeFile::advise_sequential() const {
+#if !defined(_MSC_VER)
+	if (base && ::madvise(base, size, MADV_SEQUENTIAL) < 0) {
+		fprintf(stderr, "WARN: MmapWholeFile: madvise(SEQUENTIAL) = %s\n", strerror(errno));
+	}
+#endif
+}
+
 static byte_t* adjust_bondary(byte_t* ptr, byte_t* end) {
 #define isnewline(c) ('\n' == c || '\r' == c)
     while (ptr < end && !isnewline(*ptr)) ++ptr;
@@ -311,5 +412,52 @@ void parallel_for_lines(byte_t* base, size_t size, size_t num_threads,
     }
 }
 
+#if !defined(_MSC_VER) && !defined(MADV_POPULATE_READ)
+	#define MADV_POPULATE_READ 22 // since linux 5.14
+#endif
+
+TERARK_DLL_EXPORT
+void mmap_populate(const void* base, size_t size, size_t num_threads) {
+#if defined(_MSC_VER)
+	WIN32_MEMORY_RANGE_ENTRY vm;
+	vm.VirtualAddress = (void*)base;
+	vm.NumberOfBytes  = size;
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &vm, 0);
+	TERARK_UNUSED_VAR(num_threads);
+#else
+	const size_t page = g_page_size;
+	const byte_t* lo = (const byte_t*)align_down(size_t(base), page);
+	const byte_t* hi = (const byte_t*)align_up(size_t(base) + size, page);
+	const size_t pages = (hi - lo) / page;
+	const size_t min_pages = (size_t(8) << 20) / page; // 8M per thread
+	num_threads = std::max<size_t>(std::min(num_threads, pages / min_pages), 1);
+	static std::atomic<bool> has_populate_read(true);
+	auto populate = [&](size_t tid) {
+		const byte_t* beg = lo + pages * tid / num_threads * page;
+		const byte_t* end = lo + pages * (tid + 1) / num_threads * page;
+		if (has_populate_read.load(std::memory_order_relaxed)) {
+			if (::madvise((void*)beg, end - beg, MADV_POPULATE_READ) == 0)
+				return;
+			if (EINVAL != errno) // EFAULT, EIO...: let page fault report it
+				return;
+			has_populate_read.store(false, std::memory_order_relaxed);
+		}
+		::madvise((void*)beg, end - beg, MADV_WILLNEED);
+		byte_t sum = 0;
+		for (const byte_t* p = beg; p < end; p += page)
+			sum += *(const volatile byte_t*)p; // fault in the page
+		TERARK_UNUSED_VAR(sum);
+	};
+	valvec<std::thread> thrVec(num_threads - 1, valvec_reserve());
+	for (size_t i = 1; i < num_threads; ++i) {
+		thrVec.unchecked_emplace_back(populate, i);
+	}
+	populate(0);
+	for (auto& t : thrVec) {
+		t.join();
+	}
+#endif
+}
+
 } // namespace terark
 
@@ -48,7 +48,7 @@ public:
 ZstdInputStream::ZstdInputStream(IInputStream* istream)
     : m_impl(new ZstdInputStream::Impl)
 {
-    assert(m_impl->istream != nullptr);
+    assert(istream != nullptr);
     m_impl->istream = istream;
     m_impl->dctx = ZSTD_createDCtx();
     CHECK(m_impl->dctx != NULL, "ZSTD_createDCtx() failed!");
@@ -200,9 +200,13 @@ void ZstdOutputStream::flush()
 void ZstdOutputStream::close()
 {
     assert(m_impl->ostream != nullptr);
-    m_impl->output = { m_impl->buffOut, m_impl->buffOutSize, 0 };
-    ZSTD_endStream(m_impl->cctx, &m_impl->output);
-    m_impl->ostream->write(m_impl->buffOut, m_impl->output.pos);
+    size_t remaining;
+    do { // endStream may not fit in one buffer
+        m_impl->output = { m_impl->buffOut, m_impl->buffOutSize, 0 };
+        remaining = ZSTD_endStream(m_impl->cctx, &m_impl->output);
+        CHECK_ZSTD(remaining);
+        m_impl->ostream->write(m_impl->buffOut, m_impl->output.pos);
+    } while (remaining != 0);
     m_impl->ostream = nullptr;
 }
 
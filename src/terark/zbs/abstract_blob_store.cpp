@@ -2,10 +2,12 @@
 #include "blob_store_file_header.hpp"
 #include <terark/fsa/fsa.hpp>
 #include <terark/io/FileStream.hpp>
+#include <terark/util/checksum_exception.hpp>
 #include <terark/util/mmap.hpp>
 #include <terark/hash_strmap.hpp>
 #include <terark/gold_hash_map.hpp>
 #include <terark/zbs/xxhash_helper.hpp>
+#include <thread>
 
 #if defined(_WIN32) || defined(_WIN64)
 	#define WIN32_LEAN_AND_MEAN
@@ -88,10 +90,71 @@ static bool RelaxedSizeCheck(ullong header, ullong mem) {
   return align_up(header, 64) == align_up(mem, 64) && header <= mem;
 }
 
+static bool g_deferChecksumVerify = getEnvBool("Terark_deferChecksumVerify", false);
+
+void AbstractBlobStore::set_defer_checksum_verify(bool val) {
+  g_deferChecksumVerify = val;
+}
+bool AbstractBlobStore::get_defer_checksum_verify() {
+  return g_deferChecksumVerify;
+}
+
 AbstractBlobStore*
 AbstractBlobStore::load_from_mmap(fstring fpath, bool mmapPopulate) {
   const bool writable = false;
-  MmapWholeFile fmmap(fpath, writable, mmapPopulate);
+  const size_t threads = getMmapLoadThreads();
+  const bool parallelPopulate = mmapPopulate && threads > 1;
+  const bool defer = g_deferChecksumVerify && isChecksumVerifyEnabled();
+  MmapWholeFile fmmap(fpath, writable, mmapPopulate && !parallelPopulate);
+  if (parallelPopulate && fmmap.base) {
+    mmap_populate(fmmap.base, fmmap.size, threads);
+  }
+  if (!defer) {
+    return load_from_mmap_imp(fpath, fmmap);
+  }
+  // map the file again now, the file may be deleted before the background
+  // thread is running. headers are checked now, data checksums are checked
+  // by the background thread on vmmap
+  std::shared_ptr<MmapWholeFile> vmmap(new MmapWholeFile(fpath));
+  bool old = deferDataChecksumInThread(true);
+  std::unique_ptr<AbstractBlobStore> store;
+  try {
+    store.reset(load_from_mmap_imp(fpath, fmmap));
+  }
+  catch (...) {
+    deferDataChecksumInThread(old);
+    throw;
+  }
+  deferDataChecksumInThread(old);
+  function<void(fstring)> verify;
+  fstring mem((const char*)vmmap->base, vmmap->size);
+  auto header = (const FileHeaderBase*)vmmap->base;
+  if (vmmap->size >= sizeof(FileHeaderBase) &&
+      g_getFactroyMap().exists(header->className)) {
+    verify = store->data_checksum_verifier();
+    mem.n = std::min<size_t>(header->fileSize, vmmap->size);
+  } else {
+    verify = [](fstring mem) { dfa_verify_file_crc32(mem.data(), mem.size()); };
+  }
+  if (!verify) {
+    return store.release();
+  }
+  auto p = std::make_shared<std::promise<void> >();
+  store->m_deferredVerify = p->get_future().share();
+  std::thread([p, vmmap, verify, mem]() {
+    try {
+      verify(mem);
+      p->set_value();
+    }
+    catch (...) {
+      p->set_exception(std::current_exception());
+    }
+  }).detach();
+  return store.release();
+}
+
+AbstractBlobStore*
+AbstractBlobStore::load_from_mmap_imp(fstring fpath, MmapWholeFile& fmmap) {
   if (fmmap.size < sizeof(FileHeaderBase)) {
     THROW_STD(invalid_argument,
       "AbstractBlobStore File: %s bad file header\n", fpath.c_str());
@@ -129,6 +192,26 @@ AbstractBlobStore::load_from_mmap(fstring fpath, bool mmapPopulate) {
   }
 }
 
+function<void(fstring)> AbstractBlobStore::data_checksum_verifier() const {
+  return nullptr;
+}
+
+void VerifyFileXXHash(fstring mem, uint64_t seed, const std::string& msg) {
+  auto header = (const FileHeaderBase*)mem.data();
+  if (size_t(mem.size()) < sizeof(FileHeaderBase) + sizeof(BlobStoreFileFooter) ||
+      header->fileSize > size_t(mem.size()) ||
+      header->fileSize < sizeof(FileHeaderBase) + sizeof(BlobStoreFileFooter)) {
+    THROW_STD(invalid_argument, "%s: bad file size = %zd, mem size = %zd",
+              msg.c_str(), size_t(header->fileSize), size_t(mem.size()));
+  }
+  auto base = (const byte_t*)mem.data();
+  auto& footer = ((const BlobStoreFileFooter*)(base + header->fileSize))[-1];
+  uint64_t hashVal = XXHash64(seed)(base, header->fileSize - sizeof(BlobStoreFileFooter));
+  if (hashVal != footer.fileXXHash) {
+    throw BadChecksumException(msg, footer.fileXXHash, hashVal);
+  }
+}
+
 AbstractBlobStore*
 AbstractBlobStore::load_from_user_memory(fstring dataMem) {
 	// TODO:
@@ -218,6 +301,26 @@ AbstractBlobStore::~AbstractBlobStore() {
     free(m_fpath_str);
 }
 
+AbstractBlobStore::ChecksumVerifyState
+AbstractBlobStore::checksum_verify_state() const {
+    if (!m_deferredVerify.valid())
+        return kChecksumVerified;
+    if (m_deferredVerify.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        return kChecksumVerifyPending;
+    try {
+        m_deferredVerify.get();
+        return kChecksumVerified;
+    }
+    catch (const std::exception&) {
+        return kChecksumVerifyFailed;
+    }
+}
+
+void AbstractBlobStore::wait_checksum_verify() const {
+    if (m_deferredVerify.valid())
+        m_deferredVerify.get();
+}
+
 void AbstractBlobStore::risk_swap(AbstractBlobStore& y) {
 	std::swap(m_numRecords   , y.m_numRecords   );
 	std::swap(m_unzipSize    , y.m_unzipSize    );
@@ -232,6 +335,7 @@ void AbstractBlobStore::risk_swap(AbstractBlobStore& y) {
 	std::swap(m_dictCloseType, y.m_dictCloseType);
 	std::swap(m_checksumLevel, y.m_checksumLevel);
 	std::swap(m_mmapBase     , y.m_mmapBase     );
+	std::swap(m_deferredVerify, y.m_deferredVerify);
     std::swap(m_get_record_append             , y.m_get_record_append             );
     std::swap(m_get_record_append_fiber_vm_prefetch, y.m_get_record_append_fiber_vm_prefetch);
     std::swap(m_get_record_append_CacheOffsets, y.m_get_record_append_CacheOffsets);
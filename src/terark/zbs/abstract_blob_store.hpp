@@ -1,11 +1,13 @@
 #pragma once
 #include "blob_store.hpp"
+#include <future>
 
 namespace terark {
 
 class SortableStrVec;
 class ZReorderMap;
 class LruReadonlyCache;
+class MmapWholeFile;
 
 class TERARK_DLL_EXPORT AbstractBlobStore : public BlobStore {
 public:
@@ -26,10 +28,18 @@ protected:
 	uint08_t        m_checksumLevel;
 	uint08_t        m_checksumType;
 	const struct FileHeaderBase* m_mmapBase;
+	std::shared_future<void> m_deferredVerify;
 
 	void risk_swap(AbstractBlobStore& y);
+	static AbstractBlobStore* load_from_mmap_imp(fstring fpath, MmapWholeFile&);
 
 public:
+	/// with mmapPopulate and getMmapLoadThreads() > 1, pages are populated by
+	/// these threads instead of MAP_POPULATE, whole file crc32c of DFA format
+	/// is also computed by these threads. if set_defer_checksum_verify(true),
+	/// headers are verified on load and data checksums are verified by a
+	/// background thread on another mapping of the file, the store is usable
+	/// before verified, see checksum_verify_state()
 	static AbstractBlobStore* load_from_mmap(fstring fpath, bool mmapPopulate);
 	static AbstractBlobStore* load_from_user_memory(fstring dataMem);
 	static AbstractBlobStore* load_from_user_memory(fstring dataMem, Dictionary dict);
@@ -44,6 +54,22 @@ public:
 
     uint08_t get_checksum_level() const { return m_checksumLevel; }
 
+	/// default is env Terark_deferChecksumVerify or false
+	static void set_defer_checksum_verify(bool);
+	static bool get_defer_checksum_verify();
+	enum ChecksumVerifyState : uint08_t {
+		kChecksumVerified, // verified on load, or verify is disabled
+		kChecksumVerifyPending,
+		kChecksumVerifyFailed,
+	};
+	ChecksumVerifyState checksum_verify_state() const;
+	/// wait for deferred checksum verify, rethrow its exception if failed
+	void wait_checksum_verify() const;
+	/// verifies data checksums(not header) of the file mem which is loaded
+	/// into this store, it does not ref this store, returns null if nothing
+	/// to verify
+	virtual function<void(fstring mem)> data_checksum_verifier() const;
+
 	AbstractBlobStore();
 	virtual ~AbstractBlobStore();
     virtual void reorder_zip_data(ZReorderMap& newToOld,
@@ -1,6 +1,8 @@
 #include "abstract_blob_store.hpp"
 #include "lru_page_cache.hpp"
+#include "blob_store_stat.hpp"
 #include <terark/util/function.hpp>
+#include <terark/util/profiling.hpp>
 #include <terark/thread/fiber_local.hpp>
 
 #if defined(_WIN32) || defined(_WIN64)
@@ -13,6 +15,7 @@
 #   endif
 #else
 #   include <unistd.h> // for usleep
+#   include <fcntl.h> // for posix_fadvise
 #endif
 
 namespace terark {
@@ -30,22 +33,38 @@ BlobStore::BlobStore() {
     m_pread_record_append = BlobStoreStaticCastPMF(pread_record_append_func_t,
         &BlobStore::pread_record_append_default_impl);
     m_get_zipped_size = NULL;
+    m_stat = NULL;
+    m_stat_get_record_append = NULL;
+    m_stat_get_record_append_CacheOffsets = NULL;
+    m_stat_fspread_record_append = NULL;
+    m_stat_pread_record_append = NULL;
 }
 
 BlobStore::~BlobStore() {
+    if (m_stat)
+        BlobStoreStat::detach(m_stat);
+}
+
+static bool g_enableStat = getEnvBool("BlobStore_enableStat", false);
+
+// store may be NULL
+static BlobStore* enable_stat_by_env(BlobStore* store) {
+    if (store && g_enableStat)
+        store->enable_stat(true);
+    return store;
 }
 
 BlobStore* BlobStore::load_from_mmap(fstring fpath, bool mmapPopulate) {
-    return AbstractBlobStore::load_from_mmap(fpath, mmapPopulate);
+    return enable_stat_by_env(AbstractBlobStore::load_from_mmap(fpath, mmapPopulate));
 }
 
 BlobStore* BlobStore::load_from_user_memory(fstring dataMem) {
-    return AbstractBlobStore::load_from_user_memory(dataMem);
+    return enable_stat_by_env(AbstractBlobStore::load_from_user_memory(dataMem));
 }
 
 BlobStore* BlobStore::load_from_user_memory(fstring dataMem,
                                             const Dictionary& dict) {
-    return AbstractBlobStore::load_from_user_memory(dataMem, dict);
+    return enable_stat_by_env(AbstractBlobStore::load_from_user_memory(dataMem, dict));
 }
 
 valvec<BlobStore::Block> BlobStore::get_meta_blocks() const {
@@ -200,6 +219,297 @@ const {
     }
 }
 
+///////////////////////////////////////////////////////////////////////////////
+
+void BlobStore::enable_stat(bool enable) {
+    if (enable == (NULL != m_stat)) {
+        return;
+    }
+    if (enable) {
+        const bool offsets_zipped = is_offsets_zipped();
+        m_stat = BlobStoreStat::attach(name());
+        m_stat_get_record_append = m_get_record_append;
+        m_stat_get_record_append_CacheOffsets = m_get_record_append_CacheOffsets;
+        m_stat_fspread_record_append = m_fspread_record_append;
+        m_stat_pread_record_append = m_pread_record_append;
+        if (m_get_record_append) {
+            m_get_record_append = BlobStoreStaticCastPMF(get_record_append_func_t,
+                &BlobStore::get_record_append_with_stat);
+            if (!offsets_zipped) { // keep is_offsets_zipped() unchanged
+                m_get_record_append_CacheOffsets = BlobStoreReinterpretCastPMF(
+                    get_record_append_CacheOffsets_func_t,
+                    &BlobStore::get_record_append_with_stat);
+            }
+        }
+        if (m_fspread_record_append) {
+            m_fspread_record_append = BlobStoreStaticCastPMF(fspread_record_append_func_t,
+                &BlobStore::fspread_record_append_with_stat);
+        }
+        m_pread_record_append = BlobStoreStaticCastPMF(pread_record_append_func_t,
+            &BlobStore::pread_record_append_with_stat);
+    }
+    else {
+        m_get_record_append_CacheOffsets = m_stat_get_record_append_CacheOffsets;
+        m_get_record_append = m_stat_get_record_append;
+        m_fspread_record_append = m_stat_fspread_record_append;
+        m_pread_record_append = m_stat_pread_record_append;
+        BlobStoreStat::detach(m_stat);
+        m_stat = NULL;
+    }
+}
+
+namespace {
+// time and bytes spent in the underlying pread_func
+struct StatPosRead {
+    BlobStore::pread_func_t fspread;
+    void*    lambda;
+    uint64_t ns = 0;
+    uint64_t bytes = 0;
+    static const byte_t*
+    read(void* vself, size_t offset, size_t len, valvec<byte_t>* rdbuf) {
+        auto self = static_cast<StatPosRead*>(vself);
+        qtime t0 = qtime::now();
+        auto ret = self->fspread(self->lambda, offset, len, rdbuf);
+        self->ns += (qtime::now() - t0).ns();
+        self->bytes += len;
+        return ret;
+    }
+};
+struct StatLruCachePosRead {
+    LruReadonlyCache::Buffer b;
+    LruReadonlyCache* cache;
+    intptr_t fi;
+    uint64_t hit = 0;
+    uint64_t miss = 0;
+
+    StatLruCachePosRead(valvec<byte_t>* rb) : b(rb) {
+    }
+    const byte_t*
+    operator()(size_t offset, size_t len, valvec<byte_t>*) {
+        auto ret = cache->pread(fi, offset, len, &b);
+        if (b.is_cache_hit())
+            hit++;
+        else
+            miss++;
+        return ret;
+    }
+};
+} // namespace
+
+void BlobStore::get_record_append_with_stat(size_t recID,
+                                            valvec<byte_t>* recData)
+const {
+    qtime  t0 = qtime::now();
+    size_t oldsize = recData->size();
+    BlobStoreInvokePMF(m_stat_get_record_append, recID, recData);
+    m_stat->add(BlobStoreStat::op_get, (qtime::now() - t0).ns(),
+                recData->size() - oldsize);
+}
+
+void BlobStore::fspread_record_append_with_stat(
+                    pread_func_t fspread,
+                    void* lambda,
+                    size_t baseOffset,
+                    size_t recID,
+                    valvec<byte_t>* recData,
+                    valvec<byte_t>* rdbuf)
+const {
+    qtime  t0 = qtime::now();
+    size_t oldsize = recData->size();
+    StatPosRead io;
+    io.fspread = fspread;
+    io.lambda  = lambda;
+    BlobStoreInvokePMF(m_stat_fspread_record_append, &StatPosRead::read, &io,
+                       baseOffset, recID, recData, rdbuf);
+    auto& c = m_stat->local();
+    BlobStoreStat::add(c, BlobStoreStat::op_io, io.ns, io.bytes);
+    BlobStoreStat::add(c, BlobStoreStat::op_fspread, (qtime::now() - t0).ns(),
+                       recData->size() - oldsize);
+}
+
+void BlobStore::pread_record_append_with_stat(
+                    LruReadonlyCache* cache,
+                    intptr_t fd,
+                    size_t baseOffset,
+                    size_t recID,
+                    valvec<byte_t>* recData,
+                    valvec<byte_t>* rdbuf)
+const {
+    qtime  t0 = qtime::now();
+    size_t oldsize = recData->size();
+    auto& c = m_stat->local();
+    if (NULL == m_stat_fspread_record_append) {
+        // can not separate io from unzip
+        BlobStoreInvokePMF(m_stat_pread_record_append, cache, fd, baseOffset,
+                           recID, recData, rdbuf);
+    }
+    else if (cache) { // fd is really fi for cache
+        StatLruCachePosRead cacheRead(rdbuf);
+        cacheRead.cache = cache;
+        cacheRead.fi    = fd;
+        StatPosRead io;
+        io.fspread = c_callback(cacheRead);
+        io.lambda  = &cacheRead;
+        BlobStoreInvokePMF(m_stat_fspread_record_append, &StatPosRead::read, &io,
+                           baseOffset, recID, recData, rdbuf);
+        BlobStoreStat::inc(c.cache_hit, cacheRead.hit);
+        BlobStoreStat::inc(c.cache_miss, cacheRead.miss);
+        BlobStoreStat::add(c, BlobStoreStat::op_io, io.ns, io.bytes);
+    }
+    else {
+        StatPosRead io;
+        io.fspread = &os_fspread;
+        io.lambda  = (void*)fd;
+        BlobStoreInvokePMF(m_stat_fspread_record_append, &StatPosRead::read, &io,
+                           baseOffset, recID, recData, rdbuf);
+        BlobStoreStat::add(c, BlobStoreStat::op_io, io.ns, io.bytes);
+    }
+    BlobStoreStat::add(c, BlobStoreStat::op_pread, (qtime::now() - t0).ns(),
+                       recData->size() - oldsize);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+BlobStoreReadAhead::BlobStoreReadAhead(const BlobStore* store) {
+    m_store = store;
+    min_window = std::max<size_t>(64*1024, store->min_prefetch_pages() * 4096);
+    max_window = 4*1024*1024;
+    no_fill_on_seq = false;
+    m_prefetch_cnt = 0;
+    m_prefetch_bytes = 0;
+    reset();
+}
+
+void BlobStoreReadAhead::reset() {
+    m_last_rec = size_t(-1);
+    m_last_end = 0;
+    m_seq_cnt = 0;
+    m_window = 0;
+    m_prefetched_end = 0;
+}
+
+// [lo, hi) is the file range read for recID
+// return true if [pfOffset, pfOffset + pfLen) should be prefetched
+bool BlobStoreReadAhead::on_access(size_t recID, size_t lo, size_t hi,
+                                   size_t* pfOffset, size_t* pfLen) {
+    if (lo >= hi) {
+        return false; // empty record, nothing was read
+    }
+    bool seq = recID > m_last_rec && recID - m_last_rec <= 2 && lo >= m_last_end;
+    if (size_t(-1) == m_last_rec || !seq) {
+        m_seq_cnt = 0;
+        m_window = 0;
+        m_prefetched_end = 0;
+    }
+    else if (++m_seq_cnt >= MinSeqCnt) {
+        if (0 == m_window) {
+            m_window = min_window;
+            m_prefetched_end = hi;
+        }
+        // issue next window when half of current window has been consumed
+        if (hi + m_window / 2 > m_prefetched_end) {
+            size_t beg = std::max(m_prefetched_end, hi);
+            *pfOffset = beg;
+            *pfLen = hi + m_window - beg;
+            m_prefetched_end = hi + m_window;
+            m_window = std::min(m_window * 2, max_window);
+            m_prefetch_cnt++;
+            m_prefetch_bytes += *pfLen;
+            m_last_rec = recID;
+            m_last_end = hi;
+            return true;
+        }
+    }
+    m_last_rec = recID;
+    m_last_end = hi;
+    return false;
+}
+
+// predicts is_sequential() after accessing recID, file range is unknown
+// before the read, thus it is checked by recID only
+bool BlobStoreReadAhead::is_next_sequential(size_t recID) const {
+    return m_seq_cnt + 1 >= MinSeqCnt && size_t(-1) != m_last_rec &&
+           recID > m_last_rec && recID - m_last_rec <= 2;
+}
+
+namespace {
+struct ReadAheadPosRead {
+    BlobStore::pread_func_t fspread;
+    void*  lambda;
+    size_t lo = size_t(-1);
+    size_t hi = 0;
+    static const byte_t*
+    read(void* vself, size_t offset, size_t len, valvec<byte_t>* rdbuf) {
+        auto self = static_cast<ReadAheadPosRead*>(vself);
+        self->lo = std::min(self->lo, offset);
+        self->hi = std::max(self->hi, offset + len);
+        return self->fspread(self->lambda, offset, len, rdbuf);
+    }
+};
+}
+
+static void fd_fadvise_willneed(intptr_t fd, size_t offset, size_t len) {
+#if defined(_MSC_VER)
+    TERARK_UNUSED_VAR(fd);
+    TERARK_UNUSED_VAR(offset);
+    TERARK_UNUSED_VAR(len);
+#else
+    // posix_fadvise WILLNEED initiates async readahead of the kernel
+    posix_fadvise(int(fd), offset, len, POSIX_FADV_WILLNEED);
+#endif
+}
+
+void BlobStoreReadAhead::pread_record_append(
+                    LruReadonlyCache* cache,
+                    intptr_t fi,
+                    size_t baseOffset,
+                    size_t recID,
+                    valvec<byte_t>* recData,
+                    valvec<byte_t>* rdbuf) {
+    if (!cache) { // fi is really fd
+        fspread_record_append(&BlobStore::os_fspread, (void*)fi, NULL,
+                              baseOffset, recID, recData, rdbuf);
+        return;
+    }
+    BlobStoreLruCachePosRead cacheRead(rdbuf);
+    cacheRead.cache = cache;
+    cacheRead.fi    = fi;
+    cacheRead.b.set_no_fill(no_fill_on_seq && is_next_sequential(recID));
+    ReadAheadPosRead track;
+    track.fspread = c_callback(cacheRead);
+    track.lambda  = &cacheRead;
+    m_store->fspread_record_append(&ReadAheadPosRead::read, &track,
+                                   baseOffset, recID, recData, rdbuf);
+    size_t pfOffset, pfLen;
+    if (on_access(recID, track.lo, track.hi, &pfOffset, &pfLen)) {
+        // read ahead into page cache is useless for O_DIRECT files
+        if (!cache->is_direct_io(fi))
+            fd_fadvise_willneed(cache->get_fd(fi), pfOffset, pfLen);
+    }
+}
+
+void BlobStoreReadAhead::fspread_record_append(
+                    BlobStore::pread_func_t fspread,
+                    void* lambda,
+                    prefetch_func_t prefetch,
+                    size_t baseOffset,
+                    size_t recID,
+                    valvec<byte_t>* recData,
+                    valvec<byte_t>* rdbuf) {
+    ReadAheadPosRead track;
+    track.fspread = fspread;
+    track.lambda  = lambda;
+    m_store->fspread_record_append(&ReadAheadPosRead::read, &track,
+                                   baseOffset, recID, recData, rdbuf);
+    size_t pfOffset, pfLen;
+    if (on_access(recID, track.lo, track.hi, &pfOffset, &pfLen)) {
+        if (prefetch)
+            prefetch(lambda, pfOffset, pfLen);
+        else if (&BlobStore::os_fspread == fspread)
+            fd_fadvise_willneed(intptr_t(lambda), pfOffset, pfLen);
+    }
+}
+
 
 } // namespace terark
 
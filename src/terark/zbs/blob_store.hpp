@@ -7,6 +7,7 @@
 namespace terark {
 
 class LruReadonlyCache;
+class BlobStoreStat;
 
 template<bool ZipOffset>
 struct BlobStoreRecBuffer;
@@ -185,6 +186,13 @@ public:
     size_t min_prefetch_pages() const { return m_min_prefetch_pages; }
     void set_min_prefetch_pages(size_t val) { m_min_prefetch_pages = (uint16_t)val; }
 
+    /// collect record fetch stats into BlobStoreStat of name(), record read
+    /// functions are replaced by wrappers, so there is no cost when disabled.
+    /// must not be called concurrently with record reads on this object.
+    /// enabled on load if env BlobStore_enableStat is true
+    void enable_stat(bool);
+    BlobStoreStat* get_stat() const { return m_stat; }
+
     virtual Dictionary get_dict() const = 0;
     virtual fstring get_mmap() const = 0;
     virtual void init_from_memory(fstring dataMem, Dictionary dict) = 0;
@@ -248,6 +256,75 @@ public:
 
     static const byte_t* os_fspread(void* lambda, size_t offset, size_t len,
                                     valvec<byte_t>* rdbuf);
+
+protected:
+    // original functions which are wrapped when stat is enabled
+    BlobStoreStat*               m_stat;
+    get_record_append_func_t     m_stat_get_record_append;
+    get_record_append_CacheOffsets_func_t m_stat_get_record_append_CacheOffsets;
+    fspread_record_append_func_t m_stat_fspread_record_append;
+    pread_record_append_func_t   m_stat_pread_record_append;
+
+    void get_record_append_with_stat(size_t recID, valvec<byte_t>* recData) const;
+    void fspread_record_append_with_stat(
+                        pread_func_t fspread,
+                        void* lambda,
+                        size_t baseOffset,
+                        size_t recID,
+                        valvec<byte_t>* recData,
+                        valvec<byte_t>* rdbuf) const;
+    void pread_record_append_with_stat(
+                        LruReadonlyCache* cache,
+                        intptr_t fd,
+                        size_t baseOffset,
+                        size_t recID,
+                        valvec<byte_t>* recData,
+                        valvec<byte_t>* rdbuf) const;
+};
+
+/// read ahead for an iterator which reads records by pread_record_append or
+/// fspread_record_append, one object per iterator. when recID is accessed in
+/// ascending order, the file range after current record is prefetched by
+/// posix_fadvise(WILLNEED) ahead of consumption, the window grows from
+/// min_window to max_window exponentially, random access resets the window
+class TERARK_DLL_EXPORT BlobStoreReadAhead {
+public:
+    typedef void (*prefetch_func_t)(void* lambda, size_t offset, size_t len);
+    explicit BlobStoreReadAhead(const BlobStore*);
+
+    void pread_record_append(LruReadonlyCache*, intptr_t fi,
+                             size_t baseOffset, size_t recID,
+                             valvec<byte_t>* recData,
+                             valvec<byte_t>* rdbuf);
+    /// prefetch(lambda, offset, len) is called for read ahead, it can be
+    /// NULL if fspread is BlobStore::os_fspread, else read ahead is disabled
+    void fspread_record_append(BlobStore::pread_func_t fspread, void* lambda,
+                               prefetch_func_t prefetch,
+                               size_t baseOffset, size_t recID,
+                               valvec<byte_t>* recData,
+                               valvec<byte_t>* rdbuf);
+    void reset();
+    bool is_sequential() const { return m_seq_cnt >= MinSeqCnt; }
+    size_t window() const { return m_window; }
+    size_t prefetch_cnt() const { return m_prefetch_cnt; }
+    size_t prefetch_bytes() const { return m_prefetch_bytes; }
+
+    size_t min_window; // default is max(64K, min_prefetch_pages * 4K)
+    size_t max_window; // default is 4M
+    bool   no_fill_on_seq; // use LruReadonlyCache no_fill when sequential
+
+private:
+    static const size_t MinSeqCnt = 2;
+    bool on_access(size_t recID, size_t lo, size_t hi, size_t* pfOffset, size_t* pfLen);
+    bool is_next_sequential(size_t recID) const;
+    const BlobStore* m_store;
+    size_t m_last_rec;
+    size_t m_last_end;
+    size_t m_seq_cnt;
+    size_t m_window;
+    size_t m_prefetched_end;
+    size_t m_prefetch_cnt;
+    size_t m_prefetch_bytes;
 };
 
 template<> struct BlobStoreRecBuffer<true> : BlobStore::CacheOffsets {
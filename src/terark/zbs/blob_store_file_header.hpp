@@ -11,6 +11,17 @@ namespace terark {
 #define My_bsr_size_t TERARK_IF_WORD_BITS_64(terark_bsr_u64, terark_bsr_u32)
 
 TERARK_DLL_EXPORT bool isChecksumVerifyEnabled();
+/// checksums of whole data(not header) are verified on load iff true, it is
+/// isChecksumVerifyEnabled() && !deferDataChecksumInThread(true) in thread
+TERARK_DLL_EXPORT bool isDataChecksumVerifyEnabled();
+/// for loading with deferred verify, returns old value
+TERARK_DLL_EXPORT bool deferDataChecksumInThread(bool val);
+/// threads for checksum verify and populate of big files on load, default
+/// is env Terark_mmapLoadThreads or 1, which keeps MAP_POPULATE
+TERARK_DLL_EXPORT size_t getMmapLoadThreads();
+TERARK_DLL_EXPORT void setMmapLoadThreads(size_t);
+/// whole file crc32c of DFA format(crc32cLevel >= 2), mem is the file
+TERARK_DLL_EXPORT void dfa_verify_file_crc32(const void* mem, size_t size);
 
 template<size_t Align, class File>
 void PadzeroForAlign(File& f, size_t offset) {
@@ -78,6 +89,10 @@ struct BlobStoreFileFooter {
 
 BOOST_STATIC_ASSERT(sizeof(BlobStoreFileFooter) == 64);
 
+/// whole file XXHash64 of checksumLevel 3, mem is the file which ends with
+/// BlobStoreFileFooter, throws BadChecksumException with msg on mismatch
+TERARK_DLL_EXPORT void VerifyFileXXHash(fstring mem, uint64_t seed, const std::string& msg);
+
 class AbstractBlobStore;
 
 class RegisterBlobStore {
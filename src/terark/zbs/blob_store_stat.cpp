@@ -0,0 +1,152 @@
+#include "blob_store_stat.hpp"
+#include <terark/util/throw.hpp>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace terark {
+
+void LatencyHistogram::merge(const LatencyHistogram& y) {
+    for (size_t i = 0; i < BucketNum; ++i)
+        cnt[i] += as_atomic(y.cnt[i]).load(std::memory_order_relaxed);
+    sum += as_atomic(y.sum).load(std::memory_order_relaxed);
+    max = std::max(max, as_atomic(y.max).load(std::memory_order_relaxed));
+}
+
+uint64_t LatencyHistogram::num() const {
+    uint64_t n = 0;
+    for (size_t i = 0; i < BucketNum; ++i) n += cnt[i];
+    return n;
+}
+
+uint64_t LatencyHistogram::percentile(double p) const {
+    uint64_t n = num();
+    if (0 == n)
+        return 0;
+    uint64_t target = std::max<uint64_t>(1, uint64_t(n * p / 100 + 0.5));
+    uint64_t accu = 0;
+    for (size_t i = 0; i < BucketNum; ++i) {
+        accu += cnt[i];
+        if (accu >= target) {
+            // highest value equivalent to bucket i
+            if (i + 1 == BucketNum)
+                return max;
+            return std::min(lower_of(i + 1) - 1, max);
+        }
+    }
+    return max;
+}
+
+void BlobStoreStat::Counters::merge(const Counters& y) {
+    for (size_t i = 0; i < op_num; ++i) {
+        calls[i] += as_atomic(y.calls[i]).load(std::memory_order_relaxed);
+        bytes[i] += as_atomic(y.bytes[i]).load(std::memory_order_relaxed);
+        latency[i].merge(y.latency[i]);
+    }
+    cache_hit  += as_atomic(y.cache_hit ).load(std::memory_order_relaxed);
+    cache_miss += as_atomic(y.cache_miss).load(std::memory_order_relaxed);
+}
+
+static std::mutex g_stat_mutex;
+static std::map<std::string, BlobStoreStat*>& stat_map() {
+    static std::map<std::string, BlobStoreStat*> map;
+    return map;
+}
+
+BlobStoreStat::BlobStoreStat(fstring className) {
+    for (auto& s : m_shards) s.c.reset();
+    size_t len = std::min(size_t(className.size()), sizeof(m_name) - 1);
+    memcpy(m_name, className.data(), len);
+    m_name[len] = '\0';
+    m_stores = 0;
+}
+
+BlobStoreStat* BlobStoreStat::attach(fstring className) {
+    std::lock_guard<std::mutex> lock(g_stat_mutex);
+    auto& p = stat_map()[className.str()];
+    if (!p)
+        p = new BlobStoreStat(className);
+    p->m_stores++;
+    return p;
+}
+
+void BlobStoreStat::detach(BlobStoreStat* stat) {
+    std::lock_guard<std::mutex> lock(g_stat_mutex);
+    TERARK_VERIFY_GT(stat->m_stores, 0);
+    if (0 == --stat->m_stores) {
+        stat_map().erase(stat->m_name);
+        delete stat;
+    }
+}
+
+valvec<BlobStoreStat*> BlobStoreStat::all() {
+    valvec<BlobStoreStat*> vec;
+    std::lock_guard<std::mutex> lock(g_stat_mutex);
+    for (auto& kv : stat_map())
+        vec.push_back(kv.second);
+    return vec;
+}
+
+size_t BlobStoreStat::tls_shard_id() {
+    static std::atomic<size_t> s_next{0};
+    static thread_local size_t id =
+        s_next.fetch_add(1, std::memory_order_relaxed) % ShardNum;
+    return id;
+}
+
+void BlobStoreStat::snapshot(Counters* snap) const {
+    snap->reset();
+    for (auto& s : m_shards)
+        snap->merge(s.c);
+}
+
+void BlobStoreStat::reset() {
+    // racing with concurrent add is benign, just some counts are lost
+    for (auto& s : m_shards) {
+        auto& c = s.c;
+        auto p = reinterpret_cast<uint64_t*>(&c);
+        for (size_t i = 0; i < sizeof(c) / sizeof(uint64_t); ++i)
+            as_atomic(p[i]).store(0, std::memory_order_relaxed);
+    }
+}
+
+void BlobStoreStat::print(FILE* fp) const {
+    static const char* op_names[op_num] = {
+        "get", "pread", "fspread", "io",
+    };
+    Counters c;
+    snapshot(&c);
+    fprintf(fp, "%s: stores = %zd\n", m_name, m_stores);
+    fprintf(fp, "| op      |        calls |          bytes |  avg us |  p50 us |  p99 us | p999 us |  max us |\n");
+    fprintf(fp, "| ------- | ------------:| --------------:| -------:| -------:| -------:| -------:| -------:|\n");
+    for (size_t i = 0; i < op_num; ++i) {
+        const auto& h = c.latency[i];
+        if (0 == c.calls[i])
+            continue;
+        fprintf(fp, "| %-7s | %12llu | %14llu | %7.2f | %7.2f | %7.2f | %7.2f | %7.2f |\n",
+                op_names[i], (ullong)c.calls[i], (ullong)c.bytes[i],
+                h.sum / 1e3 / c.calls[i],
+                h.percentile(50) / 1e3, h.percentile(99) / 1e3,
+                h.percentile(99.9) / 1e3, h.max / 1e3);
+    }
+    uint64_t pread_ns = c.latency[op_pread].sum + c.latency[op_fspread].sum;
+    uint64_t io_ns = c.latency[op_io].sum;
+    if (pread_ns) {
+        fprintf(fp, "pread: io time ratio = %6.3f, unzip time ratio = %6.3f\n",
+                io_ns / double(pread_ns), (pread_ns - std::min(io_ns, pread_ns)) / double(pread_ns));
+    }
+    uint64_t pages = c.cache_hit + c.cache_miss;
+    if (pages) {
+        fprintf(fp, "cache: hit = %llu, miss = %llu, hit ratio = %6.3f\n",
+                (ullong)c.cache_hit, (ullong)c.cache_miss, c.cache_hit / double(pages));
+    }
+}
+
+void BlobStoreStat::print_all(FILE* fp) {
+    // keep stats alive while printing
+    std::lock_guard<std::mutex> lock(g_stat_mutex);
+    for (auto& kv : stat_map())
+        kv.second->print(fp);
+}
+
+} // namespace terark
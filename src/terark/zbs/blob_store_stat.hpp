@@ -0,0 +1,117 @@
+#pragma once
+#include <terark/valvec.hpp>
+#include <terark/fstring.hpp>
+#include <terark/bitmanip.hpp>
+#include <terark/util/atomic.hpp>
+#include <stdio.h>
+
+namespace terark {
+
+/// log-linear latency histogram in nanoseconds, like HdrHistogram:
+/// each power of 2 range is split into SubBuckets linear buckets, so the
+/// relative error of percentiles is less than 1/SubBuckets
+struct TERARK_DLL_EXPORT LatencyHistogram {
+    static const size_t SubBits = 3;
+    static const size_t SubBuckets = size_t(1) << SubBits;
+    static const size_t MaxExp = 40; // 2^40 ns ~ 18 minutes, larger are clamped
+    static const size_t BucketNum = (MaxExp - SubBits + 2) * SubBuckets;
+
+    uint64_t cnt[BucketNum];
+    uint64_t sum; // in ns
+    uint64_t max; // in ns
+
+    static size_t index_of(uint64_t ns) {
+        if (ns < SubBuckets)
+            return size_t(ns);
+        size_t e = terark_bsr_u64(ns);
+        if (e > MaxExp)
+            return BucketNum - 1;
+        return (e - SubBits + 1) * SubBuckets + ((ns >> (e - SubBits)) & (SubBuckets-1));
+    }
+    static uint64_t lower_of(size_t idx) {
+        if (idx < SubBuckets)
+            return idx;
+        size_t e = idx / SubBuckets + SubBits - 1;
+        return (SubBuckets | (idx % SubBuckets)) << (e - SubBits);
+    }
+    void reset() { memset(this, 0, sizeof(*this)); }
+    void merge(const LatencyHistogram&);
+    uint64_t num() const;
+    /// @param p in [0, 100]
+    uint64_t percentile(double p) const;
+};
+
+/// record fetch stats of a BlobStore subclass, counters are sharded per
+/// thread and each shard is cache line aligned, thus the fast path has no
+/// contention. stores with stat enabled attach to the object of their class,
+/// it is unregistered and freed when the last store detaches
+class TERARK_DLL_EXPORT BlobStoreStat {
+public:
+    enum Op {
+        op_get,    ///< get_record_append
+        op_pread,  ///< pread_record_append
+        op_fspread,///< fspread_record_append
+        op_io,     ///< io part of pread/fspread: time spent in pread_func
+        op_num,
+    };
+    struct TERARK_DLL_EXPORT Counters {
+        uint64_t calls[op_num];
+        uint64_t bytes[op_num]; ///< record bytes for get/pread/fspread, read bytes for io
+        uint64_t cache_hit;     ///< LruReadonlyCache page hit
+        uint64_t cache_miss;
+        LatencyHistogram latency[op_num];
+
+        void reset() { memset(this, 0, sizeof(*this)); }
+        void merge(const Counters&);
+    };
+    static const size_t ShardNum = 32;
+
+    /// get or create the stat of className, and count the attached store
+    static BlobStoreStat* attach(fstring className);
+    /// the stat is freed if no store is attached
+    static void detach(BlobStoreStat*);
+    /// the stats are valid until their stores detach
+    static valvec<BlobStoreStat*> all();
+
+    const char* name() const { return m_name; }
+    size_t stores() const { return m_stores; }
+
+    /// merge all shards into *snap, it is not an atomic snapshot, but every
+    /// counter is read atomically
+    void snapshot(Counters* snap) const;
+    void reset();
+    void print(FILE*) const;
+    static void print_all(FILE*);
+
+    Counters& local() {
+        return m_shards[tls_shard_id()].c;
+    }
+    void add(Op op, uint64_t ns, uint64_t bytes) {
+        add(local(), op, ns, bytes);
+    }
+    static void add(Counters& c, Op op, uint64_t ns, uint64_t bytes) {
+        inc(c.calls[op], 1);
+        inc(c.bytes[op], bytes);
+        LatencyHistogram& h = c.latency[op];
+        inc(h.cnt[LatencyHistogram::index_of(ns)], 1);
+        inc(h.sum, ns);
+        if (ns > h.max)
+            as_atomic(h.max).store(ns, std::memory_order_relaxed);
+    }
+    static void inc(uint64_t& x, uint64_t val) {
+        // more than ShardNum threads may share one shard
+        as_atomic(x).fetch_add(val, std::memory_order_relaxed);
+    }
+
+private:
+    explicit BlobStoreStat(fstring className);
+    static size_t tls_shard_id();
+    struct alignas(64) Shard {
+        Counters c;
+    };
+    Shard m_shards[ShardNum];
+    char  m_name[64];
+    size_t m_stores; // guarded by registry mutex
+};
+
+} // namespace terark
@@ -10,7 +10,9 @@
 #include "xxhash_helper.hpp"
 #include "zip_reorder_map.hpp"
 #include "lru_page_cache.hpp"
+#include <terark/io/AsyncFileStream.hpp>
 #include <terark/io/FileStream.hpp>
+#include <terark/io/IOException.hpp>
 #include <terark/io/MemStream.hpp>
 #include <terark/io/IStreamWrapper.hpp>
 #include <terark/io/DataIO.hpp>
@@ -44,12 +46,13 @@
 #   define WIN32_LEAN_AND_MEAN
 #   define NOMINMAX
 #   include <Windows.h>
+#   include <io.h> // for dup
 #   if !defined(NDEBUG) && 0
 #       undef assert
 #       define assert(exp) ((exp) ? (void)0 : DebugBreak())
 #   endif
 #else
-#   include <unistd.h> // for usleep
+#   include <unistd.h> // for usleep, dup
 #endif
 
 namespace terark {
@@ -253,6 +256,7 @@ public:
     SeekableStreamWrapper<FileMemIO*> m_memStream;
     SeekableStreamWrapper<FileMemIO> m_memLengthStream;
 	FileStream  m_fp;
+    AsyncFileOutputStream m_asyncFp; // dup of m_fp, used by MultiThread
     FileStream  m_fpDelta;
 	std::string m_fpath;
     std::string m_fpathForLength;
@@ -313,6 +317,13 @@ public:
         assert(m_huffman_encoder == NULL);
 	}
 
+	void closeFile(size_t fileSize) {
+		if (m_asyncFp.isOpen())
+			m_asyncFp.close(); // throws errors of background writes
+		m_fp.chsize(fileSize);
+		m_fp.close();
+	}
+
 	void initWarn() {
 		m_sampleNumber = 0;
 		m_requestSampleBytes = 0;
@@ -1655,7 +1666,19 @@ void DictZipBlobStoreBuilder::prepare(size_t records, fstring fpath, size_t offs
         m_fp.seek(m_fpOffset);
     }
     m_fp.disbuf();
-    m_fpWriter.attach(&m_fp);
+    if (isMultiThread()) {
+        // zipped data is written by the serial pipeline step, write it in
+        // background, m_fp is kept for chsize
+        int fd = ::dup(fileno(m_fp.fp()));
+        if (fd < 0) {
+            throw IOException(errno, "DictZipBlobStoreBuilder::prepare: dup");
+        }
+        m_asyncFp.dopen(fd);
+        m_fpWriter.attach(&m_asyncFp);
+    }
+    else {
+        m_fpWriter.attach(&m_fp);
+    }
     TERARK_VERIFY(!m_fpDelta.isOpen());
     m_fpDelta.open(m_fpathForLength.c_str(), "wb+");
     m_fpDelta.disbuf();
@@ -2176,8 +2199,7 @@ void DictZipBlobStoreBuilder::finish(int flag) {
             m_fpWriter.flush_buffer();
             new(&store->m_zOffsets)SortedUintVec();
             if (!m_fpath.empty()) {
-                m_fp.chsize(finalSize);
-                m_fp.close();
+                closeFile(finalSize);
                 MmapWholeFile(m_fpath, true).swap(mmapStore);
                 store->m_zOffsets.risk_set_data(
                     (byte_t*)mmapStore.base + m_fpOffset + sizeof(FileHeader) + align_up(m_zipDataSize, 16),
@@ -2204,8 +2226,7 @@ void DictZipBlobStoreBuilder::finish(int flag) {
             m_fpWriter.flush_buffer();
             new(&store->m_offsets)UintVecMin0();
             if (!m_fpath.empty()) {
-                m_fp.chsize(finalSize);
-                m_fp.close();
+                closeFile(finalSize);
                 MmapWholeFile(m_fpath, true).swap(mmapStore);
                 store->m_offsets.risk_set_data(
                     (byte_t*)mmapStore.base + m_fpOffset + sizeof(FileHeader) + align_up(m_zipDataSize, 16),
@@ -2315,6 +2336,43 @@ void DictZipBlobStore::init_from_memory(fstring dataMem, Dictionary dict) {
     setDataMemory((byte*)dataMem.data(), dataMem.size());
 }
 
+// offsetsCRC and zipDataXXHash, which cover almost the whole file, the
+// header and entropy table are checked by setDataMemory
+static void
+DictZip_verifyData(const DictZipBlobStore::FileHeader* mmapBase, bool dictVerified) {
+	auto mem = (const byte_t*)(mmapBase + 1);
+	if (mmapBase->crc32cLevel >= 1 && dictVerified) {
+		// only check offsetsCRC iff dictCRC is verified
+		uint32_t offsetsCRC = Crc32c_update_parallel(0,
+			mem + mmapBase->ptrListBytes, mmapBase->offsetArrayBytes,
+			getMmapLoadThreads());
+		if (offsetsCRC != mmapBase->offsetsCRC) {
+			throw BadCrc32cException("DictZipBlobStore::offsetsCRC",
+				mmapBase->offsetsCRC, offsetsCRC);
+		}
+	}
+	if (mmapBase->crc32cLevel >= 3) {
+		auto foot = mmapBase->getFileFooter();
+		uint64_t computed = XXHash64(g_dzbsnark_seed)(mem, mmapBase->ptrListBytes);
+		uint64_t saved = foot->zipDataXXHash;
+		if (saved != computed) {
+			throw BadChecksumException("DictZipBlobStore::zipDataXXHash",
+				saved, computed);
+		}
+	}
+}
+
+function<void(fstring)> DictZipBlobStore::data_checksum_verifier() const {
+	bool dictVerified = m_dict_verified;
+	if (m_checksumLevel < 3 && !(m_checksumLevel >= 1 && dictVerified))
+		return nullptr;
+	return [dictVerified](fstring mem) {
+		auto mmapBase = (const FileHeader*)mem.data();
+		TERARK_VERIFY_EQ(mmapBase->fileSize, size_t(mem.size()));
+		DictZip_verifyData(mmapBase, dictVerified);
+	};
+}
+
 void DictZipBlobStore::setDataMemory(const void* base, size_t size) {
 	auto mmapBase = (const FileHeader*)base;
     m_mmapBase = mmapBase;
@@ -2360,14 +2418,9 @@ void DictZipBlobStore::setDataMemory(const void* base, size_t size) {
 			throw BadCrc32cException("DictZipBlobStore::headerCRC",
 				mmapBase->headerCRC, hCRC);
 		}
-		if (m_dict_verified) { // only check offsetsCRC iff dictCRC is verified
-            uint32_t offsetsCRC =
-                Crc32c_update(0, m_offsets.data(), m_offsets.mem_size());
-            if (offsetsCRC != mmapBase->offsetsCRC) {
-                throw BadCrc32cException("DictZipBlobStore::offsetsCRC",
-                    mmapBase->offsetsCRC, offsetsCRC);
-            }
-		}
+	}
+	if (isDataChecksumVerifyEnabled()) {
+		DictZip_verifyData(mmapBase, m_dict_verified);
 	}
 
 	m_entropyAlgo = Options::EntropyAlgo(mmapBase->entropyAlgo);
@@ -2430,16 +2483,6 @@ void DictZipBlobStore::setDataMemory(const void* base, size_t size) {
         }
 	}
 
-	if (m_checksumLevel >= 3 && isChecksumVerifyEnabled()) {
-		auto foot = mmapBase->getFileFooter();
-		uint64_t computed = XXHash64(g_dzbsnark_seed)(m_ptrList);
-		uint64_t saved = foot->zipDataXXHash;
-		if (saved != computed) {
-			throw BadChecksumException("DictZipBlobStore::zipDataXXHash",
-				saved, computed);
-		}
-	}
-
     m_gOffsetBits = My_bsr_size_t(m_strDict.size() - gMinLen) + 1;
     set_func_ptr();
 
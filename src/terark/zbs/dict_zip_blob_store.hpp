@@ -170,6 +170,7 @@ public:
 	void swap(DictZipBlobStore&);
 
     void init_from_memory(fstring dataMem, Dictionary dict) override;
+    function<void(fstring)> data_checksum_verifier() const override;
 
     void load_mmap(fstring fpath);
     void load_mmap_with_dict_memory(fstring fpath, Dictionary dict);
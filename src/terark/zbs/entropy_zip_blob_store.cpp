@@ -144,15 +144,9 @@ void EntropyZipBlobStore::init_from_memory(fstring dataMem, Dictionary/*dict*/)
     m_unzipSize = mmapBase->unzipSize;
     m_checksumLevel = mmapBase->checksumLevel;
     m_checksumType = mmapBase->checksumType;
-    if (m_checksumLevel == 3 && isChecksumVerifyEnabled()) {
-        XXHash64 hash(g_debsnark_seed);
-        hash.update(mmapBase, mmapBase->fileSize - sizeof(BlobStoreFileFooter));
-        const uint64_t hashVal = hash.digest();
-        auto &footer = ((const BlobStoreFileFooter*)((const byte_t*)(mmapBase) + mmapBase->fileSize))[-1];
-        if (hashVal != footer.fileXXHash) {
-            std::string msg = "EntropyZipBlobStore::load_mmap(\"" + get_fpath() + "\")";
-            throw BadChecksumException(msg, footer.fileXXHash, hashVal);
-        }
+    if (m_checksumLevel == 3 && isDataChecksumVerifyEnabled()) {
+        VerifyFileXXHash(fstring((const char*)mmapBase, mmapBase->fileSize), g_debsnark_seed,
+                         "EntropyZipBlobStore::load_mmap(\"" + get_fpath() + "\")");
     }
     m_content.risk_set_data((byte_t*)(mmapBase + 1), (mmapBase->contentBits + 7) / 8);
     m_table.risk_set_data(m_content.data() + m_content.size(), mmapBase->tableBytes);
@@ -214,6 +208,13 @@ void EntropyZipBlobStore::init_from_components(SortedUintVec&& offset,
     m_isUserMem = true;
 }
 
+function<void(fstring)> EntropyZipBlobStore::data_checksum_verifier() const {
+    if (m_checksumLevel != 3)
+        return nullptr;
+    std::string msg = "EntropyZipBlobStore::load_mmap(\"" + get_fpath() + "\")";
+    return [msg](fstring mem) { VerifyFileXXHash(mem, g_debsnark_seed, msg); };
+}
+
 void EntropyZipBlobStore::get_meta_blocks(valvec<Block>* blocks) const {
     blocks->erase_all();
     blocks->push_back({"offsets", {m_offsets.data(), (ptrdiff_t)m_offsets.mem_size()}});
@@ -41,6 +41,7 @@ public:
     void init_get_calls();
 
     void init_from_memory(fstring dataMem, Dictionary dict) override;
+    function<void(fstring)> data_checksum_verifier() const override;
     void init_from_components(SortedUintVec&& offset, valvec<byte_t>&& data,
                               valvec<byte_t>&& table, uint64_t raw_size);
     void get_meta_blocks(valvec<Block>* blocks) const override;
@@ -0,0 +1,519 @@
+#include "ext_sort.hpp"
+#include "ZstdStream.hpp"
+#include <terark/io/FileStream.hpp>
+#include <terark/io/var_int.hpp>
+#include <terark/set_op.hpp>
+#include <terark/replace_select_sort.hpp>
+#include <terark/util/sortable_strvec.hpp>
+#include <terark/util/tmpfile.hpp>
+#include <terark/util/profiling.hpp>
+#include <terark/util/throw.hpp>
+#include <future>
+#include <thread>
+#include <memory>
+#include <vector>
+#if defined(_MSC_VER)
+	#include <io.h>
+#else
+	#include <unistd.h>
+#endif
+
+namespace terark {
+
+const size_t ExternalSorter::MAX_REC_LEN = SortableStrVec::MAX_STR_LEN - 1;
+
+class ExternalSorter::RunFile {
+public:
+	AutoDeleteFile path;
+	uint64_t rawSize = 0; // bytes of framed records, before zstd
+	uint64_t fileSize = 0;
+	size_t   records = 0;
+	bool     zstd = false;
+};
+
+namespace {
+
+// guard of LoserTree, greater than any record
+static const char g_max_rec[1] = {0};
+static inline fstring max_rec() { return fstring(g_max_rec, g_max_rec); }
+
+struct RecLess {
+	bool operator()(fstring x, fstring y) const {
+		if (terark_unlikely(y.p == g_max_rec)) return x.p != g_max_rec;
+		if (terark_unlikely(x.p == g_max_rec)) return false;
+		int c = memcmp(x.p, y.p, std::min(x.n, y.n));
+		return c < 0 || (0 == c && x.n < y.n);
+	}
+};
+
+static void read_full(IInputStream* is, byte_t* buf, size_t len) {
+	size_t done = 0;
+	while (done < len) {
+		size_t n = is->read(buf + done, len - done);
+		if (0 == n) {
+			THROW_STD(runtime_error, "run file is truncated, expect %zd, got %zd",
+					  len, done);
+		}
+		done += n;
+	}
+}
+
+class RunWriter : boost::noncopyable {
+	ExternalSorter::RunFile* m_run;
+	FileStream m_fp;
+	std::unique_ptr<ZstdOutputStream> m_zstd;
+	valvec<byte_t> m_buf, m_back; // m_back is being written by m_io
+	std::future<void> m_io;
+	size_t m_bufSize;
+
+	void write_back() {
+		if (m_zstd)
+			m_zstd->write(m_back.data(), m_back.size());
+		else
+			m_fp.ensureWrite(m_back.data(), m_back.size());
+	}
+	void flush_async() {
+		if (m_io.valid())
+			m_io.get();
+		m_run->rawSize += m_buf.size();
+		m_buf.swap(m_back);
+		m_buf.risk_set_size(0);
+		m_io = std::async(std::launch::async, [this]{ write_back(); });
+	}
+public:
+	RunWriter(ExternalSorter::RunFile* run, size_t bufSize, int zstdLevel) {
+		m_run = run;
+		m_bufSize = bufSize;
+		m_fp.open(run->path.fpath, "wb");
+		m_fp.disbuf();
+		if (zstdLevel > 0) {
+			m_zstd.reset(new ZstdOutputStream(&m_fp));
+			m_zstd->setCLevel(zstdLevel);
+			run->zstd = true;
+		}
+		m_buf.reserve(bufSize);
+		m_back.reserve(bufSize);
+	}
+	~RunWriter() {
+		if (m_io.valid())
+			m_io.wait();
+	}
+	void append(fstring rec) {
+		if (m_buf.size() + rec.size() + 5 > m_bufSize && !m_buf.empty())
+			flush_async();
+		size_t oldsize = m_buf.size();
+		m_buf.resize_no_init(oldsize + rec.size() + 5);
+		byte_t* p = save_var_uint32(m_buf.data() + oldsize, uint32_t(rec.size()));
+		memcpy(p, rec.p, rec.size());
+		m_buf.risk_set_size(p + rec.size() - m_buf.data());
+		m_run->records++;
+	}
+	void finish() {
+		if (!m_buf.empty())
+			flush_async();
+		if (m_io.valid())
+			m_io.get();
+		if (m_zstd)
+			m_zstd->close();
+		m_fp.flush();
+		m_run->fileSize = m_fp.fsize();
+		m_fp.close();
+	}
+};
+
+class RunReader : boost::noncopyable {
+	FileStream m_fp;
+	std::unique_ptr<ZstdInputStream> m_zstd;
+	IInputStream* m_is;
+	valvec<byte_t> m_buf, m_back; // m_back is being read by m_io
+	std::future<size_t> m_io;
+	size_t   m_pos, m_len; // in m_buf
+	uint64_t m_remain; // bytes not yet requested
+	valvec<byte_t> m_rec; // for records across buffers
+
+	void read_async() {
+		size_t n = size_t(std::min<uint64_t>(m_remain, m_back.size()));
+		if (0 == n)
+			return;
+		m_remain -= n;
+		m_io = std::async(std::launch::async, [this,n]{
+			read_full(m_is, m_back.data(), n);
+			return n;
+		});
+	}
+	bool next_buf() {
+		if (!m_io.valid())
+			return false;
+		m_len = m_io.get();
+		m_pos = 0;
+		m_buf.swap(m_back);
+		read_async();
+		return true;
+	}
+	size_t load_len_slow() {
+		uint32_t len = 0;
+		for (int shift = 0; ; shift += 7) {
+			if (m_pos == m_len && !next_buf())
+				THROW_STD(runtime_error, "run file is truncated in record length");
+			byte_t b = m_buf[m_pos++];
+			len |= uint32_t(b & 0x7F) << shift;
+			if (!(b & 0x80))
+				return len;
+		}
+	}
+public:
+	fstring m_cur;
+
+	RunReader(const ExternalSorter::RunFile* run, size_t bufSize) {
+		m_fp.open(run->path.fpath, "rb");
+		m_fp.disbuf();
+		if (run->zstd) {
+			m_zstd.reset(new ZstdInputStream(&m_fp));
+			m_is = m_zstd.get();
+		} else {
+			m_is = &m_fp;
+		}
+		m_buf.resize_no_init(bufSize);
+		m_back.resize_no_init(bufSize);
+		m_pos = m_len = 0;
+		m_remain = run->rawSize;
+		read_async(); // next() must be called before using m_cur
+	}
+	~RunReader() {
+		if (m_io.valid())
+			m_io.wait();
+	}
+	void next() {
+		if (m_pos == m_len && !next_buf()) {
+			m_cur = max_rec();
+			return;
+		}
+		size_t len;
+		if (terark_likely(m_len - m_pos >= 5)) {
+			const byte_t* end = NULL;
+			len = load_var_uint32(m_buf.data() + m_pos, &end);
+			m_pos = end - m_buf.data();
+		} else {
+			len = load_len_slow();
+		}
+		if (terark_likely(m_len - m_pos >= len)) {
+			m_cur = fstring(m_buf.data() + m_pos, len);
+			m_pos += len;
+			return;
+		}
+		m_rec.assign(m_buf.data() + m_pos, m_len - m_pos);
+		while (m_rec.size() < len) {
+			if (!next_buf())
+				THROW_STD(runtime_error, "run file is truncated in record data");
+			m_pos = std::min(len - m_rec.size(), m_len);
+			m_rec.append(m_buf.data(), m_pos);
+		}
+		m_cur = fstring(m_rec.data(), len);
+	}
+};
+
+// a sorted slice of a SortableStrVec
+class SliceReader {
+	const SortableStrVec::SEntry* m_iter;
+	const SortableStrVec::SEntry* m_end;
+	const byte_t* m_pool;
+public:
+	fstring m_cur;
+	SliceReader(const SortableStrVec& sv, size_t beg, size_t end) {
+		m_iter = sv.m_index.data() + beg;
+		m_end  = sv.m_index.data() + end;
+		m_pool = sv.m_strpool.data();
+	}
+	void next() {
+		if (m_iter < m_end) {
+			m_cur = fstring(m_pool + m_iter->offset, size_t(m_iter->length));
+			++m_iter;
+		} else {
+			m_cur = max_rec();
+		}
+	}
+};
+
+template<class Source>
+struct WayIter {
+	typedef std::forward_iterator_tag iterator_category;
+	typedef fstring         value_type;
+	typedef ptrdiff_t       difference_type;
+	typedef const fstring*  pointer;
+	typedef const fstring&  reference;
+	Source* src;
+	const fstring& operator*() const { return src->m_cur; }
+	WayIter& operator++() { src->next(); return *this; }
+};
+
+/// sources must be positioned at their first records
+/// @returns number of output records
+template<class Source, class Output>
+size_t merge_sources(Source** srcs, size_t n, bool unique, Output output) {
+	if (0 == n)
+		return 0;
+	multi_way::LoserTree<WayIter<Source>, fstring, false, RecLess>
+		lt(max_rec());
+	lt.m_ways.resize(n);
+	for (size_t i = 0; i < n; ++i)
+		lt.m_ways[i].src = srcs[i];
+	lt.start();
+	size_t num = 0;
+	valvec<byte_t> prev;
+	while (!lt.empty()) {
+		const fstring rec = *lt.m_ways[lt.current_way()];
+		if (!unique || 0 == num || fstring(prev) != rec) {
+			output(rec);
+			if (unique)
+				prev.assign(rec.udata(), rec.size());
+			num++;
+		}
+		lt.increment();
+	}
+	return num;
+}
+
+} // namespace
+
+ExternalSorter::ExternalSorter(const Options& opt) : m_opt(opt) {
+	if (m_opt.tmpDir.empty()) {
+		const char* env = getenv("TMPDIR");
+		m_opt.tmpDir = env && *env ? env : "/tmp";
+	}
+	m_opt.threads = std::max<size_t>(m_opt.threads, 1);
+	m_opt.maxWays = std::max<size_t>(m_opt.maxWays, 2);
+	m_opt.ioBufSize = std::max<size_t>(m_opt.ioBufSize, 4096);
+	m_opt.memBudget = std::max<size_t>(m_opt.memBudget, 1 << 20);
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+ExternalSorter::~ExternalSorter() {
+	clear_runs();
+}
+
+void ExternalSorter::clear_runs() {
+	for (RunFile* run : m_runs)
+		delete run;
+	m_runs.clear();
+}
+
+ExternalSorter::RunFile* ExternalSorter::new_run() {
+	std::unique_ptr<RunFile> run(new RunFile);
+	std::string& path = run->path.fpath;
+	path = m_opt.tmpDir + "/ext_sort-XXXXXX";
+#if defined(_MSC_VER)
+	if (int err = _mktemp_s(&path[0], path.size() + 1)) {
+		run->path.fpath.clear();
+		THROW_STD(runtime_error, "_mktemp_s(%s) = %s", path.c_str(), strerror(err));
+	}
+#else
+	int fd = mkstemp(&path[0]);
+	if (fd < 0) {
+		int err = errno;
+		std::string tmp = path;
+		run->path.fpath.clear();
+		THROW_STD(runtime_error, "mkstemp(%s) = %s", tmp.c_str(), strerror(err));
+	}
+	::close(fd);
+#endif
+	return run.release();
+}
+
+size_t ExternalSorter::io_buf_size(size_t ways) const {
+	size_t sz = m_opt.memBudget / (2 * std::max<size_t>(ways, 1));
+	return std::max<size_t>(std::min(sz, m_opt.ioBufSize), 4096);
+}
+
+void ExternalSorter::add_stat(fstring rec) {
+	if (terark_unlikely(rec.size() > MAX_REC_LEN)) {
+		THROW_STD(length_error, "record too long, size = %zd, max = %zd",
+				  rec.size(), MAX_REC_LEN);
+	}
+	m_stats.records++;
+	m_stats.bytes += rec.size();
+}
+
+void ExternalSorter::write_chunk(SortableStrVec& sv) {
+	typedef SortableStrVec::SEntry SEntry;
+	const size_t n = sv.size();
+	SEntry* idx = sv.m_index.data();
+	const byte_t* pool = sv.m_strpool.data();
+	auto less = [pool](const SEntry& x, const SEntry& y) {
+		return RecLess()(fstring(pool + x.offset, size_t(x.length)),
+						 fstring(pool + y.offset, size_t(y.length)));
+	};
+	size_t nt = std::min(m_opt.threads, std::max<size_t>(n / 4096, 1));
+	std::vector<std::thread> thr;
+	for (size_t i = 1; i < nt; ++i) {
+		thr.emplace_back([=]{ std::sort(idx + n*i/nt, idx + n*(i+1)/nt, less); });
+	}
+	std::sort(idx, idx + n/nt, less);
+	for (auto& t : thr)
+		t.join();
+	valvec<SliceReader> slices(nt, valvec_reserve());
+	valvec<SliceReader*> srcs(nt, valvec_reserve());
+	for (size_t i = 0; i < nt; ++i) {
+		slices.unchecked_emplace_back(sv, n*i/nt, n*(i+1)/nt);
+		srcs.unchecked_push_back(&slices.back());
+		slices.back().next();
+	}
+	std::unique_ptr<RunFile> run(new_run());
+	RunWriter writer(run.get(), io_buf_size(1), m_opt.zstdLevel);
+	merge_sources(srcs.data(), nt, m_opt.unique,
+		[&](fstring rec) { writer.append(rec); });
+	writer.finish();
+	m_runs.push_back(run.release()); // serialized by form_runs_chunk
+}
+
+void ExternalSorter::form_runs_chunk(const Reader& read) {
+	// while a chunk is sorted and written in background, next chunk is
+	// collected in foreground, so each chunk uses half of memBudget
+	const size_t chunkMem = m_opt.memBudget / 2;
+	SortableStrVec chunks[2];
+	size_t curr = 0;
+	std::future<void> bg;
+	valvec<byte_t> rec;
+	for (;;) {
+		bool more = read(&rec);
+		SortableStrVec& sv = chunks[curr];
+		if (more) {
+			add_stat(rec);
+			sv.push_back(rec);
+		}
+		if (sv.mem_size() >= chunkMem || (!more && sv.size())) {
+			if (bg.valid())
+				bg.get();
+			bg = std::async(std::launch::async, [this,&sv]{
+				write_chunk(sv);
+				sv.m_index.risk_set_size(0); // keep memory for next chunk
+				sv.m_strpool.risk_set_size(0);
+			});
+			curr ^= 1;
+		}
+		if (!more)
+			break;
+	}
+	if (bg.valid())
+		bg.get();
+}
+
+void ExternalSorter::form_runs_replace_select(const Reader& read) {
+	// read some records to estimate the number of records in memBudget
+	std::vector<std::string> head;
+	size_t headBytes = 0;
+	valvec<byte_t> rec;
+	bool more = true;
+	while (head.size() < 4096 && (more = read(&rec))) {
+		add_stat(rec);
+		head.emplace_back((const char*)rec.data(), rec.size());
+		headBytes += rec.size();
+	}
+	if (head.empty())
+		return;
+	// 16 is for malloc overhead
+	size_t slot = headBytes / head.size() + sizeof(std::string) + 16;
+	std::vector<std::string> heap(std::max<size_t>(m_opt.memBudget / slot, 1));
+	size_t headPos = 0;
+	auto reader = [&](std::string* s) {
+		if (headPos < head.size()) {
+			s->swap(head[headPos]);
+			std::string().swap(head[headPos++]);
+			return true;
+		}
+		if (!more || !(more = read(&rec)))
+			return false;
+		add_stat(rec);
+		s->assign((const char*)rec.data(), rec.size());
+		return true;
+	};
+	struct Sink {
+		RunWriter* w;
+		void operator()(const std::string& s) const { w->append(s); }
+	};
+	std::unique_ptr<RunFile>   run;
+	std::unique_ptr<RunWriter> writer;
+	auto finish_run = [&]() {
+		if (writer) {
+			writer->finish();
+			writer.reset();
+			if (run->records)
+				m_runs.push_back(run.release());
+			else
+				run.reset();
+		}
+	};
+	auto create_writer = [&](size_t/*runs*/) {
+		finish_run();
+		run.reset(new_run());
+		writer.reset(new RunWriter(run.get(), io_buf_size(1), m_opt.zstdLevel));
+		return new Sink{writer.get()};
+	};
+	auto less    = [](const std::string& x, const std::string& y) { return x < y; };
+	auto greater = [](const std::string& x, const std::string& y) { return y < x; };
+	replace_select_sort(heap, reader, create_writer, less, greater);
+	finish_run();
+}
+
+template<class Output>
+size_t ExternalSorter::merge_runs(RunFile** runs, size_t n, Output output) {
+	std::vector<std::unique_ptr<RunReader> > readers;
+	valvec<RunReader*> srcs(n, valvec_reserve());
+	const size_t bufSize = io_buf_size(n);
+	for (size_t i = 0; i < n; ++i) {
+		readers.emplace_back(new RunReader(runs[i], bufSize));
+		srcs.unchecked_push_back(readers.back().get());
+	}
+	for (size_t i = 0; i < n; ++i)
+		srcs[i]->next();
+	return merge_sources(srcs.data(), n, m_opt.unique, output);
+}
+
+void ExternalSorter::merge(const Writer& write) {
+	// merge smallest runs first, this minimizes total bytes of all passes,
+	// records have no identity other than their bytes, so run order is free
+	const size_t ways = m_opt.maxWays;
+	auto bySize = [](const RunFile* x, const RunFile* y) {
+		return x->rawSize > y->rawSize; // min heap
+	};
+	std::make_heap(m_runs.begin(), m_runs.end(), bySize);
+	while (m_runs.size() > ways) {
+		size_t k = std::min(ways, m_runs.size() - ways + 1);
+		for (size_t i = 0; i < k; ++i)
+			std::pop_heap(m_runs.begin(), m_runs.end() - i, bySize);
+		RunFile** beg = m_runs.end() - k;
+		std::unique_ptr<RunFile> run(new_run());
+		RunWriter writer(run.get(), io_buf_size(1), m_opt.zstdLevel);
+		merge_runs(beg, k, [&](fstring rec) { writer.append(rec); });
+		writer.finish();
+		for (size_t i = 0; i < k; ++i)
+			delete beg[i];
+		m_runs.risk_set_size(m_runs.size() - k);
+		m_runs.push_back(run.release());
+		std::push_heap(m_runs.begin(), m_runs.end(), bySize);
+		m_stats.passes++;
+	}
+	m_stats.outRecords = merge_runs(m_runs.data(), m_runs.size(), write);
+	m_stats.passes++;
+}
+
+void ExternalSorter::sort(const Reader& read, const Writer& write) {
+	clear_runs();
+	memset(&m_stats, 0, sizeof(m_stats));
+	profiling pf;
+	long long t0 = pf.now();
+	if (m_opt.replaceSelect)
+		form_runs_replace_select(read);
+	else
+		form_runs_chunk(read);
+	long long t1 = pf.now();
+	m_stats.runs = m_runs.size();
+	for (const RunFile* run : m_runs)
+		m_stats.runFileSize += run->fileSize;
+	merge(write);
+	long long t2 = pf.now();
+	m_stats.formNanos  = pf.ns(t0, t1);
+	m_stats.mergeNanos = pf.ns(t1, t2);
+	clear_runs();
+}
+
+} // namespace terark
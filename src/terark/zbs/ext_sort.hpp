@@ -0,0 +1,83 @@
+#pragma once
+
+#include <terark/fstring.hpp>
+#include <terark/valvec.hpp>
+#include <boost/noncopyable.hpp>
+#include <functional>
+#include <string>
+
+namespace terark {
+
+class SortableStrVec;
+
+/// External merge sort of byte string records, records are compared by
+/// memcmp order.
+///
+/// Runs are formed by one of:
+///  - chunk mode(default): records are collected in a SortableStrVec until
+///    half of memBudget is used, the chunk is sorted by Options::threads
+///    threads(each sorts a slice, slices are merged by LoserTree) and written
+///    in background while the next chunk is being collected
+///  - replacement selection: replace_select_sort, runs are about 2x of memory
+///    on random input, and input which is almost sorted yields few runs
+///
+/// Runs are merged by LoserTree, at most maxWays runs in a pass. Run files
+/// are written and read through double buffers, the I/O(and zstd) of a buffer
+/// is done by an async task while the other buffer is being processed.
+class TERARK_DLL_EXPORT ExternalSorter : boost::noncopyable {
+public:
+	struct Options {
+		size_t memBudget = size_t(1) << 30; // memory for run formation and merge
+		size_t threads = 1;    // threads for sorting a chunk
+		size_t ioBufSize = size_t(1) << 20; // max size of each I/O buffer
+		size_t maxWays = 256;  // max runs merged in one pass, min 2
+		int    zstdLevel = 0;  // > 0: compress run files by zstd
+		bool   replaceSelect = false;
+		bool   unique = false; // output only the first of equal records
+		std::string tmpDir;    // default is $TMPDIR or /tmp
+	};
+	struct Stats {
+		size_t records;     // input records
+		size_t bytes;       // input bytes, excluding record framing
+		size_t runs;        // initial runs
+		size_t runFileSize; // file size of initial runs
+		size_t passes;      // merge passes, including the final one
+		size_t outRecords;
+		size_t formNanos;   // time of run formation
+		size_t mergeNanos;  // time of all merge passes
+	};
+	/// @returns false on end of input
+	typedef std::function<bool(valvec<byte_t>* rec)> Reader;
+	typedef std::function<void(fstring rec)> Writer;
+
+	static const size_t MAX_REC_LEN; // same as SortableStrVec::MAX_STR_LEN
+
+	explicit ExternalSorter(const Options&);
+	~ExternalSorter();
+
+	/// read all records by read, then write them in sorted order by write,
+	/// a sorter object can run sort multiple times
+	void sort(const Reader& read, const Writer& write);
+
+	const Options& options() const { return m_opt; }
+	const Stats& stats() const { return m_stats; }
+
+	class RunFile;
+private:
+	void form_runs_chunk(const Reader&);
+	void form_runs_replace_select(const Reader&);
+	void write_chunk(SortableStrVec&);
+	void merge(const Writer&);
+	template<class Output>
+	size_t merge_runs(RunFile** runs, size_t n, Output);
+	void add_stat(fstring rec);
+	size_t io_buf_size(size_t ways) const;
+	RunFile* new_run();
+	void clear_runs();
+
+	Options m_opt;
+	Stats   m_stats;
+	valvec<RunFile*> m_runs;
+};
+
+} // namespace terark
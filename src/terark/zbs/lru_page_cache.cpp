@@ -5,8 +5,11 @@
 	#include <Windows.h>
 #else
 	#include <unistd.h> // for usleep
+	#include <fcntl.h>
 	#include <sys/mman.h>
+	#include <sys/stat.h>
 #endif
+#include <map>
 #include <thread>
 #include <terark/util/throw.hpp>
 #include <terark/hash_common.hpp>
@@ -17,12 +20,17 @@
 #include <terark/util/function.hpp>
 #include <terark/bitmap.hpp>
 #include <terark/num_to_str.hpp>
+#include <terark/gold_hash_map.hpp>
+#include <terark/io/FileStream.hpp>
+#include <terark/util/hugepage.hpp>
+#include <terark/util/fast_getcpu.hpp>
 #include <atomic>
 #include <boost/preprocessor/cat.hpp>
 #if !defined(_MSC_VER)
 #include <boost/fiber/operations.hpp>
 #include <terark/thread/fiber_aio.hpp>
 #include <terark/thread/fiber_local.hpp>
+#include <terark/thread/fiber_pool.hpp>
 #endif
 
 #if defined(TERARK_WITH_TBB)
@@ -285,12 +293,14 @@ using std::memory_order_relaxed;
 namespace lru_detail {
 	struct File {
 		intptr_t fd;
+		intptr_t rd_fd; // fd for read, opened by fdopen_direct if dio_align
+		uint32_t dio_align = 0; // 0 means rd_fd is fd, read by page cache
 		uint32_t headpage = nillink;
 		uint32_t pgcnt = 0;
 		uint32_t next_fi = nillink;
 		uint32_t prev_fi = nillink;
 		bool     is_pending_drop = false;
-		explicit File(intptr_t fd1 = -1) : fd(fd1) {}
+		explicit File(intptr_t fd1 = -1) : fd(fd1), rd_fd(fd1) {}
 
 		template<class FileVec>
 		static size_t list_len(const FileVec& base, size_t head) {
@@ -441,6 +451,65 @@ namespace lru_detail {
 			base[p].lru_next = x;
 		}
 	};
+
+	/// count-min sketch of 4-bit counters for TinyLFU admission, each
+	/// uint64 holds 16 counters, counters are halved after every
+	/// m_sample increments, thus old popularity fades out
+	class FreqSketch {
+		valvec<uint64_t> m_table;
+		size_t m_mask = 0;
+		size_t m_size = 0;
+		size_t m_sample = 0;
+		size_t m_resets = 0;
+		static const size_t Depth = 4;
+
+		static uint64_t rehash(uint64_t key) {
+			key *= 0x9E3779B97F4A7C15ull;
+			return key ^ (key >> 31);
+		}
+		void locate(uint64_t h, size_t i, size_t* widx, size_t* shift) const {
+			uint64_t hi = (h + i * ((h >> 32) | 1)) * 0xC2B2AE3D27D4EB4Full;
+			*widx  = size_t(hi >> 32) & m_mask;
+			*shift = size_t(hi >> 24 & 15) * 4;
+		}
+	public:
+		void init(size_t maxItems) {
+			size_t n = 64;
+			while (n < maxItems) n *= 2;
+			m_table.resize(n, 0);
+			m_mask = n - 1;
+			m_sample = 10 * n;
+		}
+		size_t estimate(uint64_t key) const {
+			uint64_t h = rehash(key);
+			size_t freq = 15;
+			for (size_t i = 0; i < Depth; ++i) {
+				size_t widx, shift;
+				locate(h, i, &widx, &shift);
+				freq = std::min(freq, size_t(m_table[widx] >> shift & 15));
+			}
+			return freq;
+		}
+		void increment(uint64_t key) {
+			uint64_t h = rehash(key);
+			bool added = false;
+			for (size_t i = 0; i < Depth; ++i) {
+				size_t widx, shift;
+				locate(h, i, &widx, &shift);
+				if ((m_table[widx] >> shift & 15) != 15) {
+					m_table[widx] += uint64_t(1) << shift;
+					added = true;
+				}
+			}
+			if (added && ++m_size >= m_sample) {
+				for (uint64_t& w : m_table)
+					w = (w >> 1) & 0x7777777777777777ull;
+				m_size /= 2;
+				m_resets++;
+			}
+		}
+		size_t resets() const { return m_resets; }
+	};
 }
 using namespace lru_detail;
 
@@ -457,11 +526,18 @@ using namespace lru_detail;
 
 class SingleLruReadonlyCache final: public LruReadonlyCache {
 public:
+	static const size_t StatCntNum = Buffer::mix;
     bool                m_use_aio;
+	bool                m_direct_io;
+	EvictPolicy         m_policy;
 	valvec<size_t>      m_histogram;
+	FreqSketch          m_sketch; // used only by EvictPolicy::tiny_lfu
 	Node*               m_hash_nodes;
 	uint32_t*           m_bucket;
 	byte_t*             m_bufmem;
+	size_t              m_bufmem_size;
+	int                 m_numa_node; // -1 means not bound to a numa node
+	size_t              m_remote_cnt; // page accesses from other numa nodes
 	size_t              m_page_num;
 	size_t              m_bucket_size;
 	ByPermanentID<File> m_fi_to_fd;
@@ -469,7 +545,7 @@ public:
 	uint32_t            m_fi_busylist;
 	uint32_t            m_busypage_num;
 //	uint32_t            m_droppage_num;
-	size_t   m_stat_cnt[6];
+	size_t   m_stat_cnt[StatCntNum];
 	MY_MUTEX_PADDING
 	mutable MyMutex     m_mutex;
 #ifdef INDIVIDUAL_FILE_VECTOR_LOCK
@@ -477,27 +553,62 @@ public:
 	MyMutex          m_mutex_fd_fi;
 #endif
 	MY_MUTEX_PADDING
-	SingleLruReadonlyCache(size_t capacityBytes, size_t maxFiles, bool aio);
+	SingleLruReadonlyCache(size_t capacityBytes, const Options&, int numa_node);
 	~SingleLruReadonlyCache();
 	const byte_t* pread(intptr_t fi, size_t offset, size_t len, Buffer*) override;
 	void discard_impl(const Buffer& b);
 	intptr_t open(intptr_t fd) override;
+	intptr_t open_impl(const File&);
 	void close(intptr_t fi) override;
 	bool safe_close(intptr_t fi) override;
+	void close_impl(intptr_t fi, intptr_t* dio_fd);
+	bool safe_close_impl(intptr_t fi, intptr_t* dio_fd);
+	intptr_t get_fd(intptr_t fi) const override;
+	bool is_direct_io(intptr_t fi) const override;
 	void print_stat_cnt(FILE*) const override;
-	static void print_stat_cnt_impl(FILE*, const size_t cnt[6], const valvec<size_t>& histogram);
+	StatCnt get_stat_cnt(intptr_t shard) const override;
+	size_t shard_num() const override { return 1; }
+	void add_stat_cnt(StatCnt*) const;
+	static void print_stat_cnt_impl(FILE*, EvictPolicy, const size_t cnt[StatCntNum],
+									size_t sketch_resets, const valvec<size_t>& histogram);
 	valvec<size_t> get_histogram_snapshot() const;
+	size_t stat_hit_cnt() const {
+		return m_stat_cnt[Buffer::hit] + m_stat_cnt[Buffer::hit_others_load];
+	}
+	size_t stat_all_cnt() const {
+		size_t sum = 0;
+		for (size_t i = 0; i < StatCntNum; ++i) sum += m_stat_cnt[i];
+		return sum;
+	}
+	static void print_numa_stat_head(FILE*);
+	static void print_numa_stat_line(FILE*, int node, size_t shards,
+									 size_t hits, size_t all, size_t remote);
 private:
+	void count_remote(size_t pages) {
+	#if !defined(_MSC_VER)
+		if (m_numa_node >= 0 && int(fast_getnode()) != m_numa_node)
+			m_remote_cnt += pages;
+	#endif
+	}
 	uint32_t alloc_page(size_t hpos, uint64_t fi_offset_key, Buffer::CacheType*, intptr_t* fd);
+	bool should_bypass(uint64_t fi_offset_key, Buffer*, Buffer::CacheType*);
+	const byte_t* pread_impl(intptr_t fi, size_t offset, size_t len, Buffer*, bool aio);
+protected:
+	void get_hot_pages(valvec<uint64_t>* keys) const override;
+	void get_open_files(valvec<OpenFile>* files) const override;
+	void warmup_page(intptr_t fi, size_t page) override;
+	friend class MultiLruReadonlyCache;
 	void remove_from_hash(size_t bucketIdx, size_t slot);
 };
 
 ///
 SingleLruReadonlyCache::
-SingleLruReadonlyCache(size_t capacityBytes, size_t maxFiles, bool aio)
-	: m_fi_to_fd(maxFiles)
+SingleLruReadonlyCache(size_t capacityBytes, const Options& opt, int numa_node)
+	: m_fi_to_fd(opt.maxFiles)
 {
-    m_use_aio = aio;
+    m_use_aio = opt.aio;
+	m_direct_io = opt.directIO;
+	m_policy = opt.policy;
 	size_t pgNum = ceiled_div(capacityBytes, PAGE_SIZE);
 	if (pgNum >= nillink-2) {
 		THROW_STD(invalid_argument
@@ -508,29 +619,10 @@ SingleLruReadonlyCache(size_t capacityBytes, size_t maxFiles, bool aio)
 	size_t node_bytes = sizeof(Node) * (pgNum + 1);
 	size_t page_bytes = pgNum * PAGE_SIZE;
 	size_t bucket_bytes = sizeof(uint32_t) * m_bucket_size;
-	size_t bytes = page_bytes + node_bytes + bucket_bytes;
-#if defined(_MSC_VER)
-	byte_t* mem = (byte_t*)_aligned_malloc(bytes, PAGE_SIZE);
-	if (NULL == mem) {
-		THROW_STD(invalid_argument
-			, "_aligned_malloc(align=%zd, size=%zd) = %s"
-			, PAGE_SIZE, bytes, strerror(errno));
-	}
-#else
-	byte_t* mem = NULL;
-	int err = posix_memalign((void**)&mem, HUGE_PAGE_SIZE, bytes);
-	if (err) {
-		THROW_STD(invalid_argument
-			, "posix_memalign(align=%zd, size=%zd) = %s"
-			, PAGE_SIZE, bytes, strerror(err));
-	}
-  #ifdef MADV_HUGEPAGE
-	if (madvise(mem, bytes, MADV_HUGEPAGE) < 0) {
-		fprintf(stderr
-			, "WARN: SingleLruReadonlyCache: madvise(HUGEPAGE) = %s\n"
-			, strerror(errno));
-	}
-  #endif
+	size_t bytes = align_up(page_bytes + node_bytes + bucket_bytes, HUGE_PAGE_SIZE);
+	// pages are allocated on numa_node when they are first touched
+	byte_t* mem = (byte_t*)hugepage_alloc(bytes, numa_node, opt.hugetlb);
+#if !defined(_MSC_VER)
 	if (madvise(mem, bytes, MADV_WILLNEED) < 0) {
 		fprintf(stderr
 			, "WARN: SingleLruReadonlyCache: madvise(WILLNEED) = %s\n"
@@ -538,6 +630,9 @@ SingleLruReadonlyCache(size_t capacityBytes, size_t maxFiles, bool aio)
 	}
 #endif
 	m_bufmem = mem;
+	m_bufmem_size = bytes;
+	m_numa_node = numa_node;
+	m_remote_cnt = 0;
 	m_hash_nodes = (Node*)(mem + page_bytes);
 	for (size_t i = 0; i < pgNum+1; ++i) {
 		m_hash_nodes[i].fi_offset = uint64_t(-1);
@@ -558,10 +653,13 @@ SingleLruReadonlyCache(size_t capacityBytes, size_t maxFiles, bool aio)
 	m_busypage_num = 0;
 	memset(m_stat_cnt, 0, sizeof(m_stat_cnt));
 	m_histogram.reserve(128);
+	if (EvictPolicy::tiny_lfu == m_policy) {
+		m_sketch.init(pgNum);
+	}
 }
 
 SingleLruReadonlyCache::~SingleLruReadonlyCache() {
-	TERARK_IF_MSVC(_aligned_free, free)(m_bufmem);
+	hugepage_free(m_bufmem, m_bufmem_size);
 }
 
 static void
@@ -595,6 +693,63 @@ noexcept {
 #endif
 }
 
+/// aligned buffer for O_DIRECT reads
+class DirectIoBuf : boost::noncopyable {
+	byte_t* m_mem;
+public:
+	DirectIoBuf() : m_mem(NULL) {}
+	DirectIoBuf(DirectIoBuf&& y) noexcept : m_mem(y.m_mem) { y.m_mem = NULL; }
+	DirectIoBuf& operator=(DirectIoBuf&& y) noexcept {
+		std::swap(m_mem, y.m_mem);
+		return *this;
+	}
+	explicit DirectIoBuf(size_t len) {
+	#if defined(_MSC_VER)
+		m_mem = (byte_t*)_aligned_malloc(len, PAGE_SIZE);
+	#else
+		void* mem = NULL;
+		m_mem = posix_memalign(&mem, PAGE_SIZE, len) == 0 ? (byte_t*)mem : NULL;
+	#endif
+		if (NULL == m_mem) {
+			throw std::bad_alloc();
+		}
+	}
+	~DirectIoBuf() {
+	#if defined(_MSC_VER)
+		_aligned_free(m_mem);
+	#else
+		free(m_mem);
+	#endif
+	}
+	byte_t* data() const { return m_mem; }
+};
+
+/// for pages which are not filled into cache, read into an aligned page
+/// then copy to buf when fd is opened by O_DIRECT
+static void
+bypass_pread(intptr_t fd, bool direct, void* buf, size_t offset, size_t minlen, bool aio) {
+	if (direct) {
+	#if defined(_MSC_VER)
+		DirectIoBuf page(PAGE_SIZE);
+	#else
+		// the reader may be a fiber which yields in fiber_aio_read, each
+		// reader takes its own page from the pool of the thread
+		static thread_local recycle_pool<DirectIoBuf> tss;
+		DirectIoBuf page = tss.get();
+		if (NULL == page.data()) {
+			page = DirectIoBuf(PAGE_SIZE);
+		}
+	#endif
+		do_pread(fd, page.data(), offset, minlen, PAGE_SIZE, aio);
+		memcpy(buf, page.data(), minlen);
+	#if !defined(_MSC_VER)
+		tss.put(std::move(page));
+	#endif
+	} else {
+		do_pread(fd, buf, offset, minlen, PAGE_SIZE, aio);
+	}
+}
+
 static inline uint64_t MyHash(uint64_t fi_page_id) {
 	uint64_t hash1 = (fi_page_id << 3) | (fi_page_id >> 61);
 	return byte_swap(hash1);
@@ -605,6 +760,95 @@ void fdpread(intptr_t fd, void* buf, size_t len, size_t offset) {
 	do_pread(fd, buf, offset, len, len, false);
 }
 
+TERARK_DLL_EXPORT
+intptr_t fdopen_direct(intptr_t fd, size_t* align) {
+#if defined(__linux__) && defined(O_DIRECT)
+	char path[64];
+	snprintf(path, sizeof(path), "/proc/self/fd/%d", int(fd));
+	int dfd = ::open(path, O_RDONLY | O_DIRECT | O_CLOEXEC);
+	if (dfd < 0) {
+		return -1; // EINVAL: the file system does not support O_DIRECT
+	}
+	size_t dio_align = 0;
+  #if defined(STATX_DIOALIGN)
+	struct statx stx;
+	if (statx(dfd, "", AT_EMPTY_PATH, STATX_DIOALIGN, &stx) == 0 &&
+			(stx.stx_mask & STATX_DIOALIGN)) {
+		if (0 == stx.stx_dio_offset_align) {
+			::close(dfd); // O_DIRECT is not supported on this file
+			return -1;
+		}
+		dio_align = std::max(stx.stx_dio_mem_align, stx.stx_dio_offset_align);
+	}
+  #endif
+	if (0 == dio_align) {
+		// probe the logical block size: O_DIRECT read fails with EINVAL
+		// if the length or offset is not aligned to it
+		DirectIoBuf probe(PAGE_SIZE);
+		for (dio_align = 512; dio_align <= PAGE_SIZE; dio_align *= 2) {
+			if (::pread(dfd, probe.data(), dio_align, 0) >= 0)
+				break;
+			if (EINVAL != errno) {
+				dio_align = SIZE_MAX;
+				break;
+			}
+		}
+		if (dio_align > PAGE_SIZE) {
+			::close(dfd);
+			return -1;
+		}
+	}
+	*align = dio_align;
+	return dfd;
+#else
+	TERARK_UNUSED_VAR(fd);
+	TERARK_UNUSED_VAR(align);
+	return -1;
+#endif
+}
+
+TERARK_DLL_EXPORT
+void fdpread_direct(intptr_t fd, size_t align, void* buf, size_t len, size_t offset) {
+	assert(align > 0 && (align & (align - 1)) == 0);
+	if (((size_t(buf) | len | offset) & (align - 1)) == 0) {
+		do_pread(fd, buf, offset, len, len, false);
+		return;
+	}
+	size_t lo = align_down(offset, align);
+	size_t hi = align_up(offset + len, align);
+	DirectIoBuf bounce(hi - lo);
+	do_pread(fd, bounce.data(), lo, offset + len - lo, hi - lo, false);
+	memcpy(buf, bounce.data() + (offset - lo), len);
+}
+
+/// reopen f->fd by O_DIRECT, keep reading f->fd by page cache on failure
+static void open_direct(File* f) {
+	size_t align = 0;
+	intptr_t dfd = fdopen_direct(f->fd, &align);
+	if (dfd >= 0 && align <= PAGE_SIZE) {
+		f->rd_fd = dfd;
+		f->dio_align = uint32_t(align);
+		return;
+	}
+	static std::atomic<bool> warned(false);
+	if (!warned.exchange(true)) {
+		fprintf(stderr
+			, "WARN: LruReadonlyCache: O_DIRECT is not supported(fd = %zd, align = %zd)"
+			  ", read by page cache\n", f->fd, align);
+	}
+	if (dfd >= 0) {
+		::close(int(dfd)); // align > PAGE_SIZE
+	}
+}
+
+static void close_direct(intptr_t dio_fd) {
+#if !defined(_MSC_VER)
+	if (dio_fd >= 0) {
+		::close(int(dio_fd));
+	}
+#endif
+}
+
 // already in m_mutex lock
 uint32_t
 SingleLruReadonlyCache::alloc_page(size_t hpos, uint64_t fi_offset_key,
@@ -633,7 +877,7 @@ SingleLruReadonlyCache::alloc_page(size_t hpos, uint64_t fi_offset_key,
 		if (nillink != free_fi) { // double check after lock
 			File*  free_fp = &m_fi_to_fd[free_fi];
 			File*  curr_fp = &m_fi_to_fd[fi];
-			*fd = curr_fp->fd;
+			*fd = curr_fp->rd_fd;
 			assert(free_fp->pgcnt > 0);
 			assert(free_fp->is_pending_drop);
 			assert(free_fp->headpage != nillink);
@@ -685,7 +929,7 @@ SingleLruReadonlyCache::alloc_page(size_t hpos, uint64_t fi_offset_key,
 			assert(!swap_fp.is_pending_drop);
 			assert_list_len(curr_fp);
 			assert_list_len(swap_fp);
-			*fd = curr_fp.fd;
+			*fd = curr_fp.rd_fd;
 			curr_fp.pgcnt++;
 			if (--swap_fp.pgcnt) {
 				if (swap_fp.headpage == p) {
@@ -709,7 +953,7 @@ SingleLruReadonlyCache::alloc_page(size_t hpos, uint64_t fi_offset_key,
 			assert(!curr_fp.is_pending_drop);
 			assert_list_len(curr_fp);
 			Node::fi_insert_after_p(nodes, &curr_fp.headpage, p);
-			*fd = curr_fp.fd;
+			*fd = curr_fp.rd_fd;
 			curr_fp.pgcnt++;
 			assert_list_len(curr_fp);
 		}
@@ -727,8 +971,16 @@ intptr_t SingleLruReadonlyCache::open(intptr_t fd) {
 	if (fd < 0) {
 		THROW_STD(invalid_argument, "invalid fd = %zd", fd);
 	}
+	File f(fd);
+	if (m_direct_io) {
+		open_direct(&f);
+	}
+	return open_impl(f);
+}
+
+intptr_t SingleLruReadonlyCache::open_impl(const File& file) {
 	LOCK_FILE_VECTOR_FULL;
-	uint32_t fi = (uint32_t)m_fi_to_fd.push(File(fd));
+	uint32_t fi = (uint32_t)m_fi_to_fd.push(file);
 	File::insert_after_p(m_fi_to_fd, &m_fi_busylist, fi);
 #if !defined(NDEBUG) && defined(SLOW_DEBUG)
 	const File& f = m_fi_to_fd[fi];
@@ -750,6 +1002,12 @@ struct MyPageEntry {
 
 const byte_t*
 SingleLruReadonlyCache::pread(intptr_t fi, size_t offset, size_t len, Buffer* b) {
+	return pread_impl(fi, offset, len, b, m_use_aio);
+}
+
+const byte_t*
+SingleLruReadonlyCache::pread_impl(intptr_t fi, size_t offset, size_t len,
+								   Buffer* b, bool aio) {
 	if (terark_unlikely(fi < 0)) {
 		THROW_STD(invalid_argument, "invalid fi = %zd", fi);
 	}
@@ -757,6 +1015,7 @@ SingleLruReadonlyCache::pread(intptr_t fi, size_t offset, size_t len, Buffer* b)
 	uint32_t* bucket = m_bucket;
 	Node*     nodes = m_hash_nodes;
 	intptr_t  fd = -1;
+	bool      direct = false;
     assert(nullptr != b->rdbuf);
     b->cache_type = Buffer::hit; // hit is very likely
     b->owner = this;
@@ -767,6 +1026,10 @@ SingleLruReadonlyCache::pread(intptr_t fi, size_t offset, size_t len, Buffer* b)
 		{
 			size_t conflict_len = 0;
 			ScopeLock lock(m_mutex);
+			if (EvictPolicy::tiny_lfu == m_policy) {
+				m_sketch.increment(fi_offset_key);
+			}
+			count_remote(1);
 			p = bucket[hpos]; assert(p > 0); // real load
 			for (; nillink != p; p = nodes[p].hash_link) {
 				assert(p <= m_page_num);
@@ -787,13 +1050,29 @@ SingleLruReadonlyCache::pread(intptr_t fi, size_t offset, size_t len, Buffer* b)
 				}
 				conflict_len++;
 			}
+			if (should_bypass(fi_offset_key, b, &b->cache_type)) {
+				LOCK_FILE_VECTOR_ELEM;
+				fd = m_fi_to_fd[fi].rd_fd;
+				direct = m_fi_to_fd[fi].dio_align != 0;
+				goto OnBypass; // go out of scope to unlock
+			}
 			p = alloc_page(hpos, fi_offset_key, &b->cache_type, &fd);
 		}
 		if (0) {
+	OnBypass:
+			valvec<byte_t>* rdbuf = b->rdbuf;
+			rdbuf->resize_no_init(PAGE_SIZE);
+			bypass_pread(fd, direct, rdbuf->data()
+					   , align_down(offset, PAGE_SIZE)
+					   , pg_offset + len, aio);
+			b->index = 0;
+			return rdbuf->data() + pg_offset;
+		}
+		if (0) {
 	OnHitOthersLoad:
 			while (!nodes[p].is_loaded) {
 			#if !defined(_MSC_VER)
-                if (m_use_aio) {
+                if (aio) {
                     boost::this_fiber::yield();
                     if (nodes[p].is_loaded)
                         break;
@@ -814,7 +1093,7 @@ SingleLruReadonlyCache::pread(intptr_t fi, size_t offset, size_t len, Buffer* b)
 		byte_t* bufptr = m_bufmem + PAGE_SIZE*(p-1);
 		do_pread(fd, bufptr
 				   , align_down(offset, PAGE_SIZE)
-				   , pg_offset + len, PAGE_SIZE, m_use_aio);
+				   , pg_offset + len, PAGE_SIZE, aio);
 		nodes[p].is_loaded = true;
         b->index = p;
         assert(p > 0);
@@ -852,9 +1131,13 @@ SingleLruReadonlyCache::pread(intptr_t fi, size_t offset, size_t len, Buffer* b)
 		size_t missed_cnt = 0;
 		{
 			ScopeLock lock(m_mutex);
+			count_remote(plast_page - first_page);
 			for (size_t pg = first_page; pg < plast_page; ++pg) {
 				size_t hpos = pgvec[pg - first_page].hpos;
 				uint64_t fi_offset_key = (fi << 32) | pg;
+				if (EvictPolicy::tiny_lfu == m_policy) {
+					m_sketch.increment(fi_offset_key);
+				}
 				auto p = bucket[hpos];
 				assert(p > 0);
 				size_t conflict_len = 0;
@@ -871,27 +1154,45 @@ SingleLruReadonlyCache::pread(intptr_t fi, size_t offset, size_t len, Buffer* b)
 					}
 					conflict_len++;
 				}
-				p = alloc_page(hpos, fi_offset_key, &b->cache_type, &fd);
 				missed_cnt++;
+				if (should_bypass(fi_offset_key, b, &b->cache_type)) {
+					LOCK_FILE_VECTOR_ELEM;
+					fd = m_fi_to_fd[fi].rd_fd;
+					direct = m_fi_to_fd[fi].dio_align != 0;
+					p = 0; // page_id 0 is the lru list head, means not cached
+					pgvec[pg - first_page].alloc_by_me = false;
+					goto CrossPageNext;
+				}
+				p = alloc_page(hpos, fi_offset_key, &b->cache_type, &fd);
 				pgvec[pg - first_page].alloc_by_me = true;
 			CrossPageNext:
 				pgvec[pg - first_page].page_id = p;
 			}
 		}
 		// read data no lock...
-		auto readpage = [this,first_page,fd,nodes,pgvec,unibuf,fi]
+		auto readpage = [this,first_page,fd,direct,nodes,pgvec,unibuf,fi,aio]
 		(size_t fpg, size_t minlen, size_t pg_offset) {
 			auto p = pgvec[fpg - first_page].page_id;
+			if (0 == p) { // bypass, read the page to tail of unibuf
+				assert(fd >= 0);
+				size_t oldsize = unibuf->size();
+				unibuf->resize_no_init(oldsize + PAGE_SIZE);
+				byte_t* bufptr = unibuf->data() + oldsize;
+				bypass_pread(fd, direct, bufptr, fpg*PAGE_SIZE, minlen, aio);
+				memmove(bufptr, bufptr + pg_offset, minlen - pg_offset);
+				unibuf->risk_set_size(oldsize + minlen - pg_offset);
+				return;
+			}
 			byte_t* bufptr = this->m_bufmem + PAGE_SIZE*(p-1);
 			if (!nodes[p].is_loaded) {
 				if (pgvec[fpg - first_page].alloc_by_me) {
 					assert(fd >= 0);
-					do_pread(fd, bufptr, fpg*PAGE_SIZE, minlen, PAGE_SIZE, m_use_aio);
+					do_pread(fd, bufptr, fpg*PAGE_SIZE, minlen, PAGE_SIZE, aio);
 					nodes[p].is_loaded = true;
 				} else {
 					while (!nodes[p].is_loaded) {
 					#if !defined(_MSC_VER)
-					    if (m_use_aio) {
+					    if (aio) {
                             boost::this_fiber::yield();
                             if (nodes[p].is_loaded)
                                 break;
@@ -914,22 +1215,20 @@ SingleLruReadonlyCache::pread(intptr_t fi, size_t offset, size_t len, Buffer* b)
             m_mutex.lock();
 			for (size_t fpg = first_page; fpg < last; ++fpg) {
 				auto  p = pgvec_p[fpg - first_page].page_id;
-				if (0 == --nodes_p[p].ref_count)
+				if (p && 0 == --nodes_p[p].ref_count)
                     Node::lru_insert_after(nodes, 0, p);
 			}
             m_mutex.unlock();
 		);
-		if (missed_cnt > 0) {
-		    readpage(first_page, PAGE_SIZE, pg_offset);
-		    size_t pg = first_page + 1;
-		    for (; pg < plast_page - 1; ++pg) {
-			    readpage(pg, PAGE_SIZE, 0);
-		    }
-		    readpage(pg, (offset + len - 1) % PAGE_SIZE + 1, 0);
-		    assert(unibuf->size() == len);
-		    if (missed_cnt > 1) {
-			    b->cache_type = Buffer::mix;
-            }
+		readpage(first_page, PAGE_SIZE, pg_offset);
+		size_t pg = first_page + 1;
+		for (; pg < plast_page - 1; ++pg) {
+			readpage(pg, PAGE_SIZE, 0);
+		}
+		readpage(pg, (offset + len - 1) % PAGE_SIZE + 1, 0);
+		assert(unibuf->size() == len);
+		if (missed_cnt > 1) {
+			b->cache_type = Buffer::mix;
 		}
         b->index = 0;
 #if !defined(_MSC_VER)
@@ -955,6 +1254,31 @@ void SingleLruReadonlyCache::remove_from_hash(size_t bucketIdx, size_t slot) {
 	abort(); // should not goes here
 }
 
+// m_mutex is locked before calling this function
+bool SingleLruReadonlyCache::should_bypass(uint64_t fi_offset_key, Buffer* b,
+										   Buffer::CacheType* cache_type) {
+	if (b->no_fill) {
+		m_stat_cnt[Buffer::bypass_no_fill]++;
+		*cache_type = Buffer::bypass_no_fill;
+		return true;
+	}
+	if (EvictPolicy::tiny_lfu == m_policy && nillink == m_fi_freelist) {
+		// admit the page only if it is more popular than the lru victim
+		const Node* nodes = m_hash_nodes;
+		uint32_t victim = nodes[0].lru_prev;
+		if (0 != victim && uint64_t(-1) != nodes[victim].fi_offset) {
+			size_t candidate_freq = m_sketch.estimate(fi_offset_key);
+			size_t victim_freq = m_sketch.estimate(nodes[victim].fi_offset);
+			if (candidate_freq <= victim_freq) {
+				m_stat_cnt[Buffer::admit_rejected]++;
+				*cache_type = Buffer::admit_rejected;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
 void SingleLruReadonlyCache::discard_impl(const Buffer& b) {
 	assert(0 != b.index);
 	size_t p = b.index;
@@ -983,6 +1307,20 @@ void LruReadonlyCache::Buffer::discard_impl() {
 }
 
 void SingleLruReadonlyCache::close(intptr_t fi) {
+	intptr_t dio_fd = -1;
+	close_impl(fi, &dio_fd);
+	close_direct(dio_fd);
+}
+
+bool SingleLruReadonlyCache::safe_close(intptr_t fi) {
+	intptr_t dio_fd = -1;
+	bool ret = safe_close_impl(fi, &dio_fd);
+	close_direct(dio_fd);
+	return ret;
+}
+
+// *dio_fd is set to rd_fd if it is opened by open_direct, caller closes it
+void SingleLruReadonlyCache::close_impl(intptr_t fi, intptr_t* dio_fd) {
 	if (fi < 0) {
 		THROW_STD(invalid_argument, "invalid fi = %zd", fi);
 	}
@@ -992,6 +1330,9 @@ void SingleLruReadonlyCache::close(intptr_t fi) {
 	File& f = m_fi_to_fd[fi];
 	assert(f.fd >= 0);
 	assert(!f.is_pending_drop);
+	if (f.dio_align) {
+		*dio_fd = f.rd_fd;
+	}
 	f.is_pending_drop = true;
 	File::remove_fi(m_fi_to_fd, f, fi, &m_fi_busylist);
 	if (nillink == f.headpage) {
@@ -1008,7 +1349,7 @@ void SingleLruReadonlyCache::close(intptr_t fi) {
 	}
 }
 
-bool SingleLruReadonlyCache::safe_close(intptr_t fi) {
+bool SingleLruReadonlyCache::safe_close_impl(intptr_t fi, intptr_t* dio_fd) {
 	if (fi < 0) {
 		return false;
 	}
@@ -1023,6 +1364,9 @@ bool SingleLruReadonlyCache::safe_close(intptr_t fi) {
 	if (f.is_pending_drop) {
 		return false;
 	}
+	if (f.dio_align) {
+		*dio_fd = f.rd_fd;
+	}
 	f.is_pending_drop = true;
 	File::remove_fi(m_fi_to_fd, f, fi, &m_fi_busylist);
 	if (nillink == f.headpage) {
@@ -1040,6 +1384,57 @@ bool SingleLruReadonlyCache::safe_close(intptr_t fi) {
 	return true;
 }
 
+intptr_t SingleLruReadonlyCache::get_fd(intptr_t fi) const {
+	if (fi < 0) {
+		THROW_STD(invalid_argument, "invalid fi = %zd", fi);
+	}
+	LOCK_FILE_VECTOR_FULL;
+	return m_fi_to_fd[fi].fd;
+}
+
+bool SingleLruReadonlyCache::is_direct_io(intptr_t fi) const {
+	if (fi < 0) {
+		THROW_STD(invalid_argument, "invalid fi = %zd", fi);
+	}
+	LOCK_FILE_VECTOR_FULL;
+	return m_fi_to_fd[fi].dio_align != 0;
+}
+
+void SingleLruReadonlyCache::get_hot_pages(valvec<uint64_t>* keys) const {
+	const Node* nodes = m_hash_nodes;
+	ScopeLock lock(m_mutex);
+	keys->reserve(keys->size() + m_page_num);
+	// pages being referenced are not in lru list, they are the hottest
+	for (size_t p = 1; p <= m_page_num; ++p) {
+		if (nodes[p].ref_count && nodes[p].is_loaded)
+			keys->push_back(nodes[p].fi_offset);
+	}
+	for (size_t p = nodes[0].lru_next; 0 != p; p = nodes[p].lru_next) {
+		if (uint64_t(-1) != nodes[p].fi_offset && nodes[p].is_loaded)
+			keys->push_back(nodes[p].fi_offset);
+	}
+}
+
+void SingleLruReadonlyCache::get_open_files(valvec<OpenFile>* files) const {
+	LOCK_FILE_VECTOR_FULL;
+	size_t head = m_fi_busylist;
+	if (nillink == head) {
+		return;
+	}
+	size_t fi = head;
+	do {
+		const File& f = m_fi_to_fd[fi];
+		files->push_back({intptr_t(fi), intptr_t(fi), f.fd});
+		fi = f.next_fi;
+	} while (fi != head);
+}
+
+void SingleLruReadonlyCache::warmup_page(intptr_t fi, size_t page) {
+	valvec<byte_t> rdbuf;
+	Buffer b(&rdbuf);
+	pread_impl(fi, page * PAGE_SIZE, 1, &b, TERARK_IF_MSVC(false, true));
+}
+
 valvec<size_t> SingleLruReadonlyCache::get_histogram_snapshot() const {
 	valvec<size_t> histogram(m_histogram.capacity() + 10, valvec_reserve());
 	ScopeLock lock(m_mutex);
@@ -1048,12 +1443,54 @@ valvec<size_t> SingleLruReadonlyCache::get_histogram_snapshot() const {
 }
 
 void SingleLruReadonlyCache::print_stat_cnt(FILE* fp) const {
-	print_stat_cnt_impl(fp, m_stat_cnt, get_histogram_snapshot());
+	print_stat_cnt_impl(fp, m_policy, m_stat_cnt, m_sketch.resets(),
+						get_histogram_snapshot());
+	if (m_numa_node >= 0) {
+		print_numa_stat_head(fp);
+		print_numa_stat_line(fp, m_numa_node, 1, stat_hit_cnt(),
+							 stat_all_cnt(), m_remote_cnt);
+	}
+}
+
+LruReadonlyCache::StatCnt
+SingleLruReadonlyCache::get_stat_cnt(intptr_t shard) const {
+	if (shard > 0) {
+		THROW_STD(invalid_argument, "invalid shard = %zd", shard);
+	}
+	StatCnt st;
+	memset(&st, 0, sizeof(st));
+	add_stat_cnt(&st);
+	return st;
+}
+
+void SingleLruReadonlyCache::add_stat_cnt(StatCnt* st) const {
+	ScopeLock lock(m_mutex);
+	st->hit += m_stat_cnt[Buffer::hit] + m_stat_cnt[Buffer::hit_others_load];
+	st->miss += m_stat_cnt[Buffer::evicted_others]
+			  + m_stat_cnt[Buffer::initial_free]
+			  + m_stat_cnt[Buffer::dropped_free];
+	st->no_fill += m_stat_cnt[Buffer::bypass_no_fill];
+	st->rejected += m_stat_cnt[Buffer::admit_rejected];
+	st->busy_pages += m_busypage_num;
+}
+
+void SingleLruReadonlyCache::print_numa_stat_head(FILE* fp) {
+	fprintf(fp, "----\n");
+	fprintf(fp, "| numa node | shards | hit | miss | hit ratio | remote ratio |\n");
+	fprintf(fp, "| --------: | -----: | --: | ---: | --------: | -----------: |\n");
 }
 
-void SingleLruReadonlyCache::print_stat_cnt_impl(FILE* fp, const size_t cnt[6], const valvec<size_t>& histogram) {
+void SingleLruReadonlyCache::print_numa_stat_line(FILE* fp, int node,
+		size_t shards, size_t hits, size_t all, size_t remote) {
+	fprintf(fp, "| %4d | %4zd | %12zd | %12zd | %6.3f | %6.3f |\n",
+			node, shards, hits, all - hits, hits/double(all), remote/double(all));
+}
+
+void SingleLruReadonlyCache::print_stat_cnt_impl(FILE* fp, EvictPolicy policy,
+		const size_t cnt[StatCntNum], size_t sketch_resets,
+		const valvec<size_t>& histogram) {
 	size_t sum = 0;
-	for (size_t i = 0; i < 6; ++i) sum += cnt[i];
+	for (size_t i = 0; i < StatCntNum; ++i) sum += cnt[i];
 #define PrintEnum(Enum) \
   fprintf(fp, "%-15s : %12zd, %7.3f\n", #Enum, cnt[Buffer::Enum], cnt[Buffer::Enum]/double(sum))
 	PrintEnum(hit);
@@ -1061,6 +1498,17 @@ void SingleLruReadonlyCache::print_stat_cnt_impl(FILE* fp, const size_t cnt[6],
 	PrintEnum(initial_free);
 	PrintEnum(dropped_free);
 	PrintEnum(hit_others_load);
+	PrintEnum(bypass_no_fill);
+	PrintEnum(admit_rejected);
+	fprintf(fp, "----\n");
+	size_t hits = cnt[Buffer::hit] + cnt[Buffer::hit_others_load];
+	fprintf(fp, "policy = %s, hit ratio = %7.3f\n",
+			enum_stdstr(policy).c_str(), hits/double(sum));
+	if (EvictPolicy::tiny_lfu == policy) {
+		size_t admit_tried = sum - hits - cnt[Buffer::bypass_no_fill];
+		fprintf(fp, "admit rejected ratio = %7.3f, sketch resets = %zd\n",
+				cnt[Buffer::admit_rejected]/double(admit_tried), sketch_resets);
+	}
 	fprintf(fp, "----\n");
 	fprintf(fp, "| hash conflict len | freq | ratio |\n");
 	fprintf(fp, "| ----------------- | ---- | -----:|\n");
@@ -1079,92 +1527,231 @@ public:
 	//typedef boost::fibers::mutex MutexType;
 	typedef std::mutex MutexType;
 	typedef std::lock_guard<MutexType> MutexGuard;
-	MutexType m_mutex;
+	mutable MutexType m_mutex;
 
-	explicit MultiLruReadonlyCache(size_t capacityBytes, size_t shards, size_t maxFiles, bool aio) {
+	// shard i is on numa node (i % m_numa_num), 1 == m_numa_num means
+	// numa is disabled, user fi is (shard fi << 8 | (node affinity + 1))
+	// and (shard fi << 8) for files without node affinity
+	size_t m_numa_num;
+	static const int AffinityBits = 8;
+	std::map<intptr_t, size_t> m_affinity; // only for save_index
+
+	explicit MultiLruReadonlyCache(const Options& opt) {
+		size_t shards = opt.shards;
 		m_shards.reserve(shards);
-		size_t cap_all = align_up(capacityBytes, shards*PAGE_SIZE);
+		m_numa_num = 1;
+		if (opt.numa) {
+			m_numa_num = opt.numaNodes ? opt.numaNodes : numa_node_num();
+			m_numa_num = std::min(m_numa_num, shards);
+			m_numa_num = std::min(m_numa_num, (size_t(1) << AffinityBits) - 1);
+		}
+		size_t cap_all = align_up(opt.capacityBytes, shards*PAGE_SIZE);
 		size_t cap_one = cap_all / shards;
 		for (size_t i = 0; i < shards; ++i) {
-			m_shards.emplace_back(new SingleLruReadonlyCache(cap_one, maxFiles, aio));
+			int node = m_numa_num > 1 ? int(i % m_numa_num) : -1;
+			m_shards.emplace_back(new SingleLruReadonlyCache(cap_one, opt, node));
 		}
 	}
 	~MultiLruReadonlyCache() {
 	}
 	static inline
     size_t get_shard_id(uint64_t fi_page_id, uint32_t n_shards) {
-		uint64_t hash1 = (fi_page_id << 3) | (fi_page_id >> 61);
-		uint64_t hash2 = byte_swap(hash1);
-		return size_t(hash2 % n_shards);
+		// all bits of fi_page_id are mixed into high bits of the product,
+		// pages are spread to all shards even if n_shards is power of 2
+		uint64_t hash = fi_page_id * 0x9E3779B97F4A7C15ull;
+		return size_t((hash >> 32) % n_shards);
+	}
+	// affinity is 0 or node + 1
+	inline size_t get_shard_id(uint64_t fi_page_id, size_t affinity) const {
+		size_t n_shards = m_shards.size();
+		if (0 == affinity) {
+			return get_shard_id(fi_page_id, uint32_t(n_shards));
+		}
+		size_t node = affinity - 1, nn = m_numa_num;
+		size_t n_local = (n_shards - node + nn - 1) / nn;
+		return node + nn * get_shard_id(fi_page_id, uint32_t(n_local));
 	}
 	const byte_t*
-    pread(intptr_t fi, size_t offset, size_t len, Buffer* b) override {
+    pread(intptr_t ufi, size_t offset, size_t len, Buffer* b) override {
+		const intptr_t fi = ufi >> AffinityBits;
+		const size_t affinity = ufi & ((1 << AffinityBits) - 1);
 		const uint64_t fi_at_hi32 = (uint64_t(fi) << 32);
-        const uint32_t n_shards = uint32_t(m_shards.size());
-    	size_t shard = get_shard_id(fi_at_hi32|(offset>>PAGE_BITS), n_shards);
+    	size_t shard = get_shard_id(fi_at_hi32|(offset>>PAGE_BITS), affinity);
         if ((offset & (PAGE_SIZE - 1)) + len <= PAGE_SIZE) {
     		return m_shards[shard]->pread(fi, offset, len, b);
         }
         valvec<byte_t>* unibuf = b->rdbuf;
         unibuf->ensure_capacity(len);
         unibuf->erase_all();
+        // bypassed pages are read into rdbuf of the page Buffer, which
+        // must not be unibuf, pgbuf is not allocated for cached pages
+        valvec<byte_t> pgrdbuf;
+        Buffer pgbuf(&pgrdbuf);
+        pgbuf.no_fill = b->no_fill;
+        // same as SingleLruReadonlyCache: hit if all pages are hit, mix if
+        // more than one page missed, else cache type of the missed page
+        auto cache_type = Buffer::hit;
+        size_t missed_cnt = 0;
+        auto merge_cache_type = [&]() {
+            if (!pgbuf.is_cache_hit()) {
+                cache_type = pgbuf.cache_type;
+                missed_cnt++;
+            }
+        };
         {
             size_t len1 = PAGE_SIZE - (offset % PAGE_SIZE);
-            auto data = m_shards[shard]->pread(fi, offset, len1, b);
-            assert(0 != b->index);
+            auto data = m_shards[shard]->pread(fi, offset, len1, &pgbuf);
             unibuf->append(data, len1);
-            b->discard_impl();
+            merge_cache_type();
+            pgbuf.discard();
             len -= len1;
             offset += len1;
         }
         while (len >= PAGE_SIZE) {
-    	    shard = get_shard_id(fi_at_hi32|(offset>>PAGE_BITS), n_shards);
-            auto data = m_shards[shard]->pread(fi, offset, PAGE_SIZE, b);
-            assert(0 != b->index);
+    	    shard = get_shard_id(fi_at_hi32|(offset>>PAGE_BITS), affinity);
+            auto data = m_shards[shard]->pread(fi, offset, PAGE_SIZE, &pgbuf);
             unibuf->append(data, PAGE_SIZE);
-            b->discard_impl();
+            merge_cache_type();
+            pgbuf.discard();
             len -= PAGE_SIZE;
             offset += PAGE_SIZE;
         }
         if (len) {
-    	    shard = get_shard_id(fi_at_hi32|(offset>>PAGE_BITS), n_shards);
-            auto data = m_shards[shard]->pread(fi, offset, len, b);
-            assert(0 != b->index);
+    	    shard = get_shard_id(fi_at_hi32|(offset>>PAGE_BITS), affinity);
+            auto data = m_shards[shard]->pread(fi, offset, len, &pgbuf);
             unibuf->append(data, len);
-            b->discard_impl();
+            merge_cache_type();
+            pgbuf.discard();
         }
+        b->cache_type = missed_cnt > 1 ? Buffer::mix : cache_type;
+        b->index = 0;
 		return unibuf->data();
 	}
 	intptr_t open(intptr_t fd) override {
+		return open_on_node(fd, -1);
+	}
+	intptr_t open_on_node(intptr_t fd, int numa_node) override {
+		size_t affinity = 0;
+		if (numa_node >= 0 && m_numa_num > 1) {
+			affinity = size_t(numa_node) % m_numa_num + 1;
+		}
+		if (fd < 0) {
+			THROW_STD(invalid_argument, "invalid fd = %zd", fd);
+		}
+		// all shards share the O_DIRECT fd
+		File f(fd);
+		if (m_shards[0]->m_direct_io) {
+			open_direct(&f);
+		}
 	    MutexGuard lock(m_mutex);
-		intptr_t fi = m_shards[0]->open(fd);
+		intptr_t fi = m_shards[0]->open_impl(f);
 		for (size_t i = 1; i < m_shards.size(); ++i) {
-			intptr_t fii = m_shards[i]->open(fd);
+			intptr_t fii = m_shards[i]->open_impl(f);
 			TERARK_RT_assert(fi == fii, std::logic_error);
 		}
-		return fi;
+		if (affinity) {
+			m_affinity[fi] = affinity;
+		}
+		return fi << AffinityBits | affinity;
 	}
-	void close(intptr_t fi) override {
+	void close(intptr_t ufi) override {
+		if (ufi < 0) {
+			THROW_STD(invalid_argument, "invalid fi = %zd", ufi);
+		}
+		intptr_t fi = ufi >> AffinityBits;
+		intptr_t dio_fd = -1;
 	    MutexGuard lock(m_mutex);
 		for (auto& p : m_shards) {
-			p->close(fi);
+			p->close_impl(fi, &dio_fd);
 		}
+		close_direct(dio_fd);
+		m_affinity.erase(fi);
 	}
-	bool safe_close(intptr_t fi) override {
+	bool safe_close(intptr_t ufi) override {
+		if (ufi < 0) {
+			return false;
+		}
+		intptr_t fi = ufi >> AffinityBits;
 	    MutexGuard lock(m_mutex);
 		bool bRet = false;
+		intptr_t dio_fd = -1;
 		for (auto& p : m_shards) {
-			bRet = p->safe_close(fi);
+			bRet = p->safe_close_impl(fi, &dio_fd);
 		}
+		close_direct(dio_fd);
+		m_affinity.erase(fi);
 		return bRet;
 	}
+	intptr_t get_fd(intptr_t ufi) const override {
+		if (ufi < 0) {
+			THROW_STD(invalid_argument, "invalid fi = %zd", ufi);
+		}
+		return m_shards[0]->get_fd(ufi >> AffinityBits);
+	}
+	bool is_direct_io(intptr_t ufi) const override {
+		if (ufi < 0) {
+			THROW_STD(invalid_argument, "invalid fi = %zd", ufi);
+		}
+		return m_shards[0]->is_direct_io(ufi >> AffinityBits);
+	}
+	void get_hot_pages(valvec<uint64_t>* keys) const override {
+		// interleave shards to approximate the global lru order
+		valvec<valvec<uint64_t> > shard_keys(m_shards.size());
+		size_t max_len = 0;
+		for (size_t i = 0; i < m_shards.size(); ++i) {
+			m_shards[i]->get_hot_pages(&shard_keys[i]);
+			max_len = std::max(max_len, shard_keys[i].size());
+		}
+		for (size_t j = 0; j < max_len; ++j) {
+			for (auto& sk : shard_keys) {
+				if (j < sk.size())
+					keys->push_back(sk[j]);
+			}
+		}
+	}
+	void get_open_files(valvec<OpenFile>* files) const override {
+		MutexGuard lock(m_mutex);
+		size_t oldsize = files->size();
+		m_shards[0]->get_open_files(files);
+		for (size_t i = oldsize; i < files->size(); ++i) {
+			OpenFile& f = (*files)[i];
+			auto iter = m_affinity.find(f.raw_fi);
+			size_t affinity = m_affinity.end() == iter ? 0 : iter->second;
+			f.fi = f.raw_fi << AffinityBits | affinity;
+		}
+	}
+	void warmup_page(intptr_t ufi, size_t page) override {
+		const intptr_t fi = ufi >> AffinityBits;
+		const size_t affinity = ufi & ((1 << AffinityBits) - 1);
+		size_t shard = get_shard_id(uint64_t(fi) << 32 | page, affinity);
+		m_shards[shard]->warmup_page(fi, page);
+	}
+	StatCnt get_stat_cnt(intptr_t shard) const override {
+		if (shard >= intptr_t(m_shards.size())) {
+			THROW_STD(invalid_argument, "invalid shard = %zd, shards = %zd",
+					  shard, m_shards.size());
+		}
+		StatCnt st;
+		memset(&st, 0, sizeof(st));
+		if (shard >= 0) {
+			m_shards[shard]->add_stat_cnt(&st);
+		} else {
+			for (auto& p : m_shards)
+				p->add_stat_cnt(&st);
+		}
+		return st;
+	}
+	size_t shard_num() const override { return m_shards.size(); }
 	void print_stat_cnt(FILE* fp) const override {
-		size_t cnt[6];
+		const size_t StatCntNum = SingleLruReadonlyCache::StatCntNum;
+		size_t cnt[StatCntNum];
+		size_t sketch_resets = 0;
 		memset(cnt, 0, sizeof(cnt));
 		for (auto& p : m_shards) {
-			for (size_t i = 0; i < 6; ++i) {
+			for (size_t i = 0; i < StatCntNum; ++i) {
 				cnt[i] += p->m_stat_cnt[i];
 			}
+			sketch_resets += p->m_sketch.resets();
 		}
 		valvec<size_t> histogram(128, valvec_reserve());
 		for (auto& p : m_shards) {
@@ -1176,24 +1763,205 @@ public:
 				histogram[i] += hist1[i];
 			}
 		}
-		SingleLruReadonlyCache::print_stat_cnt_impl(fp, cnt, histogram);
+		SingleLruReadonlyCache::print_stat_cnt_impl(fp, m_shards[0]->m_policy,
+			cnt, sketch_resets, histogram);
+		if (m_numa_num > 1) {
+			SingleLruReadonlyCache::print_numa_stat_head(fp);
+			for (size_t node = 0; node < m_numa_num; ++node) {
+				size_t shards = 0, hits = 0, all = 0, remote = 0;
+				for (size_t i = node; i < m_shards.size(); i += m_numa_num) {
+					auto& p = m_shards[i];
+					hits += p->stat_hit_cnt();
+					all += p->stat_all_cnt();
+					remote += p->m_remote_cnt;
+					shards++;
+				}
+				SingleLruReadonlyCache::print_numa_stat_line(fp, int(node),
+						shards, hits, all, remote);
+			}
+		}
 	}
 };
 
 LruReadonlyCache*
 LruReadonlyCache::create(size_t totalcapacityBytes, size_t shards, size_t maxFiles, bool aio) {
+	Options opt;
+	opt.capacityBytes = totalcapacityBytes;
+	opt.shards = shards;
+	opt.maxFiles = maxFiles;
+	opt.aio = aio;
+	return create(opt);
+}
+
+LruReadonlyCache*
+LruReadonlyCache::create(const Options& opt) {
     if (g_lruLogLevel >= 3) {
         fprintf(stderr,
-          "INFO: LruReadonlyCache::create(cap=%zd, shards=%zd, files=%zd, aio=%d)\n",
-          totalcapacityBytes, shards, maxFiles, aio);
+          "INFO: LruReadonlyCache::create(cap=%zd, shards=%zd, files=%zd, aio=%d, directIO=%d, policy=%s)\n",
+          opt.capacityBytes, opt.shards, opt.maxFiles, opt.aio, opt.directIO,
+          enum_stdstr(opt.policy).c_str());
     }
-	if (shards <= 1) {
-		return new SingleLruReadonlyCache(totalcapacityBytes, maxFiles, aio);
+	if (opt.shards <= 1) {
+		return new SingleLruReadonlyCache(opt.capacityBytes, opt, -1);
+	}
+	if (opt.shards >= 500) {
+		THROW_STD(invalid_argument, "too large shard num = %zd", opt.shards);
 	}
-	if (shards >= 500) {
-		THROW_STD(invalid_argument, "too large shard num = %zd", shards);
+	return new MultiLruReadonlyCache(opt);
+}
+
+intptr_t LruReadonlyCache::open_on_node(intptr_t fd, int /*numa_node*/) {
+	return open(fd);
+}
+
+namespace lru_detail {
+	struct IndexFileHeader {
+		char     magic[16];
+		uint32_t version;
+		uint32_t file_num;
+		uint64_t page_num;
+	};
+	struct IndexFileId {
+		uint64_t dev;
+		uint64_t ino;
+		bool operator<(const IndexFileId& y) const {
+			return dev < y.dev || (dev == y.dev && ino < y.ino);
+		}
+	};
+	struct IndexFilePage {
+		uint32_t file_idx;
+		uint32_t page;
+	};
+	static const char IndexFileMagic[16] = "terark-lru-idx";
+}
+
+static IndexFileId get_file_id(intptr_t fd, uint64_t* fsize) {
+	IndexFileId id;
+#if defined(_MSC_VER)
+	BY_HANDLE_FILE_INFORMATION info;
+	if (!GetFileInformationByHandle((HANDLE)fd, &info)) {
+		THROW_STD(logic_error, "GetFileInformationByHandle(%zd) : ErrCode = %zd",
+			fd, (size_t)GetLastError());
+	}
+	id.dev = info.dwVolumeSerialNumber;
+	id.ino = uint64_t(info.nFileIndexHigh) << 32 | info.nFileIndexLow;
+	*fsize = uint64_t(info.nFileSizeHigh) << 32 | info.nFileSizeLow;
+#else
+	struct stat st;
+	if (::fstat(int(fd), &st) < 0) {
+		THROW_STD(logic_error, "fstat(fd = %zd) = %s", fd, strerror(errno));
 	}
-	return new MultiLruReadonlyCache(totalcapacityBytes, shards, maxFiles, aio);
+	id.dev = st.st_dev;
+	id.ino = st.st_ino;
+	*fsize = st.st_size;
+#endif
+	return id;
+}
+
+void LruReadonlyCache::save_index(fstring path) const {
+	valvec<OpenFile> files;
+	valvec<uint64_t> keys;
+	get_open_files(&files);
+	get_hot_pages(&keys);
+	gold_hash_map<intptr_t, uint32_t> raw_fi_to_idx;
+	valvec<IndexFileId> ids(files.size(), valvec_reserve());
+	for (const OpenFile& f : files) {
+		uint64_t fsize;
+		raw_fi_to_idx[f.raw_fi] = uint32_t(ids.size());
+		ids.push_back(get_file_id(f.fd, &fsize));
+	}
+	valvec<IndexFilePage> pages(keys.size(), valvec_reserve());
+	for (uint64_t key : keys) {
+		size_t idx = raw_fi_to_idx.find_i(intptr_t(key >> 32));
+		if (raw_fi_to_idx.end_i() != idx) // skip pages of closed files
+			pages.push_back({raw_fi_to_idx.val(idx), uint32_t(key)});
+	}
+	IndexFileHeader header;
+	memcpy(header.magic, IndexFileMagic, sizeof(header.magic));
+	header.version = 1;
+	header.file_num = uint32_t(ids.size());
+	header.page_num = pages.size();
+	std::string tmp = path + ".tmp";
+	{
+		FileStream fp(tmp, "wb");
+		fp.ensureWrite(&header, sizeof(header));
+		fp.ensureWrite(ids.data(), sizeof(IndexFileId) * ids.size());
+		fp.ensureWrite(pages.data(), sizeof(IndexFilePage) * pages.size());
+	}
+	if (::rename(tmp.c_str(), path.c_str()) < 0) {
+		THROW_STD(logic_error, "rename(%s, %s) = %s",
+			tmp.c_str(), path.c_str(), strerror(errno));
+	}
+}
+
+void LruReadonlyCache::warmup_task(void* self, size_t fi, size_t page) {
+	static_cast<LruReadonlyCache*>(self)->warmup_page(intptr_t(fi), page);
+}
+
+size_t LruReadonlyCache::warmup_from(fstring path, size_t concurrency) {
+	IndexFileHeader header;
+	valvec<IndexFileId> ids;
+	valvec<IndexFilePage> pages;
+	{
+		FileStream fp(path, "rb");
+		fp.ensureRead(&header, sizeof(header));
+		if (memcmp(header.magic, IndexFileMagic, sizeof(header.magic)) != 0) {
+			THROW_STD(invalid_argument, "%s is not a LruReadonlyCache index",
+				path.c_str());
+		}
+		if (header.version != 1) {
+			THROW_STD(invalid_argument, "%s: unsupported version = %u",
+				path.c_str(), header.version);
+		}
+		ids.resize_no_init(header.file_num);
+		pages.resize_no_init(header.page_num);
+		fp.ensureRead(ids.data(), sizeof(IndexFileId) * ids.size());
+		fp.ensureRead(pages.data(), sizeof(IndexFilePage) * pages.size());
+	}
+	valvec<OpenFile> files;
+	get_open_files(&files);
+	std::map<IndexFileId, std::pair<intptr_t, uint64_t> > id_to_file;
+	for (const OpenFile& f : files) {
+		uint64_t fsize;
+		IndexFileId id = get_file_id(f.fd, &fsize);
+		id_to_file[id] = std::make_pair(f.fi, fsize);
+	}
+	valvec<std::pair<intptr_t, uint64_t> > idx_to_file(ids.size(), {-1, 0});
+	for (size_t i = 0; i < ids.size(); ++i) {
+		auto iter = id_to_file.find(ids[i]);
+		if (id_to_file.end() != iter)
+			idx_to_file[i] = iter->second;
+	}
+	// load coldest page first, thus hottest page is at lru head finally
+	valvec<std::pair<intptr_t, size_t> > todo(pages.size(), valvec_reserve());
+	for (size_t i = pages.size(); i-- > 0; ) {
+		const IndexFilePage& pg = pages[i];
+		if (pg.file_idx >= ids.size()) {
+			continue;
+		}
+		auto file = idx_to_file[pg.file_idx];
+		if (file.first >= 0 && uint64_t(pg.page) * PAGE_SIZE < file.second)
+			todo.push_back({file.first, pg.page});
+	}
+	if (g_lruLogLevel >= 2) {
+		fprintf(stderr,
+		  "INFO: LruReadonlyCache::warmup_from(%s): files = %zd, pages = %zd, todo = %zd\n",
+		  path.c_str(), ids.size(), pages.size(), todo.size());
+	}
+#if defined(_MSC_VER)
+	TERARK_UNUSED_VAR(concurrency);
+	for (auto& x : todo) {
+		warmup_page(x.first, x.second);
+	}
+#else
+	static thread_local FiberPool fiber_pool(boost::fibers::context::active_pp());
+	fiber_pool.update_fiber_count(int(std::max<size_t>(concurrency, 1)));
+	for (auto& x : todo) {
+		fiber_pool.push({&LruReadonlyCache::warmup_task, this, size_t(x.first), x.second});
+	}
+	fiber_pool.wait();
+#endif
+	return todo.size();
 }
 
 } // namespace terark
@@ -1,7 +1,9 @@
 #pragma once
 
 #include <terark/valvec.hpp>
+#include <terark/fstring.hpp>
 #include <terark/util/refcount.hpp>
+#include <terark/util/enum.hpp>
 #include <boost/noncopyable.hpp>
 
 namespace terark {
@@ -10,6 +12,22 @@ class SingleLruReadonlyCache;
 class  MultiLruReadonlyCache;
 class TERARK_DLL_EXPORT LruReadonlyCache : public RefCounter {
 public:
+	TERARK_ENUM_CLASS_INCLASS(EvictPolicy, byte_t,
+		lru,      // plain LRU
+		tiny_lfu  // LRU eviction + TinyLFU admission, scan resistant
+	);
+	struct Options {
+		size_t capacityBytes = 0;
+		size_t shards = 1;
+		size_t maxFiles = 1024;
+		bool   aio = false;
+		bool   numa = false;    // put shards on numa nodes round robin
+		size_t numaNodes = 0;   // with numa, 0 means numa_node_num(), else
+		                        // shards are put on numaNodes logical nodes
+		bool   hugetlb = false; // try MAP_HUGETLB, else use MADV_HUGEPAGE
+		bool   directIO = false; // read files by O_DIRECT, see fdopen_direct
+		EvictPolicy policy = EvictPolicy::lru;
+	};
 	class Buffer : private boost::noncopyable {
         friend class SingleLruReadonlyCache;
         friend class  MultiLruReadonlyCache;
@@ -19,32 +37,103 @@ public:
 			initial_free,
 			dropped_free,
 			hit_others_load,
+			bypass_no_fill,  // page not in cache, read with no_fill hint
+			admit_rejected,  // page not in cache, rejected by admission
 			mix, // for multi page only
 		};
         SingleLruReadonlyCache* owner;
         valvec<byte_t>*         rdbuf;
 		uint32_t  index; // index == 0 indicate not ref any page
 		CacheType cache_type;
-	//	byte_t    reserved;
+		bool      no_fill;
 	//	uint16_t  missed_pages;
         void discard_impl();
     public:
         explicit
-         Buffer(valvec<byte_t>* rb) : rdbuf(rb), index(0) { assert(rb); }
+         Buffer(valvec<byte_t>* rb) : rdbuf(rb), index(0), no_fill(false) { assert(rb); }
         ~Buffer() { discard(); }
         void discard() { if (index) discard_impl(); }
+
+        /// read hint for sequential/compaction reads: missed pages are read
+        /// into rdbuf and are not filled into the cache, thus a full scan
+        /// does not flush the hot working set
+        void set_no_fill(bool val) { no_fill = val; }
+        bool is_no_fill() const { return no_fill; }
+
+        /// after pread, true if all pages are in cache
+        bool is_cache_hit() const {
+            return hit == cache_type || hit_others_load == cache_type;
+        }
 	};
 	static LruReadonlyCache*
 	create(size_t totalcapacityBytes, size_t shards, size_t maxFiles, bool aio);
+	static LruReadonlyCache* create(const Options&);
 
 	virtual const byte_t* pread(intptr_t fi, size_t offset, size_t len, Buffer*) = 0;
 	virtual intptr_t open(intptr_t fd) = 0;
+
+	/// pages of the file are only cached by shards on numa_node, thus reads
+	/// from threads on numa_node are local, numa_node < 0 means no affinity.
+	/// same as open(fd) if numa is not enabled
+	virtual intptr_t open_on_node(intptr_t fd, int numa_node);
 	virtual void close(intptr_t fi) = 0;
 	virtual bool safe_close(intptr_t fi) = 0;
+	virtual intptr_t get_fd(intptr_t fi) const = 0;
+
+	/// true if fi is read by O_DIRECT, page cache hints such as
+	/// posix_fadvise(WILLNEED) on get_fd(fi) should be skipped
+	virtual bool is_direct_io(intptr_t fi) const = 0;
 	virtual void print_stat_cnt(FILE*) const = 0;
+
+	/// page access counts, a cross page read counts each of its pages
+	struct StatCnt {
+		size_t hit;        // page is in cache, include loading by others
+		size_t miss;       // page is read from file and filled into cache
+		size_t no_fill;    // page is read from file by reads with no_fill
+		size_t rejected;   // page is read from file, rejected by tiny_lfu
+		size_t busy_pages; // cached pages of opened files
+	};
+	/// stat of the shard, shard < 0 means sum of all shards
+	virtual StatCnt get_stat_cnt(intptr_t shard = -1) const = 0;
+	virtual size_t shard_num() const = 0;
+
+	/// save (file, page) of the cached pages in MRU order, files are
+	/// identified by (st_dev, st_ino), so the index is valid after restart
+	void save_index(fstring path) const;
+
+	/// reload pages recorded by save_index, pages are read by aio in at most
+	/// concurrency fibers, files must have been opened, pages of files which
+	/// are not opened are skipped. it blocks until all pages are loaded, so
+	/// it should be called in a background thread, returns loaded page num
+	size_t warmup_from(fstring path, size_t concurrency = 32);
+
+protected:
+	struct OpenFile {
+		intptr_t fi;     // fi for pread
+		intptr_t raw_fi; // fi in page keys of get_hot_pages
+		intptr_t fd;
+	};
+	/// keys are (raw_fi << 32 | page), hottest first
+	virtual void get_hot_pages(valvec<uint64_t>* keys) const = 0;
+	virtual void get_open_files(valvec<OpenFile>* files) const = 0;
+	virtual void warmup_page(intptr_t fi, size_t page) = 0;
+	static void warmup_task(void* self, size_t fi, size_t page);
 };
 
 TERARK_DLL_EXPORT
 void fdpread(intptr_t fd, void* buf, size_t len, size_t offset);
 
+/// open the file of fd again with O_DIRECT, reads of the returned fd bypass
+/// the os page cache. *align is the alignment of buffer, offset and length
+/// required by the file, it is detected by statx(STATX_DIOALIGN) or by probe
+/// reads. returns -1 if the file does not support O_DIRECT, e.g. tmpfs
+TERARK_DLL_EXPORT
+intptr_t fdopen_direct(intptr_t fd, size_t* align);
+
+/// pread on fd returned by fdopen_direct, buf, len and offset need not to be
+/// aligned: the range is expanded to align and read into an aligned bounce
+/// buffer when any of them is not aligned
+TERARK_DLL_EXPORT
+void fdpread_direct(intptr_t fd, size_t align, void* buf, size_t len, size_t offset);
+
 } // namespace terark
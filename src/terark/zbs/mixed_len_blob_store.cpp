@@ -434,15 +434,9 @@ void MixedLenBlobStoreTpl<rank_select_t>::init_from_memory(fstring dataMem, Dict
                                                           : sizeof(uint32_t))
                 : m_fixedLen);
     m_fixedNum = mmapBase->fixedNum;
-	if (m_checksumLevel == 3 && isChecksumVerifyEnabled()) {
-		XXHash64 hash(g_dmbsnark_seed);
-		hash.update(mmapBase, mmapBase->fileSize - sizeof(BlobStoreFileFooter));
-		const uint64_t hashVal = hash.digest();
-		auto &footer = ((const BlobStoreFileFooter*)((const byte_t*)(mmapBase)+mmapBase->fileSize))[-1];
-		if (hashVal != footer.fileXXHash) {
-			std::string msg = "MixedLenBlobStore::load_mmap(\"" + get_fpath() + "\")";
-			throw BadChecksumException(msg, footer.fileXXHash, hashVal);
-		}
+	if (m_checksumLevel == 3 && isDataChecksumVerifyEnabled()) {
+		VerifyFileXXHash(fstring((const char*)mmapBase, mmapBase->fileSize), g_dmbsnark_seed,
+		                 "MixedLenBlobStore::load_mmap(\"" + get_fpath() + "\")");
 	}
 	byte_t* curr = (byte_t*)(mmapBase + 1);
 	if (m_fixedNum) {
@@ -468,6 +462,14 @@ void MixedLenBlobStoreTpl<rank_select_t>::init_from_memory(fstring dataMem, Dict
     set_func_ptr();
 }
 
+template<class rank_select_t>
+function<void(fstring)> MixedLenBlobStoreTpl<rank_select_t>::data_checksum_verifier() const {
+    if (m_checksumLevel != 3)
+        return nullptr;
+    std::string msg = "MixedLenBlobStore::load_mmap(\"" + get_fpath() + "\")";
+    return [msg](fstring mem) { VerifyFileXXHash(mem, g_dmbsnark_seed, msg); };
+}
+
 template<class rank_select_t>
 void MixedLenBlobStoreTpl<rank_select_t>::get_meta_blocks(valvec<Block>* blocks) const {
     blocks->erase_all();
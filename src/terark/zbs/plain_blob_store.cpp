@@ -99,15 +99,9 @@ void PlainBlobStore::init_from_memory(fstring dataMem, Dictionary/*dict*/) {
     m_unzipSize = mmapBase->contentBytes;
     m_checksumLevel = mmapBase->checksumLevel;
     m_checksumType = mmapBase->checksumType;
-    if (m_checksumLevel == 3 && isChecksumVerifyEnabled()) {
-        XXHash64 hash(g_dpbsnark_seed);
-        hash.update(mmapBase, mmapBase->fileSize - sizeof(BlobStoreFileFooter));
-        const uint64_t hashVal = hash.digest();
-        auto& footer = ((const BlobStoreFileFooter*)((const byte_t*)(mmapBase) + mmapBase->fileSize))[-1];
-        if (hashVal != footer.fileXXHash) {
-            std::string msg = "PlainBlobStore::load_mmap(\"" + get_fpath() + "\")";
-            throw BadChecksumException(msg, footer.fileXXHash, hashVal);
-        }
+    if (m_checksumLevel == 3 && isDataChecksumVerifyEnabled()) {
+        VerifyFileXXHash(fstring((const char*)mmapBase, mmapBase->fileSize), g_dpbsnark_seed,
+                         "PlainBlobStore::load_mmap(\"" + get_fpath() + "\")");
     }
     assert(mmapBase->offsetsUintBits == UintVecMin0::compute_uintbits(mmapBase->contentBytes));
     m_content.risk_set_data((byte_t*)(mmapBase + 1), mmapBase->contentBytes);
@@ -116,6 +110,13 @@ void PlainBlobStore::init_from_memory(fstring dataMem, Dictionary/*dict*/) {
     assert(m_offsets.mem_size() == mmapBase->offsetsBytes);
 }
 
+function<void(fstring)> PlainBlobStore::data_checksum_verifier() const {
+    if (m_checksumLevel != 3)
+        return nullptr;
+    std::string msg = "PlainBlobStore::load_mmap(\"" + get_fpath() + "\")";
+    return [msg](fstring mem) { VerifyFileXXHash(mem, g_dpbsnark_seed, msg); };
+}
+
 void PlainBlobStore::get_meta_blocks(valvec<Block>* blocks) const {
     blocks->erase_all();
     blocks->push_back({"offsets", {m_offsets.data(), (ptrdiff_t)m_offsets.mem_size()}});
@@ -385,8 +386,14 @@ class PlainBlobStore::MyBuilder::Impl : boost::noncopyable {
     size_t m_content_input_size;
     int m_checksumLevel;
     int m_checksumType;
+    // checksumLevel 2 with kCRC32C: small records are appended to m_batch
+    // with a crc slot after each, crcs are computed by Crc32c_update_batch
+    valvec<byte_t> m_batch;
+    valvec<size_t> m_batch_pos;
 
     static const size_t offset_flush_size = 128;
+    static const size_t batch_max_num = 48;
+    static const size_t batch_max_reclen = 768; // longer is 3-way by itself
 public:
     Impl(size_t contentSize, fstring fpath, size_t offset, int checksumLevel, int checksumType)
         : m_fpath(fpath.begin(), fpath.end())
@@ -420,22 +427,56 @@ public:
     }
     void add_record(fstring rec) {
         m_offset_builder->push_back(m_content_size);
-        m_writer.ensureWrite(rec.data(), rec.size());
         m_content_size += rec.size();
-        if (2 == m_checksumLevel) {
-            if (kCRC16C == m_checksumType) {
-                uint16_t crc = Crc16c_update(0, rec.data(), rec.size());
-                m_writer.ensureWrite(&crc, sizeof(crc));
-                m_content_size += sizeof(crc);
-            } else { // kCRC32C
+        if (2 == m_checksumLevel && kCRC32C == m_checksumType) {
+            if (rec.size() < batch_max_reclen) {
+                m_batch_pos.push_back(m_batch.size());
+                m_batch.append(rec.data(), rec.size());
+                m_batch.grow_no_init(sizeof(uint32_t));
+                if (m_batch_pos.size() == batch_max_num) {
+                    flush_batch();
+                }
+            } else {
+                flush_batch();
                 uint32_t crc = Crc32c_update(0, rec.data(), rec.size());
+                m_writer.ensureWrite(rec.data(), rec.size());
+                m_writer.ensureWrite(&crc, sizeof(crc));
+            }
+            m_content_size += sizeof(uint32_t);
+        }
+        else {
+            m_writer.ensureWrite(rec.data(), rec.size());
+            if (2 == m_checksumLevel) { // kCRC16C
+                uint16_t crc = Crc16c_update(0, rec.data(), rec.size());
                 m_writer.ensureWrite(&crc, sizeof(crc));
                 m_content_size += sizeof(crc);
             }
         }
         ++m_num_records;
     }
+    void flush_batch() {
+        size_t num = m_batch_pos.size();
+        if (0 == num) {
+            return;
+        }
+        m_batch_pos.push_back(m_batch.size());
+        const void* bufs[batch_max_num];
+        size_t      lens[batch_max_num];
+        uint32_t    crcs[batch_max_num];
+        for (size_t i = 0; i < num; ++i) {
+            bufs[i] = m_batch.data() + m_batch_pos[i];
+            lens[i] = m_batch_pos[i+1] - m_batch_pos[i] - sizeof(uint32_t);
+        }
+        Crc32c_update_batch(num, bufs, lens, crcs);
+        for (size_t i = 0; i < num; ++i) {
+            unaligned_save(m_batch.data() + m_batch_pos[i] + lens[i], crcs[i]);
+        }
+        m_writer.ensureWrite(m_batch.data(), m_batch.size());
+        m_batch.erase_all();
+        m_batch_pos.erase_all();
+    }
     void finish() {
+        flush_batch();
         assert(m_content_size <= m_content_input_size);
         (void)m_content_input_size;
         PadzeroForAlign<16>(m_writer, m_content_size);
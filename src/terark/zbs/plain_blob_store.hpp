@@ -27,6 +27,7 @@ class TERARK_DLL_EXPORT PlainBlobStore : public AbstractBlobStore {
 	size_t get_zipped_size_imp(size_t recID, CacheOffsets* co) const;
 public:
     void init_from_memory(fstring dataMem, Dictionary dict) override;
+    function<void(fstring)> data_checksum_verifier() const override;
     void get_meta_blocks(valvec<Block>* blocks) const override;
     void get_data_blocks(valvec<Block>* blocks) const override;
     void detach_meta_blocks(const valvec<Block>& blocks) override;
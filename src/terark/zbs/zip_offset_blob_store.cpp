@@ -99,15 +99,9 @@ void ZipOffsetBlobStore::init_from_memory(fstring dataMem, Dictionary/*dict*/) {
     m_checksumType = mmapBase->checksumType;
     m_compressLevel = mmapBase->compressLevel;
     m_supportZeroCopy = (0 == m_compressLevel);
-    if (m_checksumLevel == 3 && isChecksumVerifyEnabled()) {
-        XXHash64 hash(g_dpbsnark_seed);
-        hash.update(mmapBase, mmapBase->fileSize - sizeof(BlobStoreFileFooter));
-        const uint64_t hashVal = hash.digest();
-        auto &footer = ((const BlobStoreFileFooter*)((const byte_t*)(mmapBase) + mmapBase->fileSize))[-1];
-        if (hashVal != footer.fileXXHash) {
-            std::string msg = "ZipOffsetBlobStore::load_mmap(\"" + get_fpath() + "\")";
-            throw BadChecksumException(msg, footer.fileXXHash, hashVal);
-        }
+    if (m_checksumLevel == 3 && isDataChecksumVerifyEnabled()) {
+        VerifyFileXXHash(fstring((const char*)mmapBase, mmapBase->fileSize), g_dpbsnark_seed,
+                         "ZipOffsetBlobStore::load_mmap(\"" + get_fpath() + "\")");
     }
     m_content.risk_set_data((byte_t*)(mmapBase + 1), mmapBase->contentBytes);
     m_offsets.risk_set_data(m_content.data() + align_up(m_content.size(), 16), mmapBase->offsetsBytes);
@@ -128,6 +122,13 @@ void ZipOffsetBlobStore::init_from_memory(fstring dataMem, Dictionary/*dict*/) {
     set_func();
 }
 
+function<void(fstring)> ZipOffsetBlobStore::data_checksum_verifier() const {
+    if (m_checksumLevel != 3)
+        return nullptr;
+    std::string msg = "ZipOffsetBlobStore::load_mmap(\"" + get_fpath() + "\")";
+    return [msg](fstring mem) { VerifyFileXXHash(mem, g_dpbsnark_seed, msg); };
+}
+
 void ZipOffsetBlobStore::get_meta_blocks(valvec<Block>* blocks) const {
     blocks->erase_all();
     blocks->push_back({"offsets", {m_offsets.data(), (ptrdiff_t)m_offsets.mem_size()}});
@@ -46,6 +46,7 @@ public:
     void swap(ZipOffsetBlobStore& other);
 
     void init_from_memory(fstring dataMem, Dictionary dict) override;
+    function<void(fstring)> data_checksum_verifier() const override;
     void get_meta_blocks(valvec<Block>* blocks) const override;
     void get_data_blocks(valvec<Block>* blocks) const override;
     void detach_meta_blocks(const valvec<Block>& blocks) override;
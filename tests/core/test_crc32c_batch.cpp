@@ -0,0 +1,97 @@
+// Crc32c_update_batch: crcs must be same as scalar Crc32c_update and a
+// bitwise reference, for random record lengths(including 0 and shorter than
+// a crc word), unaligned buffers and record counts which are not multiple
+// of the 3-way interleave
+#include <terark/util/crc.hpp>
+#include <terark/util/throw.hpp>
+#include <random>
+#include <vector>
+
+using namespace terark;
+
+// bit reflected CRC32C without pre/post inversion, same as Crc32c_update
+static uint32_t crc32c_bitwise(uint32_t crc, const unsigned char* p, size_t len) {
+    for (size_t i = 0; i < len; ++i) {
+        crc ^= p[i];
+        for (int k = 0; k < 8; ++k)
+            crc = crc & 1 ? (crc >> 1) ^ 0x82F63B78 : crc >> 1;
+    }
+    return crc;
+}
+
+static size_t rand_len(std::mt19937& rnd) {
+    switch (rnd() % 8) {
+    case 0:  return 0;
+    case 1:  return rnd() % 8;    // shorter than a crc word
+    case 2:  return 8 + rnd() % 8;
+    case 3:  return 4096 + rnd() % 4096;
+    default: return rnd() % 768;  // records batched by PlainBlobStore
+    }
+}
+
+static void test_batch(std::mt19937& rnd, size_t num) {
+    std::vector<size_t> lens(num);
+    size_t total = 0;
+    for (auto& len : lens) {
+        len = rand_len(rnd);
+        total += len + 8;
+    }
+    std::vector<unsigned char> mem(total + 8);
+    for (auto& c : mem)
+        c = (unsigned char)rnd();
+    std::vector<const void*> bufs(num);
+    size_t pos = 0;
+    for (size_t i = 0; i < num; ++i) {
+        pos += rnd() % 8; // random alignment
+        bufs[i] = mem.data() + pos;
+        pos += lens[i];
+    }
+    TERARK_VERIFY_LE(pos, mem.size());
+    std::vector<uint32_t> crcs(num + 1, 0xDEADBEEF);
+    Crc32c_update_batch(num, bufs.data(), lens.data(), crcs.data());
+    for (size_t i = 0; i < num; ++i) {
+        auto p = (const unsigned char*)bufs[i];
+        uint32_t expected = Crc32c_update(0, p, lens[i]);
+        TERARK_VERIFY_F(crcs[i] == expected, "num = %zd, i = %zd, len = %zd",
+                        num, i, lens[i]);
+        TERARK_VERIFY_EQ(expected, crc32c_bitwise(0, p, lens[i]));
+    }
+    TERARK_VERIFY_EQ(crcs[num], 0xDEADBEEF); // not written out of range
+}
+
+// all records in a 3-way group have same length, or one of them is empty
+static void test_equal_lens(std::mt19937& rnd) {
+    std::vector<unsigned char> mem(3 * 1000);
+    for (auto& c : mem)
+        c = (unsigned char)rnd();
+    for (size_t len = 0; len < 1000; len += 1 + len / 16) {
+        for (size_t empty = 0; empty < 4; ++empty) {
+            const void* bufs[3];
+            size_t lens[3];
+            uint32_t crcs[3];
+            for (size_t i = 0; i < 3; ++i) {
+                bufs[i] = mem.data() + i * len;
+                lens[i] = i == empty ? 0 : len;
+            }
+            Crc32c_update_batch(3, bufs, lens, crcs);
+            for (size_t i = 0; i < 3; ++i)
+                TERARK_VERIFY_EQ(crcs[i], Crc32c_update(0, bufs[i], lens[i]));
+        }
+    }
+}
+
+int main() {
+    std::mt19937 rnd(1);
+    Crc32c_update_batch(0, NULL, NULL, NULL);
+    for (int round = 0; round < 200; ++round) {
+        for (size_t num = 1; num <= 10; ++num)
+            test_batch(rnd, num);
+    }
+    test_batch(rnd, 48); // max batch num of PlainBlobStore
+    test_batch(rnd, 1000);
+    printf("  random lens passed\n");
+    test_equal_lens(rnd);
+    printf("  equal lens passed\n");
+    printf("test_crc32c_batch passed\n");
+    return 0;
+}
@@ -0,0 +1,109 @@
+// MmapSeqAdvise: a scan with the advice window and drop behind must read the
+// same data as the file, for unaligned ranges, windows smaller than the
+// minimum, cursors which jump, go back or pass the end, and finish twice.
+// madvise on locked pages fails with EINVAL, which must not switch the drop
+// advice of later scans, and locked pages must not be dropped
+#include <terark/util/mmap.hpp>
+#include <terark/util/throw.hpp>
+#include <sys/mman.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <random>
+#include <string>
+
+using namespace terark;
+
+static const char* g_fpath = "test_mmap_seq_advise.bin";
+
+static std::string make_data(size_t size, std::mt19937& rnd) {
+    std::string data(size, '\0');
+    for (auto& c : data)
+        c = char(rnd());
+    return data;
+}
+
+static void write_file(const std::string& data) {
+    FILE* fp = fopen(g_fpath, "wb");
+    TERARK_VERIFY(NULL != fp);
+    TERARK_VERIFY_EQ(fwrite(data.data(), 1, data.size(), fp), data.size());
+    fclose(fp);
+}
+
+// scan [beg, end) by step bytes, the advance cursor may jump by jump bytes
+static void scan(const byte_t* base, size_t beg, size_t end, size_t window,
+                 const std::string& data, std::mt19937& rnd) {
+    MmapSeqAdvise adv(base + beg, base + end, window);
+    for (size_t pos = beg; pos < end; ) {
+        size_t n = std::min(end - pos, size_t(1 + rnd() % 65536));
+        if (memcmp(base + pos, data.data() + pos, n) != 0)
+            TERARK_DIE("data mismatch at pos = %zd, window = %zd", pos, window);
+        pos += n;
+        switch (rnd() % 16) {
+        case 0: adv.advance(base + pos / 2); break; // go back
+        case 1: adv.advance(base + end + 4096); break; // pass the end
+        default: adv.advance(base + pos); break;
+        }
+    }
+    adv.finish();
+    adv.finish();
+    adv.advance(base + end); // no-op after finish
+}
+
+static void test_file_scan(std::mt19937& rnd) {
+    const size_t size = (size_t(24) << 20) + 12345;
+    const std::string data = make_data(size, rnd);
+    write_file(data);
+    MmapWholeFile mmap(g_fpath);
+    TERARK_VERIFY_EQ(mmap.size, size);
+    auto base = (const byte_t*)mmap.base;
+    for (size_t window : {size_t(0), size_t(1) << 20, size_t(4) << 20,
+                          MmapSeqAdvise::DEFAULT_WINDOW}) {
+        scan(base, 0, size, window, data, rnd);
+        scan(base, 777, size - 4321, window, data, rnd); // unaligned
+        scan(base, 100, 200, window, data, rnd); // in a page
+        scan(base, size, size, window, data, rnd); // empty
+    }
+    // data is still same after all pages are dropped
+    TERARK_VERIFY(memcmp(base, data.data(), size) == 0);
+    ::unlink(g_fpath);
+    printf("  file scan passed\n");
+}
+
+static void test_locked(std::mt19937& rnd) {
+    const int advice = MmapSeqAdvise::drop_advice();
+    const size_t size = size_t(8) << 20;
+    const std::string data = make_data(size, rnd);
+    void* mem = ::mmap(NULL, size, PROT_READ|PROT_WRITE,
+                       MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    TERARK_VERIFY(MAP_FAILED != mem);
+    memcpy(mem, data.data(), size);
+    if (::mlock(mem, size) != 0) {
+        printf("  locked skipped: mlock = %s\n", strerror(errno));
+        ::munmap(mem, size);
+        return;
+    }
+    // DONTNEED would zero the pages of this private mapping if not locked
+    scan((const byte_t*)mem, 0, size, 1 << 20, data, rnd);
+    TERARK_VERIFY(memcmp(mem, data.data(), size) == 0);
+    TERARK_VERIFY_EQ(MmapSeqAdvise::drop_advice(), advice);
+    ::munlock(mem, size);
+    ::munmap(mem, size);
+    printf("  locked passed\n");
+}
+
+int main() {
+    std::mt19937 rnd(1);
+    int advice = MmapSeqAdvise::drop_advice();
+#if defined(MADV_COLD)
+    TERARK_VERIFY(MADV_COLD == advice || MADV_DONTNEED == advice);
+#else
+    TERARK_VERIFY_EQ(advice, MADV_DONTNEED);
+#endif
+    printf("  drop advice = %s\n", MADV_DONTNEED == advice ? "DONTNEED" : "COLD");
+    test_file_scan(rnd);
+    test_locked(rnd);
+    printf("test_mmap_seq_advise passed\n");
+    return 0;
+}
@@ -0,0 +1,155 @@
+#include <terark/io/var_int.hpp>
+#include <terark/io/IStream.hpp>
+#include <terark/io/StreamBuffer.hpp>
+#include <terark/util/throw.hpp>
+#include <terark/valvec.hpp>
+#include <algorithm>
+#include <random>
+#include <stdio.h>
+
+using namespace terark;
+
+// returns at most m_chunk bytes per read, thus ints are cut at buffer end
+class ChunkInputStream : public IInputStream {
+	const byte_t* m_pos;
+	const byte_t* m_end;
+	size_t m_chunk;
+public:
+	ChunkInputStream(const valvec<byte_t>& mem, size_t chunk)
+		: m_pos(mem.data()), m_end(mem.end()), m_chunk(chunk) {}
+	size_t read(void* vbuf, size_t length) override {
+		size_t n = std::min(std::min(length, m_chunk), size_t(m_end - m_pos));
+		memcpy(vbuf, m_pos, n);
+		m_pos += n;
+		return n;
+	}
+	bool eof() const override { return m_pos == m_end; }
+};
+
+template<class UInt>
+static valvec<UInt> gen(std::mt19937_64& rnd, size_t n) {
+	valvec<UInt> a(n);
+	for (size_t i = 0; i < n; ++i) {
+		switch (rnd() % 4) {
+		case 0:  a[i] = UInt(rnd() % 128); break; // 1 byte
+		case 1:  a[i] = UInt(rnd() % 16384); break;
+		default: a[i] = UInt(rnd() >> (rnd() % 64)); break;
+		}
+		if (i / 64 % 3 == 0)
+			a[i] &= 127; // runs of 1 byte ints for the fast paths
+	}
+	return a;
+}
+
+template<class UInt>
+static valvec<byte_t> encode(const valvec<UInt>& a) {
+	valvec<byte_t> buf(a.size() * 10 + 16);
+	byte_t* end = sizeof(UInt) == 4
+		? save_var_uint32_array(buf.data(), (const uint32_t*)a.data(), a.size())
+		: save_var_uint64_array(buf.data(), (const uint64_t*)a.data(), a.size());
+	// must be same as element-wise encoding
+	valvec<byte_t> ref(a.size() * 10 + 16);
+	byte_t* p = ref.data();
+	for (size_t i = 0; i < a.size(); ++i)
+		p = sizeof(UInt) == 4 ? save_var_uint32(p, uint32_t(a[i]))
+							  : save_var_uint64(p, uint64_t(a[i]));
+	TERARK_VERIFY_EQ(end - buf.data(), p - ref.data());
+	TERARK_VERIFY_EQ(memcmp(buf.data(), ref.data(), p - ref.data()), 0);
+	buf.risk_set_size(end - buf.data());
+	buf.shrink_to_fit(); // exact size, reading past end is caught by asan
+	return buf;
+}
+
+template<class UInt>
+static const byte_t* decode(const byte_t* p, const byte_t* end, UInt* a, size_t* n) {
+	return sizeof(UInt) == 4
+		? load_var_uint32_array(p, end, (uint32_t*)a, n)
+		: load_var_uint64_array(p, end, (uint64_t*)a, n);
+}
+
+template<class UInt>
+static void test_round_trip(std::mt19937_64& rnd, size_t n) {
+	valvec<UInt> a = gen<UInt>(rnd, n);
+	valvec<byte_t> buf = encode(a);
+	valvec<UInt> b(n + 1, UInt(-1));
+	size_t k = n;
+	const byte_t* p = decode(buf.data(), buf.end(), b.data(), &k);
+	TERARK_VERIFY_EQ(k, n);
+	TERARK_VERIFY(p == buf.end());
+	for (size_t i = 0; i < n; ++i)
+		TERARK_VERIFY_EQ(a[i], b[i]);
+	TERARK_VERIFY_EQ(b[n], UInt(-1));
+}
+
+// the buffer ends in the middle of an int: complete ints are decoded and
+// the returned pointer is at the beginning of the cut int
+template<class UInt>
+static void test_cut_at_end(std::mt19937_64& rnd) {
+	const size_t n = 300;
+	valvec<UInt> a = gen<UInt>(rnd, n);
+	a.back() = UInt(-1); // max length int at the end
+	valvec<byte_t> full = encode(a);
+	valvec<size_t> offsets(n + 1);
+	const byte_t* q = full.data();
+	for (size_t i = 0; i < n; ++i) {
+		offsets[i] = q - full.data();
+		sizeof(UInt) == 4 ? load_var_uint32(q, &q) : load_var_uint64(q, &q);
+	}
+	offsets[n] = full.size();
+	for (size_t cut = 0; cut <= full.size(); ++cut) {
+		valvec<byte_t> buf(full.data(), cut);
+		buf.shrink_to_fit();
+		valvec<UInt> b(n);
+		size_t k = n;
+		const byte_t* p = decode(buf.data(), buf.data() + cut, b.data(), &k);
+		size_t complete = std::upper_bound(offsets.begin() + 1, offsets.end(), cut)
+						- (offsets.begin() + 1);
+		TERARK_VERIFY_EQ(k, complete);
+		TERARK_VERIFY_EQ(size_t(p - buf.data()), offsets[complete]);
+		for (size_t i = 0; i < k; ++i)
+			TERARK_VERIFY_EQ(a[i], b[i]);
+	}
+}
+
+// values straddle the end of the stream buffer
+template<class UInt>
+static void test_stream(std::mt19937_64& rnd, size_t bufsize, size_t chunk) {
+	const size_t n = 5000;
+	valvec<UInt> a = gen<UInt>(rnd, n);
+	valvec<byte_t> mem = encode(a);
+	ChunkInputStream cis(mem, chunk);
+	InputBuffer ib(&cis);
+	ib.initbuf(bufsize);
+	valvec<UInt> b(n);
+	for (size_t i = 0; i < n; ) {
+		size_t k = std::min(n - i, size_t(1 + rnd() % 700));
+		if (sizeof(UInt) == 4)
+			ib.read_var_uint32_array((uint32_t*)b.data() + i, k);
+		else
+			ib.read_var_uint64_array((uint64_t*)b.data() + i, k);
+		i += k;
+	}
+	TERARK_VERIFY(ib.eof());
+	for (size_t i = 0; i < n; ++i)
+		TERARK_VERIFY_EQ(a[i], b[i]);
+}
+
+int main() {
+	std::mt19937_64 rnd(12345);
+	for (size_t n : {0, 1, 7, 8, 9, 15, 16, 17, 100, 1000, 10000}) {
+		test_round_trip<uint32_t>(rnd, n);
+		test_round_trip<uint64_t>(rnd, n);
+	}
+	for (int r = 0; r < 20; ++r) {
+		test_cut_at_end<uint32_t>(rnd);
+		test_cut_at_end<uint64_t>(rnd);
+	}
+	for (size_t bufsize : {16, 64, 4096}) {
+		for (size_t chunk : {1, 7, 13, 4096}) {
+			test_stream<uint32_t>(rnd, bufsize, chunk);
+			test_stream<uint64_t>(rnd, bufsize, chunk);
+		}
+	}
+	printf("test_var_int_array passed\n");
+	return 0;
+}
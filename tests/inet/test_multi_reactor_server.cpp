@@ -0,0 +1,194 @@
+// MultiReactorServer on loopback: accept and echo by multiple clients, with
+// inline handlers and fiber handlers, pipelined and large requests, and
+// reactors do not busy spin while fiber handlers are waiting
+#include <terark/inet/MultiReactorServer.hpp>
+#include <terark/inet/MessageInputStream.hpp>
+#include <terark/util/throw.hpp>
+#include <boost/fiber/operations.hpp>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace terark;
+using rpc::MessageHeader;
+
+static const uint32_t WHOLE_PARTID = uint32_t(MSG_HEADER_WHOLE) << MSG_HEADER_SHIFT;
+
+static int connect_to(int port) {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    TERARK_VERIFY_GE(fd, 0);
+    struct sockaddr_in sa; memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(uint16_t(port));
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    TERARK_VERIFY_EQ(::connect(fd, (struct sockaddr*)&sa, sizeof(sa)), 0);
+    return fd;
+}
+
+static void send_all(int fd, const std::string& data) {
+    size_t pos = 0;
+    while (pos < data.size()) {
+        ssize_t n = ::send(fd, data.data() + pos, data.size() - pos, MSG_NOSIGNAL);
+        TERARK_VERIFY_GT(n, 0);
+        pos += n;
+    }
+}
+
+static bool recv_all(int fd, void* buf, size_t len) {
+    size_t pos = 0;
+    while (pos < len) {
+        ssize_t n = ::recv(fd, (char*)buf + pos, len - pos, 0);
+        if (n <= 0)
+            return false;
+        pos += n;
+    }
+    return true;
+}
+
+static std::string frame(uint32_t seqid, const std::string& data) {
+    MessageHeader h;
+    h.length = uint32_t(data.size());
+    h.seqid = seqid;
+    h.partid = WHOLE_PARTID;
+    h.convert();
+    return std::string((const char*)&h, sizeof(h)) + data;
+}
+
+static bool recv_reply(int fd, uint32_t* seqid, std::string* data) {
+    MessageHeader h;
+    if (!recv_all(fd, &h, sizeof(h)))
+        return false;
+    h.convert();
+    TERARK_VERIFY_EQ(h.partid, WHOLE_PARTID);
+    *seqid = h.seqid;
+    data->resize(h.length);
+    return recv_all(fd, &(*data)[0], h.length);
+}
+
+// reply is "echo:" + request
+static void echo(MultiReactorServer::Request* r) {
+    std::string reply = "echo:" + r->data().str();
+    r->reply(reply);
+}
+
+// each client sends batches of pipelined requests of random sizes, some
+// are larger than readBufSize
+static void run_client(int port, unsigned seed, size_t rounds) {
+    std::mt19937 rnd(seed);
+    int fd = connect_to(port);
+    uint32_t seqid = 0;
+    for (size_t i = 0; i < rounds; ++i) {
+        std::vector<std::string> reqs(1 + rnd() % 8);
+        std::string batch;
+        for (auto& req : reqs) {
+            size_t len = rnd() % 16 ? rnd() % 200 : 4096 + rnd() % 20000;
+            req.resize(len);
+            for (auto& c : req)
+                c = char(rnd());
+            batch += frame(seqid + uint32_t(&req - &reqs[0]), req);
+        }
+        send_all(fd, batch);
+        for (auto& req : reqs) {
+            uint32_t rseq = 0;
+            std::string reply;
+            TERARK_VERIFY(recv_reply(fd, &rseq, &reply));
+            TERARK_VERIFY_EQ(rseq, seqid + uint32_t(&req - &reqs[0]));
+            TERARK_VERIFY(reply == "echo:" + req);
+        }
+        seqid += uint32_t(reqs.size());
+    }
+    ::close(fd);
+}
+
+static void wait_closed(const MultiReactorServer& server, size_t num) {
+    for (int i = 0; i < 1000 && server.stats().closed < num; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    TERARK_VERIFY_EQ(server.stats().closed, num);
+}
+
+static void test_echo(int fibers) {
+    MultiReactorServer::Options opt;
+    opt.reactors = 3;
+    opt.fibers = fibers;
+    opt.readBufSize = 4096;
+    opt.maxMsgLen = 64 << 10;
+    MultiReactorServer server("127.0.0.1:0", opt, &echo);
+    server.start();
+    TERARK_VERIFY_GT(server.port(), 0);
+    TERARK_VERIFY_EQ(server.reactors(), 3);
+
+    const size_t clients = 8, rounds = 200;
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < clients; ++i)
+        threads.emplace_back(&run_client, server.port(), unsigned(i + 1), rounds);
+    for (auto& t : threads)
+        t.join();
+    wait_closed(server, clients);
+    auto st = server.stats();
+    TERARK_VERIFY_EQ(st.accepted, clients);
+    TERARK_VERIFY_GE(st.requests, clients * rounds);
+    TERARK_VERIFY_GT(st.recvBytes, 0);
+    TERARK_VERIFY_GT(st.sendBytes, st.recvBytes); // "echo:" prefix
+
+    // message larger than maxMsgLen closes the connection
+    int fd = connect_to(server.port());
+    send_all(fd, frame(1, std::string(opt.maxMsgLen + 1, 'x')));
+    uint32_t rseq;
+    std::string reply;
+    TERARK_VERIFY(!recv_reply(fd, &rseq, &reply));
+    ::close(fd);
+    wait_closed(server, clients + 1);
+
+    server.stop();
+    server.join();
+    printf("  echo fibers = %d passed: requests = %zd\n", fibers, st.requests);
+}
+
+// handlers are pending(as waiting fiber aio) for a while, reactors must
+// keep running them without spinning on epoll_wait(timeout = 0)
+static void test_no_busy_spin() {
+    MultiReactorServer::Options opt;
+    opt.reactors = 1;
+    opt.fibers = 4;
+    const auto wait = std::chrono::milliseconds(300);
+    MultiReactorServer server("127.0.0.1:0", opt,
+      [wait](MultiReactorServer::Request* r) {
+        auto deadline = std::chrono::steady_clock::now() + wait;
+        while (std::chrono::steady_clock::now() < deadline)
+            boost::this_fiber::yield();
+        r->reply(r->data());
+      });
+    server.start();
+    int fd = connect_to(server.port());
+    clock_t cpu0 = clock();
+    auto t0 = std::chrono::steady_clock::now();
+    send_all(fd, frame(7, "slow"));
+    uint32_t rseq = 0;
+    std::string reply;
+    TERARK_VERIFY(recv_reply(fd, &rseq, &reply));
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    double cpu = double(clock() - cpu0) / CLOCKS_PER_SEC;
+    TERARK_VERIFY_EQ(rseq, 7u);
+    TERARK_VERIFY(reply == "slow");
+    TERARK_VERIFY_GE(wall, 0.3);
+    ::close(fd);
+    server.stop();
+    server.join();
+    printf("  no busy spin: wall = %.3f, cpu = %.3f\n", wall, cpu);
+    TERARK_VERIFY_LT(cpu, wall / 2);
+}
+
+int main() {
+    test_echo(0);
+    test_echo(4);
+    test_no_busy_spin();
+    printf("test_multi_reactor_server passed\n");
+    return 0;
+}
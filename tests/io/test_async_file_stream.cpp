@@ -0,0 +1,183 @@
+// AsyncFileOutputStream: round trip, tell() and background write errors, in
+// writer thread mode and io_uring mode(falls back to writer thread if
+// io_uring is not compiled in)
+#include <terark/io/AsyncFileStream.hpp>
+#include <terark/io/IOException.hpp>
+#include <terark/util/throw.hpp>
+#include <terark/valvec.hpp>
+#include <fcntl.h>
+#include <string.h>
+#include <random>
+#include <unistd.h>
+
+using namespace terark;
+
+typedef AsyncFileOutputStream::Options Options;
+
+static const char* g_fpath = "test_async_file_stream.bin";
+
+static valvec<byte_t> read_file(const char* fpath) {
+    valvec<byte_t> data;
+    int fd = ::open(fpath, O_RDONLY);
+    TERARK_VERIFY_GE(fd, 0);
+    byte_t buf[8192];
+    intptr_t n;
+    while ((n = ::read(fd, buf, sizeof(buf))) > 0)
+        data.append(buf, n);
+    TERARK_VERIFY_EQ(n, 0);
+    ::close(fd);
+    return data;
+}
+
+// random sized writes(smaller and larger than bufSize), writeByte,
+// flush_async and wait between writes
+static void write_random(AsyncFileOutputStream& os, valvec<byte_t>& expected,
+                         std::mt19937& rnd, size_t total) {
+    const uint64_t base = os.tell() - expected.size();
+    valvec<byte_t> chunk;
+    while (expected.size() < total) {
+        switch (rnd() % 8) {
+        case 0:
+            for (size_t k = rnd() % 100; k; --k) {
+                byte_t b = byte_t(rnd());
+                os.writeByte(b);
+                expected.push_back(b);
+            }
+            break;
+        case 1:
+            os.flush_async();
+            break;
+        case 2:
+            os.wait();
+            break;
+        default:
+            chunk.resize_no_init(rnd() % (rnd() % 4 ? 3000 : 20000));
+            for (auto& b : chunk)
+                b = byte_t(rnd());
+            os.write(chunk.data(), chunk.size());
+            expected.append(chunk);
+            break;
+        }
+        TERARK_VERIFY_EQ(os.tell(), base + expected.size());
+    }
+}
+
+static void test_round_trip(const Options& opt, std::mt19937& rnd) {
+    valvec<byte_t> expected;
+    {
+        AsyncFileOutputStream os(g_fpath, opt);
+        TERARK_VERIFY(os.isOpen());
+        if (!opt.useUring)
+            TERARK_VERIFY(!os.is_uring());
+        TERARK_VERIFY_EQ(os.tell(), 0);
+        write_random(os, expected, rnd, 300000);
+        os.fdatasync();
+        TERARK_VERIFY(read_file(g_fpath) == expected); // visible after flush
+        write_random(os, expected, rnd, 400000);
+        os.close();
+        TERARK_VERIFY(!os.isOpen());
+        TERARK_VERIFY_EQ(os.tell(), 0);
+        os.close(); // close again is ok
+    }
+    TERARK_VERIFY(read_file(g_fpath) == expected);
+}
+
+// dopen writes from current file position, tell() is file offset
+static void test_dopen_offset(const Options& opt, std::mt19937& rnd) {
+    const char header[] = "header written by write(2)";
+    int fd = ::open(g_fpath, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+    TERARK_VERIFY_GE(fd, 0);
+    TERARK_VERIFY_EQ(::write(fd, header, sizeof(header)), intptr_t(sizeof(header)));
+    valvec<byte_t> expected((const byte_t*)header, sizeof(header));
+    {
+        AsyncFileOutputStream os;
+        os.dopen(fd, opt);
+        TERARK_VERIFY_EQ(os.fd(), fd);
+        TERARK_VERIFY_EQ(os.tell(), sizeof(header));
+        write_random(os, expected, rnd, 100000);
+    } // destructor closes
+    TERARK_VERIFY(read_file(g_fpath) == expected);
+}
+
+// errors of background writes are thrown by a later call, the fd is closed
+// even if close() throws
+static void test_write_error(const Options& opt, const char* what, int fd,
+                             int expected_err) {
+    AsyncFileOutputStream os;
+    os.dopen(fd, opt);
+    valvec<byte_t> data(opt.bufSize * 2 + 100, 'x');
+    int err = 0;
+    try {
+        for (int i = 0; i < 100; ++i)
+            os.write(data.data(), data.size());
+        os.flush();
+    }
+    catch (const IOException& ex) {
+        err = ex.errCode();
+    }
+    TERARK_VERIFY_EQ(err, expected_err);
+    err = 0;
+    try {
+        os.close();
+    }
+    catch (const IOException& ex) {
+        err = ex.errCode();
+    }
+    TERARK_VERIFY_EQ(err, expected_err); // error is sticky
+    TERARK_VERIFY(!os.isOpen());
+    TERARK_VERIFY_EQ(::fcntl(fd, F_GETFD), -1); // closed
+    os.close(); // no error after close
+    printf("  write error(%s) passed: %s\n", what, strerror(expected_err));
+}
+
+static void test(bool useUring) {
+    std::mt19937 rnd(useUring ? 1 : 2);
+    Options opt;
+    opt.useUring = useUring;
+    opt.bufSize = 4096; // min size, many buffer switches
+    for (size_t bufNum : {2, 3, 5}) {
+        opt.bufNum = bufNum;
+        opt.syncBytes = 0;
+        opt.syncOnClose = false;
+        test_round_trip(opt, rnd);
+        opt.syncBytes = 8192;
+        opt.syncOnClose = true;
+        test_round_trip(opt, rnd);
+        test_dopen_offset(opt, rnd);
+    }
+    opt.bufSize = 64 << 10;
+    opt.bufNum = 3;
+    test_round_trip(opt, rnd);
+
+    opt.bufSize = 4096;
+    opt.syncBytes = 0;
+    opt.syncOnClose = false;
+    {
+        // file is opened read only
+        int fd = ::open(g_fpath, O_RDONLY);
+        TERARK_VERIFY_GE(fd, 0);
+        test_write_error(opt, "read only fd", fd, EBADF);
+    }
+    if (access("/dev/full", W_OK) == 0) {
+        int fd = ::open("/dev/full", O_WRONLY);
+        TERARK_VERIFY_GE(fd, 0);
+        test_write_error(opt, "/dev/full", fd, ENOSPC);
+    }
+    {
+        // pipe is not seekable, pwrite fails
+        int fds[2];
+        TERARK_VERIFY_EQ(::pipe(fds), 0);
+        test_write_error(opt, "pipe", fds[1], ESPIPE);
+        ::close(fds[0]);
+    }
+    AsyncFileOutputStream os(g_fpath, opt);
+    printf("useUring = %d, is_uring = %d passed\n", useUring, os.is_uring());
+}
+
+int main() {
+    test(false);
+    test(true);
+    ::unlink(g_fpath);
+    printf("test_async_file_stream passed\n");
+    return 0;
+}
@@ -0,0 +1,227 @@
+// DATA_IO_LOAD_SAVE of a padded class of dumpable members is packed by one
+// ensureWrite/ensureRead, the bytes must be same as saving member by member
+// (the format before packing), for elements, vectors and arrays, with native
+// and byte swapped streams. unpadded and mixed classes are checked as well,
+// and all of them must be loaded back
+#include <terark/io/DataIO.hpp>
+#include <terark/io/MemStream.hpp>
+#include <terark/util/throw.hpp>
+#include <terark/valvec.hpp>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace terark;
+
+struct Padded {
+    uint64_t id;
+    uint8_t  type;
+    // 3 bytes padding
+    uint32_t flags;
+    uint16_t shard;
+    // 6 bytes padding
+    double   score;
+    uint8_t  b;
+    // 3 bytes padding
+    float    e;
+    DATA_IO_LOAD_SAVE(Padded, &id&type&flags&shard&score&b&e)
+    bool operator==(const Padded& y) const {
+        return id == y.id && type == y.type && flags == y.flags &&
+               shard == y.shard && score == y.score && b == y.b && e == y.e;
+    }
+};
+
+struct Unpadded {
+    uint32_t a;
+    uint32_t b;
+    uint64_t c;
+    DATA_IO_LOAD_SAVE(Unpadded, &a&b&c)
+    bool operator==(const Unpadded& y) const {
+        return a == y.a && b == y.b && c == y.c;
+    }
+};
+
+// not dumpable, saved member by member
+struct Mixed {
+    uint32_t    a;
+    std::string s;
+    uint8_t     b;
+    uint64_t    c;
+    Padded      p;
+    DATA_IO_LOAD_SAVE(Mixed, &a&s&b&c&p)
+    bool operator==(const Mixed& y) const {
+        return a == y.a && s == y.s && b == y.b && c == y.c && p == y.p;
+    }
+};
+
+static_assert(sizeof(Padded) == 40, "Padded must have padding");
+static_assert(sizeof(Unpadded) == 16, "Unpadded must have no padding");
+
+// the format before packing: each member in order, without padding
+template<class T>
+static void put(std::string* out, T x, bool bswap) {
+    char* p = (char*)&x;
+    if (bswap)
+        std::reverse(p, p + sizeof(T));
+    out->append(p, sizeof(T));
+}
+static std::string ref_bytes(const Padded& x, bool bswap) {
+    std::string out;
+    put(&out, x.id, bswap); put(&out, x.type, bswap);
+    put(&out, x.flags, bswap); put(&out, x.shard, bswap);
+    put(&out, x.score, bswap); put(&out, x.b, bswap); put(&out, x.e, bswap);
+    return out;
+}
+static std::string ref_bytes(const Unpadded& x, bool bswap) {
+    std::string out;
+    put(&out, x.a, bswap); put(&out, x.b, bswap); put(&out, x.c, bswap);
+    return out;
+}
+
+static Padded make_padded(std::mt19937& rnd) {
+    Padded x;
+    memset(&x, 0xCC, sizeof(x)); // padding is garbage, must not be saved
+    x.id = uint64_t(rnd()) << 32 | rnd();
+    x.type = uint8_t(rnd());
+    x.flags = rnd();
+    x.shard = uint16_t(rnd());
+    x.score = rnd() * 0.25;
+    x.b = uint8_t(rnd());
+    x.e = float(rnd() % 1000) / 8;
+    return x;
+}
+static Unpadded make_unpadded(std::mt19937& rnd) {
+    Unpadded x;
+    x.a = rnd();
+    x.b = rnd();
+    x.c = uint64_t(rnd()) << 32 | rnd();
+    return x;
+}
+static Mixed make_mixed(std::mt19937& rnd) {
+    Mixed x;
+    x.a = rnd();
+    x.s.assign(rnd() % 300, char('a' + rnd() % 26));
+    x.b = uint8_t(rnd());
+    x.c = uint64_t(rnd()) << 32 | rnd();
+    x.p = make_padded(rnd);
+    return x;
+}
+
+template<class Output>
+static std::string bytes_of(const Output& dio) {
+    return std::string((const char*)dio.begin(), dio.tell());
+}
+
+// var_size_t by the stream itself, it is not changed by packing
+template<class Output>
+static std::string size_bytes(size_t n) {
+    Output dio;
+    dio << var_size_t(n);
+    return bytes_of(dio);
+}
+
+template<class Output, class Input, class T>
+static void test_type(std::mt19937& rnd, T (*make)(std::mt19937&), bool bswap) {
+    const size_t num = 1000;
+    std::vector<T> vec(num);
+    valvec<T> vvec(num);
+    T arr[7];
+    std::string expected_elem, expected_arr;
+    for (size_t i = 0; i < num; ++i) {
+        vec[i] = vvec[i] = make(rnd);
+        expected_elem += ref_bytes(vec[i], bswap);
+    }
+    for (auto& x : arr) {
+        x = make(rnd);
+        expected_arr += ref_bytes(x, bswap);
+    }
+    Output dio;
+    for (auto& x : vec)
+        dio << x;
+    TERARK_VERIFY(bytes_of(dio) == expected_elem);
+    dio.rewind();
+    dio << vec;
+    TERARK_VERIFY(bytes_of(dio) == size_bytes<Output>(num) + expected_elem);
+    dio.rewind();
+    dio << vvec;
+    TERARK_VERIFY(bytes_of(dio) == size_bytes<Output>(num) + expected_elem);
+    dio.rewind();
+    dio << arr;
+    TERARK_VERIFY(bytes_of(dio) == expected_arr);
+
+    // round trip
+    dio.rewind();
+    for (auto& x : vec)
+        dio << x;
+    dio << vec << vvec << arr;
+    Input din;
+    din.set(dio.begin(), dio.tell());
+    for (auto& x : vec) {
+        T y;
+        din >> y;
+        TERARK_VERIFY(y == x);
+    }
+    std::vector<T> vec2;
+    valvec<T> vvec2;
+    T arr2[7];
+    din >> vec2 >> vvec2 >> arr2;
+    TERARK_VERIFY(vec2 == vec);
+    TERARK_VERIFY_EQ(vvec2.size(), num);
+    for (size_t i = 0; i < num; ++i)
+        TERARK_VERIFY(vvec2[i] == vec[i]);
+    for (size_t i = 0; i < 7; ++i)
+        TERARK_VERIFY(arr2[i] == arr[i]);
+    TERARK_VERIFY(din.eof());
+}
+
+// mixed class is saved member by member, its Padded member is packed
+template<class Output, class Input>
+static void test_mixed(std::mt19937& rnd, bool bswap) {
+    std::vector<Mixed> vec(500);
+    std::string expected;
+    for (auto& x : vec) {
+        x = make_mixed(rnd);
+        Output ref;
+        ref << x.a << x.s << x.b << x.c;
+        expected += bytes_of(ref) + ref_bytes(x.p, bswap);
+    }
+    Output dio;
+    for (auto& x : vec)
+        dio << x;
+    TERARK_VERIFY(bytes_of(dio) == expected);
+    dio << vec;
+    Input din;
+    din.set(dio.begin(), dio.tell());
+    for (auto& x : vec) {
+        Mixed y;
+        din >> y;
+        TERARK_VERIFY(y == x);
+    }
+    std::vector<Mixed> vec2;
+    din >> vec2;
+    TERARK_VERIFY(vec2 == vec);
+    TERARK_VERIFY(din.eof());
+}
+
+template<class Output, class Input>
+static void test_stream(const char* name, bool bswap) {
+    std::mt19937 rnd(1);
+    test_type<Output, Input>(rnd, make_padded, bswap);
+    test_type<Output, Input>(rnd, make_unpadded, bswap);
+    test_mixed<Output, Input>(rnd, bswap);
+    printf("  %s passed\n", name);
+}
+
+int main() {
+#if defined(BOOST_ENDIAN_LITTLE_BYTE)
+    const bool big_swap = true;
+#else
+    const bool big_swap = false;
+#endif
+    test_stream<NativeDataOutput<AutoGrownMemIO>, NativeDataInput<MemIO> >("native", false);
+    test_stream<LittleEndianDataOutput<AutoGrownMemIO>, LittleEndianDataInput<MemIO> >("little endian", !big_swap);
+    test_stream<BigEndianDataOutput<AutoGrownMemIO>, BigEndianDataInput<MemIO> >("big endian", big_swap);
+    printf("test_data_io_pack passed\n");
+    return 0;
+}
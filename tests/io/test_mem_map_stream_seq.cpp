@@ -0,0 +1,151 @@
+// MemMapStream::set_seq_hint: a readonly stream with the sequential hint must
+// read the same data by read, skip and seek, for several windows, and drop
+// the page cache of the region behind the mapped region if the filesystem
+// honors POSIX_FADV_DONTNEED. the hint must be ignored by a writable stream
+#include <terark/io/MemMapStream.hpp>
+#include <terark/util/throw.hpp>
+#include <terark/valvec.hpp>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <random>
+#include <string>
+
+using namespace terark;
+
+static const char* g_fpath = "test_mem_map_stream_seq.bin";
+
+static std::string make_data(size_t size, std::mt19937& rnd) {
+    std::string data(size, '\0');
+    for (auto& c : data)
+        c = char(rnd());
+    return data;
+}
+
+static void write_file(const std::string& data) {
+    FILE* fp = fopen(g_fpath, "wb");
+    TERARK_VERIFY(NULL != fp);
+    TERARK_VERIFY_EQ(fwrite(data.data(), 1, data.size(), fp), data.size());
+    fclose(fp);
+}
+
+// resident pages of the file in [0, len) of the page cache
+static size_t resident_pages(size_t len) {
+    int fd = ::open(g_fpath, O_RDONLY);
+    TERARK_VERIFY_GE(fd, 0);
+    void* base = ::mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+    TERARK_VERIFY(MAP_FAILED != base);
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    valvec<unsigned char> vec((len + page_size - 1) / page_size, valvec_no_init());
+    TERARK_VERIFY_EQ(::mincore(base, len, vec.data()), 0);
+    size_t n = 0;
+    for (unsigned char c : vec)
+        n += c & 1;
+    ::munmap(base, len);
+    ::close(fd);
+    return n;
+}
+
+static void fill_page_cache(size_t len) {
+    int fd = ::open(g_fpath, O_RDONLY);
+    TERARK_VERIFY_GE(fd, 0);
+    char buf[65536];
+    for (size_t pos = 0; pos < len; pos += sizeof(buf))
+        TERARK_VERIFY_GT(::pread(fd, buf, sizeof(buf), pos), 0);
+    ::close(fd);
+}
+
+// the filesystem drops clean pages by POSIX_FADV_DONTNEED, tmpfs does not
+static bool fadv_dontneed_works(size_t len) {
+    fill_page_cache(len);
+    int fd = ::open(g_fpath, O_RDONLY);
+    TERARK_VERIFY_GE(fd, 0);
+    posix_fadvise(fd, 0, len, POSIX_FADV_DONTNEED);
+    ::close(fd);
+    return resident_pages(len) == 0;
+}
+
+static void test_read(const std::string& data, size_t window, std::mt19937& rnd) {
+    MemMapStream fp(0, g_fpath, O_RDONLY);
+    fp.set_seq_hint(window);
+    TERARK_VERIFY_EQ(fp.seq_hint(), window);
+    TERARK_VERIFY_EQ(fp.size(), data.size());
+    std::string buf;
+    size_t pos = 0;
+    while (pos < data.size()) {
+        size_t n = std::min(data.size() - pos, size_t(1 + rnd() % 300000));
+        switch (rnd() % 8) {
+        case 0:
+            fp.skip(n);
+            break;
+        case 1: // seek back a little, then read to the same pos
+            fp.seek(pos - std::min(pos, size_t(rnd() % 8192)));
+            buf.resize(pos - fp.tell());
+            fp.ensureRead(&buf[0], buf.size());
+            TERARK_VERIFY(memcmp(buf.data(), data.data() + pos - buf.size(), buf.size()) == 0);
+            continue;
+        default:
+            buf.resize(n);
+            fp.ensureRead(&buf[0], n);
+            if (memcmp(buf.data(), data.data() + pos, n) != 0)
+                TERARK_DIE("data mismatch at pos = %zd, window = %zd", pos, window);
+            break;
+        }
+        pos += n;
+        TERARK_VERIFY_EQ(fp.tell(), pos);
+    }
+    TERARK_VERIFY(fp.eof());
+}
+
+// pages of the regions which have been unmapped are dropped
+static void test_drop_behind(const std::string& data, size_t window) {
+    const size_t len = size_t(16) << 20; // 8 mapped regions of 2M
+    fill_page_cache(data.size());
+    {
+        MemMapStream fp(0, g_fpath, O_RDONLY);
+        fp.set_seq_hint(window);
+        std::string buf(65536, '\0');
+        for (size_t pos = 0; pos < len + buf.size(); pos += buf.size())
+            fp.ensureRead(&buf[0], buf.size());
+    }
+    size_t resident = resident_pages(len);
+    TERARK_VERIFY_F(resident == 0, "window = %zd, resident = %zd", window, resident);
+}
+
+static void test_writable(std::mt19937& rnd) {
+    const std::string data = make_data(size_t(5) << 20, rnd);
+    {
+        MemMapStream fp(0, g_fpath, O_RDWR|O_CREAT);
+        fp.set_seq_hint(size_t(4) << 20);
+        for (size_t pos = 0; pos < data.size(); pos += 4096)
+            fp.ensureWrite(data.data() + pos, std::min(data.size() - pos, size_t(4096)));
+        fp.set_fsize(data.size());
+    }
+    MemMapStream fp(0, g_fpath, O_RDONLY);
+    std::string buf(data.size(), '\0');
+    fp.ensureRead(&buf[0], buf.size());
+    TERARK_VERIFY(buf == data);
+}
+
+int main() {
+    std::mt19937 rnd(1);
+    const std::string data = make_data((size_t(40) << 20) + 12345, rnd);
+    write_file(data);
+    for (size_t window : {size_t(0), size_t(1) << 20, size_t(8) << 20, size_t(64) << 20})
+        test_read(data, window, rnd);
+    printf("  read passed\n");
+    if (fadv_dontneed_works(data.size())) {
+        for (size_t window : {size_t(1) << 20, size_t(8) << 20})
+            test_drop_behind(data, window);
+        printf("  drop behind passed\n");
+    } else {
+        printf("  drop behind skipped: POSIX_FADV_DONTNEED is ignored by the filesystem\n");
+    }
+    test_writable(rnd);
+    printf("  writable passed\n");
+    ::unlink(g_fpath);
+    printf("test_mem_map_stream_seq passed\n");
+    return 0;
+}
@@ -0,0 +1,204 @@
+// DenseDFA_V2::build_compact must give a dfa which accepts the same language
+// as the source: states are paired by walking from roots, each pair must have
+// same term bit, zpath and moves. sparse targets of all widths(16 and 24 bit
+// delta, and full StateID for a dfa with more than 2^23 states) are covered,
+// with and without byte classes, path zip and hotness
+#include <terark/fsa/automata.hpp>
+#include <terark/fsa/dense_dfa_v2.hpp>
+#include <terark/util/throw.hpp>
+#include <random>
+#include <string>
+
+using namespace terark;
+
+typedef Automata<State32> SrcDFA;
+
+// targets are near the state with probability 1/2, so the 16 bit delta is
+// used by some states and the 24 bit delta is used by others
+static void make_dfa(SrcDFA* dfa, size_t num, fstring alphabet,
+                     size_t maxdeg, size_t chains, std::mt19937& rnd) {
+    dfa->erase_all();
+    dfa->resize_states(num);
+    valvec<CharTarget<size_t> > moves;
+    for (size_t s = 0; s < num; ++s) {
+        bool near = rnd() % 2 == 0;
+        size_t deg = 1 + rnd() % maxdeg;
+        moves.erase_all();
+        for (size_t i = 0; i < alphabet.size() && moves.size() < deg; ++i) {
+            if (rnd() % alphabet.size() >= deg)
+                continue;
+            size_t t = near ? (s + rnd() % 1000) % num : rnd() % num;
+            moves.push_back({byte_t(alphabet[i]), t});
+        }
+        dfa->add_all_move(s, moves.data(), moves.size());
+        if (rnd() % 4 == 0)
+            dfa->set_term_bit(s);
+    }
+    // chains of states with single in and out for path zip, entered by '.'
+    for (size_t k = 0; k < chains; ++k) {
+        size_t chain = dfa->total_states(), len = 2 + rnd() % 10;
+        dfa->resize_states(chain + len);
+        dfa->add_move(k * num / chains, chain, '.');
+        for (size_t i = 0; i < len; ++i) {
+            size_t next = i + 1 < len ? chain + i + 1 : rnd() % num;
+            dfa->add_move(chain + i, next, alphabet[rnd() % alphabet.size()]);
+        }
+    }
+}
+
+template<class DFA>
+static void check(const SrcDFA& src, const valvec<size_t>& roots,
+                  const DFA& cdfa, bool all_chars) {
+    TERARK_VERIFY_GE(cdfa.total_states(), roots.size());
+    valvec<size_t> s2c(src.total_states(), size_t(-1));
+    valvec<size_t> c2s(cdfa.total_states(), size_t(-1));
+    valvec<size_t> queue;
+    auto pair = [&](size_t x, size_t y) {
+        TERARK_VERIFY_LT(y, cdfa.total_states());
+        if (size_t(-1) == s2c[x]) {
+            TERARK_VERIFY_EQ(c2s[y], size_t(-1));
+            s2c[x] = y, c2s[y] = x;
+            queue.push_back(x);
+        }
+        TERARK_VERIFY_EQ(s2c[x], y);
+    };
+    for (size_t i = 0; i < roots.size(); ++i) {
+        if (size_t(-1) == s2c[roots[i]])
+            pair(roots[i], i); // roots are [0, nRoots)
+    }
+    valvec<CharTarget<size_t> > moves(SrcDFA::sigma, valvec_no_init());
+    for (size_t head = 0; head < queue.size(); ++head) {
+        size_t x = queue[head], y = s2c[x];
+        TERARK_VERIFY_EQ(src.is_term(x), cdfa.is_term(y));
+        TERARK_VERIFY_EQ(src.is_pzip(x), cdfa.is_pzip(y));
+        if (src.is_pzip(x))
+            TERARK_VERIFY(src.get_zpath_data(x, NULL) == cdfa.get_zpath_data(y, NULL));
+        size_t n = src.get_all_move(x, moves.data());
+        for (size_t i = 0; i < n; ++i)
+            pair(moves[i].target, cdfa.state_move(y, moves[i].ch));
+        if (all_chars) {
+            for (size_t ch = 0, i = 0; ch < 256; ++ch) {
+                if (i < n && moves[i].ch == ch)
+                    i++;
+                else
+                    TERARK_VERIFY_EQ(cdfa.state_move(y, ch), DFA::nil_state);
+            }
+        }
+    }
+    // a duplicate root is cloned, the clone is same as the paired state
+    size_t clones = 0;
+    for (size_t i = 0; i < roots.size(); ++i) {
+        size_t y = s2c[roots[i]];
+        if (y == i)
+            continue;
+        clones++;
+        TERARK_VERIFY_EQ(cdfa.is_term(i), cdfa.is_term(y));
+        for (size_t ch = 0; ch < 256; ++ch)
+            TERARK_VERIFY_EQ(cdfa.state_move(i, ch), cdfa.state_move(y, ch));
+    }
+    // src states are reachable, so all states are paired
+    TERARK_VERIFY_EQ(queue.size() + clones, cdfa.total_states());
+}
+
+template<class DFA>
+static void count_widths(const DFA& cdfa, size_t cnt[3]) {
+    cnt[0] = cnt[1] = cnt[2] = 0;
+    for (auto& s : cdfa.internal_get_states())
+        if (s.num_sparse())
+            cnt[s.sparse_width()]++;
+}
+
+template<class DFA>
+static void test_one(const char* name, const SrcDFA& src,
+                     const valvec<size_t>& roots, const size_t* hotness,
+                     bool all_chars) {
+    DFA cdfa;
+    TERARK_VERIFY(cdfa.build_compact(roots, src, hotness));
+    check(src, roots, cdfa, all_chars);
+    size_t cnt[3];
+    count_widths(cdfa, cnt);
+    printf("  %s: states = %zd, byte_class = %zd, sparse width 0/1/2 = %zd/%zd/%zd passed\n",
+           name, cdfa.total_states(), cdfa.num_byte_class(), cnt[0], cnt[1], cnt[2]);
+}
+
+static void test(size_t num, fstring alphabet, size_t maxdeg, std::mt19937& rnd) {
+    SrcDFA src;
+    make_dfa(&src, num, alphabet, maxdeg, num / 16, rnd);
+    valvec<size_t> roots(1, initial_state);
+    for (size_t i = 0; i < 3 && i < num; ++i)
+        roots.push_back(rnd() % num); // may be duplicate
+    valvec<size_t> hotness(num, valvec_no_init());
+    for (size_t& h : hotness)
+        h = rnd() % 16;
+    test_one<DenseDFA_V2_uint32_288>("plain", src, roots, NULL, true);
+    test_one<DenseDFA_V2_uint32_288>("hotness", src, roots, hotness.data(), true);
+    test_one<DenseDFA_V2_uint32_288_bc64>("byte class", src, roots, NULL, true);
+    test_one<DenseDFA_V2_uint32_288_bc64>("byte class hotness", src, roots, hotness.data(), true);
+    if (num < 100 || num > 10000)
+        return;
+    // path_zip requires a single root and all states are reachable
+    SrcDFA zipped, reachable;
+    valvec<size_t> zroots(1, initial_state);
+    reachable.normalize(zroots, src, "BFS");
+    zipped.path_zip(reachable, "DFS");
+    TERARK_VERIFY_GT(zipped.num_zpath_states(), 0);
+    test_one<DenseDFA_V2_uint32_288>("pzip", zipped, zroots, NULL, true);
+    test_one<DenseDFA_V2_uint32_288_bc64>("byte class pzip", zipped, zroots, NULL, true);
+}
+
+// more than 64 byte classes, bc64 fails and the plain layout is used
+static void test_too_many_classes() {
+    SrcDFA src;
+    src.resize_states(257);
+    for (size_t ch = 0; ch < 256; ++ch)
+        src.add_move(initial_state, 1 + ch, ch);
+    valvec<size_t> roots(1, initial_state);
+    DenseDFA_V2_uint32_288_bc64 bc;
+    TERARK_VERIFY(!bc.build_compact(roots, src));
+    DenseDFA_V2_uint32_288 plain;
+    TERARK_VERIFY(plain.build_compact(roots, src));
+    check(src, roots, plain, true);
+    printf("  too many byte classes passed\n");
+}
+
+// more than 2^23 states, deltas of far targets do not fit 24 bits. with BFS
+// order, targets of early states are near, and the sparse target is the max
+// target id, so random hotness is used to give far forward targets
+static void test_full_width(std::mt19937& rnd) {
+    // 'a' moves to the next state, so all states are reachable, 'b' and 'c'
+    // move to random states, one of the 3 targets is sparse
+    const size_t num = (size_t(1) << 23) + 100000;
+    SrcDFA src;
+    src.resize_states(num);
+    valvec<size_t> hotness(num, valvec_no_init());
+    for (size_t s = 0; s < num; ++s) {
+        CharTarget<size_t> moves[3] = {
+            {'a', (s + 1) % num}, {'b', rnd() % num}, {'c', rnd() % num},
+        };
+        src.add_all_move(s, moves, 3);
+        if (rnd() % 4 == 0)
+            src.set_term_bit(s);
+        hotness[s] = rnd();
+    }
+    valvec<size_t> roots(1, initial_state);
+    DenseDFA_V2_uint32_288_bc64 cdfa;
+    TERARK_VERIFY(cdfa.build_compact(roots, src, hotness.data()));
+    check(src, roots, cdfa, false);
+    size_t cnt[3];
+    count_widths(cdfa, cnt);
+    TERARK_VERIFY_GT(cnt[0], 0);
+    printf("  full width: states = %zd, sparse width 0/1/2 = %zd/%zd/%zd passed\n",
+           cdfa.total_states(), cnt[0], cnt[1], cnt[2]);
+}
+
+int main() {
+    std::mt19937 rnd(1);
+    test(1, "a", 1, rnd);
+    test(100, "abcdefgh", 8, rnd);
+    test(5000, "0123456789abcdefghijklmnopqrstuvwxyz", 12, rnd);
+    test(100000, "abcdefghijklmnop", 8, rnd); // 24 bit delta
+    test_too_many_classes();
+    test_full_width(rnd);
+    printf("test_dense_dfa_v2_compact passed\n");
+    return 0;
+}
@@ -0,0 +1,210 @@
+// lazy dfa(load_regex_lazy) and stream match(begin_feed/feed/finish) must
+// give same results as the prebuilt dfa which is built by regex_build from
+// the same regex file, see Makefile
+#include <terark/fsa/mre_match.hpp>
+#include <terark/fsa/re2/lazy_dfa.hpp>
+#include <terark/util/throw.hpp>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace terark;
+
+typedef MultiRegexFullMatch FullMatch;
+
+struct Expected {
+    size_t longest, shortest;
+    valvec<int> longest_ids, shortest_ids, all_ids;
+    valvec<std::pair<int, int> > all_len; // (regex_id, len)
+};
+
+static valvec<int> sorted_ids(const FullMatch& m) {
+    valvec<int> ids(m.begin(), m.size());
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+static valvec<std::pair<int, int> > sorted_len(const FullMatch& m) {
+    valvec<std::pair<int, int> > v;
+    for (auto& x : m.cur_match())
+        v.push_back({x.regex_id, x.len});
+    std::sort(v.begin(), v.end());
+    return v;
+}
+
+static Expected get_result(FullMatch* m, fstring text) {
+    Expected e;
+    e.longest = m->match(text);
+    e.longest_ids = sorted_ids(*m);
+    e.shortest = m->shortest_match(text);
+    e.shortest_ids = sorted_ids(*m);
+    TERARK_VERIFY_EQ(m->match_all(text), m->size());
+    e.all_ids = sorted_ids(*m);
+    m->match_all_len(text);
+    e.all_len = sorted_len(*m);
+    return e;
+}
+
+static bool same(const Expected& x, const Expected& y) {
+    return x.longest == y.longest && x.shortest == y.shortest &&
+           x.longest_ids == y.longest_ids && x.shortest_ids == y.shortest_ids &&
+           x.all_ids == y.all_ids && x.all_len == y.all_len;
+}
+
+// feed text in random chunks, including empty chunks, and keep feeding after
+// feed returned false, the result must be same as the non-stream method
+static bool stream_ok(FullMatch* m, fstring text, const Expected& e,
+                      std::mt19937& rnd) {
+    for (int mode = FullMatch::StreamLongest; mode <= FullMatch::StreamAll; ++mode) {
+        m->begin_feed(FullMatch::StreamMode(mode));
+        size_t pos = 0;
+        while (pos < text.size()) {
+            size_t n = rnd() % 4 == 0 ? 0 : rnd() % (text.size() - pos + 1);
+            m->feed(fstring(text.p + pos, ptrdiff_t(n)));
+            pos += n;
+        }
+        m->feed(fstring(text.p + pos, ptrdiff_t(0)));
+        size_t ret = m->finish();
+        valvec<int> ids = sorted_ids(*m);
+        switch (mode) {
+        case FullMatch::StreamLongest:
+            if (ret != e.longest || ids != e.longest_ids) return false;
+            break;
+        case FullMatch::StreamShortest:
+            if (ret != e.shortest || ids != e.shortest_ids) return false;
+            break;
+        case FullMatch::StreamAll:
+            if (ret != e.all_ids.size() || ids != e.all_ids) return false;
+            break;
+        }
+    }
+    return true;
+}
+
+static std::vector<std::string> gen_texts(std::mt19937& rnd) {
+    static const char* pieces[] = {
+        "abc", "x12", "foo", "bar", "ab", "cd", "e", "hello", "q", "z",
+        "ZZ", "AB", "k", "1", "f", "bb", "y", "c", "Q", "\n",
+    };
+    const size_t npieces = sizeof(pieces) / sizeof(pieces[0]);
+    std::vector<std::string> texts;
+    texts.emplace_back(); // empty text
+    for (size_t i = 0; i < 3000; ++i) {
+        std::string t;
+        size_t k = rnd() % 8;
+        if (i % 10 == 0)
+            k = 20 + rnd() % 80; // long text for stream
+        for (size_t j = 0; j < k; ++j)
+            t += pieces[rnd() % npieces];
+        if (i % 7 == 0 && !t.empty())
+            t[rnd() % t.size()] ^= char(1 + rnd() % 255); // random byte
+        texts.push_back(t);
+    }
+    return texts;
+}
+
+static void compare(FullMatch* m, const std::vector<std::string>& texts,
+                    const std::vector<Expected>& expected, const char* name) {
+    std::mt19937 rnd(7);
+    for (size_t i = 0; i < texts.size(); ++i) {
+        Expected e = get_result(m, texts[i]);
+        if (!same(e, expected[i]))
+            TERARK_DIE("%s: non-stream mismatch on text[%zd] = \"%s\"",
+                       name, i, texts[i].c_str());
+        if (!stream_ok(m, texts[i], expected[i], rnd))
+            TERARK_DIE("%s: stream mismatch on text[%zd] = \"%s\"",
+                       name, i, texts[i].c_str());
+    }
+}
+
+// small maxmem forces cache resets, shallow states are kept by keepDepth
+static void test_cache_reset(const char* regex_file, unsigned keepDepth,
+                             const std::vector<std::string>& texts,
+                             const std::vector<Expected>& expected) {
+    MultiRegexMatchOptions opt;
+    opt.lazyDfaMaxMem = 16 << 10;
+    opt.lazyDfaKeepDepth = keepDepth;
+    opt.load_regex_lazy(regex_file);
+    std::unique_ptr<FullMatch> m(FullMatch::create(opt));
+    compare(m.get(), texts, expected, "lazy reset");
+    auto st = opt.get_lazy_dfa()->get_stats();
+    TERARK_VERIFY_GT(st.resets, 0);
+    TERARK_VERIFY_GT(st.totalStates, st.states);
+    if (keepDepth)
+        TERARK_VERIFY_GT(st.keptStates, 0);
+    else
+        TERARK_VERIFY_EQ(st.keptStates, 0);
+    printf("cache reset(keepDepth = %u) passed: resets = %zd, kept = %zd\n",
+           keepDepth, st.resets, st.keptStates);
+}
+
+// clones share the lazy dfa cache, misses and resets are concurrent
+static void test_concurrent(const char* regex_file, size_t maxmem,
+                            const std::vector<std::string>& texts,
+                            const std::vector<Expected>& expected) {
+    MultiRegexMatchOptions opt;
+    opt.lazyDfaMaxMem = maxmem;
+    opt.load_regex_lazy(regex_file);
+    std::unique_ptr<FullMatch> proto(FullMatch::create(opt));
+    const size_t nthr = 4;
+    std::atomic<size_t> bad{0};
+    auto work = [&](size_t tid) {
+        std::unique_ptr<FullMatch> m(proto->clone());
+        std::mt19937 rnd((unsigned)tid);
+        for (size_t k = 0; k < texts.size(); ++k) {
+            size_t i = (k * (2*tid + 1) + tid * 997) % texts.size();
+            if (!same(get_result(m.get(), texts[i]), expected[i]) ||
+                !stream_ok(m.get(), texts[i], expected[i], rnd))
+                bad++;
+        }
+    };
+    std::vector<std::thread> threads;
+    for (size_t tid = 0; tid < nthr; ++tid)
+        threads.emplace_back(work, tid);
+    for (auto& t : threads)
+        t.join();
+    TERARK_VERIFY_EQ(bad.load(), 0);
+    auto st = opt.get_lazy_dfa()->get_stats();
+    TERARK_VERIFY_GT(st.misses, 0);
+    printf("concurrent(maxmem = %zd) passed: resets = %zd\n", maxmem, st.resets);
+}
+
+int main(int argc, char* argv[]) {
+    const char* regex_file = argc > 1 ? argv[1] : "test_lazy_dfa.regex";
+    const char* dfa_file   = argc > 2 ? argv[2] : "test_lazy_dfa.dfa";
+    const char* meta_file  = argc > 3 ? argv[3] : "test_lazy_dfa.meta";
+    std::mt19937 rnd(12345);
+    std::vector<std::string> texts = gen_texts(rnd);
+    std::vector<Expected> expected(texts.size());
+    {
+        MultiRegexMatchOptions opt;
+        opt.load_dfa(dfa_file);
+        opt.regexMetaFilePath = meta_file;
+        std::unique_ptr<FullMatch> m(FullMatch::create(opt));
+        for (size_t i = 0; i < texts.size(); ++i)
+            expected[i] = get_result(m.get(), texts[i]);
+        compare(m.get(), texts, expected, "prebuilt");
+    }
+    size_t nmatch = 0;
+    for (auto& e : expected)
+        nmatch += e.longest > 0;
+    TERARK_VERIFY_GT(nmatch, texts.size() / 4); // a?b?c? matches empty text
+    printf("prebuilt stream passed: %zd of %zd texts matched\n", nmatch, texts.size());
+    {
+        MultiRegexMatchOptions opt;
+        opt.load_regex_lazy(regex_file);
+        std::unique_ptr<FullMatch> m(FullMatch::create(opt));
+        compare(m.get(), texts, expected, "lazy");
+        TERARK_VERIFY_EQ(opt.get_lazy_dfa()->get_stats().resets, 0);
+        printf("lazy passed\n");
+    }
+    test_cache_reset(regex_file, 2, texts, expected);
+    test_cache_reset(regex_file, 0, texts, expected);
+    test_concurrent(regex_file, 64 << 20, texts, expected);
+    test_concurrent(regex_file, 16 << 10, texts, expected);
+    printf("test_lazy_dfa passed\n");
+    return 0;
+}
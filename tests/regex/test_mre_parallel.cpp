@@ -0,0 +1,124 @@
+// MultiRegexFullMatch::parallel_match_all must give same result as the
+// single thread match_all, for multiple threads and lookback, on the dot
+// star dfa(regex_build -a) and the head anchored dfa, with matches which
+// cross chunk boundaries and long range matches(q.*z) which make the
+// speculated start state of chunks wrong, see Makefile
+#include <terark/fsa/mre_match.hpp>
+#include <terark/util/throw.hpp>
+#include <string.h>
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace terark;
+
+typedef MultiRegexFullMatch FullMatch;
+
+static const size_t TextLen = 200000;
+static const size_t Threads[] = {1, 2, 3, 4, 7, 8};
+
+static const char* pieces[] = {
+    "hellohello", "x12345y", "ZZABCk", "foobarbaz", "1234-56", "wabcdw",
+    "abc", "hello",
+};
+static const size_t npieces = sizeof(pieces) / sizeof(pieces[0]);
+
+static valvec<int> sorted_ids(const FullMatch& m) {
+    valvec<int> ids(m.begin(), m.size());
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+// filler '#' is not in any regex, a piece is put across each chunk
+// boundary of each thread count, the piece is split at a random pos
+static std::string boundary_text(std::mt19937& rnd, size_t piece) {
+    std::string text(TextLen, '#');
+    for (size_t n : Threads) {
+        for (size_t t = 1; t < n; ++t) {
+            size_t b = TextLen * t / n;
+            const char* p = pieces[(piece + t) % npieces];
+            size_t len = strlen(p);
+            size_t split = 1 + rnd() % (len - 1);
+            memcpy(&text[b - split], p, len);
+        }
+    }
+    return text;
+}
+
+static std::string random_text(std::mt19937& rnd) {
+    std::string text;
+    while (text.size() < TextLen) {
+        if (rnd() % 4)
+            text.append(1 + rnd() % 64, "#ab1-wxyz"[rnd() % 9]);
+        else
+            text += pieces[rnd() % npieces];
+    }
+    text.resize(TextLen);
+    return text;
+}
+
+static void check(FullMatch* m, fstring text, const char* name) {
+    size_t num = m->match_all(text);
+    valvec<int> expected = sorted_ids(*m);
+    TERARK_VERIFY_EQ(num, expected.size());
+    for (size_t threads : Threads) {
+        for (size_t lookback : {1, 16, 256}) {
+            size_t num2 = m->parallel_match_all(text, threads, lookback);
+            valvec<int> ids = sorted_ids(*m);
+            if (num2 != num || ids != expected)
+                TERARK_DIE("%s: threads = %zd, lookback = %zd: %zd != %zd",
+                           name, threads, lookback, num2, num);
+        }
+    }
+}
+
+static void test(const char* dfa_file, const char* meta_file) {
+    MultiRegexMatchOptions opt;
+    opt.load_dfa(dfa_file);
+    opt.regexMetaFilePath = meta_file;
+    std::unique_ptr<FullMatch> m(FullMatch::create(opt));
+    std::mt19937 rnd(1);
+    size_t matched = 0;
+    for (size_t piece = 0; piece < npieces; ++piece) {
+        std::string text = boundary_text(rnd, piece);
+        check(m.get(), text, "boundary");
+        matched += m->size();
+        // q.*z spans all chunks, the speculated start states are wrong
+        size_t qpos = 1 + rnd() % 100;
+        text[qpos] = 'q';
+        text[TextLen - 1 - rnd() % 100] = 'z';
+        check(m.get(), text, "q.*z");
+        matched += m->size();
+        // head anchored q.*z is alive in all chunks
+        text[0] = 'q';
+        check(m.get(), text, "^q.*z");
+        matched += m->size();
+        text[0] = '#';
+        // q is out of lookback of the chunk, z is in the last chunk
+        text[qpos] = '#';
+        text[TextLen / 3 + rnd() % 1000] = 'q';
+        check(m.get(), text, "q.*z in chunk");
+        matched += m->size();
+    }
+    for (int i = 0; i < 10; ++i) {
+        std::string text = random_text(rnd);
+        check(m.get(), text, "random");
+        matched += m->size();
+    }
+    check(m.get(), std::string(TextLen, '#'), "no match");
+    check(m.get(), "hello", "short");
+    check(m.get(), "", "empty");
+    printf("  %s passed: matched = %zd\n", dfa_file, matched);
+}
+
+int main(int argc, char* argv[]) {
+    const char* dotstar = argc > 1 ? argv[1] : "test_mre_parallel.dfa";
+    const char* anchored = argc > 2 ? argv[2] : "test_mre_parallel_anchored.dfa";
+    const char* meta = argc > 3 ? argv[3] : "test_mre_parallel.meta";
+    test(dotstar, meta);
+    test(anchored, meta);
+    printf("test_mre_parallel passed\n");
+    return 0;
+}
@@ -0,0 +1,126 @@
+// MultiRegexSubmatch stream match(begin_feed/feed/finish and match_stream on
+// IZeroCopyInputStream) must give same full match len, matched regexes and
+// captures as the one shot match(), for 1 byte chunks, random chunks
+// (including empty chunks) and random zcRead buffers, see Makefile
+#include <terark/fsa/mre_match.hpp>
+#include <terark/io/ZeroCopy.hpp>
+#include <terark/util/throw.hpp>
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <string>
+
+using namespace terark;
+
+typedef MultiRegexSubmatch Submatch;
+
+static const char* pieces[] = {
+    "aab", "bbc", "12-", "345", "foo", "bar", "xbaz", "hel", "lo", "ell",
+    "abcd", "e", "q", "z", "x12y", "abcdd", "hello",
+};
+static const size_t npieces = sizeof(pieces) / sizeof(pieces[0]);
+
+struct Result {
+    size_t len;
+    valvec<int> ids;
+    valvec<std::pair<int,int> > caps; // of matched regexes, ordered by id
+    bool operator==(const Result& y) const {
+        return len == y.len && ids == y.ids && caps == y.caps;
+    }
+};
+
+static Result get_result(const Submatch& m, size_t len) {
+    Result r;
+    r.len = len;
+    r.ids.assign(m.fullmatch_regex());
+    std::sort(r.ids.begin(), r.ids.end());
+    for (int regex_id : r.ids) {
+        TERARK_VERIFY(m.is_full_match(regex_id));
+        for (int i = 0; i < m.num_submatch(regex_id); ++i)
+            r.caps.push_back(m.get_match_range(regex_id, i));
+    }
+    return r;
+}
+
+// zcRead returns random size buffers which are not longer than the request
+class RandomChunkStream : public IZeroCopyInputStream {
+    fstring m_text;
+    size_t  m_pos = 0;
+    std::mt19937* m_rnd;
+public:
+    RandomChunkStream(fstring text, std::mt19937* rnd)
+        : m_text(text), m_rnd(rnd) {}
+    const void* zcRead(size_t length, size_t* readed) override {
+        size_t n = std::min(m_text.size() - m_pos, (*m_rnd)() % (length + 1));
+        if (0 == n && m_pos < m_text.size())
+            n = 1;
+        const void* buf = m_text.p + m_pos;
+        m_pos += n;
+        *readed = n;
+        return buf;
+    }
+    bool eof() const override { return m_text.size() == m_pos; }
+};
+
+static Result feed_chunks(Submatch* m, fstring text, std::mt19937& rnd,
+                          size_t maxchunk) {
+    m->begin_feed();
+    for (size_t pos = 0; pos < text.size(); ) {
+        size_t n = 1 == maxchunk ? 1 : rnd() % maxchunk;
+        n = std::min(n, text.size() - pos);
+        m->feed(fstring(text.p + pos, ptrdiff_t(n)));
+        pos += n;
+    }
+    return get_result(*m, m->finish());
+}
+
+static std::string make_text(std::mt19937& rnd) {
+    std::string text;
+    size_t num = rnd() % 8;
+    for (size_t i = 0; i < num; ++i) {
+        if (rnd() % 4)
+            text += pieces[rnd() % npieces];
+        else
+            text.append(1 + rnd() % 4, "abcxyz019-"[rnd() % 10]);
+    }
+    return text;
+}
+
+static void check(Submatch* m, fstring text, std::mt19937& rnd, size_t* matched) {
+    const Result expected = get_result(*m, m->match(text));
+    if (!(feed_chunks(m, text, rnd, 1) == expected))
+        TERARK_DIE("1 byte chunks: text = %s", text.c_str());
+    for (size_t maxchunk : {3, 8, 64}) {
+        if (!(feed_chunks(m, text, rnd, maxchunk) == expected))
+            TERARK_DIE("random chunks(max %zd): text = %s", maxchunk, text.c_str());
+    }
+    for (size_t bufsize : {1, 4, 1024}) {
+        RandomChunkStream is(text, &rnd);
+        size_t len = m->match_stream(&is, bufsize);
+        if (!(get_result(*m, len) == expected))
+            TERARK_DIE("match_stream(bufsize %zd): text = %s", bufsize, text.c_str());
+    }
+    *matched += expected.ids.size();
+}
+
+int main(int argc, char* argv[]) {
+    const char* dfa_file = argc > 1 ? argv[1] : "test_mre_submatch_stream.dfa";
+    const char* meta = argc > 2 ? argv[2] : "test_mre_submatch_stream.meta";
+    MultiRegexMatchOptions opt;
+    opt.load_dfa(dfa_file);
+    opt.regexMetaFilePath = meta;
+    std::unique_ptr<Submatch> m(Submatch::create(opt));
+    std::mt19937 rnd(1);
+    size_t matched = 0;
+    check(m.get(), "", rnd, &matched);
+    for (size_t i = 0; i < npieces; ++i)
+        check(m.get(), pieces[i], rnd, &matched);
+    check(m.get(), "hellllo" + std::string(5000, 'a') + "z", rnd, &matched);
+    check(m.get(), "q" + std::string(5000, 'z'), rnd, &matched);
+    for (int i = 0; i < 20000; ++i)
+        check(m.get(), make_text(rnd), rnd, &matched);
+    TERARK_VERIFY_GT(matched, 0);
+    printf("  matched = %zd\n", matched);
+    printf("test_mre_submatch_stream passed\n");
+    return 0;
+}
@@ -0,0 +1,162 @@
+// parallel union and minimize of regex_build -j: par_dfa_union_n must give
+// the identical dfa(same state ids) as dfa_union_n, par_minimize_multi_root_dfa
+// (ParallelRefine) must give the same minimized dfa as Hopcroft up to state
+// numbering, for multiple thread counts
+#include <terark/fsa/automata.hpp>
+#include <terark/util/throw.hpp>
+#include <random>
+
+using namespace terark;
+
+typedef Automata<State32> DFA;
+
+// sub dfa are random graphs on a few labels, some moves are missing, a sub
+// dfa is a copy of another with probability 1/2, so copies are equivalent
+// for minimize and do not blow up the power set for union
+static void make_sub_dfa(DFA* dfa, size_t num_sub, size_t sub_states,
+                         valvec<size_t>* roots, std::mt19937& rnd) {
+    dfa->resize_states(num_sub * sub_states);
+    roots->erase_all();
+    valvec<CharTarget<size_t> > moves(DFA::sigma, valvec_no_init());
+    for (size_t k = 0; k < num_sub; ++k) {
+        size_t base = k * sub_states;
+        size_t copy = k && rnd() % 2 ? (rnd() % k) * sub_states : base;
+        for (size_t s = 0; s < sub_states; ++s) {
+            if (copy != base) {
+                size_t n = dfa->get_all_move(copy + s, moves.data());
+                for (size_t i = 0; i < n; ++i)
+                    moves[i].target += base - copy;
+                dfa->add_all_move(base + s, moves.data(), n);
+                if (dfa->is_term(copy + s))
+                    dfa->set_term_bit(base + s);
+                continue;
+            }
+            size_t n = 0;
+            for (auchar_t ch = 'a'; ch <= 'e'; ++ch) {
+                if (rnd() % 3)
+                    moves[n++] = {ch, base + rnd() % sub_states};
+            }
+            dfa->add_all_move(base + s, moves.data(), n);
+            if (rnd() % 8 == 0)
+                dfa->set_term_bit(base + s);
+        }
+        roots->push_back(base);
+    }
+}
+
+static bool same_dfa(const DFA& x, const DFA& y) {
+    if (x.total_states() != y.total_states())
+        return false;
+    valvec<CharTarget<size_t> > mx(DFA::sigma, valvec_no_init());
+    valvec<CharTarget<size_t> > my(DFA::sigma, valvec_no_init());
+    for (size_t s = 0; s < x.total_states(); ++s) {
+        if (x.is_term(s) != y.is_term(s))
+            return false;
+        size_t nx = x.get_all_move(s, mx.data());
+        size_t ny = y.get_all_move(s, my.data());
+        if (nx != ny)
+            return false;
+        for (size_t i = 0; i < nx; ++i)
+            if (mx[i].ch != my[i].ch || mx[i].target != my[i].target)
+                return false;
+    }
+    return true;
+}
+
+// same graph up to state numbering, states are paired by bfs from roots
+static bool isomorphic(const DFA& x, const valvec<size_t>& xroots,
+                       const DFA& y, const valvec<size_t>& yroots) {
+    if (x.total_states() != y.total_states() || xroots.size() != yroots.size())
+        return false;
+    valvec<size_t> x2y(x.total_states(), size_t(-1));
+    valvec<size_t> y2x(y.total_states(), size_t(-1));
+    valvec<size_t> queue;
+    auto pair = [&](size_t sx, size_t sy) {
+        if (size_t(-1) == x2y[sx] && size_t(-1) == y2x[sy]) {
+            x2y[sx] = sy, y2x[sy] = sx;
+            queue.push_back(sx);
+            return true;
+        }
+        return x2y[sx] == sy && y2x[sy] == sx;
+    };
+    for (size_t i = 0; i < xroots.size(); ++i)
+        if (!pair(xroots[i], yroots[i]))
+            return false;
+    valvec<CharTarget<size_t> > mx(DFA::sigma, valvec_no_init());
+    valvec<CharTarget<size_t> > my(DFA::sigma, valvec_no_init());
+    for (size_t head = 0; head < queue.size(); ++head) {
+        size_t sx = queue[head], sy = x2y[sx];
+        if (x.is_term(sx) != y.is_term(sy))
+            return false;
+        size_t nx = x.get_all_move(sx, mx.data());
+        size_t ny = y.get_all_move(sy, my.data());
+        if (nx != ny)
+            return false;
+        for (size_t i = 0; i < nx; ++i) {
+            if (mx[i].ch != my[i].ch || !pair(mx[i].target, my[i].target))
+                return false;
+        }
+    }
+    return queue.size() == x.total_states();
+}
+
+static void test_union(const DFA& src, const valvec<size_t>& roots,
+                       DFA* unioned) {
+    size_t ps_size = unioned->dfa_union_n(src, roots);
+    TERARK_VERIFY_GT(ps_size, 0);
+    for (size_t threads : {1, 2, 3, 8}) {
+        DFA par;
+        TERARK_VERIFY_EQ(par.par_dfa_union_n(src, roots, threads), ps_size);
+        TERARK_VERIFY(same_dfa(*unioned, par));
+    }
+    // PowerLimit exceeded returns 0 as serial
+    DFA limited;
+    TERARK_VERIFY_EQ(limited.par_dfa_union_n(src, roots, 4, ps_size / 2), 0);
+    printf("  union: sub dfa = %zd, states = %zd, power set size = %zd passed\n",
+           roots.size(), unioned->total_states(), ps_size);
+}
+
+// Hopcroft requires all states are reachable from roots, as the unioned
+// dfa of regex_build, roots are mapped to 0..n-1 by normalize
+static void test_minimize(const DFA& src, const valvec<size_t>& srcRoots) {
+    DFA dfa;
+    dfa.normalize(srcRoots, src, "DFS");
+    valvec<size_t> roots(srcRoots.size(), valvec_no_init());
+    for (size_t i = 0; i < roots.size(); ++i)
+        roots[i] = i;
+    DFA hmin;
+    valvec<size_t> hroots;
+    dfa.hopcroft_multi_root_dfa(roots, hmin, &hroots);
+    TERARK_VERIFY_LE(hmin.total_states(), dfa.total_states());
+    for (size_t threads : {1, 2, 3, 8}) {
+        DFA pmin;
+        valvec<size_t> proots;
+        dfa.par_minimize_multi_root_dfa(roots, pmin, &proots, threads);
+        TERARK_VERIFY_EQ(proots.size(), roots.size());
+        TERARK_VERIFY(isomorphic(hmin, hroots, pmin, proots));
+    }
+    printf("  minimize: roots = %zd, states = %zd -> %zd passed\n",
+           roots.size(), dfa.total_states(), hmin.total_states());
+}
+
+int main() {
+    std::mt19937 rnd(1);
+    for (size_t num_sub : {1, 2, 4, 5}) {
+        DFA src, unioned;
+        valvec<size_t> roots;
+        make_sub_dfa(&src, num_sub, 30, &roots, rnd);
+        test_union(src, roots, &unioned);
+        test_minimize(src, roots);
+        valvec<size_t> uroots(1, initial_state);
+        test_minimize(unioned, uroots);
+    }
+    // many roots which share states, as dynaRoots of regex_build
+    DFA src;
+    valvec<size_t> roots;
+    make_sub_dfa(&src, 8, 5000, &roots, rnd);
+    for (size_t i = 1; i < 100; ++i)
+        roots.push_back(i * 397); // distinct
+    test_minimize(src, roots);
+    printf("test_par_dfa_build passed\n");
+    return 0;
+}
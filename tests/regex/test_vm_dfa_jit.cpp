@@ -0,0 +1,160 @@
+// VirtualMachineDFA_JIT: walk by native code must give same state and pos as
+// interp_walk on random dfa(sparse, simd and index map states, with and
+// without path zip), for accepted texts, rejected texts and empty text
+#include <terark/fsa/automata.hpp>
+#include <terark/fsa/virtual_machine_dfa.hpp>
+#include <terark/fsa/virtual_machine_dfa_builder.hpp>
+#include <terark/fsa/virtual_machine_dfa_jit.hpp>
+#include <terark/util/throw.hpp>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace terark;
+
+typedef Automata<State32_512> SrcDFA;
+
+static const int RegexNum = 3;
+
+// out degree is mixed: 1 and chains for zpath, few labels for compare and
+// branch, up to 16 for simd, and dense states for index map.
+// final states are as regex dfa: FULL_MATCH_DELIM to the binary regex id
+static void make_dfa(SrcDFA* dfa, size_t num, std::mt19937& rnd) {
+    dfa->resize_states(num + 5 * RegexNum);
+    for (int id = 0; id < RegexNum; ++id) {
+        size_t root = num + 5 * id;
+        for (size_t i = 0; i < 4; ++i)
+            dfa->add_move(root + i, root + i + 1, byte_t(id >> (8 * i)));
+        dfa->set_term_bit(root + 4);
+    }
+    valvec<CharTarget<size_t> > moves;
+    for (size_t s = 0; s < num; ++s) {
+        size_t deg;
+        switch (rnd() % 8) {
+        case 0: case 1: case 2: deg = 1; break;
+        case 3: deg = 2 + rnd() % 15; break;
+        case 4: deg = 17 + rnd() % 240; break;
+        default: deg = 1 + rnd() % 4; break;
+        }
+        bool narrow = rnd() % 2 == 0; // labels in 'a'..'h', walks go deeper
+        // vm builder requires < 128 unique targets of a state
+        size_t pool[64];
+        for (auto& t : pool)
+            t = rnd() % num;
+        moves.erase_all();
+        for (size_t ch = 0; ch < 256 && moves.size() < deg; ++ch) {
+            if (narrow && (ch < 'a' || ch > 'h'))
+                continue;
+            if (rnd() % (narrow ? 8 : 256) < deg)
+                moves.push_back({auchar_t(ch), pool[rnd() % 64]});
+        }
+        if (moves.empty())
+            moves.push_back({auchar_t('a' + rnd() % 8), rnd() % num});
+        if (1 == deg && rnd() % 2 == 0) {
+            // a chain of states with single in and out, for path zip
+            size_t chain = dfa->total_states(), len = 2 + rnd() % 10;
+            dfa->resize_states(chain + len);
+            for (size_t i = 0; i < len; ++i) {
+                size_t next = i + 1 < len ? chain + i + 1 : rnd() % num;
+                dfa->add_move(chain + i, next, 'a' + rnd() % 8);
+                if (rnd() % 16 == 0)
+                    dfa->add_move(chain + i, num + 5 * (rnd() % RegexNum), FULL_MATCH_DELIM);
+            }
+            moves[0].target = chain;
+        }
+        dfa->add_all_move(s, moves.data(), moves.size());
+        if (rnd() % 4 == 0 || 1 == num)
+            dfa->add_move(s, num + 5 * (rnd() % RegexNum), FULL_MATCH_DELIM);
+    }
+}
+
+// random walk on src, ends on a final state or is rejected
+static std::string make_text(const SrcDFA& src, std::mt19937& rnd, bool* accepted) {
+    std::string text;
+    size_t state = initial_state;
+    size_t maxlen = rnd() % 64;
+    valvec<CharTarget<size_t> > moves(SrcDFA::sigma, valvec_no_init());
+    while (text.size() < maxlen) {
+        size_t n = src.get_all_move(state, moves.data());
+        while (n && moves[n-1].ch >= 256)
+            n--; // FULL_MATCH_DELIM
+        if (0 == n)
+            break;
+        auto ct = moves[rnd() % n];
+        text.push_back(char(ct.ch));
+        state = ct.target;
+        if (rnd() % 8 == 0)
+            break;
+    }
+    if (rnd() % 4 == 0) {
+        text.push_back(char(rnd())); // may be rejected
+        if (rnd() % 2 == 0)
+            text.append(rnd() % 8, char(rnd()));
+    }
+    *accepted = true;
+    state = initial_state;
+    for (byte_t ch : text) {
+        state = src.state_move(state, ch);
+        if (SrcDFA::nil_state == state) {
+            *accepted = false;
+            break;
+        }
+    }
+    if (*accepted)
+        *accepted = SrcDFA::nil_state != src.state_move(state, FULL_MATCH_DELIM);
+    return text;
+}
+
+static void test(size_t num, unsigned seed, bool pzip) {
+    std::mt19937 rnd(seed);
+    SrcDFA src;
+    make_dfa(&src, num, rnd);
+    VirtualMachineDFA vm;
+    if (pzip) {
+        SrcDFA zipped;
+        zipped.path_zip(src, "DFS");
+        vm.build_from(zipped);
+    } else {
+        vm.build_from(src);
+    }
+    VirtualMachineDFA_JIT jit(&vm);
+    const auto& st = jit.stats();
+    size_t accepted_num = 0, rejected_num = 0;
+    auto check = [&](fstring text, bool accepted) {
+        size_t pos1 = size_t(-1), pos2 = size_t(-1);
+        size_t state1 = jit.interp_walk(&vm, initial_state, text, &pos1);
+        size_t state2 = jit.walk(initial_state, text, &pos2);
+        TERARK_VERIFY_EQ(state1, state2);
+        TERARK_VERIFY_EQ(pos1, pos2);
+        TERARK_VERIFY_LE(pos1, text.size());
+        if (accepted) {
+            TERARK_VERIFY_EQ(pos1, text.size());
+            TERARK_VERIFY(vm.is_term(state1));
+            accepted_num++;
+        } else {
+            rejected_num++;
+        }
+    };
+    check("", SrcDFA::nil_state != src.state_move(initial_state, FULL_MATCH_DELIM));
+    for (int i = 0; i < 20000; ++i) {
+        bool accepted = false;
+        std::string text = make_text(src, rnd, &accepted);
+        check(text, accepted);
+    }
+    TERARK_VERIFY_GT(accepted_num, 0);
+    TERARK_VERIFY_GT(rejected_num, 0);
+    printf("  states = %zd, pzip = %d, %s passed: cmp = %zd, simd = %zd, table = %zd, accepted = %zd, rejected = %zd\n",
+           vm.total_states(), pzip, jit.is_jitted() ? "jit" : "interp",
+           st.cmpStates, st.simdStates, st.tableStates, accepted_num, rejected_num);
+}
+
+int main() {
+    for (bool pzip : {false, true}) {
+        test(1, 1, pzip);
+        test(50, 2, pzip);
+        test(1000, 3, pzip);
+        test(20000, 4, pzip);
+    }
+    printf("test_vm_dfa_jit passed\n");
+    return 0;
+}
@@ -0,0 +1,170 @@
+// rpc client and server on a socketpair, the server has 0 or 4 worker threads:
+// async calls between begin_batch and the outermost end_batch are not sent
+// before end_batch, batches larger than the output buffer are complete,
+// ordered async calls run and reply in order even if the server has worker
+// threads, noorder calls are run concurrently by the worker pool, futures get
+// the results, and exceptions of server functions are propagated to sync
+// calls, futures and async callbacks, the session is usable after that.
+// the server side is test_rpc_async_server.cpp, see Makefile
+#include <terark/rpc/client.hpp>
+#include <terark/inet/SocketStream.hpp>
+#include <terark/util/throw.hpp>
+#include <sys/socket.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace terark;
+using namespace terark::rpc;
+
+#include "test_rpc_async.h"
+
+typedef rpc_client<PortableDataInput, PortableDataOutput> Client;
+
+class RpcTestClient : public rpc_test_client::RpcTest {
+public:
+    std::vector<int> returned; // x of append, in the order of replies
+    std::vector<int> failed;   // x of append which got rpc_ret_exception
+    RpcTestClient() {
+        this->append.set_async_callback(&RpcTestClient::on_append);
+    }
+private:
+    void on_append(const client_packet_base& packet, rpc_in<int> x) {
+        if (rpc_ret_exception == packet.retv)
+            failed.push_back(x.r);
+        else {
+            TERARK_VERIFY_EQ(packet.retv, x.r);
+            returned.push_back(x.r);
+        }
+    }
+};
+RPC_TYPEDEF_PTR(RpcTestClient);
+
+static void test_batch(Client& client, RpcTestClient* obj) {
+    const int num = 100;
+    std::vector<std::future<rpc_ret_t> > futures(num);
+    size_t calls = rpc_test_server_calls();
+    {
+        rpc_client_base::batch_scope batch(&client);
+        {
+            rpc_client_base::batch_scope nested(&client);
+            for (int i = 0; i < num / 2; ++i)
+                futures[i] = obj->get_val.async_future(i);
+        }
+        for (int i = num / 2; i < num; ++i)
+            futures[i] = obj->get_val.async_future(i);
+        // nothing is sent before the outermost end_batch
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        TERARK_VERIFY_EQ(rpc_test_server_calls(), calls);
+    }
+    client.wait_pending_async();
+    for (int i = 0; i < num; ++i)
+        TERARK_VERIFY_EQ(futures[i].get(), i);
+    TERARK_VERIFY_EQ(rpc_test_server_calls(), calls + num);
+
+    // larger than the output buffer, which is flushed when it is full
+    const int big = 5000;
+    std::vector<std::string> strs(big);
+    futures.resize(big);
+    {
+        rpc_client_base::batch_scope batch(&client);
+        for (int i = 0; i < big; ++i) {
+            strs[i].assign(1 + i % 100, 'a');
+            futures[i] = obj->get_len.async_future(strs[i]);
+        }
+    }
+    client.wait_pending_async();
+    for (int i = 0; i < big; ++i)
+        TERARK_VERIFY_EQ(futures[i].get(), 1 + i % 100);
+}
+
+// 8f97c87: ordered calls were run by the worker pool and could be reordered
+static void test_ordered(Client& client, RpcTestClient* obj) {
+    const int num = 64;
+    for (bool batched : {false, true}) {
+        obj->returned.clear();
+        if (batched)
+            client.begin_batch();
+        for (int i = 0; i < num; ++i)
+            obj->append.async(i);
+        if (batched)
+            client.end_batch();
+        client.wait_pending_async();
+        std::vector<int> log;
+        TERARK_VERIFY_EQ(obj->take_log(&log), num);
+        TERARK_VERIFY_EQ(log.size(), size_t(num));
+        TERARK_VERIFY_EQ(obj->returned.size(), size_t(num));
+        for (int i = 0; i < num; ++i) {
+            TERARK_VERIFY_EQ(log[i], i);
+            TERARK_VERIFY_EQ(obj->returned[i], i);
+        }
+    }
+}
+
+// the first call waits for all later calls, it can return only if the later
+// calls are run while it is running
+static void test_noorder(Client& client, RpcTestClient* obj) {
+    const int num = 8;
+    std::vector<std::future<rpc_ret_t> > futures(num);
+    futures[0] = obj->wait_done.async_future(0, num - 1);
+    for (int i = 1; i < num; ++i)
+        futures[i] = obj->wait_done.async_future(i, 0);
+    client.wait_pending_async();
+    for (int i = 0; i < num; ++i)
+        TERARK_VERIFY_EQ(futures[i].get(), i);
+}
+
+static void test_exception(Client& client, RpcTestClient* obj) {
+    const std::string empty, hello = "hello";
+    TERARK_VERIFY_EQ(obj->get_len(empty), rpc_ret_exception);
+    TERARK_VERIFY_EQ(obj->get_len(hello), 5);
+
+    std::future<rpc_ret_t> ferr = obj->get_len.async_future(empty);
+    std::future<rpc_ret_t> fok = obj->get_len.async_future(hello);
+    client.wait_pending_async();
+    bool caught = false;
+    try {
+        ferr.get();
+    }
+    catch (const rpc_exception& exp) {
+        caught = true;
+    }
+    TERARK_VERIFY(caught);
+    TERARK_VERIFY_EQ(fok.get(), 5);
+
+    obj->returned.clear();
+    obj->failed.clear();
+    obj->append.async(-1);
+    obj->append.async(1);
+    client.wait_pending_async();
+    TERARK_VERIFY_EQ(obj->failed.size(), 1);
+    TERARK_VERIFY_EQ(obj->failed[0], -1);
+    TERARK_VERIFY_EQ(obj->returned.size(), 1);
+    TERARK_VERIFY_EQ(obj->returned[0], 1);
+    std::vector<int> log;
+    TERARK_VERIFY_EQ(obj->take_log(&log), 1);
+    TERARK_VERIFY_EQ(obj->get_val(7), 7);
+}
+
+static void test(int nThreads) {
+    int fds[2];
+    TERARK_VERIFY_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    start_rpc_test_server(fds[0], nThreads);
+    SocketStream stream(fds[1]); // close the session on return
+    Client client(&stream);
+    RpcTestClientPtr obj = client.create("obj");
+    test_batch(client, obj.get());
+    test_ordered(client, obj.get());
+    if (nThreads > 1)
+        test_noorder(client, obj.get());
+    test_exception(client, obj.get());
+    printf("  worker threads = %d passed\n", nThreads);
+}
+
+int main() {
+    test(0);
+    test(4);
+    printf("test_rpc_async passed\n");
+    return 0;
+}
@@ -0,0 +1,39 @@
+// interface of test_rpc_async, included after client.hpp or server.hpp.
+// client and server definitions are different, so they are put in different
+// namespaces, they are linked into one exe
+#pragma once
+
+namespace IF_RPC_SERVER(rpc_test_server, rpc_test_client) {
+
+class RpcTest : public GlobaleScope
+{
+public:
+    BEGIN_RPC_ADD_MF(RpcTest)
+        RPC_ADD_MF(get_val)
+        RPC_ADD_MF(get_len)
+        RPC_ADD_MF(append)
+        RPC_ADD_MF(take_log)
+        RPC_ADD_MF(wait_done)
+    END_RPC_ADD_MF()
+
+    //! returns x
+    RPC_DECLARE_MF(get_val, (rpc_in<int> x))
+    //! returns x.size(), throws if x is empty
+    RPC_DECLARE_MF(get_len, (const std::string& x))
+    //! appends x to the log after sleep of (3 - x % 4) ms, throws if x < 0
+    RPC_DECLARE_MF(append, (rpc_in<int> x))
+    //! moves the log to log
+    RPC_DECLARE_MF(take_log, (std::vector<int>* log))
+    //! wait_for == 0: count as done and return x
+    //! wait_for >  0: wait until wait_for calls are done, return -1 if timeout
+    RPC_DECLARE_MF(wait_done, (rpc_in<int> x, rpc_in<int> wait_for))
+};
+
+} // namespace
+
+//! start a server of one session on the socket fd, the session runs until
+//! the peer is closed, nThreads is for rpc_server::set_worker_threads
+void start_rpc_test_server(int fd, int nThreads);
+
+//! number of calls which have been started by all test servers
+size_t rpc_test_server_calls();
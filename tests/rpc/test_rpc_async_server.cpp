@@ -0,0 +1,102 @@
+// server side of test_rpc_async, see test_rpc_async.h
+#include <terark/rpc/server.hpp>
+#include <terark/inet/SocketStream.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+using namespace terark;
+using namespace terark::rpc;
+
+#include "test_rpc_async.h"
+
+static std::atomic<size_t> g_calls(0);
+
+namespace rpc_test_server {
+
+BEGIN_RPC_IMP_INTERFACE(RpcTestImp, RpcTest)
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::vector<int> m_log;
+    int m_done = 0;
+
+    rpc_ret_t get_val(rpc_in<int> x) {
+        g_calls++;
+        return x.r;
+    }
+    rpc_ret_t get_len(const std::string& x) {
+        g_calls++;
+        if (x.empty()) // client gets rpc_ret_exception
+            throw std::invalid_argument("get_len: empty string");
+        return x.size();
+    }
+    rpc_ret_t append(rpc_in<int> x) {
+        g_calls++;
+        if (x.r < 0)
+            throw std::invalid_argument("append: negative");
+        // if calls were run concurrently, later calls would be appended first
+        std::this_thread::sleep_for(std::chrono::milliseconds(3 - x.r % 4));
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_log.push_back(x.r);
+        return x.r;
+    }
+    rpc_ret_t take_log(std::vector<int>* log) {
+        g_calls++;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        log->swap(m_log);
+        m_log.clear();
+        return log->size();
+    }
+    rpc_ret_t wait_done(rpc_in<int> x, rpc_in<int> wait_for) {
+        g_calls++;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (0 == wait_for.r) {
+            m_done++;
+            m_cond.notify_all();
+            return x.r;
+        }
+        auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (m_done < wait_for.r) {
+            if (m_cond.wait_until(lock, timeout) == std::cv_status::timeout)
+                return -1;
+        }
+        return x.r;
+    }
+END_RPC_IMP_INTERFACE()
+
+} // namespace rpc_test_server
+
+// accepts the socket once, then start() returns
+class OneShotAcceptor : public IAcceptor {
+    int m_fd;
+public:
+    explicit OneShotAcceptor(int fd) : m_fd(fd) {}
+    IDuplexStream* accept() override {
+        if (m_fd < 0)
+            return NULL;
+        SocketStream* stream = new SocketStream(m_fd);
+        m_fd = -1;
+        return stream;
+    }
+};
+
+struct RpcTestServer {
+    OneShotAcceptor acceptor;
+    rpc_server<PortableDataInput, PortableDataOutput> server;
+    RpcTestServer(int fd) : acceptor(fd), server(&acceptor) {}
+};
+
+void start_rpc_test_server(int fd, int nThreads) {
+    // rpc_server does not join sessions, so it is alive until exit
+    RpcTestServer* p = new RpcTestServer(fd);
+    p->server.set_worker_threads(nThreads);
+    RPC_SERVER_AUTO_CREATE(p->server, rpc_test_server::RpcTestImp);
+    p->server.start();
+}
+
+size_t rpc_test_server_calls() {
+    return g_calls;
+}
@@ -0,0 +1,111 @@
+// NestLoudsTrie build sorts the input unless conf.isInputSorted is set or the
+// input is SortedStrVec family, which can not be sorted, the input which is
+// not sorted by the build must be checked: unsorted input is rejected by
+// std::invalid_argument, instead of giving a broken trie
+#include <terark/fsa/nest_trie_dawg.hpp>
+#include <terark/util/sortable_strvec.hpp>
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace terark;
+
+static std::vector<std::string> make_keys(size_t num) {
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < num; ++i) {
+        char buf[64];
+        int len = snprintf(buf, sizeof(buf), "%zx.%zu-%.*s", i % 251,
+                           i * 7919 % 100003, int(i % 9), "xyzxyzxyz");
+        keys.emplace_back(buf, len);
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    return keys;
+}
+
+template<class StrVec>
+static void fill(StrVec& strVec, const std::vector<std::string>& keys) {
+    size_t pool = 0;
+    for (auto& key : keys)
+        pool += key.size();
+    strVec.reserve(keys.size(), pool); // SortedStrVec requires reserve
+    for (auto& key : keys)
+        strVec.push_back(key);
+}
+
+template<class StrVec>
+static bool build(StrVec& strVec, bool isInputSorted,
+                  const std::vector<std::string>& keys) {
+    NestLoudsTrieConfig conf;
+    conf.initFromEnv();
+    conf.nestLevel = 3;
+    conf.isInputSorted = isInputSorted;
+    NestLoudsTrieDAWG_SE_512 dawg;
+    try {
+        dawg.build_from(strVec, conf);
+    }
+    catch (const std::invalid_argument&) {
+        return false;
+    }
+    TERARK_VERIFY_EQ(dawg.num_words(), keys.size());
+    for (auto& key : keys)
+        TERARK_VERIFY_LT(dawg.index(key), keys.size());
+    return true;
+}
+
+// SortableStrVec is sorted if !isInputSorted, else it is checked
+static void test_sortable(const std::vector<std::string>& sorted,
+                          const std::vector<std::string>& shuffled) {
+    {
+        SortableStrVec strVec;
+        fill(strVec, shuffled);
+        TERARK_VERIFY(build(strVec, false, sorted));
+    }
+    {
+        SortableStrVec strVec;
+        fill(strVec, sorted);
+        TERARK_VERIFY(build(strVec, true, sorted));
+    }
+    {
+        SortableStrVec strVec;
+        fill(strVec, shuffled);
+        TERARK_VERIFY(!build(strVec, true, sorted));
+    }
+    printf("  SortableStrVec passed\n");
+}
+
+// SortedStrVec is always checked, isInputSorted does not matter
+template<class StrVec>
+static void test_sorted(const char* name, const std::vector<std::string>& sorted,
+                        const std::vector<std::string>& shuffled) {
+    for (bool isInputSorted : {false, true}) {
+        {
+            StrVec strVec;
+            fill(strVec, sorted);
+            TERARK_VERIFY(build(strVec, isInputSorted, sorted));
+        }
+        {
+            StrVec strVec;
+            fill(strVec, shuffled);
+            TERARK_VERIFY(!build(strVec, isInputSorted, sorted));
+        }
+    }
+    printf("  %s passed\n", name);
+}
+
+int main() {
+    const std::vector<std::string> sorted = make_keys(20000);
+    std::vector<std::string> shuffled = sorted;
+    std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(1));
+    // only the last 2 keys are out of order
+    std::vector<std::string> last_swapped = sorted;
+    std::swap(last_swapped[sorted.size() - 2], last_swapped.back());
+    test_sortable(sorted, shuffled);
+    test_sorted<VoSortedStrVec>("VoSortedStrVec", sorted, shuffled);
+    test_sorted<QoSortedStrVec>("QoSortedStrVec", sorted, last_swapped);
+    test_sorted<DoSortedStrVec>("DoSortedStrVec", sorted, last_swapped);
+    printf("test_nest_louds_trie_sorted passed\n");
+    return 0;
+}
@@ -0,0 +1,122 @@
+// NestTrieDAWG::build_from_patricia: index(key) must map through word_valpos
+// back to the valpos of the key in source Patricia, for every key
+#include <terark/fsa/nest_trie_dawg.hpp>
+#include <terark/fsa/cspptrie.inl>
+#include <random>
+#include <stdexcept>
+
+using namespace terark;
+
+static std::string make_key(fstring prefix, size_t i) {
+    char buf[64];
+    int len = snprintf(buf, sizeof(buf), "%zx.%zu-%.*s", i % 251, i * 7919 % 100003,
+                       int(i % 9), "xyzxyzxyz");
+    return prefix + std::string(buf, len);
+}
+
+static MainPatricia* make_patricia(fstring prefix, size_t num) {
+    MainPatricia* trie = new MainPatricia(sizeof(uint64_t), 1<<20, Patricia::SingleThreadStrict);
+    Patricia::WriterTokenPtr wtp(new Patricia::WriterToken());
+    wtp->acquire(trie);
+    for (size_t i = 0; i < num; ++i) {
+        uint64_t val = i;
+        wtp->insert(make_key(prefix, i), &val); // dup keys are ignored
+    }
+    wtp->release();
+    return trie;
+}
+
+template<class Dawg>
+static void test(const char* name, fstring prefix, size_t num) {
+    std::unique_ptr<MainPatricia> src(make_patricia(prefix, num));
+    NestLoudsTrieConfig conf;
+    conf.initFromEnv();
+    conf.nestLevel = 3;
+    conf.commonPrefix = prefix.str();
+    Dawg dawg;
+    valvec<size_t> word_valpos;
+    dawg.build_from_patricia(*src, &word_valpos, conf);
+    const size_t n = src->num_words();
+    TERARK_VERIFY_EQ(dawg.num_words(), n);
+    TERARK_VERIFY_EQ(word_valpos.size(), n);
+
+    Patricia::ReaderTokenPtr rtp(new Patricia::ReaderToken());
+    rtp->acquire(src.get());
+    valvec<bool> seen(n, false);
+    for (size_t i = 0; i < num; ++i) {
+        std::string key = make_key(prefix, i);
+        TERARK_VERIFY(rtp->lookup(key));
+        size_t id = dawg.index(key);
+        TERARK_VERIFY_LT(id, n);
+        TERARK_VERIFY_EQ(word_valpos[id], rtp->get_valpos());
+        TERARK_VERIFY(dawg.nth_word(id) == key);
+        seen[id] = true;
+        TERARK_VERIFY_EQ(dawg.index(key + '\1'), size_t(-1));
+    }
+    rtp->release();
+    for (size_t id = 0; id < n; ++id)
+        TERARK_VERIFY(seen[id]);
+
+    // all words of src, word id is not lexical order, it is the BFS order
+    auto iter = src->new_iter();
+    size_t cnt = 0, total_len = 0;
+    for (bool ok = iter->seek_begin(); ok; ok = iter->incr(), ++cnt) {
+        size_t id = dawg.index(iter->word());
+        TERARK_VERIFY_LT(id, n);
+        TERARK_VERIFY_EQ(word_valpos[id], iter->get_valpos());
+        total_len += iter->word().size();
+    }
+    iter->dispose();
+    TERARK_VERIFY_EQ(cnt, n);
+    TERARK_VERIFY_EQ(dawg.adfa_total_words_len(), total_len);
+
+    // build without word_valpos
+    Dawg dawg2;
+    dawg2.build_from_patricia(*src, nullptr, conf);
+    TERARK_VERIFY_EQ(dawg2.num_words(), n);
+    TERARK_VERIFY_EQ(dawg2.index(make_key(prefix, num / 2)), dawg.index(make_key(prefix, num / 2)));
+    printf("%s(commonPrefix = \"%s\") passed: %zd words\n", name, prefix.c_str(), n);
+}
+
+template<class Dawg>
+static void test_reject(const char* name) {
+    NestLoudsTrieConfig conf;
+    conf.initFromEnv();
+    conf.nestLevel = 3;
+    {
+        // a word does not start with commonPrefix
+        std::unique_ptr<MainPatricia> src(make_patricia("pre/", 1000));
+        Patricia::WriterTokenPtr wtp(new Patricia::WriterToken());
+        wtp->acquire(src.get());
+        uint64_t val = 0;
+        TERARK_VERIFY(wtp->insert("other", &val));
+        wtp->release();
+        conf.commonPrefix = "pre/";
+        Dawg dawg;
+        bool thrown = false;
+        try { dawg.build_from_patricia(*src, nullptr, conf); }
+        catch (const std::invalid_argument&) { thrown = true; }
+        TERARK_VERIFY(thrown);
+    }
+    {
+        MainPatricia empty(sizeof(uint64_t), 1<<20, Patricia::SingleThreadStrict);
+        conf.commonPrefix.clear();
+        Dawg dawg;
+        bool thrown = false;
+        try { dawg.build_from_patricia(empty, nullptr, conf); }
+        catch (const std::invalid_argument&) { thrown = true; }
+        TERARK_VERIFY(thrown);
+    }
+    printf("%s reject passed\n", name);
+}
+
+int main() {
+    test<NestLoudsTrieDAWG_SE_512>("NestLoudsTrieDAWG_SE_512", "", 20000);
+    test<NestLoudsTrieDAWG_SE_512>("NestLoudsTrieDAWG_SE_512", "user/", 20000);
+    test<NestLoudsTrieDAWG_IL_256>("NestLoudsTrieDAWG_IL_256", "", 20000);
+    test<NestLoudsTrieDAWG_IL_256>("NestLoudsTrieDAWG_IL_256", "a/long/common/prefix/of/all/keys/", 20000);
+    test<NestLoudsTrieDAWG_SE_512>("NestLoudsTrieDAWG_SE_512", "", 1);
+    test_reject<NestLoudsTrieDAWG_SE_512>("NestLoudsTrieDAWG_SE_512");
+    printf("test_nest_trie_dawg_from_patricia passed\n");
+    return 0;
+}
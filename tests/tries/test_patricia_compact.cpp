@@ -0,0 +1,152 @@
+// MainPatricia compact_to/compact: iteration order, values and lookups must
+// be same before and after compaction
+#include <terark/fsa/cspptrie.inl>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace terark;
+
+typedef std::vector<std::pair<std::string, uint64_t> > KeyValVec;
+
+static const size_t NumKeys = 50000;
+
+static std::string make_key(size_t i) {
+    char buf[64];
+    // shared prefixes, various lengths and fanouts, some key is prefix of others
+    int len = snprintf(buf, sizeof(buf), "%zx/%zu%.*s", i % 97, i / 7,
+                       int(i % 5), "abcde");
+    return std::string(buf, len);
+}
+
+static uint64_t make_val(size_t i) { return i * 0x9E3779B97F4A7C15ull; }
+
+// insert in random order, thus children are scattered in mempool
+static void insert_keys(MainPatricia& trie, size_t beg, size_t end) {
+    std::vector<size_t> ids;
+    for (size_t i = beg; i < end; ++i)
+        ids.push_back(i);
+    std::shuffle(ids.begin(), ids.end(), std::mt19937(unsigned(beg)));
+    Patricia::WriterTokenPtr wtp(new Patricia::WriterToken());
+    wtp->acquire(&trie);
+    for (size_t i : ids) {
+        uint64_t val = make_val(i);
+        wtp->insert(make_key(i), &val); // dup keys are ignored
+        TERARK_VERIFY(wtp->has_value());
+    }
+    wtp->release();
+}
+
+static KeyValVec dump(const MainPatricia& trie, bool reverse = false) {
+    KeyValVec kv;
+    auto iter = trie.new_iter();
+    bool ok = reverse ? iter->seek_end() : iter->seek_begin();
+    for (; ok; ok = reverse ? iter->decr() : iter->incr())
+        kv.emplace_back(iter->word().str(), iter->value_of<uint64_t>());
+    iter->dispose();
+    if (reverse)
+        std::reverse(kv.begin(), kv.end());
+    return kv;
+}
+
+static void check(MainPatricia& trie, const KeyValVec& expected,
+                  uint64_t xor_val = 0) {
+    TERARK_VERIFY_EQ(trie.num_words(), expected.size());
+    KeyValVec kv = dump(trie);
+    TERARK_VERIFY_EQ(kv.size(), expected.size());
+    for (size_t i = 0; i < kv.size(); ++i) {
+        TERARK_VERIFY(kv[i].first == expected[i].first);
+        TERARK_VERIFY_EQ(kv[i].second, expected[i].second ^ xor_val);
+    }
+    TERARK_VERIFY(dump(trie, true) == kv);
+    Patricia::ReaderTokenPtr rtp(new Patricia::ReaderToken());
+    rtp->acquire(&trie);
+    for (auto& x : expected) {
+        TERARK_VERIFY(rtp->lookup(x.first));
+        TERARK_VERIFY_EQ(rtp->value_of<uint64_t>(), x.second ^ xor_val);
+        std::string miss = x.first + '\xFF';
+        TERARK_VERIFY(!rtp->lookup(miss));
+    }
+    rtp->release();
+    // lower_bound of absent keys
+    auto iter = trie.new_iter();
+    for (size_t i = 0; i + 1 < expected.size(); i += 101) {
+        std::string key = expected[i].first + '\0';
+        TERARK_VERIFY(iter->seek_lower_bound(key));
+        TERARK_VERIFY(iter->word() == expected[i+1].first);
+    }
+    iter->dispose();
+}
+
+static void test_compact_to(Patricia::ConcurrentLevel src_level,
+                            Patricia::ConcurrentLevel dst_level) {
+    MainPatricia src(sizeof(uint64_t), 16<<20, src_level);
+    insert_keys(src, 0, NumKeys);
+    const KeyValVec expected = dump(src);
+    check(src, expected);
+
+    MainPatricia dst(sizeof(uint64_t), 16<<20, dst_level);
+    const uint64_t xor_val = 0x5A5A;
+    size_t ncopy = 0;
+    MainPatricia::CompactStat cs;
+    src.compact_to(&dst, &cs, [&](MainPatricia* d, void* dval, const void* sval) {
+        TERARK_VERIFY(d == &dst);
+        TERARK_VERIFY_EQ(memcmp(dval, sval, sizeof(uint64_t)), 0);
+        *(uint64_t*)dval ^= xor_val;
+        ncopy++;
+    });
+    TERARK_VERIFY_EQ(ncopy, expected.size());
+    check(src, expected); // src is not changed
+    check(dst, expected, xor_val);
+    TERARK_VERIFY_EQ(cs.old_mem_size, src.mem_size());
+    TERARK_VERIFY_EQ(cs.new_mem_size, dst.mem_size());
+    TERARK_VERIFY_LE(cs.new_mem_size, cs.old_mem_size);
+    TERARK_VERIFY_GE(cs.new_near_ratio, cs.old_near_ratio);
+    TERARK_VERIFY_LE(cs.new_avg_dist, cs.old_avg_dist);
+
+    // dst is writable after compact
+    insert_keys(dst, NumKeys, NumKeys + 1000);
+    TERARK_VERIFY_EQ(dst.num_words(), expected.size() + 1000);
+    printf("compact_to(%s -> %s) passed: mem %zd -> %zd, near %.3f -> %.3f\n",
+           enum_cstr(src_level), enum_cstr(dst_level), cs.old_mem_size,
+           cs.new_mem_size, cs.old_near_ratio, cs.new_near_ratio);
+}
+
+static void test_compact_in_place() {
+    MainPatricia trie(sizeof(uint64_t), 1<<20, Patricia::SingleThreadStrict);
+    insert_keys(trie, 0, NumKeys);
+    const char appdata[] = "appdata is kept by compact";
+    memcpy(trie.alloc_appdata(sizeof(appdata)), appdata, sizeof(appdata));
+    const KeyValVec expected = dump(trie);
+    MainPatricia::CompactStat cs;
+    trie.compact(&cs);
+    check(trie, expected);
+    TERARK_VERIFY_EQ(trie.appdata_len(), pow2_align_up(sizeof(appdata), 4));
+    TERARK_VERIFY_EQ(memcmp(trie.appdata_ptr(), appdata, sizeof(appdata)), 0);
+    TERARK_VERIFY_LE(cs.new_mem_size, cs.old_mem_size);
+    TERARK_VERIFY_EQ(trie.mem_size(), cs.new_mem_size);
+
+    // compact again is stable
+    MainPatricia::CompactStat cs2;
+    trie.compact(&cs2);
+    check(trie, expected);
+    TERARK_VERIFY_EQ(cs2.new_mem_size, cs.new_mem_size);
+    TERARK_VERIFY_EQ(cs2.num_nodes, cs.num_nodes);
+
+    insert_keys(trie, NumKeys, NumKeys + 1000);
+    TERARK_VERIFY_EQ(trie.num_words(), expected.size() + 1000);
+    KeyValVec all = dump(trie);
+    trie.compact();
+    check(trie, all);
+    printf("compact in place passed: mem %zd -> %zd\n",
+           cs.old_mem_size, cs.new_mem_size);
+}
+
+int main() {
+    test_compact_to(Patricia::SingleThreadStrict, Patricia::SingleThreadStrict);
+    test_compact_to(Patricia::SingleThreadShared, Patricia::OneWriteMultiRead);
+    test_compact_to(Patricia::OneWriteMultiRead, Patricia::SingleThreadStrict);
+    test_compact_in_place();
+    printf("test_patricia_compact passed\n");
+    return 0;
+}
@@ -0,0 +1,181 @@
+// crash consistency of Patricia persistent mode(persist=1)
+#include <terark/fsa/cspptrie.inl>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace terark;
+
+static const char* g_fpath = "test_patricia_persist.trie";
+static const char* g_jpath = "test_patricia_persist.trie.jnl";
+static const size_t PageSize = 4096; // header slot size
+
+// crash is simulated by _exit after the g_crash_at'th fdatasync of the
+// process, persist_sync calls fdatasync after: 1. journal, 2. image, 3. header
+static int g_crash_at = 0;
+extern "C" int fdatasync(int fd) {
+    int ret = int(syscall(SYS_fdatasync, fd));
+    if (g_crash_at && 0 == --g_crash_at)
+        _exit(0);
+    return ret;
+}
+
+static fstring make_key(char* buf, size_t i) {
+    int len = snprintf(buf, 64, "k%08u-%zx", unsigned(i * 2654435761u % 100000000u), i);
+    return fstring(buf, len);
+}
+
+static std::string conf(Patricia::ConcurrentLevel level) {
+    std::string s = "?persist=1";
+    if (Patricia::OneWriteMultiRead == level)
+        s += "&vm_grow=1";
+    return s + "&file_path=" + g_fpath;
+}
+
+static void insert_range(Patricia::ConcurrentLevel level, size_t beg, size_t end,
+                         bool sync) {
+    MainPatricia trie(sizeof(uint32_t), 64<<10, level, conf(level));
+    TERARK_VERIFY(trie.is_persistent());
+    TERARK_VERIFY_EQ(trie.num_words(), beg);
+    Patricia::WriterTokenPtr wtp(new Patricia::WriterToken());
+    wtp->acquire(&trie);
+    for (size_t i = beg; i < end; ++i) {
+        char buf[64];
+        uint32_t val = uint32_t(i);
+        TERARK_VERIFY(wtp->insert(make_key(buf, i), &val));
+        TERARK_VERIFY(wtp->has_value());
+    }
+    wtp->release();
+    if (sync)
+        TERARK_VERIFY_GT(trie.persist_sync(), 0);
+}
+
+static void crash_in_sync(Patricia::ConcurrentLevel level, size_t beg, size_t end,
+                          int crash_at) {
+    fflush(stdout);
+    pid_t pid = fork();
+    TERARK_VERIFY_GE(pid, 0);
+    if (0 == pid) {
+        g_crash_at = crash_at;
+        insert_range(level, beg, end, true);
+        _exit(1); // not reached
+    }
+    int status = 0;
+    TERARK_VERIFY_EQ(waitpid(pid, &status, 0), pid);
+    TERARK_VERIFY(WIFEXITED(status));
+    TERARK_VERIFY_EQ(WEXITSTATUS(status), 0);
+}
+
+// keys [0, n) with value i, value of [0, modified) is ~i, key n is missing
+static void check(Patricia::ConcurrentLevel level, size_t n, size_t modified = 0) {
+    MainPatricia trie(sizeof(uint32_t), 64<<10, level, conf(level));
+    TERARK_VERIFY_EQ(trie.num_words(), n);
+    Patricia::ReaderTokenPtr rtp(new Patricia::ReaderToken());
+    rtp->acquire(&trie);
+    char buf[64];
+    for (size_t i = 0; i < n; ++i) {
+        TERARK_VERIFY(rtp->lookup(make_key(buf, i)));
+        uint32_t expected = i < modified ? ~uint32_t(i) : uint32_t(i);
+        TERARK_VERIFY_EQ(rtp->value_of<uint32_t>(), expected);
+    }
+    TERARK_VERIFY(!rtp->lookup(make_key(buf, n)));
+    rtp->release();
+    size_t cnt = 0;
+    auto iter = trie.new_iter();
+    for (bool ok = iter->seek_begin(); ok; ok = iter->incr())
+        cnt++;
+    iter->dispose();
+    TERARK_VERIFY_EQ(cnt, n);
+}
+
+static uint64_t header_seq(int fd, size_t slot) {
+    uint64_t seq = 0; // just after 16 bytes magic
+    TERARK_VERIFY_EQ(pread(fd, &seq, 8, slot * PageSize + 16), 8);
+    return seq;
+}
+
+// overwrite the header slot with smaller seq, as a torn header write
+static void corrupt_old_header() {
+    int fd = ::open(g_fpath, O_RDWR);
+    TERARK_VERIFY_GE(fd, 0);
+    size_t slot = header_seq(fd, 0) < header_seq(fd, 1) ? 0 : 1;
+    char garbage[64];
+    memset(garbage, 0x5A, sizeof(garbage));
+    TERARK_VERIFY_EQ(pwrite(fd, garbage, sizeof(garbage), slot * PageSize + 8), 64);
+    ::close(fd);
+}
+
+static void truncate_journal() {
+    struct stat st;
+    TERARK_VERIFY_EQ(::stat(g_jpath, &st), 0);
+    TERARK_VERIFY_GT(st.st_size, 0);
+    TERARK_VERIFY_EQ(::truncate(g_jpath, st.st_size / 2), 0);
+}
+
+static void modify_values(Patricia::ConcurrentLevel level, size_t modified) {
+    MainPatricia trie(sizeof(uint32_t), 64<<10, level, conf(level));
+    Patricia::ReaderTokenPtr rtp(new Patricia::ReaderToken());
+    rtp->acquire(&trie);
+    for (size_t i = 0; i < modified; ++i) {
+        char buf[64];
+        TERARK_VERIFY(rtp->lookup(make_key(buf, i)));
+        uint32_t& val = rtp->mutable_value_of<uint32_t>();
+        val = ~uint32_t(i);
+        trie.persist_mark_dirty(&val, sizeof(val));
+    }
+    rtp->release();
+    TERARK_VERIFY_GT(trie.persist_sync(), 0);
+    TERARK_VERIFY_EQ(trie.persist_sync(), 0); // nothing changed
+}
+
+static void test(Patricia::ConcurrentLevel level) {
+    ::unlink(g_fpath);
+    ::unlink(g_jpath);
+    insert_range(level, 0, 20000, true);
+    check(level, 20000);
+    insert_range(level, 20000, 25000, false); // lost
+    check(level, 20000);
+    insert_range(level, 20000, 30000, true); // reopen and append
+    check(level, 30000);
+
+    // journal is synced, image is not touched
+    crash_in_sync(level, 30000, 32000, 1);
+    truncate_journal(); // incomplete journal is discarded
+    check(level, 30000);
+    crash_in_sync(level, 30000, 32000, 1);
+    check(level, 32000); // complete journal is replayed
+
+    // image is synced, header write is torn
+    crash_in_sync(level, 32000, 34000, 2);
+    corrupt_old_header();
+    check(level, 34000);
+
+    // header is synced, journal is obsolete
+    crash_in_sync(level, 34000, 36000, 3);
+    check(level, 36000);
+    corrupt_old_header(); // committed header is still valid
+    check(level, 36000);
+
+    modify_values(level, 1000);
+    check(level, 36000, 1000);
+
+    if (Patricia::SingleThreadStrict == level) {
+        MainPatricia trie(sizeof(uint32_t), 64<<10, level, conf(level));
+        trie.compact();
+        TERARK_VERIFY_GT(trie.persist_sync(), 0);
+    }
+    check(level, 36000, 1000);
+    ::unlink(g_fpath);
+    ::unlink(g_jpath);
+    printf("level %s passed\n", enum_cstr(level));
+}
+
+int main() {
+    test(Patricia::SingleThreadStrict);
+    test(Patricia::SingleThreadShared);
+    test(Patricia::OneWriteMultiRead);
+    printf("test_patricia_persist passed\n");
+    return 0;
+}
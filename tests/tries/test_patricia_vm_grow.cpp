@@ -0,0 +1,120 @@
+// Patricia vm_grow: insert far past the initially committed mempool, all
+// keys inserted before and after each grow must still be readable
+#include <terark/fsa/cspptrie.inl>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace terark;
+
+static const size_t NumKeys = 300000; // about 10x of initial commit(2M)
+
+static fstring make_key(char* buf, size_t i) {
+    int len = snprintf(buf, 64, "%08zx/key-%zu", size_t(i * 2654435761u % NumKeys), i);
+    return fstring(buf, len);
+}
+
+// num_words of MultiWriteMultiRead is synced lazily, count by iterating
+static void check_all(MainPatricia& trie, size_t n) {
+    Patricia::ReaderTokenPtr rtp(new Patricia::ReaderToken());
+    rtp->acquire(&trie);
+    char buf[64];
+    for (size_t i = 0; i < n; ++i) {
+        TERARK_VERIFY(rtp->lookup(make_key(buf, i)));
+        TERARK_VERIFY_EQ(rtp->value_of<uint64_t>(), i);
+    }
+    TERARK_VERIFY(!rtp->lookup(make_key(buf, n)));
+    rtp->release();
+    size_t cnt = 0;
+    valvec<byte_t> prev;
+    auto iter = trie.new_iter();
+    for (bool ok = iter->seek_begin(); ok; ok = iter->incr()) {
+        TERARK_VERIFY(fstring(prev) < iter->word());
+        prev.assign(iter->word().udata(), iter->word().size());
+        cnt++;
+    }
+    iter->dispose();
+    TERARK_VERIFY_EQ(cnt, n);
+}
+
+// one writer, a reader keeps reading keys which are already inserted while
+// the mempool grows
+static void test_one_writer() {
+    MainPatricia trie(sizeof(uint64_t), 64<<10, Patricia::OneWriteMultiRead, "?vm_grow=1");
+    const size_t cap0 = trie.mem_capacity();
+    std::atomic<size_t> inserted{0};
+    std::atomic<size_t> read_cnt{0};
+    std::thread reader([&]() {
+        Patricia::ReaderTokenPtr rtp(new Patricia::ReaderToken());
+        char buf[64];
+        size_t n;
+        while ((n = inserted.load(std::memory_order_acquire)) < NumKeys) {
+            rtp->acquire(&trie);
+            for (size_t k = 0; k < 1000 && n; ++k) {
+                size_t i = (k * 7919 + n) % n;
+                TERARK_VERIFY(rtp->lookup(make_key(buf, i)));
+                TERARK_VERIFY_EQ(rtp->value_of<uint64_t>(), i);
+            }
+            rtp->idle();
+            read_cnt++;
+        }
+        rtp->release();
+    });
+    Patricia::WriterTokenPtr wtp(new Patricia::WriterToken());
+    wtp->acquire(&trie);
+    size_t grow_cnt = 0, cap = cap0;
+    for (size_t i = 0; i < NumKeys; ++i) {
+        char buf[64];
+        uint64_t val = i;
+        TERARK_VERIFY(wtp->insert(make_key(buf, i), &val));
+        TERARK_VERIFY(wtp->has_value()); // never fails by mem_alloc_fail
+        inserted.store(i + 1, std::memory_order_release);
+        if (trie.mem_capacity() != cap) {
+            TERARK_VERIFY_GT(trie.mem_capacity(), cap);
+            cap = trie.mem_capacity();
+            grow_cnt++;
+        }
+    }
+    wtp->release();
+    reader.join();
+    TERARK_VERIFY_GT(trie.mem_size(), cap0); // inserted past initial commit
+    TERARK_VERIFY_GE(grow_cnt, 2);
+    TERARK_VERIFY_EQ(trie.num_words(), NumKeys);
+    check_all(trie, NumKeys);
+    printf("one writer passed: cap %zd -> %zd, grow %zd times, reads %zd\n",
+           cap0, trie.mem_capacity(), grow_cnt, read_cnt.load());
+}
+
+// writers grow the mempool concurrently in ThreadCacheMemPool
+static void test_multi_writer(size_t nthr) {
+    MainPatricia trie(sizeof(uint64_t), 64<<10, Patricia::MultiWriteMultiRead, "?vm_grow=1");
+    const size_t cap0 = trie.mem_capacity();
+    std::vector<std::thread> writers;
+    for (size_t tid = 0; tid < nthr; ++tid) {
+        writers.emplace_back([&,tid]() {
+            Patricia::WriterToken& token = *trie.tls_writer_token_nn();
+            token.acquire(&trie);
+            for (size_t i = tid; i < NumKeys; i += nthr) {
+                char buf[64];
+                uint64_t val = i;
+                TERARK_VERIFY(trie.insert(make_key(buf, i), &val, &token));
+                TERARK_VERIFY(token.has_value());
+            }
+            token.release();
+        });
+    }
+    for (auto& t : writers)
+        t.join();
+    TERARK_VERIFY_GT(trie.mem_size(), cap0);
+    TERARK_VERIFY_GT(trie.mem_capacity(), cap0);
+    check_all(trie, NumKeys);
+    printf("%zd writers passed: cap %zd -> %zd\n", nthr, cap0, trie.mem_capacity());
+}
+
+int main() {
+    test_one_writer();
+    test_multi_writer(1);
+    test_multi_writer(4);
+    printf("test_patricia_vm_grow passed\n");
+    return 0;
+}
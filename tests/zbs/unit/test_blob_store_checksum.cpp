@@ -0,0 +1,218 @@
+// checksum verify on AbstractBlobStore::load_from_mmap: deferred verify of
+// data checksums on the background thread for both factory formats(XXHash64
+// of PlainBlobStore) and DFA format(crc32c of NestLoudsTrieBlobStore), header
+// checks are synchronous, and mmap_populate by multiple threads
+#include <terark/zbs/abstract_blob_store.hpp>
+#include <terark/zbs/blob_store_file_header.hpp>
+#include <terark/zbs/plain_blob_store.hpp>
+#include <terark/util/checksum_exception.hpp>
+#include <terark/util/mmap.hpp>
+#include <terark/util/sortable_strvec.hpp>
+#include <terark/util/throw.hpp>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <memory>
+#include <string>
+
+using namespace terark;
+
+static const size_t NumRecords = 20000;
+
+static std::string make_record(size_t i) {
+    std::string rec = "record-" + std::to_string(i * 7919) + "-";
+    rec.append(i % 50, char('a' + i % 26));
+    return rec;
+}
+
+static void build_plain(const char* fpath) {
+    size_t contentSize = 0;
+    for (size_t i = 0; i < NumRecords; ++i)
+        contentSize += make_record(i).size();
+    PlainBlobStore::MyBuilder builder(contentSize, NumRecords, fpath, 0, 3);
+    for (size_t i = 0; i < NumRecords; ++i)
+        builder.addRecord(make_record(i));
+    builder.finish();
+}
+
+static void build_trie(const char* fpath) {
+    SortableStrVec strVec;
+    for (size_t i = 0; i < NumRecords; ++i)
+        strVec.push_back(make_record(i));
+    std::unique_ptr<AbstractBlobStore> store(
+        NestLoudsTrieBlobStore_build("NestLoudsTrieBlobStore_SE_512", 2, strVec));
+    store->save_mmap(fpath);
+}
+
+static void verify_records(const AbstractBlobStore* store, bool sorted) {
+    TERARK_VERIFY_EQ(store->num_records(), NumRecords);
+    valvec<byte_t> rec;
+    for (size_t i = 0; i < NumRecords; i += 97) {
+        store->get_record(i, &rec);
+        if (!sorted)
+            TERARK_VERIFY(fstring(rec) == make_record(i));
+    }
+}
+
+static void xor_byte(const char* fpath, size_t offset) {
+    int fd = ::open(fpath, O_RDWR);
+    TERARK_VERIFY_GE(fd, 0);
+    byte_t b = 0;
+    TERARK_VERIFY_EQ(::pread(fd, &b, 1, offset), 1);
+    b ^= 0x5A;
+    TERARK_VERIFY_EQ(::pwrite(fd, &b, 1, offset), 1);
+    ::close(fd);
+}
+
+static size_t file_size(const char* fpath) {
+    MmapWholeFile mmap(fpath);
+    return mmap.size;
+}
+
+static AbstractBlobStore* load(const char* fpath) {
+    return AbstractBlobStore::load_from_mmap(fpath, false);
+}
+
+// deferred verify of a good file, the file is deleted before verify is done
+static void test_deferred_ok(const char* fpath, bool sorted) {
+    std::unique_ptr<AbstractBlobStore> store(load(fpath));
+    ::unlink(fpath);
+    verify_records(store.get(), sorted); // usable before verified
+    store->wait_checksum_verify();
+    TERARK_VERIFY_EQ(store->checksum_verify_state(), AbstractBlobStore::kChecksumVerified);
+    verify_records(store.get(), sorted);
+}
+
+// data is corrupted: load succeeds, deferred verify fails, and sync load
+// throws if verify is not deferred
+static void test_deferred_bad(const char* fpath, size_t offset) {
+    xor_byte(fpath, offset);
+    std::unique_ptr<AbstractBlobStore> store(load(fpath));
+    bool thrown = false;
+    try {
+        store->wait_checksum_verify();
+    }
+    catch (const BadChecksumException& ex) {
+        thrown = true;
+        TERARK_VERIFY_NE(ex.m_old, ex.m_new);
+    }
+    TERARK_VERIFY(thrown);
+    TERARK_VERIFY_EQ(store->checksum_verify_state(), AbstractBlobStore::kChecksumVerifyFailed);
+    thrown = false;
+    try {
+        store->wait_checksum_verify(); // exception is kept
+    }
+    catch (const BadChecksumException&) {
+        thrown = true;
+    }
+    TERARK_VERIFY(thrown);
+    store.reset();
+
+    AbstractBlobStore::set_defer_checksum_verify(false);
+    thrown = false;
+    try {
+        store.reset(load(fpath));
+    }
+    catch (const BadChecksumException&) {
+        thrown = true;
+    }
+    TERARK_VERIFY(thrown);
+    AbstractBlobStore::set_defer_checksum_verify(true);
+}
+
+// header is checked on load even if verify is deferred
+static void test_header_bad(const char* fpath, size_t offset) {
+    xor_byte(fpath, offset);
+    bool thrown = false;
+    try {
+        std::unique_ptr<AbstractBlobStore> store(load(fpath));
+    }
+    catch (const BadChecksumException&) {
+        thrown = true;
+    }
+    TERARK_VERIFY(thrown);
+}
+
+static void test_plain() {
+    const char* fpath = "test_blob_store_checksum.plain";
+    build_plain(fpath);
+    test_deferred_ok(fpath, false);
+
+    build_plain(fpath);
+    {
+        AbstractBlobStore::set_defer_checksum_verify(false);
+        std::unique_ptr<AbstractBlobStore> store(load(fpath));
+        TERARK_VERIFY_EQ(store->checksum_verify_state(), AbstractBlobStore::kChecksumVerified);
+        store->wait_checksum_verify(); // no-op
+        AbstractBlobStore::set_defer_checksum_verify(true);
+    }
+    test_deferred_bad(fpath, file_size(fpath) / 2);
+    ::unlink(fpath);
+    printf("  PlainBlobStore passed\n");
+}
+
+static void test_trie() {
+    const char* fpath = "test_blob_store_checksum.trie";
+    build_trie(fpath);
+    test_deferred_ok(fpath, true);
+
+    build_trie(fpath);
+    test_deferred_bad(fpath, file_size(fpath) - 1); // last byte of data
+    build_trie(fpath);
+    test_header_bad(fpath, 900); // reserved bytes of DFA_MmapHeader
+    ::unlink(fpath);
+    printf("  NestLoudsTrieBlobStore passed\n");
+}
+
+// content is not changed by populate, size may be not page aligned
+static void test_mmap_populate() {
+    const char* fpath = "test_blob_store_checksum.populate";
+    for (size_t size : {size_t(0), size_t(1), size_t(4095), size_t(5 << 20) + 123}) {
+        {
+            std::string data(size, '\0');
+            for (size_t i = 0; i < size; ++i)
+                data[i] = char(i * 131 + i / 4096);
+            FILE* fp = fopen(fpath, "wb");
+            TERARK_VERIFY(fp != NULL);
+            TERARK_VERIFY_EQ(fwrite(data.data(), 1, size, fp), size);
+            fclose(fp);
+            if (!size)
+                continue; // can not mmap empty file
+            for (size_t threads : {1, 4, 8}) {
+                MmapWholeFile mmap(fpath);
+                TERARK_VERIFY_EQ(mmap.size, size);
+                mmap_populate(mmap.base, mmap.size, threads);
+                TERARK_VERIFY(memcmp(mmap.base, data.data(), size) == 0);
+            }
+        }
+        mmap_populate(nullptr, 0, 4); // empty is ok
+    }
+    ::unlink(fpath);
+
+    // load_from_mmap with populate by threads
+    fpath = "test_blob_store_checksum.plain";
+    build_plain(fpath);
+    size_t oldThreads = getMmapLoadThreads();
+    for (size_t threads : {1, 4}) {
+        setMmapLoadThreads(threads);
+        std::unique_ptr<AbstractBlobStore> store(
+            AbstractBlobStore::load_from_mmap(fpath, true));
+        store->wait_checksum_verify();
+        verify_records(store.get(), false);
+    }
+    setMmapLoadThreads(oldThreads);
+    ::unlink(fpath);
+    printf("  mmap_populate passed\n");
+}
+
+int main() {
+    if (!getenv("Terark_mmapLoadThreads"))
+        TERARK_VERIFY_EQ(getMmapLoadThreads(), 1); // default: MAP_POPULATE
+    AbstractBlobStore::set_defer_checksum_verify(true);
+    test_plain();
+    test_trie();
+    test_mmap_populate();
+    printf("test_blob_store_checksum passed\n");
+    return 0;
+}
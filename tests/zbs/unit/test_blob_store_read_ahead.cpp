@@ -0,0 +1,202 @@
+#include <terark/zbs/plain_blob_store.hpp>
+#include <terark/zbs/lru_page_cache.hpp>
+#include <terark/util/mmap.hpp>
+#include <terark/util/throw.hpp>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace terark;
+
+static const char* g_fpath = "test_blob_store_read_ahead.zbs";
+static const size_t NumRecords = 3000;
+static const size_t RecordLen = 1000;
+static const size_t MinWindow = 16*1024;
+static const size_t MaxWindow = 128*1024;
+
+static std::string make_record(size_t i) {
+    std::string rec(RecordLen, '\0');
+    for (size_t j = 0; j < RecordLen; ++j)
+        rec[j] = char(i * 31 + j * 7);
+    return rec;
+}
+
+// records are read from mmap, prefetched ranges are recorded
+struct MemFile {
+    const byte_t* base;
+    size_t last_end = 0; // end offset of last read
+    valvec<std::pair<size_t, size_t> > prefetched;
+
+    static const byte_t*
+    fspread(void* vself, size_t offset, size_t len, valvec<byte_t>*) {
+        auto self = static_cast<MemFile*>(vself);
+        self->last_end = offset + len;
+        return self->base + offset;
+    }
+    static void prefetch(void* vself, size_t offset, size_t len) {
+        static_cast<MemFile*>(vself)->prefetched.push_back({offset, len});
+    }
+};
+
+// records no_fill hint of each pread, pages are read from mmap
+class RecordingCache : public LruReadonlyCache {
+public:
+    const byte_t* base;
+    intptr_t fd;
+    valvec<bool> no_fill;
+
+    const byte_t* pread(intptr_t, size_t offset, size_t, Buffer* b) override {
+        no_fill.push_back(b->is_no_fill());
+        return base + offset;
+    }
+    intptr_t open(intptr_t) override { return 0; }
+    void close(intptr_t) override {}
+    bool safe_close(intptr_t) override { return true; }
+    intptr_t get_fd(intptr_t) const override { return fd; }
+    bool is_direct_io(intptr_t) const override { return false; }
+    void print_stat_cnt(FILE*) const override {}
+    StatCnt get_stat_cnt(intptr_t) const override { return StatCnt(); }
+    size_t shard_num() const override { return 1; }
+protected:
+    void get_hot_pages(valvec<uint64_t>*) const override {}
+    void get_open_files(valvec<OpenFile>*) const override {}
+    void warmup_page(intptr_t, size_t) override {}
+};
+
+static void read_rec(BlobStoreReadAhead& ra, MemFile& mf, size_t recID) {
+    valvec<byte_t> rec, rdbuf;
+    ra.fspread_record_append(&MemFile::fspread, &mf, &MemFile::prefetch,
+                             0, recID, &rec, &rdbuf);
+    TERARK_VERIFY(fstring(rec) == make_record(recID));
+}
+
+// window grows from min_window to max_window, prefetched ranges are
+// contiguous and always ahead of the consumed record
+static void test_window_growth(const BlobStore* store, MemFile& mf) {
+    BlobStoreReadAhead ra(store);
+    ra.min_window = MinWindow;
+    ra.max_window = MaxWindow;
+    mf.prefetched.erase_all();
+    size_t prefetched_end = 0;
+    size_t expected_window = MinWindow;
+    for (size_t i = 0; i < NumRecords; ++i) {
+        size_t old_cnt = mf.prefetched.size();
+        read_rec(ra, mf, i);
+        TERARK_VERIFY_EQ(ra.is_sequential(), i >= 2);
+        if (i < 2) {
+            TERARK_VERIFY_EQ(mf.prefetched.size(), 0);
+            continue;
+        }
+        if (mf.prefetched.size() != old_cnt) {
+            TERARK_VERIFY_EQ(mf.prefetched.size(), old_cnt + 1);
+            auto pf = mf.prefetched.back();
+            if (prefetched_end)
+                TERARK_VERIFY_EQ(pf.first, prefetched_end);
+            prefetched_end = pf.first + pf.second;
+            expected_window = std::min(expected_window * 2, MaxWindow);
+            TERARK_VERIFY_EQ(ra.window(), expected_window);
+        }
+        // prefetch is issued before current record consumes half window
+        TERARK_VERIFY_GE(prefetched_end, mf.last_end + ra.window() / 2);
+    }
+    TERARK_VERIFY_EQ(ra.window(), MaxWindow);
+    TERARK_VERIFY_EQ(ra.prefetch_cnt(), mf.prefetched.size());
+    size_t bytes = 0;
+    for (auto& pf : mf.prefetched) bytes += pf.second;
+    TERARK_VERIFY_EQ(ra.prefetch_bytes(), bytes);
+}
+
+// backward or skipping access resets window, skipping 1 record is still
+// sequential
+static void test_reset_on_random(const BlobStore* store, MemFile& mf) {
+    BlobStoreReadAhead ra(store);
+    ra.min_window = MinWindow;
+    ra.max_window = MaxWindow;
+    mf.prefetched.erase_all();
+    for (size_t i = 0; i < 500; ++i)
+        read_rec(ra, mf, i);
+    TERARK_VERIFY(ra.is_sequential());
+    TERARK_VERIFY_GT(ra.window(), MinWindow);
+
+    size_t cnt = mf.prefetched.size();
+    read_rec(ra, mf, 10); // backward
+    TERARK_VERIFY(!ra.is_sequential());
+    TERARK_VERIFY_EQ(ra.window(), 0);
+    TERARK_VERIFY_EQ(mf.prefetched.size(), cnt);
+    read_rec(ra, mf, 12); // skip 1 record
+    read_rec(ra, mf, 13);
+    TERARK_VERIFY(ra.is_sequential());
+    TERARK_VERIFY_EQ(mf.prefetched.size(), cnt + 1);
+    TERARK_VERIFY_EQ(mf.prefetched.back().second, MinWindow); // restarted
+
+    read_rec(ra, mf, 17); // skip 3 records
+    TERARK_VERIFY(!ra.is_sequential());
+    TERARK_VERIFY_EQ(ra.window(), 0);
+    read_rec(ra, mf, 18);
+    read_rec(ra, mf, 19);
+    TERARK_VERIFY(ra.is_sequential());
+
+    ra.reset();
+    TERARK_VERIFY(!ra.is_sequential());
+    TERARK_VERIFY_EQ(ra.window(), 0);
+    cnt = mf.prefetched.size();
+    read_rec(ra, mf, 20);
+    read_rec(ra, mf, 21);
+    TERARK_VERIFY_EQ(mf.prefetched.size(), cnt);
+}
+
+// no_fill hint is set just for the reads which are sequential
+static void test_no_fill(const BlobStore* store, RecordingCache& cache,
+                         bool no_fill_on_seq) {
+    BlobStoreReadAhead ra(store);
+    ra.no_fill_on_seq = no_fill_on_seq;
+    cache.no_fill.erase_all();
+    valvec<byte_t> rec, rdbuf;
+    auto read = [&](size_t recID) {
+        rec.erase_all();
+        ra.pread_record_append(&cache, 0, 0, recID, &rec, &rdbuf);
+        TERARK_VERIFY(fstring(rec) == make_record(recID));
+    };
+    for (size_t i = 0; i < 100; ++i)
+        read(i);
+    read(5); // random
+    read(6);
+    read(7);
+    TERARK_VERIFY_EQ(cache.no_fill.size(), 103);
+    for (size_t i = 0; i < 100; ++i) {
+        bool expected = no_fill_on_seq && i >= 2;
+        TERARK_VERIFY_EQ(cache.no_fill[i], expected);
+    }
+    TERARK_VERIFY_EQ(cache.no_fill[100], false);
+    TERARK_VERIFY_EQ(cache.no_fill[101], false);
+    TERARK_VERIFY_EQ(cache.no_fill[102], no_fill_on_seq);
+    TERARK_VERIFY_GT(ra.prefetch_cnt(), 0);
+}
+
+int main() {
+    {
+        PlainBlobStore::MyBuilder builder(NumRecords * RecordLen, NumRecords, g_fpath);
+        for (size_t i = 0; i < NumRecords; ++i)
+            builder.addRecord(make_record(i));
+        builder.finish();
+    }
+    std::unique_ptr<AbstractBlobStore> store(
+        AbstractBlobStore::load_from_mmap(g_fpath, false));
+    TERARK_VERIFY_EQ(store->num_records(), NumRecords);
+    MmapWholeFile mmap(g_fpath);
+    MemFile mf;
+    mf.base = (const byte_t*)mmap.base;
+    test_window_growth(store.get(), mf);
+    test_reset_on_random(store.get(), mf);
+
+    boost::intrusive_ptr<RecordingCache> cache(new RecordingCache);
+    cache->base = (const byte_t*)mmap.base;
+    cache->fd = ::open(g_fpath, O_RDONLY);
+    TERARK_VERIFY_GE(cache->fd, 0);
+    test_no_fill(store.get(), *cache, true);
+    test_no_fill(store.get(), *cache, false);
+    ::close(int(cache->fd));
+    store.reset();
+    ::unlink(g_fpath);
+    printf("test_blob_store_read_ahead passed\n");
+    return 0;
+}
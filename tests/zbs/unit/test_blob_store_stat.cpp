@@ -0,0 +1,225 @@
+// BlobStoreStat: LatencyHistogram buckets and percentiles, enable_stat
+// wrappers count get/pread/fspread/io and cache hit/miss without changing
+// records, and stats are unregistered when the last store detaches
+#include <terark/zbs/blob_store_stat.hpp>
+#include <terark/zbs/abstract_blob_store.hpp>
+#include <terark/zbs/lru_page_cache.hpp>
+#include <terark/zbs/plain_blob_store.hpp>
+#include <terark/util/throw.hpp>
+#include <fcntl.h>
+#include <unistd.h>
+#include <memory>
+#include <random>
+#include <string>
+
+using namespace terark;
+
+typedef LatencyHistogram Hist;
+
+static void test_index_of() {
+    for (uint64_t ns = 0; ns < Hist::SubBuckets; ++ns) {
+        TERARK_VERIFY_EQ(Hist::index_of(ns), ns);
+        TERARK_VERIFY_EQ(Hist::lower_of(ns), ns);
+    }
+    // every bucket is [lower_of(i), lower_of(i+1)), width <= lower / SubBuckets
+    for (size_t i = 0; i + 1 < Hist::BucketNum; ++i) {
+        uint64_t lo = Hist::lower_of(i), hi = Hist::lower_of(i + 1);
+        TERARK_VERIFY_LT(lo, hi);
+        TERARK_VERIFY_EQ(Hist::index_of(lo), i);
+        TERARK_VERIFY_EQ(Hist::index_of(hi - 1), i);
+        if (i >= Hist::SubBuckets)
+            TERARK_VERIFY_LE((hi - lo) * Hist::SubBuckets, lo);
+    }
+    std::mt19937_64 rnd(1);
+    for (int i = 0; i < 100000; ++i) {
+        uint64_t ns = rnd() >> (rnd() % 64);
+        size_t idx = Hist::index_of(ns);
+        TERARK_VERIFY_LT(idx, Hist::BucketNum);
+        if (idx + 1 < Hist::BucketNum) {
+            TERARK_VERIFY_LE(Hist::lower_of(idx), ns);
+            TERARK_VERIFY_LT(ns, Hist::lower_of(idx + 1));
+        }
+    }
+    // larger than 2^(MaxExp+1) are clamped to the last bucket
+    TERARK_VERIFY_EQ(Hist::index_of(uint64_t(1) << (Hist::MaxExp + 1)), Hist::BucketNum - 1);
+    TERARK_VERIFY_EQ(Hist::index_of(UINT64_MAX), Hist::BucketNum - 1);
+    printf("  index_of passed\n");
+}
+
+static void add(Hist& h, uint64_t ns) {
+    h.cnt[Hist::index_of(ns)]++;
+    h.sum += ns;
+    h.max = std::max(h.max, ns);
+}
+
+static void test_percentile() {
+    Hist h;
+    h.reset();
+    TERARK_VERIFY_EQ(h.percentile(50), 0);
+    for (uint64_t ns = 1; ns <= 10000; ++ns)
+        add(h, ns);
+    TERARK_VERIFY_EQ(h.num(), 10000);
+    for (double p : {1.0, 10.0, 50.0, 90.0, 99.0, 99.9}) {
+        uint64_t expected = uint64_t(p * 100);
+        uint64_t val = h.percentile(p);
+        // upper bound of the bucket of the expected value
+        TERARK_VERIFY_GE(val, expected);
+        TERARK_VERIFY_LE(val, expected + expected / Hist::SubBuckets);
+    }
+    TERARK_VERIFY_EQ(h.percentile(100), 10000); // clamped to max
+    TERARK_VERIFY_EQ(h.percentile(0), 1);
+
+    Hist h2;
+    h2.reset();
+    add(h2, uint64_t(1) << 50); // clamped bucket, percentile is max
+    h.merge(h2);
+    TERARK_VERIFY_EQ(h.num(), 10001);
+    TERARK_VERIFY_EQ(h.max, uint64_t(1) << 50);
+    TERARK_VERIFY_EQ(h.percentile(100), uint64_t(1) << 50);
+    TERARK_VERIFY_LT(h.percentile(99), Hist::lower_of(Hist::index_of(10000) + 1));
+    printf("  percentile passed\n");
+}
+
+static const size_t NumRecords = 3000;
+
+static std::string make_record(size_t i) {
+    std::string rec = "record-" + std::to_string(i * 7919) + "-";
+    rec.append(i % 300, char('a' + i % 26));
+    return rec;
+}
+
+static const byte_t* fd_pread(void* lambda, size_t offset, size_t len,
+                              valvec<byte_t>* rdbuf) {
+    rdbuf->resize_no_init(len);
+    fdpread(*(int*)lambda, rdbuf->data(), len, offset);
+    return rdbuf->data();
+}
+
+// get_record of PlainBlobStore is zero copy, rec points to the mmap
+static void verify_get(const BlobStore* store, size_t recID) {
+    valvec<byte_t> rec;
+    store->get_record(recID, &rec);
+    TERARK_VERIFY(fstring(rec) == make_record(recID));
+    if (store->support_zero_copy())
+        rec.risk_release_ownership();
+}
+
+static BlobStoreStat::Counters snapshot(const BlobStore* store) {
+    BlobStoreStat::Counters c;
+    store->get_stat()->snapshot(&c);
+    return c;
+}
+
+static BlobStoreStat* find_stat(const std::string& name) {
+    for (auto stat : BlobStoreStat::all())
+        if (stat->name() == name)
+            return stat;
+    return NULL;
+}
+
+static void test_enable_stat() {
+    const char* fpath = "test_blob_store_stat.plain";
+    size_t contentSize = 0;
+    for (size_t i = 0; i < NumRecords; ++i)
+        contentSize += make_record(i).size();
+    {
+        PlainBlobStore::MyBuilder builder(contentSize, NumRecords, fpath, 0, 3);
+        for (size_t i = 0; i < NumRecords; ++i)
+            builder.addRecord(make_record(i));
+        builder.finish();
+    }
+    std::unique_ptr<AbstractBlobStore> store(AbstractBlobStore::load_from_mmap(fpath, false));
+    std::unique_ptr<AbstractBlobStore> store2(AbstractBlobStore::load_from_mmap(fpath, false));
+    const std::string name = store->name();
+    store->enable_stat(false); // BlobStore_enableStat may be set
+    store2->enable_stat(false);
+    TERARK_VERIFY(NULL == store->get_stat());
+    TERARK_VERIFY(NULL == find_stat(name));
+    store->enable_stat(true);
+    store->enable_stat(true); // no-op
+    TERARK_VERIFY(NULL != store->get_stat());
+    TERARK_VERIFY(find_stat(name) == store->get_stat());
+    TERARK_VERIFY_EQ(store->get_stat()->stores(), 1);
+    store2->enable_stat(true);
+    TERARK_VERIFY(store2->get_stat() == store->get_stat()); // one per class
+    TERARK_VERIFY_EQ(store->get_stat()->stores(), 2);
+    store->get_stat()->reset();
+
+    int fd = ::open(fpath, O_RDONLY);
+    TERARK_VERIFY_GE(fd, 0);
+    std::unique_ptr<LruReadonlyCache> cache(LruReadonlyCache::create(1 << 20, 1, 16, false));
+    intptr_t fi = cache->open(fd);
+    valvec<byte_t> rec, rdbuf;
+    size_t bytes = 0;
+    for (size_t i = 0; i < NumRecords; ++i) {
+        std::string expected = make_record(i);
+        bytes += expected.size();
+        verify_get(store.get(), i);
+        store->pread_record(NULL, fd, 0, i, &rec, &rdbuf);
+        TERARK_VERIFY(fstring(rec) == expected);
+        store->pread_record(cache.get(), fi, 0, i, &rec, &rdbuf);
+        TERARK_VERIFY(fstring(rec) == expected);
+        store->fspread_record(&fd_pread, &fd, 0, i, &rec, &rdbuf);
+        TERARK_VERIFY(fstring(rec) == expected);
+    }
+    auto c = snapshot(store.get());
+    TERARK_VERIFY_EQ(c.calls[BlobStoreStat::op_get], NumRecords);
+    TERARK_VERIFY_EQ(c.calls[BlobStoreStat::op_pread], 2 * NumRecords);
+    TERARK_VERIFY_EQ(c.calls[BlobStoreStat::op_fspread], NumRecords);
+    TERARK_VERIFY_EQ(c.bytes[BlobStoreStat::op_get], bytes);
+    TERARK_VERIFY_EQ(c.bytes[BlobStoreStat::op_pread], 2 * bytes);
+    TERARK_VERIFY_EQ(c.bytes[BlobStoreStat::op_fspread], bytes);
+    TERARK_VERIFY_GE(c.calls[BlobStoreStat::op_io], 3 * NumRecords);
+    TERARK_VERIFY_GE(c.bytes[BlobStoreStat::op_io], 3 * bytes);
+    TERARK_VERIFY_GT(c.cache_hit, 0);
+    TERARK_VERIFY_GT(c.cache_miss, 0);
+    // counted by pread calls on the cache, a call may read multiple pages
+    auto st = cache->get_stat_cnt();
+    TERARK_VERIFY_GE(c.cache_hit + c.cache_miss, NumRecords);
+    TERARK_VERIFY_LE(c.cache_hit + c.cache_miss, st.hit + st.miss);
+    for (size_t op = 0; op < BlobStoreStat::op_num; ++op) {
+        TERARK_VERIFY_EQ(c.latency[op].num(), c.calls[op]);
+        TERARK_VERIFY_LE(c.latency[op].max, c.latency[op].sum);
+    }
+    verify_get(store2.get(), 0); // counted into the same stat
+    TERARK_VERIFY_EQ(snapshot(store.get()).calls[BlobStoreStat::op_get], NumRecords + 1);
+
+    // disabled: original functions, not counted
+    store2->enable_stat(false);
+    TERARK_VERIFY(NULL == store2->get_stat());
+    TERARK_VERIFY_EQ(store->get_stat()->stores(), 1);
+    for (size_t i = 0; i < NumRecords; i += 7) {
+        std::string expected = make_record(i);
+        verify_get(store2.get(), i);
+        store2->pread_record(NULL, fd, 0, i, &rec, &rdbuf);
+        TERARK_VERIFY(fstring(rec) == expected);
+        store2->fspread_record(&fd_pread, &fd, 0, i, &rec, &rdbuf);
+        TERARK_VERIFY(fstring(rec) == expected);
+    }
+    auto c2 = snapshot(store.get());
+    TERARK_VERIFY_EQ(c2.calls[BlobStoreStat::op_get], NumRecords + 1);
+    TERARK_VERIFY_EQ(c2.calls[BlobStoreStat::op_pread], 2 * NumRecords);
+    TERARK_VERIFY_EQ(c2.calls[BlobStoreStat::op_fspread], NumRecords);
+    BlobStoreStat::print_all(stdout);
+
+    // the last store detaches on destruction, the stat is unregistered
+    store2->enable_stat(true);
+    TERARK_VERIFY_EQ(store->get_stat()->stores(), 2);
+    store.reset();
+    TERARK_VERIFY_EQ(find_stat(name)->stores(), 1);
+    store2.reset();
+    TERARK_VERIFY(NULL == find_stat(name));
+
+    cache->close(fi);
+    ::close(fd);
+    ::unlink(fpath);
+    printf("  enable_stat passed\n");
+}
+
+int main() {
+    test_index_of();
+    test_percentile();
+    test_enable_stat();
+    printf("test_blob_store_stat passed\n");
+    return 0;
+}
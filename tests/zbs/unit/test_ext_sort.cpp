@@ -0,0 +1,144 @@
+// ExternalSorter: output must be same as std::sort(and std::unique) of the
+// input, for both run formation modes, multi-pass merges, zstd runs and
+// records which straddle I/O buffers of RunReader
+#include <terark/zbs/ext_sort.hpp>
+#include <terark/util/throw.hpp>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace terark;
+
+typedef std::vector<std::string> StrVec;
+
+static const size_t IoBufSize = 4096; // min size
+
+// lengths are mixed:
+//  - short records, many record lengths(var_uint32) straddle buffer ends,
+//    which are read by RunReader::load_len_slow
+//  - records with 2 bytes length(>= 128), length bytes may be split
+//  - records longer than IoBufSize span 2 or more buffers(RunReader::m_rec)
+//  - dups for unique, and empty records
+static StrVec make_input(size_t num, unsigned seed) {
+    std::mt19937 rnd(seed);
+    StrVec vec;
+    vec.reserve(num);
+    for (size_t i = 0; i < num; ++i) {
+        size_t len;
+        size_t r = rnd() % 64;
+        if (r < 4)
+            len = 0;
+        else if (r < 12)
+            len = 128 + rnd() % 300;
+        else if (r < 13)
+            len = IoBufSize + rnd() % (3 * IoBufSize);
+        else
+            len = 1 + rnd() % 40;
+        std::string s(len, '\0');
+        for (auto& c : s)
+            c = char(rnd() % 4 ? 'a' + rnd() % 3 : rnd()); // some high bytes
+        vec.push_back(std::move(s));
+        if (rnd() % 8 == 0)
+            vec.push_back(vec[rnd() % vec.size()]); // dup
+    }
+    return vec;
+}
+
+static StrVec run_sort(ExternalSorter& sorter, const StrVec& input) {
+    size_t pos = 0;
+    StrVec output;
+    sorter.sort(
+        [&](valvec<byte_t>* rec) {
+            if (pos == input.size())
+                return false;
+            rec->assign((const byte_t*)input[pos].data(), input[pos].size());
+            pos++;
+            return true;
+        },
+        [&](fstring rec) { output.push_back(rec.str()); });
+    TERARK_VERIFY_EQ(pos, input.size());
+    return output;
+}
+
+static void test(const char* name, const ExternalSorter::Options& opt,
+                 const StrVec& input, size_t min_passes = 1) {
+    StrVec expected = input;
+    std::sort(expected.begin(), expected.end()); // unsigned char order
+    if (opt.unique)
+        expected.erase(std::unique(expected.begin(), expected.end()), expected.end());
+    size_t bytes = 0;
+    for (auto& s : input)
+        bytes += s.size();
+
+    ExternalSorter sorter(opt);
+    for (int round = 0; round < 2; ++round) { // a sorter can be reused
+        StrVec output = run_sort(sorter, input);
+        TERARK_VERIFY_EQ(output.size(), expected.size());
+        for (size_t i = 0; i < output.size(); ++i)
+            TERARK_VERIFY(output[i] == expected[i]);
+        const ExternalSorter::Stats& st = sorter.stats();
+        TERARK_VERIFY_EQ(st.records, input.size());
+        TERARK_VERIFY_EQ(st.bytes, bytes);
+        TERARK_VERIFY_EQ(st.outRecords, expected.size());
+        TERARK_VERIFY_GE(st.passes, min_passes);
+        if (input.empty())
+            TERARK_VERIFY_EQ(st.runs, 0);
+        else
+            TERARK_VERIFY_GE(st.runs, 1);
+    }
+    const ExternalSorter::Stats& st = sorter.stats();
+    printf("%-32s passed: records %zd, runs %zd, runFileSize %zd, passes %zd\n",
+           name, st.records, st.runs, st.runFileSize, st.passes);
+}
+
+int main() {
+    const StrVec input = make_input(60000, 1);
+    ExternalSorter::Options opt;
+    opt.memBudget = 1 << 20; // min size, many runs
+    opt.ioBufSize = IoBufSize;
+    opt.tmpDir = ".";
+
+    for (bool replaceSelect : {false, true}) {
+        const char* mode = replaceSelect ? "replace_select" : "chunk";
+        char name[64];
+        opt.replaceSelect = replaceSelect;
+        opt.threads = 1;
+        opt.maxWays = 256;
+        opt.zstdLevel = 0;
+        opt.unique = false;
+        snprintf(name, sizeof(name), "%s", mode);
+        test(name, opt, input);
+
+        opt.threads = 3; // replace_select ignores threads
+        snprintf(name, sizeof(name), "%s threads=3", mode);
+        test(name, opt, input);
+
+        // runs are more than maxWays, intermediate passes are needed
+        opt.maxWays = 2;
+        snprintf(name, sizeof(name), "%s maxWays=2", mode);
+        test(name, opt, input, 3);
+        opt.maxWays = 3;
+        snprintf(name, sizeof(name), "%s maxWays=3", mode);
+        test(name, opt, input, 2);
+
+        opt.zstdLevel = 1;
+        snprintf(name, sizeof(name), "%s zstd maxWays=3", mode);
+        test(name, opt, input, 2);
+
+        opt.unique = true;
+        snprintf(name, sizeof(name), "%s zstd unique", mode);
+        test(name, opt, input, 2);
+        opt.zstdLevel = 0;
+        snprintf(name, sizeof(name), "%s unique", mode);
+        test(name, opt, input, 2);
+
+        opt.maxWays = 256;
+        snprintf(name, sizeof(name), "%s empty input", mode);
+        test(name, opt, StrVec());
+        snprintf(name, sizeof(name), "%s all dups", mode);
+        test(name, opt, StrVec(5000, std::string(300, 'x')));
+    }
+    printf("test_ext_sort passed\n");
+    return 0;
+}
@@ -0,0 +1,479 @@
+// LruReadonlyCache: hit/miss counters of single and cross page reads, cache
+// type of cross page reads on multi shards, no_fill reads do not change the
+// cache, one-shot scans do not evict the hot set with tiny_lfu, and shard
+// selection of files opened on numa nodes, save_index and warmup_from, and
+// O_DIRECT reads
+#include <terark/zbs/lru_page_cache.hpp>
+#include <terark/util/throw.hpp>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+using namespace terark;
+
+typedef LruReadonlyCache::Options Options;
+typedef LruReadonlyCache::StatCnt StatCnt;
+
+static const size_t PageSize = 4096;
+static const size_t CachePages = 64;
+static const size_t FilePages = 2200;
+static const char* g_fpath = "test_lru_page_cache.bin";
+
+static byte_t byte_at(size_t offset) {
+    return byte_t(offset * 131 + offset / PageSize);
+}
+
+static void make_file(const char* fpath = g_fpath, size_t pages = FilePages) {
+    valvec<byte_t> data(pages * PageSize, valvec_no_init());
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = byte_at(i);
+    int fd = ::open(fpath, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+    TERARK_VERIFY_GE(fd, 0);
+    TERARK_VERIFY_EQ(::write(fd, data.data(), data.size()), intptr_t(data.size()));
+    ::close(fd);
+}
+
+// returns true if all pages are in cache
+static bool cache_read(LruReadonlyCache* cache, intptr_t fi, size_t offset,
+                       size_t len, LruReadonlyCache::Buffer* b,
+                       bool no_fill = false) {
+    b->discard();
+    b->set_no_fill(no_fill);
+    const byte_t* p = cache->pread(fi, offset, len, b);
+    for (size_t i = 0; i < len; ++i)
+        TERARK_VERIFY_EQ(p[i], byte_at(offset + i));
+    return b->is_cache_hit();
+}
+
+struct CacheFile {
+    std::unique_ptr<LruReadonlyCache> cache;
+    int fd;
+    intptr_t fi;
+    valvec<byte_t> rdbuf;
+    LruReadonlyCache::Buffer b;
+
+    explicit CacheFile(const Options& opt) : b(&rdbuf) {
+        cache.reset(LruReadonlyCache::create(opt));
+        fd = ::open(g_fpath, O_RDONLY);
+        TERARK_VERIFY_GE(fd, 0);
+        fi = cache->open(fd);
+    }
+    ~CacheFile() {
+        b.discard();
+        cache->close(fi);
+        TERARK_VERIFY_EQ(cache->get_stat_cnt().busy_pages, 0);
+        ::close(fd);
+    }
+    bool read(size_t offset, size_t len, bool no_fill = false) {
+        return cache_read(cache.get(), fi, offset, len, &b, no_fill);
+    }
+    bool read_page(size_t page, bool no_fill = false) {
+        return read(page * PageSize + page % 100, 100, no_fill);
+    }
+};
+
+static Options make_opt(size_t shards, LruReadonlyCache::EvictPolicy policy) {
+    Options opt;
+    opt.capacityBytes = CachePages * PageSize;
+    opt.shards = shards;
+    opt.policy = policy;
+    return opt;
+}
+
+static void verify_stat(const StatCnt& st, size_t hit, size_t miss,
+                        size_t no_fill, size_t busy_pages) {
+    TERARK_VERIFY_EQ(st.hit, hit);
+    TERARK_VERIFY_EQ(st.miss, miss);
+    TERARK_VERIFY_EQ(st.no_fill, no_fill);
+    TERARK_VERIFY_EQ(st.rejected, 0);
+    TERARK_VERIFY_EQ(st.busy_pages, busy_pages);
+}
+
+static void test_counters(size_t shards) {
+    CacheFile cf(make_opt(shards, LruReadonlyCache::EvictPolicy::lru));
+    TERARK_VERIFY_EQ(cf.cache->shard_num(), shards);
+    for (size_t pg = 0; pg < 10; ++pg)
+        TERARK_VERIFY(!cf.read_page(pg));
+    verify_stat(cf.cache->get_stat_cnt(), 0, 10, 0, 10);
+    for (size_t pg = 0; pg < 10; ++pg)
+        TERARK_VERIFY(cf.read_page(pg));
+    verify_stat(cf.cache->get_stat_cnt(), 10, 10, 0, 10);
+
+    // page 9 is cached, 10 and 11 are not, each page is counted
+    TERARK_VERIFY(!cf.read(9 * PageSize + 100, 2 * PageSize));
+    verify_stat(cf.cache->get_stat_cnt(), 11, 12, 0, 12);
+
+    // only the first page is missed, the last page is hit
+    TERARK_VERIFY(!cf.read_page(21));
+    TERARK_VERIFY(!cf.read_page(22));
+    TERARK_VERIFY(!cf.read(20 * PageSize, 3 * PageSize));
+    TERARK_VERIFY( cf.read(20 * PageSize, 3 * PageSize));
+    // three pages are missed
+    TERARK_VERIFY(!cf.read(30 * PageSize + 1, 2 * PageSize));
+    TERARK_VERIFY( cf.read(30 * PageSize + 1, 2 * PageSize));
+    verify_stat(cf.cache->get_stat_cnt(), 11+2+3+3, 12+2+1+3, 0, 18);
+
+    // no_fill: missed pages are not cached, cached pages are hit
+    TERARK_VERIFY(!cf.read_page(40, true));
+    TERARK_VERIFY(!cf.read(41 * PageSize + 5, 3 * PageSize, true));
+    TERARK_VERIFY(!cf.read(21 * PageSize + 5, 2 * PageSize, true)); // 23 missed
+    TERARK_VERIFY( cf.read(21 * PageSize + 5, PageSize - 5, true));
+    verify_stat(cf.cache->get_stat_cnt(), 19+2+1, 18, 1+4+1, 18);
+    TERARK_VERIFY(!cf.read_page(40)); // not filled by no_fill read
+    verify_stat(cf.cache->get_stat_cnt(), 22, 19, 6, 19);
+
+    StatCnt sum;
+    memset(&sum, 0, sizeof(sum));
+    for (size_t i = 0; i < shards; ++i) {
+        StatCnt st = cf.cache->get_stat_cnt(i);
+        sum.hit += st.hit;
+        sum.miss += st.miss;
+        sum.no_fill += st.no_fill;
+        sum.busy_pages += st.busy_pages;
+    }
+    verify_stat(sum, 22, 19, 6, 19);
+    printf("  counters shards = %zd passed\n", shards);
+}
+
+// hot pages are read between pages of a one-shot scan, the reuse distance
+// of hot pages is larger than the cache, plain lru evicts them
+static size_t hot_hits_in_scan(CacheFile& cf, bool no_fill_scan) {
+    const size_t HotPages = 16, ScanPerHot = 4;
+    for (int round = 0; round < 8; ++round) {
+        for (size_t pg = 0; pg < HotPages; ++pg)
+            cf.read_page(pg);
+    }
+    StatCnt st0 = cf.cache->get_stat_cnt();
+    size_t hot_hits = 0, hot_reads = 0;
+    for (size_t pg = HotPages; pg < FilePages; ++pg) {
+        cf.read_page(pg, no_fill_scan);
+        if (pg % ScanPerHot == 0) {
+            hot_hits += cf.read_page(hot_reads % HotPages);
+            hot_reads++;
+        }
+    }
+    StatCnt st1 = cf.cache->get_stat_cnt();
+    if (no_fill_scan) {
+        TERARK_VERIFY_EQ(st1.no_fill - st0.no_fill, FilePages - HotPages);
+        TERARK_VERIFY_EQ(st1.miss, st0.miss);
+        TERARK_VERIFY_EQ(st1.busy_pages, st0.busy_pages);
+    }
+    return hot_hits * 100 / hot_reads;
+}
+
+static void test_scan_resistance() {
+    using EvictPolicy = LruReadonlyCache::EvictPolicy;
+    size_t lru_ratio, lfu_ratio, no_fill_ratio;
+    {
+        CacheFile cf(make_opt(1, EvictPolicy::lru));
+        lru_ratio = hot_hits_in_scan(cf, false);
+        TERARK_VERIFY_EQ(cf.cache->get_stat_cnt().rejected, 0);
+    }
+    {
+        CacheFile cf(make_opt(1, EvictPolicy::tiny_lfu));
+        lfu_ratio = hot_hits_in_scan(cf, false);
+        TERARK_VERIFY_GT(cf.cache->get_stat_cnt().rejected, FilePages / 2);
+    }
+    {
+        CacheFile cf(make_opt(1, EvictPolicy::lru));
+        no_fill_ratio = hot_hits_in_scan(cf, true);
+    }
+    printf("  scan: hot hit%% lru = %zd, tiny_lfu = %zd, lru no_fill = %zd\n",
+           lru_ratio, lfu_ratio, no_fill_ratio);
+    TERARK_VERIFY_LT(lru_ratio, 10);
+    TERARK_VERIFY_GE(lfu_ratio, 95);
+    TERARK_VERIFY_EQ(no_fill_ratio, 100);
+}
+
+static std::vector<StatCnt> shard_stats(const LruReadonlyCache* cache) {
+    std::vector<StatCnt> stats;
+    for (size_t i = 0; i < cache->shard_num(); ++i)
+        stats.push_back(cache->get_stat_cnt(i));
+    return stats;
+}
+
+// reads pages [0, NodePages) of fi, returns the shards the pages went to
+static std::vector<bool>
+read_on_shards(LruReadonlyCache* cache, intptr_t fi, bool expect_hit) {
+    const size_t NodePages = 200;
+    valvec<byte_t> rdbuf;
+    LruReadonlyCache::Buffer b(&rdbuf);
+    auto st0 = shard_stats(cache);
+    for (size_t pg = 0; pg < NodePages; ++pg)
+        TERARK_VERIFY_EQ(cache_read(cache, fi, pg * PageSize, 100, &b), expect_hit);
+    auto st1 = shard_stats(cache);
+    std::vector<bool> used(st1.size());
+    size_t sum = 0;
+    for (size_t i = 0; i < st1.size(); ++i) {
+        size_t cnt = expect_hit ? st1[i].hit - st0[i].hit
+                                : st1[i].miss - st0[i].miss;
+        used[i] = cnt > 0;
+        sum += cnt;
+    }
+    TERARK_VERIFY_EQ(sum, NodePages);
+    return used;
+}
+
+// shards are put on numaNodes logical nodes round robin, pages of a file
+// opened on node k only go to shards i with i % numaNodes == k, and are
+// spread to all of them, files without affinity go to all shards
+static void test_numa_affinity(size_t shards, size_t numaNodes) {
+    Options opt = make_opt(shards, LruReadonlyCache::EvictPolicy::lru);
+    opt.capacityBytes = shards * 512 * PageSize;
+    opt.numa = true;
+    opt.numaNodes = numaNodes;
+    std::unique_ptr<LruReadonlyCache> cache(LruReadonlyCache::create(opt));
+    TERARK_VERIFY_EQ(cache->shard_num(), shards);
+    std::vector<int> fds;
+    std::vector<intptr_t> fis;
+    for (int node = -1; node <= int(numaNodes); ++node) {
+        int fd = ::open(g_fpath, O_RDONLY);
+        TERARK_VERIFY_GE(fd, 0);
+        intptr_t fi = cache->open_on_node(fd, node);
+        TERARK_VERIFY_EQ(cache->get_fd(fi), fd);
+        TERARK_VERIFY(!cache->is_direct_io(fi));
+        fds.push_back(fd);
+        fis.push_back(fi);
+    }
+    for (size_t k = 0; k < fis.size(); ++k) {
+        int node = int(k) - 1; // numaNodes is same as node 0
+        auto used = read_on_shards(cache.get(), fis[k], false);
+        for (size_t i = 0; i < shards; ++i) {
+            bool expected = node < 0 || i % numaNodes == size_t(node) % numaNodes;
+            TERARK_VERIFY_EQ(used[i], expected);
+        }
+    }
+    // close finds the shards of the file, other files are still cached
+    for (size_t k = 0; k < fis.size(); ++k) {
+        auto st0 = shard_stats(cache.get());
+        cache->close(fis[k]);
+        ::close(fds[k]);
+        auto st1 = shard_stats(cache.get());
+        int node = int(k) - 1;
+        size_t dropped = 0;
+        for (size_t i = 0; i < shards; ++i) {
+            size_t cnt = st0[i].busy_pages - st1[i].busy_pages;
+            if (node >= 0 && i % numaNodes != size_t(node) % numaNodes)
+                TERARK_VERIFY_EQ(cnt, 0);
+            dropped += cnt;
+        }
+        TERARK_VERIFY_EQ(dropped, 200);
+        for (size_t j = k + 1; j < fis.size(); ++j)
+            read_on_shards(cache.get(), fis[j], true);
+    }
+    TERARK_VERIFY_EQ(cache->get_stat_cnt().busy_pages, 0);
+    printf("  numa shards = %zd, nodes = %zd passed\n", shards, numaNodes);
+}
+
+// open_on_node is same as open without numa
+static void test_no_numa(size_t shards) {
+    Options opt = make_opt(shards, LruReadonlyCache::EvictPolicy::lru);
+    opt.capacityBytes = shards * 512 * PageSize;
+    opt.numaNodes = 2;
+    std::unique_ptr<LruReadonlyCache> cache(LruReadonlyCache::create(opt));
+    int fd = ::open(g_fpath, O_RDONLY);
+    TERARK_VERIFY_GE(fd, 0);
+    intptr_t fi = cache->open_on_node(fd, 1);
+    auto used = read_on_shards(cache.get(), fi, false);
+    for (size_t i = 0; i < shards; ++i)
+        TERARK_VERIFY(used[i]);
+    read_on_shards(cache.get(), fi, true);
+    cache->close(fi);
+    ::close(fd);
+    TERARK_VERIFY_EQ(cache->get_stat_cnt().busy_pages, 0);
+    printf("  no numa shards = %zd passed\n", shards);
+}
+
+// reads pages [beg, end) of fi, returns number of hit pages
+static size_t read_range(LruReadonlyCache* cache, intptr_t fi,
+                         size_t beg, size_t end) {
+    valvec<byte_t> rdbuf;
+    LruReadonlyCache::Buffer b(&rdbuf);
+    size_t hits = 0;
+    for (size_t pg = beg; pg < end; ++pg)
+        hits += cache_read(cache, fi, pg * PageSize + 7, 50, &b);
+    return hits;
+}
+
+// save_index and warmup_from on a new cache: pages of renamed files are
+// loaded(files are identified by dev and inode), pages of deleted files and
+// pages past EOF of truncated files are skipped, pages of files which are
+// not in the index are not loaded, and the hottest pages are kept if the
+// new cache is smaller
+static void test_warmup(size_t shards) {
+    const char* fa = "test_lru_page_cache.a";
+    const char* fb = "test_lru_page_cache.b";
+    const char* fb2 = "test_lru_page_cache.b2";
+    const char* fc = "test_lru_page_cache.c";
+    const char* fd = "test_lru_page_cache.d";
+    const char* fidx = "test_lru_page_cache.idx";
+    make_file(fa, 200);
+    make_file(fb, 100);
+    make_file(fc, 100);
+    Options opt = make_opt(shards, LruReadonlyCache::EvictPolicy::lru);
+    opt.capacityBytes = 1024 * PageSize;
+    {
+        std::unique_ptr<LruReadonlyCache> cache(LruReadonlyCache::create(opt));
+        int fds[3];
+        intptr_t fis[3];
+        const char* fpaths[3] = {fa, fb, fc};
+        for (int i = 0; i < 3; ++i) {
+            fds[i] = ::open(fpaths[i], O_RDONLY);
+            TERARK_VERIFY_GE(fds[i], 0);
+            fis[i] = cache->open(fds[i]);
+        }
+        TERARK_VERIFY_EQ(read_range(cache.get(), fis[2], 0, 100), 0);
+        TERARK_VERIFY_EQ(read_range(cache.get(), fis[1], 20, 80), 0);
+        TERARK_VERIFY_EQ(read_range(cache.get(), fis[0], 0, 200), 0);
+        cache->save_index(fidx);
+        for (int i = 0; i < 3; ++i) {
+            cache->close(fis[i]);
+            ::close(fds[i]);
+        }
+    }
+    TERARK_VERIFY_EQ(::rename(fb, fb2), 0);
+    TERARK_VERIFY_EQ(::truncate(fa, 150 * PageSize + 100), 0); // 151 pages
+    make_file(fd, 100); // a new file, not in the index
+    TERARK_VERIFY_EQ(::unlink(fc), 0); // after make fd, inode is not reused
+    {
+        std::unique_ptr<LruReadonlyCache> cache(LruReadonlyCache::create(opt));
+        int fda = ::open(fa, O_RDONLY);
+        int fdb = ::open(fb2, O_RDONLY);
+        int fdc = ::open(fd, O_RDONLY);
+        intptr_t fia = cache->open(fda);
+        intptr_t fib = cache->open(fdb);
+        intptr_t fic = cache->open(fdc);
+        TERARK_VERIFY_EQ(cache->warmup_from(fidx, 4), 151 + 60);
+        StatCnt st = cache->get_stat_cnt();
+        TERARK_VERIFY_EQ(st.miss, 151 + 60);
+        TERARK_VERIFY_EQ(st.busy_pages, 151 + 60);
+        TERARK_VERIFY_EQ(read_range(cache.get(), fia, 0, 151), 151);
+        TERARK_VERIFY_EQ(read_range(cache.get(), fib, 20, 80), 60);
+        TERARK_VERIFY_EQ(read_range(cache.get(), fib, 0, 20), 0);
+        TERARK_VERIFY_EQ(read_range(cache.get(), fic, 0, 100), 0);
+        cache->close(fia); cache->close(fib); cache->close(fic);
+        ::close(fda); ::close(fdb); ::close(fdc);
+    }
+    if (1 == shards) {
+        // keeps the hottest 64 pages: the last 64 pages read of fa
+        opt.capacityBytes = 64 * PageSize;
+        std::unique_ptr<LruReadonlyCache> cache(LruReadonlyCache::create(opt));
+        make_file(fa, 200);
+        int fda = ::open(fa, O_RDONLY);
+        intptr_t fia = cache->open(fda);
+        TERARK_VERIFY_EQ(cache->warmup_from(fidx, 4), 200);
+        TERARK_VERIFY_EQ(read_range(cache.get(), fia, 136, 200), 64);
+        TERARK_VERIFY_EQ(read_range(cache.get(), fia, 0, 64), 0);
+        cache->close(fia);
+        ::close(fda);
+    }
+    {
+        // not an index file
+        std::unique_ptr<LruReadonlyCache> cache(LruReadonlyCache::create(opt));
+        bool thrown = false;
+        try {
+            cache->warmup_from(fa);
+        }
+        catch (const std::invalid_argument&) {
+            thrown = true;
+        }
+        TERARK_VERIFY(thrown);
+    }
+    ::unlink(fa); ::unlink(fb2); ::unlink(fd); ::unlink(fidx);
+    printf("  warmup shards = %zd passed\n", shards);
+}
+
+// fdpread_direct expands unaligned buf, offset and len to the alignment,
+// the expanded range may be past EOF, and the cache reads O_DIRECT files
+// by cached pages and by no_fill pages(aligned per thread page buffers)
+static void test_direct_io() {
+    const char* fpath = "test_lru_page_cache.dio";
+    const size_t fsize = 5 * PageSize + 123;
+    {
+        valvec<byte_t> data(fsize, valvec_no_init());
+        for (size_t i = 0; i < fsize; ++i)
+            data[i] = byte_at(i);
+        int fd = ::open(fpath, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+        TERARK_VERIFY_GE(fd, 0);
+        TERARK_VERIFY_EQ(::write(fd, data.data(), fsize), intptr_t(fsize));
+        ::close(fd);
+    }
+    int fd = ::open(fpath, O_RDONLY);
+    TERARK_VERIFY_GE(fd, 0);
+    size_t align = 0;
+    intptr_t dfd = fdopen_direct(fd, &align);
+    if (dfd < 0) {
+        printf("  direct io skipped: O_DIRECT is not supported\n");
+        ::close(fd);
+        ::unlink(fpath);
+        return;
+    }
+    TERARK_VERIFY_GE(align, 1);
+    TERARK_VERIFY_LE(align, PageSize);
+    TERARK_VERIFY_EQ((align & (align - 1)), 0);
+    valvec<byte_t> buf(fsize + 64, valvec_no_init());
+    auto check = [&](size_t offset, size_t len, size_t bufoff) {
+        fdpread_direct(dfd, align, buf.data() + bufoff, len, offset);
+        for (size_t i = 0; i < len; ++i)
+            TERARK_VERIFY_EQ(buf[bufoff + i], byte_at(offset + i));
+    };
+    const size_t tail_pg = align_down(fsize, PageSize);
+    for (size_t bufoff : {0, 1, 8}) {
+        check(0, PageSize, bufoff);
+        check(1, 100, bufoff);
+        check(align - 1, 2, bufoff); // crosses an align boundary
+        check(PageSize - 10, PageSize + 20, bufoff);
+        check(0, fsize, bufoff); // whole file, tail is past EOF
+        check(fsize - 1, 1, bufoff); // last byte
+        check(tail_pg, fsize - tail_pg, bufoff); // aligned offset, tail
+        check(tail_pg - 7, fsize - tail_pg + 7, bufoff);
+        check(fsize, 0, bufoff);
+    }
+    ::close(int(dfd));
+
+    Options opt = make_opt(2, LruReadonlyCache::EvictPolicy::lru);
+    opt.directIO = true;
+    std::unique_ptr<LruReadonlyCache> cache(LruReadonlyCache::create(opt));
+    intptr_t fi = cache->open(fd);
+    TERARK_VERIFY(cache->is_direct_io(fi));
+    TERARK_VERIFY_EQ(cache->get_fd(fi), fd);
+    valvec<byte_t> rdbuf;
+    LruReadonlyCache::Buffer b(&rdbuf);
+    for (bool no_fill : {true, false, true}) {
+        for (size_t offset : {size_t(0), size_t(1), PageSize - 1, tail_pg + 1})
+            cache_read(cache.get(), fi, offset, fsize - offset, &b, no_fill);
+        cache_read(cache.get(), fi, fsize - 1, 1, &b, no_fill);
+        cache_read(cache.get(), fi, PageSize + 5, 100, &b, no_fill);
+    }
+    StatCnt st = cache->get_stat_cnt();
+    TERARK_VERIFY_EQ(st.busy_pages, 6);
+    TERARK_VERIFY_EQ(st.miss, 6);
+    TERARK_VERIFY_GT(st.no_fill, 6);
+    b.discard();
+    cache->close(fi);
+    ::close(fd);
+    ::unlink(fpath);
+    printf("  direct io align = %zd passed\n", align);
+}
+
+int main() {
+    make_file();
+    test_counters(1);
+    test_counters(3);
+    test_counters(4);
+    test_scan_resistance();
+    test_numa_affinity(4, 2);
+    test_numa_affinity(5, 2);
+    test_numa_affinity(7, 3);
+    test_no_numa(1);
+    test_no_numa(4);
+    test_warmup(1);
+    test_warmup(4);
+    test_direct_io();
+    ::unlink(g_fpath);
+    printf("test_lru_page_cache passed\n");
+    return 0;
+}
@@ -0,0 +1,90 @@
+// PlainBlobStore with record level crc32c(checksumLevel 2): short records
+// are batched by the builder for Crc32c_update_batch, the content must be
+// byte identical to the unbatched layout(each record followed by its crc),
+// and records are verified on read
+#include <terark/zbs/blob_store_file_header.hpp>
+#include <terark/zbs/plain_blob_store.hpp>
+#include <terark/util/crc.hpp>
+#include <terark/util/throw.hpp>
+#include <string.h>
+#include <unistd.h>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace terark;
+
+// lengths are mixed: empty, shorter than a crc word, batched(< 768), and
+// long records which flush the pending batch
+static std::vector<std::string> make_records(size_t num, unsigned seed) {
+    std::mt19937 rnd(seed);
+    std::vector<std::string> vec(num);
+    for (auto& rec : vec) {
+        size_t len;
+        switch (rnd() % 16) {
+        case 0:  len = 0; break;
+        case 1:  len = rnd() % 8; break;
+        case 2:  len = 768 + rnd() % 3000; break;
+        case 3:  len = 767; break;
+        default: len = rnd() % 200; break;
+        }
+        rec.resize(len);
+        for (auto& c : rec)
+            c = char(rnd());
+    }
+    return vec;
+}
+
+// unbatched layout: record + crc32c, as the builder before batching
+static std::string unbatched_content(const std::vector<std::string>& recs) {
+    std::string content;
+    for (auto& rec : recs) {
+        uint32_t crc = Crc32c_update(0, rec.data(), rec.size());
+        content += rec;
+        content.append((const char*)&crc, sizeof(crc));
+    }
+    return content;
+}
+
+static void test(const char* fpath, size_t num, unsigned seed) {
+    std::vector<std::string> recs = make_records(num, seed);
+    size_t contentSize = 0;
+    for (auto& rec : recs)
+        contentSize += rec.size();
+    {
+        PlainBlobStore::MyBuilder builder(contentSize, num, fpath, 0, 2, kCRC32C);
+        for (auto& rec : recs)
+            builder.addRecord(rec);
+        builder.finish();
+    }
+    const std::string expected = unbatched_content(recs);
+    std::unique_ptr<AbstractBlobStore> store(AbstractBlobStore::load_from_mmap(fpath, false));
+    valvec<AbstractBlobStore::Block> blocks;
+    store->get_data_blocks(&blocks);
+    TERARK_VERIFY_EQ(blocks.size(), 1);
+    TERARK_VERIFY_EQ(blocks[0].data.size(), expected.size());
+    TERARK_VERIFY(memcmp(blocks[0].data.data(), expected.data(), expected.size()) == 0);
+    TERARK_VERIFY_EQ(store->num_records(), num);
+    valvec<byte_t> rec;
+    for (size_t i = 0; i < num; ++i) {
+        store->get_record(i, &rec);
+        TERARK_VERIFY(fstring(rec) == recs[i]);
+        if (store->support_zero_copy())
+            rec.risk_release_ownership();
+    }
+    store.reset();
+    ::unlink(fpath);
+    printf("  records = %zd, content = %zd passed\n", num, expected.size());
+}
+
+int main() {
+    const char* fpath = "test_plain_blob_store_crc.plain";
+    test(fpath, 1, 1);
+    test(fpath, 47, 2);
+    test(fpath, 48, 3); // exactly one full batch
+    test(fpath, 49, 4);
+    test(fpath, 20000, 5);
+    printf("test_plain_blob_store_crc passed\n");
+    return 0;
+}
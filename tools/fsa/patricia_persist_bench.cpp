@@ -0,0 +1,169 @@
+#ifdef _MSC_VER
+#define _CRT_NONSTDC_NO_WARNINGS
+#define _CRT_SECURE_NO_WARNINGS
+#define _SCL_SECURE_NO_WARNINGS
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <terark/fsa/cspptrie.inl>
+#include <terark/util/autoclose.hpp>
+#include <terark/util/profiling.hpp>
+#include <terark/util/linebuf.hpp>
+#include <terark/util/fstrvec.hpp>
+#include <getopt.h>
+#include <fcntl.h>
+
+using namespace terark;
+
+void usage(const char* prog) {
+    fprintf(stderr, R"EOS(Usage: %s Options [Input-TXT-File]
+Options:
+    -h Show this help information
+    -f Persist-File, required
+    -n Generated key num, used if Input-TXT-File is omitted, default 1M
+    -k Call persist_sync every k inserts, default 10000
+    -w Writer ConcurrentLevel, SingleThreadStrict..OneWriteMultiRead
+    -r Reopen Persist-File and verify all keys after benchmark
+Insert keys into a volatile trie and a persistent trie, then print insert
+throughput of both, the persistent trie is synced every k inserts.
+)EOS", prog);
+    exit(1);
+}
+
+struct BenchResult {
+    double sec = 0;
+    size_t syncs = 0;
+    size_t pages = 0;
+    size_t sync_ns = 0;
+};
+
+static BenchResult
+run(const fstrvec& keys, Patricia::ConcurrentLevel conLevel,
+    const std::string& conf, size_t sync_every, bool persist)
+{
+    BenchResult res;
+    profiling pf;
+    MainPatricia trie(sizeof(uint32_t), 0, conLevel, conf);
+    Patricia::WriterTokenPtr wtp(new Patricia::WriterToken());
+    Patricia::WriterToken* wt = wtp.get();
+    wt->acquire(&trie);
+    long long t0 = pf.now();
+    for (size_t i = 0; i < keys.size(); ++i) {
+        uint32_t val = uint32_t(i);
+        wt->insert(keys[i], &val);
+        if (persist && (i + 1) % sync_every == 0) {
+            long long t1 = pf.now();
+            res.pages += trie.persist_sync();
+            res.sync_ns += pf.ns(t1, pf.now());
+            res.syncs++;
+        }
+    }
+    if (persist) {
+        long long t1 = pf.now();
+        res.pages += trie.persist_sync();
+        res.sync_ns += pf.ns(t1, pf.now());
+        res.syncs++;
+    }
+    res.sec = pf.sf(t0, pf.now());
+    wt->release();
+    return res;
+}
+
+int main(int argc, char* argv[]) {
+    const char* persist_fname = NULL;
+    size_t key_num = 1000000;
+    size_t sync_every = 10000;
+    bool reopen_verify = false;
+    auto conLevel = Patricia::OneWriteMultiRead;
+    for (;;) {
+        int opt = getopt(argc, argv, "f:hk:n:rw:");
+        switch (opt) {
+        case -1:
+            goto GetoptDone;
+        case 'f':
+            persist_fname = optarg;
+            break;
+        case 'k':
+            sync_every = std::max(1, atoi(optarg));
+            break;
+        case 'n':
+            key_num = strtoull(optarg, NULL, 10);
+            break;
+        case 'r':
+            reopen_verify = true;
+            break;
+        case 'w':
+            if (!enum_value(optarg, &conLevel)) {
+                fprintf(stderr, "ERROR: -w %s : Invalid ConcurrentLevel\n", optarg);
+                return 1;
+            }
+            break;
+        case '?':
+        case 'h':
+        default:
+            usage(argv[0]);
+        }
+    }
+GetoptDone:
+    if (NULL == persist_fname) {
+        fprintf(stderr, "ERROR: -f Persist-File is required\n");
+        usage(argv[0]);
+    }
+    if (conLevel > Patricia::OneWriteMultiRead) {
+        fprintf(stderr, "ERROR: -w %s : persist supports up to OneWriteMultiRead\n",
+                enum_cstr(conLevel));
+        return 1;
+    }
+    fstrvec keys;
+    if (const char* input_fname = argv[optind]) {
+        Auto_fclose fp(fopen(input_fname, "r"));
+        if (!fp) {
+            fprintf(stderr, "FATAL: fopen(\"%s\", \"r\") = %s\n", input_fname, strerror(errno));
+            return 1;
+        }
+        LineBuf line;
+        while (line.getline(fp) > 0) {
+            line.chomp();
+            keys.push_back(line);
+        }
+    }
+    else {
+        char buf[64];
+        for (size_t i = 0; i < key_num; ++i) {
+            // scatter keys over the trie, so every sync dirties many pages
+            unsigned long long x = i * 0x9E3779B97F4A7C15ULL;
+            int len = snprintf(buf, sizeof(buf), "%016llx-%zd", x, i);
+            keys.push_back(fstring(buf, len));
+        }
+    }
+    ::unlink(persist_fname);
+    ::unlink((std::string(persist_fname) + ".jnl").c_str());
+    std::string pconf = "?persist=1&vm_grow=1&file_path=";
+    pconf += persist_fname;
+
+    BenchResult vol = run(keys, conLevel, "?vm_grow=1", sync_every, false);
+    BenchResult per = run(keys, conLevel, pconf, sync_every, true);
+    printf("level = %s, keys = %zd, sync every %zd\n", enum_cstr(conLevel), keys.size(), sync_every);
+    printf("volatile: %8.3f sec, %8.3f M inserts/s\n", vol.sec, keys.size() / vol.sec / 1e6);
+    printf("persist : %8.3f sec, %8.3f M inserts/s, syncs = %zd, pages = %zd, avg sync = %.3f ms, avg pages = %.1f\n",
+           per.sec, keys.size() / per.sec / 1e6, per.syncs, per.pages,
+           per.sync_ns / 1e6 / per.syncs, double(per.pages) / per.syncs);
+
+    if (reopen_verify) {
+        MainPatricia trie(sizeof(uint32_t), 0, conLevel, pconf);
+        Patricia::ReaderTokenPtr rtp(new Patricia::ReaderToken());
+        rtp->acquire(&trie);
+        size_t bad = 0;
+        for (size_t i = 0; i < keys.size(); ++i) {
+            if (!rtp->lookup(keys[i]))
+                bad++;
+        }
+        rtp->release();
+        printf("reopen: words = %zd, missing = %zd\n", trie.num_words(), bad);
+        if (bad)
+            return 1;
+    }
+    return 0;
+}
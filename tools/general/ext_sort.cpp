@@ -0,0 +1,108 @@
+#include <terark/zbs/ext_sort.hpp>
+#include <terark/util/linebuf.hpp>
+#include <terark/util/autoclose.hpp>
+#include <getopt.h>
+
+using namespace terark;
+
+int usage(const char* prog) {
+	fprintf(stderr, R"EOS(Usage: %s Options [Input-File ...]
+  sort lines by memcmp order, read stdin if no Input-File
+Options:
+    -m MemBudget: default 1G, suffix K/M/G/T is supported
+    -t Threads: threads for sorting a chunk, default 1
+    -b IoBufSize: max size of each run I/O buffer, default 1M
+    -w MaxWays: max runs merged in one pass, default 256
+    -z ZstdLevel: compress run files by zstd with level
+    -r Form runs by replacement selection
+    -u Output only the first of equal lines
+    -T TmpDir: directory of run files, default $TMPDIR or /tmp
+    -o Output-File: default stdout
+    -s Print stats to stderr
+)EOS", prog);
+	return 1;
+}
+
+int main(int argc, char* argv[]) {
+	ExternalSorter::Options opt;
+	const char* ofname = NULL;
+	bool print_stats = false;
+	for (int c; (c = getopt(argc, argv, "b:m:o:rst:T:uw:z:")) != -1; ) {
+		switch (c) {
+		case '?': return usage(argv[0]);
+		case 'b': opt.ioBufSize = ParseSizeXiB(optarg); break;
+		case 'm': opt.memBudget = ParseSizeXiB(optarg); break;
+		case 'o': ofname = optarg; break;
+		case 'r': opt.replaceSelect = true; break;
+		case 's': print_stats = true; break;
+		case 't': opt.threads = std::max(1, atoi(optarg)); break;
+		case 'T': opt.tmpDir = optarg; break;
+		case 'u': opt.unique = true; break;
+		case 'w': opt.maxWays = std::max(2, atoi(optarg)); break;
+		case 'z': opt.zstdLevel = atoi(optarg); break;
+		}
+	}
+	Auto_fclose fo;
+	if (ofname) {
+		fo = fopen(ofname, "w");
+		if (NULL == fo) {
+			fprintf(stderr, "ERROR: fopen(%s, w) = %s\n", ofname, strerror(errno));
+			return 2;
+		}
+	}
+	FILE* out = fo.self_or(stdout);
+	int argIdx = optind;
+	Auto_fclose fi;
+	FILE* in = argIdx < argc ? NULL : stdin;
+	LineBuf line;
+	auto read = [&](valvec<byte_t>* rec) {
+		for (;;) {
+			if (NULL == in) {
+				if (argIdx >= argc)
+					return false;
+				fi = fopen(argv[argIdx], "r");
+				if (NULL == fi) {
+					fprintf(stderr, "ERROR: fopen(%s, r) = %s\n", argv[argIdx], strerror(errno));
+					exit(2);
+				}
+				in = fi;
+				argIdx++;
+			}
+			if (line.getline(in) > 0) {
+				line.chomp();
+				rec->assign((const byte_t*)line.p, line.n);
+				return true;
+			}
+			if (in != stdin)
+				fi.close();
+			in = NULL;
+		}
+	};
+	auto write = [&](fstring rec) {
+		fwrite(rec.p, 1, rec.n, out);
+		putc('\n', out);
+	};
+	try {
+		ExternalSorter sorter(opt);
+		sorter.sort(read, write);
+		if (fflush(out) != 0) {
+			fprintf(stderr, "ERROR: write output = %s\n", strerror(errno));
+			return 3;
+		}
+		if (print_stats) {
+			auto& st = sorter.stats();
+			fprintf(stderr,
+				"records = %zd, bytes = %zd, out records = %zd\n"
+				"runs = %zd, run file size = %zd, merge passes = %zd\n"
+				"form runs time = %.3f's, merge time = %.3f's\n",
+				st.records, st.bytes, st.outRecords,
+				st.runs, st.runFileSize, st.passes,
+				st.formNanos / 1e9, st.mergeNanos / 1e9);
+		}
+	}
+	catch (const std::exception& ex) {
+		fprintf(stderr, "ERROR: %s\n", ex.what());
+		return 3;
+	}
+	return 0;
+}
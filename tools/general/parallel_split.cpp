@@ -9,12 +9,15 @@
 
 using namespace terark;
 
-// write system call can not write more than 2G
+// write system call can not write more than 2G, write by small chunks to
+// advance MmapSeqAdvise, which keeps readahead ahead of the write
 void fuck_write(size_t tid, int fd, const void* vbuf, size_t len) {
     const char* pbuf = (const char*)vbuf;
     size_t remain = len;
+    MmapSeqAdvise advise(pbuf, pbuf + len);
     while (remain) {
-        intptr_t len1 = std::min(remain, size_t(1)<<30);
+        advise.advance(pbuf);
+        intptr_t len1 = std::min(remain, size_t(8)<<20);
         intptr_t len2 = write(fd, pbuf, len1);
         if (len2 != len1) {
             int err = errno;
@@ -3,6 +3,7 @@
 #include <terark/fsa/fsa.hpp>
 #include <terark/fsa/dfa_mmap_header.hpp>
 #include <terark/fsa/nfa.hpp>
+#include <terark/fsa/dense_dfa_v2.hpp>
 #include <terark/fsa/virtual_machine_dfa.hpp>
 #include <terark/bitmap.hpp>
 #include <terark/util/autofree.hpp>
@@ -11,6 +12,28 @@ using namespace terark;
 
 class DenseDFA_Stat {
 public:
+	template<class DFA>
+	static void print_layout(const DFA* dfa) {
+		auto& states = dfa->internal_get_states();
+		size_t width_hist[4] = {0};
+		size_t sparse = 0;
+		for (size_t i = 0; i < states.size(); ++i) {
+			size_t n = states[i].num_sparse();
+			if (n) {
+				width_hist[states[i].sparse_width()]++;
+				sparse += n;
+			}
+		}
+		size_t states_mem = sizeof(typename DFA::state_t) * states.size();
+		size_t pool_mem = dfa->internal_get_pool().size();
+		printf("layout: states=%zd state_size=%zd states_mem=%zd pool_mem=%zd mem=%zd\n"
+			, states.size(), sizeof(typename DFA::state_t), states_mem, pool_mem
+			, states_mem + pool_mem);
+		printf("layout: labels=%d byte_class=%zd sparse_targets=%zd\n"
+			, int(DFA::label_num), dfa->num_byte_class(), sparse);
+		printf("layout: sparse states by target width: 32bit=%zd 16bit=%zd 24bit=%zd\n"
+			, width_hist[0], width_hist[1], width_hist[2]);
+	}
 	int main(int argc, char* argv[]) {
 		if (argc < 2) {
 			fprintf(stderr, "Usage: %s dfa_file\n", argv[0]);
@@ -21,6 +44,10 @@ public:
 		valvec<size_t> stack;
 		febitvec       color(dfa->v_total_states(), 0);
 		size_t nil = dfa->v_nil_state();
+		if (auto d2 = dynamic_cast<const DenseDFA_V2_uint32_288*>(&*dfa))
+			print_layout(d2);
+		else if (auto d2 = dynamic_cast<const DenseDFA_V2_uint32_288_bc64*>(&*dfa))
+			print_layout(d2);
 		if (auto vm = dynamic_cast<const VirtualMachineDFA*>(&*dfa)) {
 			for(size_t i = vm->m_dfa_cluster_num; i < vm->num_roots(); ++i) {
 				size_t root = vm->get_root(i);
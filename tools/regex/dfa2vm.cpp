@@ -4,6 +4,12 @@
 #include <terark/fsa/dense_dfa_v2.hpp>
 #include <terark/fsa/virtual_machine_dfa.hpp>
 #include <terark/fsa/virtual_machine_dfa_builder.hpp>
+#include <terark/fsa/virtual_machine_dfa_jit.hpp>
+#include <terark/util/autoclose.hpp>
+#include <terark/util/fstrvec.hpp>
+#include <terark/util/linebuf.hpp>
+#include <terark/util/profiling.hpp>
+#include <getopt.h>
 
 using namespace terark;
 
@@ -22,29 +28,121 @@ public:
 		return roots;
 	}
 
+	const char* bench_fname = NULL;
+	size_t bench_loops = 1;
+
 	template<class MyDFA>
-	void convert_to_vm(const MyDFA* dfa, const char* vm_fname) {
+	int convert_to_vm(const MyDFA* dfa, const char* vm_fname) {
 		valvec<uint32_t> roots = get_roots(dfa);
 		VirtualMachineDFA smalldfa;
 		smalldfa.build_from(*dfa, roots);
-		smalldfa.save_mmap(vm_fname);
+		if (vm_fname)
+			smalldfa.save_mmap(vm_fname);
 		printf("input.roots.size() = %d\n", (int)roots.size());
 		printf("small.roots.size() = %d\n", (int)smalldfa.num_roots());
+		if (bench_fname)
+			return bench(smalldfa);
+		return 0;
+	}
+
+	// walk each line from initial_state by interpreter and JIT
+	int bench(const VirtualMachineDFA& vm) {
+		fstrvec lines;
+		{
+			Auto_fclose fp(fopen(bench_fname, "r"));
+			if (!fp) {
+				fprintf(stderr, "ERROR: fopen(%s, r) = %s\n", bench_fname, strerror(errno));
+				return 1;
+			}
+			LineBuf line;
+			while (line.getline(fp) > 0) {
+				line.chomp();
+				lines.push_back(line);
+			}
+		}
+		profiling pf;
+		auto t0 = pf.now();
+		VirtualMachineDFA_JIT jit(&vm);
+		auto t1 = pf.now();
+		auto& st = jit.stats();
+		printf("jit: %s, compile = %.3f ms, states = %zd, code = %zd, data = %zd\n"
+			, jit.is_jitted() ? "native" : "unavailable, use interpreter"
+			, pf.mf(t0, t1), st.states, st.codeSize, st.dataSize);
+		printf("jit: cmp states = %zd, simd states = %zd, table states = %zd, uniq index maps = %zd\n"
+			, st.cmpStates, st.simdStates, st.tableStates, st.uniqIndexMaps);
+		size_t bytes = 0, sum1 = 0, sum2 = 0, diff = 0;
+		long long ns1 = 0, ns2 = 0;
+		for (size_t loop = 0; loop < bench_loops; ++loop) {
+			t0 = pf.now();
+			for (size_t i = 0; i < lines.size(); ++i) {
+				size_t pos;
+				size_t state = jit.interp_walk(&vm, initial_state, lines[i], &pos);
+				sum1 += state + pos;
+			}
+			t1 = pf.now();
+			for (size_t i = 0; i < lines.size(); ++i) {
+				size_t pos;
+				size_t state = jit.walk(initial_state, lines[i], &pos);
+				sum2 += state + pos;
+			}
+			auto t2 = pf.now();
+			ns1 += pf.ns(t0, t1);
+			ns2 += pf.ns(t1, t2);
+			bytes += lines.strpool.size();
+		}
+		for (size_t i = 0; i < lines.size(); ++i) {
+			size_t pos1, pos2;
+			size_t state1 = jit.interp_walk(&vm, initial_state, lines[i], &pos1);
+			size_t state2 = jit.walk(initial_state, lines[i], &pos2);
+			if (state1 != state2 || pos1 != pos2)
+				diff++;
+		}
+		printf("interp: %8.3f MB/s\n", bytes * 1e3 / std::max<long long>(ns1, 1));
+		printf("jit   : %8.3f MB/s\n", bytes * 1e3 / std::max<long long>(ns2, 1));
+		printf("lines = %zd, loops = %zd, mismatch = %zd\n", lines.size(), bench_loops, diff);
+		return diff || sum1 != sum2 ? 1 : 0;
+	}
+
+	void usage(const char* prog) {
+		fprintf(stderr, R"EOS(Usage: %s Options src_dfa_file [dest_vm_file]
+Options:
+    -b Bench-Text-File: walk each line from initial state by interpreter and
+       JIT, print throughput of both and verify they are same
+    -n Bench-Loops: default 1
+)EOS", prog);
 	}
 
 	int main(int argc, char* argv[]) {
-		if (argc < 3) {
-			fprintf(stderr, "Usage: %s src_dfa_file dest_vm_file\n", argv[0]);
+		for (int opt; (opt = getopt(argc, argv, "b:n:")) != -1; ) {
+			switch (opt) {
+			case 'b':
+				bench_fname = optarg;
+				break;
+			case 'n':
+				bench_loops = std::max(1, atoi(optarg));
+				break;
+			default:
+				usage(argv[0]);
+				return 1;
+			}
+		}
+		if (optind + 1 > argc || (optind + 2 > argc && !bench_fname)) {
+			usage(argv[0]);
 			return 1;
 		}
-		std::unique_ptr<BaseDFA> idfa(BaseDFA::load_from(argv[1]));
+		const char* vm_fname = optind + 1 < argc ? argv[optind + 1] : NULL;
+		std::unique_ptr<BaseDFA> idfa(BaseDFA::load_from(argv[optind]));
 		if (auto dfa = dynamic_cast<DenseDFA_uint32_320*>(idfa.get())) {
-			convert_to_vm(dfa, argv[2]);
-			return 0;
+			return convert_to_vm(dfa, vm_fname);
 		}
 		if (auto dfa = dynamic_cast<DenseDFA_V2_uint32_288*>(idfa.get())) {
-			convert_to_vm(dfa, argv[2]);
-			return 0;
+			return convert_to_vm(dfa, vm_fname);
+		}
+		if (auto dfa = dynamic_cast<DenseDFA_V2_uint32_288_bc64*>(idfa.get())) {
+			return convert_to_vm(dfa, vm_fname);
+		}
+		if (auto vm = dynamic_cast<VirtualMachineDFA*>(idfa.get())) {
+			return bench_fname ? bench(*vm) : 0;
 		}
 		return 0;
 	}
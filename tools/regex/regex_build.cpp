@@ -115,6 +115,9 @@ bool ignore_case = false;
 bool do_print_parse_tree = getenv("REGEX_BUILD_PRINT_PARSE_TREE") ? 1 : 0;
 bool limit_cluster_union_power_size = true;
 int g_minZpathLen = 2;
+size_t num_threads = 1; // for union and minimize all sub DFA
+bool compact_layout = false;
+const char* hotness_sample_file = NULL;
 
 // when enable with_submatch_capture
 //  1. bin_meta_file should likely be used together
@@ -234,6 +237,14 @@ Options:
       Timeout1: Timeout for compiling one regex
       Timeout2: Timeout for union all regex
    -P : DO NOT Limit cluster_union_power_size, default is true
+   -C : Save Large-DFA in compact layout: DenseDFA_V2 with states renumbered
+        by BFS order, sparse targets as 16/24 bit relative state id, and with
+        byte classes if the DFA has no more than 64 byte classes
+   -H Sample-Text-File: Renumber hot states to front for compact layout,
+        hotness is the visit count by matching each line of the file,
+        implies -C
+   -j Threads: Union and minimize all sub DFA by multiple threads, default 1
+      The result DFA files are identical to single thread
 
 Input-Regex-File format
    This is a tab separated text file, column 1 is the regex, other columns are
@@ -1250,7 +1261,7 @@ int build() {
 			fprintf(stderr, "   If failed, try to add option -D to build a dynamic matching FSA\n");
 		}
 		size_t timeout_us = all_regex_timeout_seconds * 1000000;
-		ps_size = unioned_dfa.dfa_union_n(alldfa, roots1, size_t(-1), timeout_us);
+		ps_size = unioned_dfa.par_dfa_union_n(alldfa, roots1, num_threads, size_t(-1), timeout_us);
 		if (0 == ps_size) { // make dfa failed
 			unioned_dfa.erase_all();
 			fprintf(stderr, "FATAL: In dfa_union_n, failed because power set explosion\n");
@@ -1292,7 +1303,10 @@ int build() {
 	roots1.pop_back(); // remove the guard 'root'
 	auto t2 = pf.now();
 	fprintf(stderr, "time: union all sub DFA: %f's\n", pf.sf(t1,t2));
-	unioned_dfa.hopcroft_multi_root_dfa(dynaRoots1, MinDFA, &dynaRoots2);
+	if (num_threads > 1)
+		unioned_dfa.par_minimize_multi_root_dfa(dynaRoots1, MinDFA, &dynaRoots2, num_threads);
+	else
+		unioned_dfa.hopcroft_multi_root_dfa(dynaRoots1, MinDFA, &dynaRoots2);
 	auto t3 = pf.now();
 #if 0
 	for (size_t i = 0; i < dynaRoots2.size(); ++i) {
@@ -1374,8 +1388,12 @@ int build() {
 	pzip.set_sigma(REGEX_DFA_SIGMA); // 259
 	pzip.m_atom_dfa_num = roots1.size()+1; // include initial_state
 	pzip.m_dfa_cluster_num = dynaRoots1.size() - (roots1.size()+1);
-	if (out_dfa_file)
-		pzip.save_mmap(out_dfa_file);
+	if (out_dfa_file) {
+		if (compact_layout)
+			save_compact(pzip, i2i);
+		else
+			pzip.save_mmap(out_dfa_file);
+	}
 	if (out_min_file) {
 		VirtualMachineDFA smalldfa;
 		smalldfa.build_from(pzip, i2i);
@@ -1386,6 +1404,73 @@ int build() {
 	return 0;
 }
 
+template<class MyDFA>
+void save_compact(const MyDFA& pzip, const valvec<size_t>& roots) {
+	valvec<size_t> hotness;
+	if (hotness_sample_file)
+		compute_hotness(pzip, hotness_sample_file, &hotness);
+	const size_t* hot = hotness_sample_file ? hotness.data() : NULL;
+	auto save = [&](auto& cdfa) {
+		cdfa.m_atom_dfa_num = pzip.m_atom_dfa_num;
+		cdfa.m_dfa_cluster_num = pzip.m_dfa_cluster_num;
+		fprintf(stderr, "Compacted_UnionDFA: states=%zd transitions=%zd mem=%zd | per-state: trans=%.3f mem=%.3f | byte_class=%zd\n"
+				, cdfa.total_states()
+				, cdfa.total_transitions()
+				, cdfa.mem_size()
+				, cdfa.total_transitions()/double(cdfa.total_states())
+				, cdfa.mem_size()/double(cdfa.total_states())
+				, cdfa.num_byte_class()
+				);
+		cdfa.save_mmap(out_dfa_file);
+	};
+	{
+		DenseDFA_V2_uint32_288_bc64 cdfa;
+		if (cdfa.build_compact(roots, pzip, hot)) {
+			save(cdfa);
+			return;
+		}
+	}
+	if (!be_quiet)
+		fprintf(stderr, "compact layout: byte classes are more than %d, use DenseDFA_V2_uint32_288\n"
+				, DenseDFA_V2_uint32_288_bc64::label_num);
+	DenseDFA_V2_uint32_288 cdfa;
+	cdfa.build_compact(roots, pzip, hot);
+	save(cdfa);
+}
+
+// hotness[s] is the visit count of state s by matching each line of fname
+template<class MyDFA>
+void compute_hotness(const MyDFA& dfa, const char* fname, valvec<size_t>* hotness) {
+	terark::Auto_fclose fp(fopen(fname, "r"));
+	if (!fp) {
+		HIGH_LIGHT("FATAL: fopen(%s, r) = %s\n", fname, strerror(errno));
+		exit(3);
+	}
+	hotness->resize_fill(dfa.total_states(), 0);
+	terark::LineBuf line;
+	while (line.getline(fp) > 0) {
+		line.chomp();
+		size_t curr = initial_state;
+		size_t i = 0;
+		(*hotness)[curr]++;
+		while (i < line.size()) {
+			if (dfa.is_pzip(curr)) {
+				fstring zs = dfa.get_zpath_data(curr, NULL);
+				size_t j = 0;
+				while (j < zs.size() && i + j < line.size() && zs[j] == line[i + j]) ++j;
+				if (j < zs.size() || (i += j) == line.size())
+					break;
+			}
+			size_t next = dfa.state_move(curr, (byte_t)line[i]);
+			if (dfa.nil_state == next)
+				break;
+			curr = next;
+			(*hotness)[curr]++;
+			i++;
+		}
+	}
+}
+
 template<class MyDFA>
 void report_conflict(const MyDFA& MinDFA, const char* fname) {
 	if (NULL == fname)
@@ -1517,7 +1602,7 @@ int main(int argc, char** argv) {
 	int dfa_type = 'd';
 	const char* finput_name = NULL;
 	for (;;) {
-		int opt = getopt(argc, argv, "a::gGhLO:o:t:c:E:s::b:z:DIqT:P");
+		int opt = getopt(argc, argv, "a::gGhj:LO:o:t:c:CE:s::b:z:DH:IqT:P");
 		switch (opt) {
 		default:
 		case 'h':
@@ -1558,6 +1643,9 @@ int main(int argc, char** argv) {
 		case 'I':
 			ignore_case = true;
 			break;
+		case 'j':
+			num_threads = std::max(1, atoi(optarg));
+			break;
 		case 'D':
 			dynamic_dfa_matching = true;
 			break;
@@ -1602,6 +1690,14 @@ int main(int argc, char** argv) {
 		case 'P':
 			limit_cluster_union_power_size = false;
 			break;
+		case 'C':
+			compact_layout = true;
+			break;
+		case 'H':
+			check_fname_begin(opt);
+			hotness_sample_file = optarg;
+			compact_layout = true;
+			break;
 		}
 	}
 GetoptDone:
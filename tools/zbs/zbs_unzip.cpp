@@ -10,6 +10,12 @@
 #include <terark/util/sortable_strvec.hpp>
 #include <terark/util/profiling.hpp>
 #include <getopt.h>
+#include <fcntl.h>
+#ifdef _MSC_VER
+	#include <io.h>
+#else
+	#include <unistd.h>
+#endif
 //#include <thread> // weired complition error in vs2015, so move to first inlcude
 #include <random>
 
@@ -24,6 +30,8 @@ void usage(const char* prog) {
 		"    -h Show this help information\n"
 		"    -t Show timing and through put\n"
 		"    -p MMAP_POPULATE(linux) or FileMapping prefetch(windows)\n"
+		"    -P Read records by pread on the file with read ahead, not by mmap\n"
+		"       only for single thread unzip\n"
 		"    -r Unzip in random order\n"
 		"    -b Bench mark loop, this will not output unzipped data\n"
 		"    -B Output as binary, do not append newline for each record\n"
@@ -37,10 +45,11 @@ int main(int argc, char* argv[]) {
 	bool timing = false;
 	bool isRandom = false;
 	bool mmapPopulate = false;
+	bool usePread = false;
 	int benchmarkLoop = false;
 	int threads = 0;
 	for (;;) {
-		int opt = getopt(argc, argv, "b:BhtrpT:");
+		int opt = getopt(argc, argv, "b:BhtrpPT:");
 		switch (opt) {
 		case -1:
 			goto GetoptDone;
@@ -59,6 +68,9 @@ int main(int argc, char* argv[]) {
 		case 'p':
 			mmapPopulate = true;
 			break;
+		case 'P':
+			usePread = true;
+			break;
 		case 'T':
 			threads = atoi(optarg);
 			break;
@@ -85,12 +97,29 @@ GetoptDone:
 	std::unique_ptr<AbstractBlobStore> ds(AbstractBlobStore::load_from_mmap(dfaFname, mmapPopulate));
 #endif
 	valvec<byte_t> rec;
+	valvec<byte_t> rdbuf;
+	intptr_t fd = -1;
+	std::unique_ptr<BlobStoreReadAhead> readAhead;
+	if (usePread) {
+		fd = ::open(dfaFname, O_RDONLY);
+		if (fd < 0) {
+			fprintf(stderr, "ERROR: open(%s) = %s\n", dfaFname, strerror(errno));
+			return 1;
+		}
+		readAhead.reset(new BlobStoreReadAhead(ds.get()));
+	}
 	long long t1 = pf.now();
 	long long t2 = t1;
 	long long num = 0;
 	long long bytes = 0;
 	auto getOne = [&](size_t recId) {
-		ds->get_record(recId, &rec);
+		if (readAhead) {
+			rec.risk_set_size(0);
+			readAhead->pread_record_append(NULL, fd, 0, recId, &rec, &rdbuf);
+		}
+		else {
+			ds->get_record(recId, &rec);
+		}
 	//	fprintf(stderr, "%08zd: len=%05zd\n", recId, rec.size());
 		bytes += rec.size();
 		if (!benchmarkLoop) {
@@ -191,6 +220,13 @@ GetoptDone:
 		num = ds->num_records();
 	}
 	long long t3 = pf.now();
+	if (readAhead && timing) {
+		fprintf(stderr, "read ahead: %12zd times, %12zd bytes\n",
+			readAhead->prefetch_cnt(), readAhead->prefetch_bytes());
+	}
+	if (fd >= 0) {
+		::close(int(fd));
+	}
 	if (timing || benchmarkLoop || threads) {
 		fprintf(stderr, "record num: %12lld\n", num);
 		fprintf(stderr, "unzip size: %12lld, avg = %8.1f\n", bytes, 1.0*bytes/num);